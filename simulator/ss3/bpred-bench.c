@@ -0,0 +1,459 @@
+/* bpred-bench.c - branch predictor throughput, footprint and accuracy */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "options.h"
+#include "bpred.h"
+#include "bptrace.h"
+#include "cbptrace.h"
+
+/*
+ * This program drives every predictor class, outside of any simulator,
+ * with synthetic branch streams and with recorded branch traces, and
+ * reports for each predictor and stream how fast the host runs its
+ * lookup and update paths, how much host memory it holds and how
+ * accurately it predicts.
+ *
+ * The synthetic streams run SITES conditional branches in a fixed order,
+ * as in a large loop body, over and over:
+ *
+ *	biased:     each branch goes its own way 90% to 99% of the time
+ *	periodic:   each branch is a loop exit, taken (P-1) of every P runs,
+ *		    P from 2 to 33
+ *	correlated: in every group of four branches, the first two are coin
+ *		    flips, the third is their exclusive or and the fourth
+ *		    repeats the first
+ *	random:     every branch is a coin flip
+ *
+ * Recorded traces are those written by sim-bpred -bptrace (or, with
+ * -cbp, BT9 traces as used by the Championship Branch Prediction).
+ *
+ * Branches are fed in chunks; only the predictor calls are timed, not
+ * the stream generation or trace decoding.  Each predictor starts cold
+ * on each stream.  The throughput is in branches per second, each branch
+ * being one bpred_lookup() and one bpred_update(); it depends on the
+ * build flags (OFLAGS in the Makefile).
+ */
+
+/* predictors benchmarked, in the default configurations of sim-bpred; the
+   table arguments are in the order bpred_create() takes them */
+static struct bench_pred_t {
+  char *name;			/* predictor name, as for -bpred */
+  enum bpred_class class;	/* predictor class */
+  unsigned int bimod_size;	/* bimod table size */
+  unsigned int l1size;		/* level-1 table size */
+  unsigned int l2size;		/* level-2 table size */
+  unsigned int meta_size;	/* meta predictor table size */
+  unsigned int shift_width;	/* history register width */
+  unsigned int xor;		/* history xor address flag */
+} bench_preds[] = {
+  { "nottaken",		BPredNotTaken,	0,	0,	0,	0,	0,   0 },
+  { "taken",		BPredTaken,	0,	0,	0,	0,	0,   0 },
+  { "bimod",		BPred2bit,	2048,	0,	0,	0,	0,   0 },
+  { "2lev",		BPred2Level,	0,	1,	1024,	0,	8,   0 },
+  { "comb",		BPredComb,	2048,	1,	1024,	1024,	8,   0 },
+  { "perceptron",	BPredPerc,	0,	128,	8,	0,	27,  0 },
+  { "alpha21264",	BPredAlpha21264,0,	1024,	1024,	4096,	10,  0 },
+  { "tage",		BPredTage,	4096,	7,	1024,	5,	130, 9 },
+  { "hperc",		BPredHPerc,	0,	1024,	8,	8,	256, 0 },
+};
+#define BENCH_NPREDS	(sizeof(bench_preds) / sizeof(bench_preds[0]))
+
+/* BTB and return-address stack of every predictor, as in sim-bpred */
+#define BENCH_BTB_SETS		512
+#define BENCH_BTB_ASSOC		4
+#define BENCH_RAS_SIZE		8
+
+/* synthetic stream patterns */
+enum bench_pattern {
+  PatBiased,			/* strongly biased branches */
+  PatPeriodic,			/* loop exits of fixed trip counts */
+  PatCorrelated,		/* branches decided by earlier branches */
+  PatRandom,			/* coin flips */
+  Pat_NUM
+};
+
+static char *pattern_names[Pat_NUM] =
+  { "biased", "periodic", "correlated", "random" };
+
+/* branches handed to the predictors at a time */
+#define BENCH_CHUNK		65536
+
+/* address of the first synthetic branch, and the distance between them */
+#define BENCH_TEXT		0x00400000
+#define BENCH_SITE_INSTS	4
+
+/* predictors to run, all if none */
+#define MAX_BENCH_PREDS		BENCH_NPREDS
+static int pred_nelt = 0;
+static char *pred_names[MAX_BENCH_PREDS];
+
+/* branches per synthetic stream */
+static unsigned int synth_branches;
+
+/* static branches in the synthetic streams */
+static unsigned int synth_sites;
+
+/* synthetic stream generator seed */
+static int synth_seed;
+
+/* branches replayed per recorded trace, 0 for all */
+static unsigned int trace_branches;
+
+/* recorded traces are BT9 traces */
+static int trace_cbp;
+
+/* print help message */
+static int help_me;
+
+/* recorded traces, from the first orphan argument on */
+static int trace_index = -1;
+
+/* synthetic stream state */
+struct synth_t {
+  enum bench_pattern pat;	/* stream pattern */
+  word_t rand;			/* xorshift generator state */
+  counter_t n;			/* branches generated */
+  word_t *site;			/* per-site bias (PatBiased) or period
+				   (PatPeriodic) */
+  int last[2];			/* outcomes of the group's first two
+				   branches (PatCorrelated) */
+};
+
+/* a stream being fed to a predictor */
+struct stream_t {
+  char *name;			/* pattern name or trace file name */
+  counter_t left;		/* branches left to feed, -1 for no limit */
+  struct synth_t *synth;	/* synthetic stream, or NULL */
+  struct bptrace_t *bpt;	/* recorded trace (sim-bpred -bptrace) */
+  struct bptrace_cursor_t cursor;/* ... and its replay cursor */
+  struct cbptrace_t *cbp;	/* recorded trace (BT9) */
+};
+
+/* next value of xorshift generator state *S */
+static word_t
+synth_rand(word_t *s)
+{
+  *s ^= *s << 13;
+  *s ^= *s >> 17;
+  *s ^= *s << 5;
+  return *s;
+}
+
+/* a coin flip from generator state *S */
+#define SYNTH_FLIP(S)		((synth_rand(S) >> 16) & 1)
+
+/* start synthetic stream SY with pattern PAT */
+static void
+synth_start(struct synth_t *sy, enum bench_pattern pat)
+{
+  unsigned int i;
+  word_t r;
+
+  sy->pat = pat;
+  sy->rand = synth_seed ? (word_t)synth_seed : 1;
+  sy->n = 0;
+  sy->last[0] = sy->last[1] = 0;
+  for (i = 0; i < synth_sites; i++)
+    {
+      r = synth_rand(&sy->rand);
+      if (pat == PatBiased)
+	{
+	  /* taken rate out of 1024: 90% to 99%, either way */
+	  sy->site[i] = 922 + (r >> 8) % 92;
+	  if (r & 1)
+	    sy->site[i] = 1024 - sy->site[i];
+	}
+      else
+	sy->site[i] = 2 + (r >> 8) % 32;
+    }
+}
+
+/* generate the next branch of synthetic stream SY into *REC */
+static void
+synth_next(struct synth_t *sy, struct bptrace_rec_t *rec)
+{
+  unsigned int i = (unsigned int)(sy->n % synth_sites);
+  counter_t iter = sy->n / synth_sites;
+  int taken = 0;
+
+  switch (sy->pat)
+    {
+    case PatBiased:
+      taken = (synth_rand(&sy->rand) >> 8) % 1024 < sy->site[i];
+      break;
+    case PatPeriodic:
+      taken = (iter % sy->site[i]) != sy->site[i] - 1;
+      break;
+    case PatCorrelated:
+      switch (i % 4)
+	{
+	case 0:
+	case 1:
+	  taken = sy->last[i % 4] = SYNTH_FLIP(&sy->rand);
+	  break;
+	case 2:
+	  taken = sy->last[0] ^ sy->last[1];
+	  break;
+	case 3:
+	  taken = sy->last[0];
+	  break;
+	}
+      break;
+    case PatRandom:
+      taken = SYNTH_FLIP(&sy->rand);
+      break;
+    default:
+      panic("bogus synthetic pattern");
+    }
+
+  rec->pc = BENCH_TEXT + i * BENCH_SITE_INSTS * sizeof(md_inst_t);
+  rec->target = rec->pc + 4 * BENCH_SITE_INSTS * sizeof(md_inst_t);
+  rec->op = BNE;
+  rec->taken = taken;
+  rec->is_call = FALSE;
+  rec->is_return = FALSE;
+  sy->n++;
+}
+
+/* fill BUF with up to N branches of stream S, returns the number filled */
+static unsigned int
+stream_fill(struct stream_t *s, struct bptrace_rec_t *buf, unsigned int n)
+{
+  unsigned int i;
+  counter_t ninsts;
+
+  if (s->left >= 0 && s->left < n)
+    n = (unsigned int)s->left;
+
+  for (i = 0; i < n; i++)
+    {
+      if (s->synth)
+	synth_next(s->synth, &buf[i]);
+      else if (s->cbp ? !cbptrace_read(s->cbp, &buf[i], &ninsts)
+	       : !bptrace_read(s->bpt, &s->cursor, &buf[i]))
+	break;
+    }
+
+  if (s->left >= 0)
+    s->left -= i;
+  return i;
+}
+
+/* drive PRED with the N branches in BUF, as sim-bpred does */
+static void
+bench_drive(struct bpred_t *pred, struct bptrace_rec_t *buf, unsigned int n)
+{
+  struct bpred_update_t update_rec;
+  struct bptrace_rec_t *rec;
+  md_addr_t pred_PC, npc;
+  unsigned int i;
+  int stack_idx;
+
+  for (i = 0; i < n; i++)
+    {
+      rec = &buf[i];
+      npc = rec->taken ? rec->target : rec->pc + sizeof(md_inst_t);
+
+      pred_PC = bpred_lookup(pred, rec->pc, rec->target, rec->op,
+			     rec->is_call, rec->is_return,
+			     &update_rec, &stack_idx);
+      if (!pred_PC)
+	pred_PC = rec->pc + sizeof(md_inst_t);
+
+      bpred_update(pred, rec->pc, npc,
+		   /* taken? */npc != rec->pc + sizeof(md_inst_t),
+		   /* pred taken? */pred_PC != rec->pc + sizeof(md_inst_t),
+		   /* correct pred? */pred_PC == npc,
+		   rec->op, &update_rec);
+    }
+}
+
+/* create predictor BP */
+static struct bpred_t *
+bench_create(struct bench_pred_t *bp)
+{
+  return bpred_create(bp->class, bp->bimod_size, bp->l1size, bp->l2size,
+		      bp->meta_size, bp->shift_width, bp->xor,
+		      BENCH_BTB_SETS, BENCH_BTB_ASSOC, /* full tags */0,
+		      BENCH_RAS_SIZE);
+}
+
+/* run predictor BP over stream S and print its results */
+static void
+bench_run(struct bench_pred_t *bp, struct stream_t *s,
+	  struct bptrace_rec_t *buf)
+{
+  struct bpred_t *pred = bench_create(bp);
+  counter_t branches = 0, updates;
+  unsigned int n;
+  clock_t start, ticks = 0;
+  double secs;
+
+  while ((n = stream_fill(s, buf, BENCH_CHUNK)) != 0)
+    {
+      start = clock();
+      bench_drive(pred, buf, n);
+      ticks += clock() - start;
+      branches += n;
+    }
+
+  secs = (double)ticks / CLOCKS_PER_SEC;
+  updates = pred->dir_hits + pred->misses;
+  fprintf(stdout, "%-11s %-12s %12.0f %9.3f %10.2f %10lu %9.4f\n",
+	  bp->name, s->name, (double)branches, secs,
+	  secs > 0.0 ? (double)branches / secs / 1e6 : 0.0,
+	  (unsigned long)bpred_host_bytes(pred),
+	  updates ? (double)pred->dir_hits / (double)updates : 0.0);
+  fflush(stdout);
+}
+
+/* run every selected predictor over every stream */
+static void
+bench_main(int argc, char **argv)
+{
+  struct bptrace_rec_t *buf;
+  struct synth_t synth;
+  struct stream_t s;
+  unsigned int i;
+  int p, k;
+
+  if (!(buf = calloc(BENCH_CHUNK, sizeof(struct bptrace_rec_t))))
+    fatal("out of virtual memory");
+  if (!(synth.site = calloc(synth_sites, sizeof(word_t))))
+    fatal("out of virtual memory");
+
+  fprintf(stdout, "%-11s %-12s %12s %9s %10s %10s %9s\n",
+	  "predictor", "stream", "branches", "seconds", "Mbr/s",
+	  "host_bytes", "dir_rate");
+
+  for (i = 0; i < BENCH_NPREDS; i++)
+    {
+      struct bench_pred_t *bp = &bench_preds[i];
+
+      if (pred_nelt)
+	{
+	  for (k = 0; k < pred_nelt; k++)
+	    if (!mystricmp(pred_names[k], bp->name))
+	      break;
+	  if (k == pred_nelt)
+	    continue;
+	}
+
+      for (p = 0; p < Pat_NUM; p++)
+	{
+	  memset(&s, 0, sizeof(s));
+	  s.name = pattern_names[p];
+	  s.left = synth_branches;
+	  s.synth = &synth;
+	  synth_start(&synth, (enum bench_pattern)p);
+	  bench_run(bp, &s, buf);
+	}
+
+      for (k = trace_index; k >= 0 && k < argc; k++)
+	{
+	  memset(&s, 0, sizeof(s));
+	  s.name = argv[k];
+	  s.left = trace_branches ? (counter_t)trace_branches : -1;
+	  if (trace_cbp)
+	    s.cbp = cbptrace_open(argv[k]);
+	  else
+	    {
+	      s.bpt = bptrace_open(argv[k]);
+	      bptrace_rewind(s.bpt, &s.cursor);
+	    }
+	  bench_run(bp, &s, buf);
+	  if (s.cbp)
+	    cbptrace_close(s.cbp);
+	  else
+	    bptrace_free(s.bpt);
+	}
+    }
+
+  fprintf(stdout,
+	  "\nMbr/s: millions of branches per second, each a lookup and an "
+	  "update\n"
+	  "dir_rate: direction hit rate (dir_hits / updates)\n");
+
+  free(synth.site);
+  free(buf);
+}
+
+/* the first orphan argument starts the recorded traces */
+static int
+orphan_fn(int i, int argc, char **argv)
+{
+  trace_index = i;
+  return /* done */FALSE;
+}
+
+int
+main(int argc, char **argv)
+{
+  struct opt_odb_t *odb;
+  unsigned int i;
+  int k;
+
+  odb = opt_new(orphan_fn);
+  opt_reg_header(odb,
+"bpred-bench: This program drives every branch predictor class with\n"
+"synthetic branch streams and with the recorded branch traces named on\n"
+"its command line, and reports throughput, host memory and accuracy.\n");
+  opt_reg_flag(odb, "-h", "print help message",
+	       &help_me, /* default */FALSE, /* !print */FALSE, NULL);
+  opt_reg_string_list(odb, "-preds",
+		      "predictors to run {nottaken|taken|bimod|2lev|comb|"
+		      "perceptron|alpha21264|tage|hperc}, all if none",
+		      pred_names, MAX_BENCH_PREDS, &pred_nelt, NULL,
+		      /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+  opt_reg_uint(odb, "-branches", "branches per synthetic stream",
+	       &synth_branches, /* default */1000000,
+	       /* print */TRUE, /* format */NULL);
+  opt_reg_uint(odb, "-sites", "static branches in the synthetic streams",
+	       &synth_sites, /* default */256,
+	       /* print */TRUE, /* format */NULL);
+  opt_reg_int(odb, "-seed", "synthetic stream generator seed",
+	      &synth_seed, /* default */1, /* print */TRUE, /* format */NULL);
+  opt_reg_uint(odb, "-max:branches",
+	       "branches replayed per recorded trace (0 = all)",
+	       &trace_branches, /* default */0,
+	       /* print */TRUE, /* format */NULL);
+  opt_reg_flag(odb, "-cbp", "recorded traces are BT9 traces",
+	       &trace_cbp, /* default */FALSE, /* print */TRUE, NULL);
+
+  opt_process_options(odb, argc, argv);
+
+  if (help_me)
+    {
+      fprintf(stderr, "Usage: %s {-options} [trace files]\n\n", argv[0]);
+      opt_print_help(odb, stderr);
+      exit(0);
+    }
+
+  if (!synth_branches || !synth_sites)
+    fatal("synthetic streams need at least one branch and one static branch");
+  for (k = 0; k < pred_nelt; k++)
+    {
+      for (i = 0; i < BENCH_NPREDS; i++)
+	if (!mystricmp(pred_names[k], bench_preds[i].name))
+	  break;
+      if (i == BENCH_NPREDS)
+	fatal("cannot parse predictor type `%s'", pred_names[k]);
+    }
+
+  bench_main(argc, argv);
+
+  opt_delete(odb);
+  return 0;
+}
@@ -62,6 +62,19 @@
 /* turn this on to enable the SimpleScalar 2.0 RAS bug */
 /* #define RAS_BUG_COMPATIBLE */
 
+/* default perceptron geometry: 128 perceptrons of 8-bit weights, 27
+   inputs (the bias and 26 history bits); it gets its own kernels */
+#define PERC_DEF_ROWS		128
+#define PERC_DEF_HIST		27
+#define PERC_DEF_WBITS		8
+
+/* non-zero if perceptron config CFG has the default geometry */
+#define PERC_DEF_GEOM(CFG)						\
+  ((CFG)->weight_i == PERC_DEF_ROWS && (CFG)->history == PERC_DEF_HIST	\
+   && (CFG)->weight_bits == PERC_DEF_WBITS)
+
+static void dir_kernels(struct bpred_t *pred);
+
 /* create a branch predictor */
 struct bpred_t *			/* branch predictory instance */
 bpred_create(enum bpred_class class,	/* type of predictor to create */
@@ -73,6 +86,7 @@ bpred_create(enum bpred_class class,	/* type of predictor to create */
 	     unsigned int xor,  	/* history xor address flag */
 	     unsigned int btb_sets,	/* number of sets in BTB */ 
 	     unsigned int btb_assoc,	/* BTB associativity */
+	     unsigned int btb_tag_bits,	/* BTB partial tag width, 0 for full */
 	     unsigned int retstack_size) /* num entries in ret-addr stack */
 {
   struct bpred_t *pred;
@@ -87,6 +101,19 @@ bpred_create(enum bpred_class class,	/* type of predictor to create */
     pred->dirpred.alpha21264 = 
       bpred_alpha21264_create(l1size, l2size, shift_width, meta_size);
     break;
+
+  case BPredTage:
+    pred->dirpred.tage =
+      bpred_tage_create(/* base */bimod_size, /* tables */l1size,
+			/* table size */l2size, /* min hist */meta_size,
+			/* max hist */shift_width, /* tag bits */xor);
+    break;
+
+  case BPredHPerc:
+    pred->dirpred.hperc =
+      bpred_hperc_create(/* tables */meta_size, /* table size */l1size,
+			 /* weight bits */l2size, /* hist */shift_width);
+    break;
   
   case BPredComb:
     /* bimodal component */
@@ -135,6 +162,8 @@ bpred_create(enum bpred_class class,	/* type of predictor to create */
   /* allocate ret-addr stack */
   switch (class) {
   case BPredAlpha21264:
+  case BPredTage:
+  case BPredHPerc:
     // -Project ///////////////////////////////////////////// Perceptron //////
   case BPredPerc:                   // Allocate BTB and retstack for perceptron as well 
     // -Project ///////////////////////////////////////////// Perceptron //////
@@ -143,32 +172,8 @@ bpred_create(enum bpred_class class,	/* type of predictor to create */
   case BPred2Level:
   case BPred2bit:
     {
-      int i;
-
       /* allocate BTB */
-      if (!btb_sets || (btb_sets & (btb_sets-1)) != 0)
-	fatal("number of BTB sets must be non-zero and a power of two");
-      if (!btb_assoc || (btb_assoc & (btb_assoc-1)) != 0)
-	fatal("BTB associativity must be non-zero and a power of two");
-
-      if (!(pred->btb.btb_data = calloc(btb_sets * btb_assoc,
-					sizeof(struct bpred_btb_ent_t))))
-	fatal("cannot allocate BTB");
-
-      pred->btb.sets = btb_sets;
-      pred->btb.assoc = btb_assoc;
-
-      if (pred->btb.assoc > 1)
-        for (i=0; i < (pred->btb.assoc*pred->btb.sets); i++)
-        {
-          if (i % pred->btb.assoc != pred->btb.assoc - 1)
-            pred->btb.btb_data[i].next = &pred->btb.btb_data[i+1];
-          else
-            pred->btb.btb_data[i].next = NULL;
-          
-          if (i % pred->btb.assoc != pred->btb.assoc - 1)
-            pred->btb.btb_data[i+1].prev = &pred->btb.btb_data[i];
-        }
+      bpred_btb_init(&pred->btb, btb_sets, btb_assoc, btb_tag_bits);
 
       /* allocate retstack */
       if ((retstack_size & (retstack_size-1)) != 0)
@@ -193,10 +198,54 @@ bpred_create(enum bpred_class class,	/* type of predictor to create */
     panic("bogus predictor class");
   }
 
+  dir_kernels(pred);
+
   return pred;
 }
 
-/* create a branch direction predictor */
+/* set the return-address stack of PRED to checkpoint its CKPT top entries
+   with every branch, and to behave as OVERFLOW past its ends */
+void
+bpred_retstack_mode(struct bpred_t *pred,/* branch predictor instance */
+		    unsigned int ckpt,	/* top entries to checkpoint */
+		    enum bpred_ras_overflow overflow)/* overflow behavior */
+{
+  if (ckpt > RAS_CKPT_MAX)
+    fatal("return-address-stack checkpoint of `%d' entries must be at "
+	  "most %d", ckpt, RAS_CKPT_MAX);
+  if (overflow < 0 || overflow >= RASOverflow_NUM)
+    panic("bogus return-address-stack overflow mode");
+
+  pred->retstack.ckpt = MIN(ckpt, (unsigned int)pred->retstack.size);
+  pred->retstack.overflow = overflow;
+}
+
+/* attach to PRED the indirect target predictor ITTAGE, the statistical
+   corrector SC and the loop predictor LOOP, any of them NULL for none; the
+   corrector and then the loop predictor may override the direction
+   predictor's prediction for conditional branches */
+void
+bpred_components(struct bpred_t *pred,	/* branch predictor instance */
+		 struct bpred_ittage_t *ittage,/* indirect target predictor */
+		 struct bpred_sc_t *sc,	/* statistical corrector */
+		 struct bpred_loop_t *loop)/* loop predictor */
+{
+  if (pred->class == BPredTaken || pred->class == BPredNotTaken)
+    panic("static predictors take no components");
+
+  pred->ittage = ittage;
+  pred->sc = sc;
+  pred->loop = loop;
+}
+
+/* keep a per-branch misprediction profile for PRED */
+void
+bpred_profile(struct bpred_t *pred)	/* branch predictor instance */
+{
+  if (!pred->prof)
+    pred->prof = bpred_prof_create();
+}
+
 struct bpred_dir_t *		/* branch direction predictor instance */
 bpred_dir_create (
   enum bpred_class class,	/* type of predictor to create */
@@ -278,38 +327,31 @@ bpred_dir_create (
     // Setting sanity checkers to make sure the perceptron predictor is initialized correctly
     case BPredPerc:
     {
-      int h;
-
-      if (!l1size)
-        fatal("perceptron: number of perceptrons `%d' must be positive", l1size);
+      if (!l1size || (l1size & (l1size-1)) != 0)
+        fatal("perceptron: number of perceptrons `%d' must be non-zero and a power of two", l1size);
       if (!shift_width)
         fatal("perceptron: history length `%d' must be positive", shift_width);
 
-      /* Clamp to internal array limits */
-      if (l1size > MAX_PERC)
-        l1size = MAX_PERC;
-      if (shift_width > MAX_HIST)
-        shift_width = MAX_HIST;
-
-      /* Map arguments to perceptron view. */
-      pred_dir->config.perc.weight_i    = l1size;
-      pred_dir->config.perc.weight_bits = l2size;
-      pred_dir->config.perc.history     = shift_width;
-      pred_dir->config.perc.lookup_out  = 0;
-      pred_dir->config.perc.i           = 0;
-
-       pred_dir->config.perc.max_weight =
-          (1 << (pred_dir->config.perc.weight_bits - 1)) - 1;
-
-      /* Initialize history to +1 (taken bias). */
-      for (h = 0; h < pred_dir->config.perc.history && h < MAX_HIST; h++)
-        pred_dir->config.perc.mask_table[h] = 1;
-
-      /* Optionally clear rest */
-      for (; h < MAX_HIST; h++)
-        pred_dir->config.perc.mask_table[h] = 0;
-
-      /* weight_table is already zeroed by calloc on bpred_dir_t. */
+      /* Map arguments to perceptron view, allocated apart from the
+         other classes' state. */
+      pred_dir->config.perc = calloc(1, sizeof(struct bpred_dir_perc_t));
+      if (!pred_dir->config.perc)
+        fatal("out of virtual memory");
+      pred_dir->config.perc->weight_i    = l1size;
+      pred_dir->config.perc->weight_bits = l2size;
+      pred_dir->config.perc->history     = shift_width;
+
+      /* training threshold, with extra stabilization for large histories */
+      pred_dir->config.perc->theta = (int)(1.93 * shift_width) + 14;
+      if (shift_width > 32)
+        pred_dir->config.perc->theta += shift_width / 4;
+
+      /* Packed weight rows sized to the configuration; the history
+         length counts the bias input, the global history starts out
+         all taken. */
+      pred_dir->config.perc->table =
+        bpred_perc_create(l1size, shift_width - 1, l2size);
+      bpred_perc_hist_init(&pred_dir->config.perc->hist);
       break;
     }
    
@@ -342,11 +384,15 @@ bpred_dir_config(
 
   case BPredPerc:
     fprintf(stream,
-            "pred_dir: %s: perceptron: %d entries, %d weight_bits, history=%d\n",
+            "pred_dir: %s: perceptron: %d entries, %d weight_bits, history=%d, "
+            "%d-bit packed weights, %s kernel\n",
             name,
-            pred_dir->config.perc.weight_i,
-            pred_dir->config.perc.weight_bits,
-            pred_dir->config.perc.history);
+            pred_dir->config.perc->weight_i,
+            pred_dir->config.perc->weight_bits,
+            pred_dir->config.perc->history,
+            pred_dir->config.perc->table->wide ? 16 : 8,
+            (PERC_DEF_GEOM(pred_dir->config.perc)
+             ? "inline" : bpred_perc_kernel_name()));
     break;
     // -Project ///////////////////////////////////////////// Perceptron //////
 
@@ -383,8 +429,19 @@ bpred_config(struct bpred_t *pred,	/* branch predictor instance */
   switch (pred->class) {
   case BPredAlpha21264:
     bpred_alpha21264_config(pred->dirpred.alpha21264, "alpha21264", stream);
-    fprintf(stream, "btb: %d sets x %d associativity\n", 
-            pred->btb.sets, pred->btb.assoc);
+    bpred_btb_config(&pred->btb, stream);
+    fprintf(stream, "ret_stack: %d entries\n", pred->retstack.size);
+    break;
+
+  case BPredTage:
+    bpred_tage_config(pred->dirpred.tage, "tage", stream);
+    bpred_btb_config(&pred->btb, stream);
+    fprintf(stream, "ret_stack: %d entries\n", pred->retstack.size);
+    break;
+
+  case BPredHPerc:
+    bpred_hperc_config(pred->dirpred.hperc, "hperc", stream);
+    bpred_btb_config(&pred->btb, stream);
     fprintf(stream, "ret_stack: %d entries\n", pred->retstack.size);
     break;
 
@@ -393,8 +450,7 @@ bpred_config(struct bpred_t *pred,	/* branch predictor instance */
 // tracking the total number of lookups, updates, and hits. 
    case BPredPerc:
     bpred_dir_config(pred->dirpred.bimod, "perceptron", stream);
-    fprintf(stream, "btb: %d sets x %d associativity",
-            pred->btb.sets, pred->btb.assoc);
+    bpred_btb_config(&pred->btb, stream);
     fprintf(stream, "ret_stack: %d entries", pred->retstack.size);
     break;
 
@@ -403,22 +459,19 @@ bpred_config(struct bpred_t *pred,	/* branch predictor instance */
     bpred_dir_config (pred->dirpred.bimod, "bimod", stream);
     bpred_dir_config (pred->dirpred.twolev, "2lev", stream);
     bpred_dir_config (pred->dirpred.meta, "meta", stream);
-    fprintf(stream, "btb: %d sets x %d associativity", 
-	    pred->btb.sets, pred->btb.assoc);
+    bpred_btb_config(&pred->btb, stream);
     fprintf(stream, "ret_stack: %d entries", pred->retstack.size);
     break;
 
   case BPred2Level:
     bpred_dir_config (pred->dirpred.twolev, "2lev", stream);
-    fprintf(stream, "btb: %d sets x %d associativity", 
-	    pred->btb.sets, pred->btb.assoc);
+    bpred_btb_config(&pred->btb, stream);
     fprintf(stream, "ret_stack: %d entries", pred->retstack.size);
     break;
 
   case BPred2bit:
     bpred_dir_config (pred->dirpred.bimod, "bimod", stream);
-    fprintf(stream, "btb: %d sets x %d associativity", 
-	    pred->btb.sets, pred->btb.assoc);
+    bpred_btb_config(&pred->btb, stream);
     fprintf(stream, "ret_stack: %d entries", pred->retstack.size);
     break;
 
@@ -432,6 +485,110 @@ bpred_config(struct bpred_t *pred,	/* branch predictor instance */
   default:
     panic("bogus branch predictor class");
   }
+
+  if (pred->ittage)
+    bpred_ittage_config(pred->ittage, stream);
+  if (pred->sc)
+    bpred_sc_config(pred->sc, stream);
+  if (pred->loop)
+    bpred_loop_config(pred->loop, stream);
+}
+
+/* host bytes held by direction predictor DIR */
+static size_t
+dir_host_bytes(struct bpred_dir_t *dir)	/* branch dir predictor inst */
+{
+  struct bpred_perc_t *p;
+  size_t bytes = sizeof(struct bpred_dir_t);
+
+  switch (dir->class)
+    {
+    case BPredPerc:
+      p = dir->config.perc->table;
+      bytes += sizeof(struct bpred_dir_perc_t) + sizeof(struct bpred_perc_t)
+	+ (size_t)p->n * (p->stride + 1)
+	  * (p->wide ? sizeof(shalf_t) : sizeof(sbyte_t));
+      break;
+    case BPred2Level:
+      bytes += dir->config.two.l1size * sizeof(int) + dir->config.two.l2size;
+      break;
+    case BPred2bit:
+      bytes += dir->config.bimod.size;
+      break;
+    default:
+      panic("bogus branch direction predictor class");
+    }
+  return bytes;
+}
+
+/* host bytes held by PRED: its tables, BTB, ret-addr stack, components and
+   profile, and the structures holding them */
+size_t					/* bytes of host memory */
+bpred_host_bytes(struct bpred_t *pred)	/* branch predictor instance */
+{
+  struct bpred_alpha21264_t *alpha;
+  struct bpred_tage_t *tage;
+  struct bpred_hperc_t *hperc;
+  size_t bytes = sizeof(struct bpred_t);
+  unsigned int n;
+
+  switch (pred->class)
+    {
+    case BPredComb:
+      bytes += dir_host_bytes(pred->dirpred.bimod)
+	+ dir_host_bytes(pred->dirpred.twolev)
+	+ dir_host_bytes(pred->dirpred.meta);
+      break;
+    case BPred2Level:
+      bytes += dir_host_bytes(pred->dirpred.twolev);
+      break;
+    case BPred2bit:
+    case BPredPerc:
+      bytes += dir_host_bytes(pred->dirpred.bimod);
+      break;
+    case BPredAlpha21264:
+      alpha = pred->dirpred.alpha21264;
+      bytes += sizeof(struct bpred_alpha21264_t) + alpha->arena_size
+	+ ALPHA21264_LINE_SIZE - 1;
+      break;
+    case BPredTage:
+      tage = pred->dirpred.tage;
+      bytes += sizeof(struct bpred_tage_t) + tage->base_size
+	+ (size_t)(tage->ntables << tage->log_size)
+	  * sizeof(struct bpred_tage_ent_t);
+      break;
+    case BPredHPerc:
+      hperc = pred->dirpred.hperc;
+      bytes += sizeof(struct bpred_hperc_t)
+	+ (hperc->ntables << hperc->log_size);
+      break;
+    case BPredTaken:
+    case BPredNotTaken:
+      break;
+    default:
+      panic("bogus predictor class");
+    }
+
+  n = pred->btb.sets * pred->btb.assoc;
+  bytes += n * (sizeof(word_t) + sizeof(md_addr_t) + sizeof(byte_t))
+    + pred->btb.sets * sizeof(qword_t);
+  bytes += pred->retstack.size * sizeof(struct bpred_btb_ent_t);
+
+  if (pred->ittage)
+    bytes += sizeof(struct bpred_ittage_t)
+      + (size_t)(pred->ittage->ntables << pred->ittage->log_size)
+        * sizeof(struct bpred_ittage_ent_t);
+  if (pred->sc)
+    bytes += sizeof(struct bpred_sc_t)
+      + ((pred->sc->ntables + 1) << pred->sc->log_size);
+  if (pred->loop)
+    bytes += sizeof(struct bpred_loop_t)
+      + pred->loop->sets * LOOP_ASSOC * sizeof(struct bpred_loop_ent_t);
+  if (pred->prof)
+    bytes += sizeof(struct bpred_prof_t)
+      + pred->prof->size * sizeof(struct bpred_prof_ent_t);
+
+  return bytes;
 }
 
 /* print predictor stats */
@@ -445,42 +602,78 @@ bpred_stats(struct bpred_t *pred,	/* branch predictor instance */
 	  (double)pred->dir_hits/(double)(pred->dir_hits+pred->misses));
 }
 
-/* register branch predictor stats */
-void
-bpred_reg_stats(struct bpred_t *pred,	/* branch predictor instance */
-		struct stat_sdb_t *sdb)	/* stats database */
+/* stats name of PRED */
+static char *
+bpred_name(struct bpred_t *pred)	/* branch predictor instance */
 {
-  char buf[512], buf1[512], *name;
+  if (pred->name)
+    return pred->name;
 
-  /* get a name for this predictor */
   switch (pred->class)
     {
     case BPredAlpha21264:
-      name = "bpred_alpha21264";
-      break;
+      return "bpred_alpha21264";
+    case BPredTage:
+      return "bpred_tage";
+    case BPredHPerc:
+      return "bpred_hperc";
       // -Project ///////////////////////////////////////////// Perceptron //////
     case BPredPerc:
-      name = "bpred_perc";
-      break;
+      return "bpred_perc";
 // -Project ///////////////////////////////////////////// Perceptron //////
     case BPredComb:
-      name = "bpred_comb";
-      break;
+      return "bpred_comb";
     case BPred2Level:
-      name = "bpred_2lev";
-      break;
+      return "bpred_2lev";
     case BPred2bit:
-      name = "bpred_bimod";
-      break;
+      return "bpred_bimod";
     case BPredTaken:
-      name = "bpred_taken";
-      break;
+      return "bpred_taken";
     case BPredNotTaken:
-      name = "bpred_nottaken";
-      break;
+      return "bpred_nottaken";
     default:
       panic("bogus branch predictor class");
     }
+}
+
+/* print the TOPN branches of the profile of PRED with the most
+   mispredictions, with the functions SYM says they are in, if non-NULL */
+void
+bpred_profile_print(struct bpred_t *pred,/* branch predictor instance */
+		    int topn,		/* branches to print */
+		    bpred_prof_sym_t sym,/* function namer, or NULL */
+		    FILE *stream)	/* output stream */
+{
+  if (!pred->prof)
+    return;
+
+  bpred_prof_print(pred->prof, bpred_name(pred), topn, sym, stream);
+  switch (pred->class)
+    {
+    case BPredComb:
+      fprintf(stream, "2nd%%: 2-level predictions, ");
+      break;
+    case BPredAlpha21264:
+      fprintf(stream, "2nd%%: global predictions, ");
+      break;
+    case BPredPerc:
+    case BPredHPerc:
+      fprintf(stream, "weak%%: outputs within theta, ");
+      break;
+    default:
+      break;
+    }
+  fprintf(stream, "over%%: overridden by the corrector or loop predictor\n");
+}
+
+/* register branch predictor stats */
+void
+bpred_reg_stats(struct bpred_t *pred,	/* branch predictor instance */
+		struct stat_sdb_t *sdb)	/* stats database */
+{
+  char buf[512], buf1[512], *name;
+
+  name = bpred_name(pred);
 
   sprintf(buf, "%s.lookups", name);
   stat_reg_counter(sdb, buf, "total number of bpred lookups",
@@ -553,6 +746,14 @@ bpred_reg_stats(struct bpred_t *pred,	/* branch predictor instance */
   stat_reg_counter(sdb, buf,
 		   "total number of address popped off of ret-addr stack",
 		   &pred->retstack_pops, 0, NULL);
+  sprintf(buf, "%s.retstack_overflows", name);
+  stat_reg_counter(sdb, buf,
+		   "total number of pushes onto a full ret-addr stack",
+		   &pred->retstack_overflows, 0, NULL);
+  sprintf(buf, "%s.retstack_underflows", name);
+  stat_reg_counter(sdb, buf,
+		   "total number of pops from an empty ret-addr stack",
+		   &pred->retstack_underflows, 0, NULL);
   sprintf(buf, "%s.used_ras.PP", name);
   stat_reg_counter(sdb, buf,
 		   "total number of RAS predictions used",
@@ -566,6 +767,16 @@ bpred_reg_stats(struct bpred_t *pred,	/* branch predictor instance */
   stat_reg_formula(sdb, buf,
 		   "RAS prediction rate (i.e., RAS hits/used RAS)",
 		   buf1, "%9.4f");
+  if (pred->class == BPredTage)
+    bpred_tage_reg_stats(pred->dirpred.tage, name, sdb);
+  else if (pred->class == BPredHPerc)
+    bpred_hperc_reg_stats(pred->dirpred.hperc, name, sdb);
+  if (pred->ittage)
+    bpred_ittage_reg_stats(pred->ittage, name, sdb);
+  if (pred->sc)
+    bpred_sc_reg_stats(pred->sc, name, sdb);
+  if (pred->loop)
+    bpred_loop_reg_stats(pred->loop, name, sdb);
 }
 
 void
@@ -585,119 +796,711 @@ bpred_after_priming(struct bpred_t *bpred)
   bpred->misses = 0;
   bpred->retstack_pops = 0;
   bpred->retstack_pushes = 0;
+  bpred->retstack_overflows = 0;
+  bpred->retstack_underflows = 0;
   bpred->ras_hits = 0;
+  if (bpred->class == BPredTage)
+    bpred_tage_reset_stats(bpred->dirpred.tage);
+  if (bpred->ittage)
+    bpred_ittage_reset_stats(bpred->ittage);
+  if (bpred->sc)
+    bpred_sc_reset_stats(bpred->sc);
+  if (bpred->loop)
+    bpred_loop_reset_stats(bpred->loop);
 }
 
 #define BIMOD_HASH(PRED, ADDR)						\
   ((((ADDR) >> 19) ^ ((ADDR) >> MD_BR_SHIFT)) & ((PRED)->config.bimod.size-1))
     /* was: ((baddr >> 16) ^ baddr) & (pred->dirpred.bimod.size-1) */
 
+/* perceptron row of the branch at ADDR, in a table of ROWS perceptrons */
+#define PERC_HASH(ROWS, ADDR)						\
+  ((((ADDR) >> 2) ^ ((ADDR) >> 13) ^ ((ADDR) >> 17)) & ((ROWS) - 1))
+
+/* 2-bit counter of the branch at BADDR in a bimodal table */
+static char *
+bimod_ctr(struct bpred_dir_t *pred_dir,	/* branch dir predictor inst */
+	  md_addr_t baddr)		/* branch address */
+{
+  return (char *)&pred_dir->config.bimod.table[BIMOD_HASH(pred_dir, baddr)];
+}
+
+/* 2-bit counter of the branch at BADDR in a 2-level predictor */
+static char *
+twolev_ctr(struct bpred_dir_t *pred_dir,/* branch dir predictor inst */
+	   md_addr_t baddr)		/* branch address */
+{
+  int l1index, l2index;
+
+  /* traverse 2-level tables */
+  l1index = (baddr >> MD_BR_SHIFT) & (pred_dir->config.two.l1size - 1);
+  l2index = pred_dir->config.two.shiftregs[l1index];
+  if (pred_dir->config.two.xor)
+    {
+#if 1
+      /* this L2 index computation is more "compatible" to McFarling's
+	 verison of it, i.e., if the PC xor address component is only
+	 part of the index, take the lower order address bits for the
+	 other part of the index, rather than the higher order ones */
+      l2index = (((l2index ^ (baddr >> MD_BR_SHIFT))
+		  & ((1 << pred_dir->config.two.shift_width) - 1))
+		 | ((baddr >> MD_BR_SHIFT)
+		    << pred_dir->config.two.shift_width));
+#else
+      l2index = l2index ^ (baddr >> MD_BR_SHIFT);
+#endif
+    }
+  else
+    {
+      l2index =
+	l2index
+	  | ((baddr >> MD_BR_SHIFT) << pred_dir->config.two.shift_width);
+    }
+  l2index = l2index & (pred_dir->config.two.l2size - 1);
+
+  /* get a pointer to prediction state information */
+  return (char *)&pred_dir->config.two.l2table[l2index];
+}
+
 /* predicts a branch direction */
 char *						/* pointer to counter */
 bpred_dir_lookup(struct bpred_dir_t *pred_dir,	/* branch dir predictor inst */
 		 md_addr_t baddr)		/* branch address */
 {
-  unsigned char *p = NULL;
+  char *p = NULL;
 
   /* Except for jumps, get a pointer to direction-prediction bits */
   switch (pred_dir->class) {
     case BPred2Level:
-      {
-	int l1index, l2index;
-
-        /* traverse 2-level tables */
-        l1index = (baddr >> MD_BR_SHIFT) & (pred_dir->config.two.l1size - 1);
-        l2index = pred_dir->config.two.shiftregs[l1index];
-        if (pred_dir->config.two.xor)
-	  {
-#if 1
-	    /* this L2 index computation is more "compatible" to McFarling's
-	       verison of it, i.e., if the PC xor address component is only
-	       part of the index, take the lower order address bits for the
-	       other part of the index, rather than the higher order ones */
-	    l2index = (((l2index ^ (baddr >> MD_BR_SHIFT))
-			& ((1 << pred_dir->config.two.shift_width) - 1))
-		       | ((baddr >> MD_BR_SHIFT)
-			  << pred_dir->config.two.shift_width));
-#else
-	    l2index = l2index ^ (baddr >> MD_BR_SHIFT);
-#endif
-	  }
-	else
-	  {
-	    l2index =
-	      l2index
-		| ((baddr >> MD_BR_SHIFT) << pred_dir->config.two.shift_width);
-	  }
-        l2index = l2index & (pred_dir->config.two.l2size - 1);
-
-        /* get a pointer to prediction state information */
-        p = &pred_dir->config.two.l2table[l2index];
-      }
+      p = twolev_ctr(pred_dir, baddr);
       break;
-      // -Project ///////////////////////////////////////////// Perceptron //////
-// Here we implement the way the look up works in the perceptron predictor.
-// This implementation is mimicing the way the perceptron predictor is implemented in the paper.
+    case BPred2bit:
+      p = bimod_ctr(pred_dir, baddr);
+      break;
+    case BPredTaken:
+    case BPredNotTaken:
+      break;
+    default:
+      panic("bogus branch direction predictor class");
+    }
+
+  return p;
+}
+
+/* rebuild the speculative perceptron history HIST, NBITS long, after
+   the branch at BADDR, described by *DIR_UPDATE_PTR, resolved with
+   outcome TAKEN: the history it saw at lookup, plus its outcome if it is
+   a conditional branch */
+static void
+perc_hist_repair(struct bpred_perc_hist_t *hist,/* perceptron history */
+		 unsigned int nbits,		/* history length */
+		 struct bpred_update_t *dir_update_ptr,/* pred state pointer */
+		 md_addr_t baddr,		/* branch address */
+		 int taken)			/* actual branch outcome */
+{
+  *hist = dir_update_ptr->perc.hist;
+  if (dir_update_ptr->dir.spec)
+    bpred_perc_hist_push(hist, nbits, taken, baddr >> MD_BR_SHIFT);
+}
+
+/*
+ * Direction predictor kernels, one set per class; bpred_create() points
+ * the predictor at the set of its class.  COND is non-zero for a
+ * conditional branch; for a jump, the lookup kernels only checkpoint and
+ * shift the history, and their result is not used.  The update kernels
+ * also undo a wrong guess still in the history of a mispredicted branch
+ * that was not squashed through bpred_recover() (e.g., in sim-bpred).
+ */
+
+/* the bimodal, 2-level and meta counters have always moved two steps
+   per update here, which earlier results depend on */
+#define CTR_STEP		2
+
+/* move 2-bit counter *CTR toward UP, saturating */
+static void
+ctr_update(char *ctr, int up)
+{
+  if (up)
+    *ctr = MIN(*ctr + CTR_STEP, 3);
+  else
+    *ctr = MAX(*ctr - CTR_STEP, 0);
+}
+
+/* shift outcome TAKEN of the branch at BADDR into its level-1 history
+   register of 2-level predictor PRED_DIR */
+static void
+twolev_hist_update(struct bpred_dir_t *pred_dir,/* branch dir predictor */
+		   md_addr_t baddr,	/* branch address */
+		   int taken)		/* actual branch outcome */
+{
+  int l1index = (baddr >> MD_BR_SHIFT) & (pred_dir->config.two.l1size - 1);
 
+  pred_dir->config.two.shiftregs[l1index] =
+    ((pred_dir->config.two.shiftregs[l1index] << 1) | (!!taken))
+    & ((1 << pred_dir->config.two.shift_width) - 1);
+}
+
+/* BPred2bit */
+
+static int
+bimod_lookup(struct bpred_t *pred, md_addr_t baddr, int cond,
+	     struct bpred_update_t *dir_update_ptr)
+{
+  if (!cond)
+    return TRUE;
+
+  dir_update_ptr->pdir1 = bimod_ctr(pred->dirpred.bimod, baddr);
+  return (*dir_update_ptr->pdir1 >= 2);
+}
+
+static void
+bimod_update(struct bpred_t *pred, md_addr_t baddr, int cond, int taken,
+	     struct bpred_update_t *dir_update_ptr)
+{
+  if (dir_update_ptr->pdir1)
+    ctr_update(dir_update_ptr->pdir1, taken);
+}
 
+/* BPred2Level */
 
-// -Project ////////////////////////////////////////////////// Perceptron
-case BPredPerc:
+static int
+twolev_lookup(struct bpred_t *pred, md_addr_t baddr, int cond,
+	      struct bpred_update_t *dir_update_ptr)
 {
-    int idx, h;
-    int sum = 0;
-    int hist_len = pred_dir->config.perc.history;
+  if (!cond)
+    return TRUE;
 
-    /* Perceptron index: hash PC -> table entry */
-    idx = (baddr >> MD_BR_SHIFT) % pred_dir->config.perc.weight_i;
-    pred_dir->config.perc.i = idx;
+  dir_update_ptr->pdir1 = twolev_ctr(pred->dirpred.twolev, baddr);
+  return (*dir_update_ptr->pdir1 >= 2);
+}
 
-    /*
-     * Compute perceptron output:
-     * y = w0 (bias) + sum( wi * xi )
-     * where xi = ±1 history bits
-     */
+static void
+twolev_update(struct bpred_t *pred, md_addr_t baddr, int cond, int taken,
+	      struct bpred_update_t *dir_update_ptr)
+{
+  /* the level-1 history is only shifted at update */
+  if (cond)
+    twolev_hist_update(pred->dirpred.twolev, baddr, taken);
+  if (dir_update_ptr->pdir1)
+    ctr_update(dir_update_ptr->pdir1, taken);
+}
 
-    /* Add bias weight (weight 0) multiplied by constant +1 */
-    sum = pred_dir->config.perc.weight_table[idx][0];
+/* BPredComb */
 
-    /* Dot product for remaining history bits */
-    for (h = 1; h < hist_len; h++)
+static int
+comb_lookup(struct bpred_t *pred, md_addr_t baddr, int cond,
+	    struct bpred_update_t *dir_update_ptr)
+{
+  char *bimod, *twolev, *meta;
+
+  if (!cond)
+    return TRUE;
+
+  bimod = bimod_ctr(pred->dirpred.bimod, baddr);
+  twolev = twolev_ctr(pred->dirpred.twolev, baddr);
+  meta = bimod_ctr(pred->dirpred.meta, baddr);
+  dir_update_ptr->pmeta = meta;
+  dir_update_ptr->dir.meta  = (*meta >= 2);
+  dir_update_ptr->dir.bimod = (*bimod >= 2);
+  dir_update_ptr->dir.twolev  = (*twolev >= 2);
+  dir_update_ptr->dir.second = (*meta >= 2);
+  if (*meta >= 2)
+    {
+      dir_update_ptr->pdir1 = twolev;
+      dir_update_ptr->pdir2 = bimod;
+    }
+  else
     {
-        int x = pred_dir->config.perc.mask_table[h];
-        if (x == 0) x = -1;       // encode history as ±1
+      dir_update_ptr->pdir1 = bimod;
+      dir_update_ptr->pdir2 = twolev;
+    }
+  return (*dir_update_ptr->pdir1 >= 2);
+}
+
+static void
+comb_update(struct bpred_t *pred, md_addr_t baddr, int cond, int taken,
+	    struct bpred_update_t *dir_update_ptr)
+{
+  /* L1 table is updated unconditionally for combining predictor too */
+  if (cond)
+    twolev_hist_update(pred->dirpred.twolev, baddr, taken);
+
+  /* both direction predictors train, the meta predictor only if their
+     directions were different, toward the one that was correct */
+  if (dir_update_ptr->pdir1)
+    ctr_update(dir_update_ptr->pdir1, taken);
+  if (dir_update_ptr->pdir2)
+    ctr_update(dir_update_ptr->pdir2, taken);
+  if (dir_update_ptr->pmeta
+      && dir_update_ptr->dir.bimod != dir_update_ptr->dir.twolev)
+    ctr_update(dir_update_ptr->pmeta, dir_update_ptr->dir.twolev == !!taken);
+}
+
+/* BPredPerc, for ROWS perceptrons over NBITS history bits: the generic
+   kernels pass the configured geometry and call the host's dot-product
+   and training kernels; the kernels for the default geometry (DEF set)
+   pass constants and run the inline 8-bit loops of bpred_perc.h, so an
+   optimizing compiler folds the row hash and shift widths and unrolls
+   the dot product and training over the constant history length */
+
+static INLINE int
+perc_lookup_k(struct bpred_t *pred, md_addr_t baddr, int cond,
+	      struct bpred_update_t *dir_update_ptr,
+	      unsigned int rows, unsigned int nbits, int def)
+{
+  struct bpred_dir_t *perc = pred->dirpred.bimod;
+  int taken;
+
+  /* every control instruction saves the history it saw, so a
+     mispredicted one can roll back the younger branches' shifts */
+  dir_update_ptr->perc.hist = perc->config.perc->hist;
+  dir_update_ptr->dir.spec = FALSE;
+  if (!cond)
+    return TRUE;
+
+  /* dot-product: bias + sum(w_i * h_i); output and row travel with the
+     branch to its update */
+  dir_update_ptr->perc.idx = PERC_HASH(rows, baddr);
+  dir_update_ptr->perc.out =
+    (def
+     ? bpred_perc_output8_n(perc->config.perc->table,
+			    dir_update_ptr->perc.idx,
+			    &perc->config.perc->hist, nbits)
+     : bpred_perc_output(perc->config.perc->table, dir_update_ptr->perc.idx,
+			 &perc->config.perc->hist));
+  taken = (dir_update_ptr->perc.out >= 0);
+  dir_update_ptr->dir.perc = taken;
+  dir_update_ptr->dir.weak =
+    (abs(dir_update_ptr->perc.out) <= perc->config.perc->theta);
+
+  /* speculatively shift in the predicted direction */
+  bpred_perc_hist_push(&perc->config.perc->hist, nbits, taken,
+		       baddr >> MD_BR_SHIFT);
+  dir_update_ptr->dir.spec = TRUE;
+  return taken;
+}
+
+static INLINE void
+perc_update_k(struct bpred_t *pred, md_addr_t baddr, int taken,
+	      struct bpred_update_t *dir_update_ptr, unsigned int nbits,
+	      int def)
+{
+  struct bpred_dir_t *perc = pred->dirpred.bimod;
+  int t = taken ? +1 : -1;
+  int y = dir_update_ptr->perc.out;
+  int abs_y = (y < 0 ? -y : y);
+
+  if (!dir_update_ptr->dir.spec)
+    return;
 
-        sum += pred_dir->config.perc.weight_table[idx][h] * x;
+  /* train on a misprediction or when the output was not confident,
+     against the history this branch was predicted with */
+  if ((t * y) <= 0 || abs_y <= perc->config.perc->theta)
+    {
+      if (def)
+	bpred_perc_train8_n(perc->config.perc->table,
+			    dir_update_ptr->perc.idx,
+			    &dir_update_ptr->perc.hist, taken, nbits);
+      else
+	bpred_perc_train(perc->config.perc->table, dir_update_ptr->perc.idx,
+			 &dir_update_ptr->perc.hist, taken);
     }
 
-    /* Store perceptron output for update() */
-    pred_dir->config.perc.lookup_out = sum;
+  if (!dir_update_ptr->dir.fixed
+      && dir_update_ptr->dir.spec_taken != !!taken)
+    perc_hist_repair(&perc->config.perc->hist, nbits,
+		     dir_update_ptr, baddr, taken);
+}
+
+static int
+perc_lookup(struct bpred_t *pred, md_addr_t baddr, int cond,
+	    struct bpred_update_t *dir_update_ptr)
+{
+  struct bpred_dir_t *perc = pred->dirpred.bimod;
+
+  return perc_lookup_k(pred, baddr, cond, dir_update_ptr,
+		       perc->config.perc->weight_i,
+		       perc->config.perc->history - 1, FALSE);
+}
+
+static void
+perc_update(struct bpred_t *pred, md_addr_t baddr, int cond, int taken,
+	    struct bpred_update_t *dir_update_ptr)
+{
+  perc_update_k(pred, baddr, taken, dir_update_ptr,
+		pred->dirpred.bimod->config.perc->history - 1, FALSE);
+}
 
-    /*
-     * Return a non-null pointer to keep interface consistent.
-     * Not actually used by perceptron predictor.
-     */
-    p = (unsigned char *)&pred_dir->config.perc.weight_table[idx][0];
+static void
+perc_repair(struct bpred_t *pred, md_addr_t baddr, int taken,
+	    struct bpred_update_t *dir_update_ptr)
+{
+  perc_hist_repair(&pred->dirpred.bimod->config.perc->hist,
+		   pred->dirpred.bimod->config.perc->history - 1,
+		   dir_update_ptr, baddr, taken);
 }
-break;
-// -Project ////////////////////////////////////////////////// Perceptron
 
+static int
+perc_lookup_def(struct bpred_t *pred, md_addr_t baddr, int cond,
+		struct bpred_update_t *dir_update_ptr)
+{
+  return perc_lookup_k(pred, baddr, cond, dir_update_ptr,
+		       PERC_DEF_ROWS, PERC_DEF_HIST - 1, TRUE);
+}
 
+static void
+perc_update_def(struct bpred_t *pred, md_addr_t baddr, int cond, int taken,
+		struct bpred_update_t *dir_update_ptr)
+{
+  perc_update_k(pred, baddr, taken, dir_update_ptr, PERC_DEF_HIST - 1, TRUE);
+}
 
+static void
+perc_repair_def(struct bpred_t *pred, md_addr_t baddr, int taken,
+		struct bpred_update_t *dir_update_ptr)
+{
+  perc_hist_repair(&pred->dirpred.bimod->config.perc->hist, PERC_DEF_HIST - 1,
+		   dir_update_ptr, baddr, taken);
+}
 
+/* BPredHPerc */
 
-// -Project ///////////////////////////////////////////// Perceptron //////
+static int
+hperc_lookup(struct bpred_t *pred, md_addr_t baddr, int cond,
+	     struct bpred_update_t *dir_update_ptr)
+{
+  struct bpred_hperc_t *hperc = pred->dirpred.hperc;
+  int taken;
+
+  /* as for the perceptron, but the weights come from all tables */
+  dir_update_ptr->perc.hist = hperc->hist;
+  dir_update_ptr->dir.spec = FALSE;
+  if (!cond)
+    return TRUE;
+
+  dir_update_ptr->perc.out = bpred_hperc_output(hperc, baddr, &hperc->hist);
+  taken = (dir_update_ptr->perc.out >= 0);
+  dir_update_ptr->dir.perc = taken;
+  dir_update_ptr->dir.weak = (abs(dir_update_ptr->perc.out) <= hperc->theta);
+
+  bpred_perc_hist_push(&hperc->hist, hperc->hist_bits, taken,
+		       baddr >> MD_BR_SHIFT);
+  dir_update_ptr->dir.spec = TRUE;
+  return taken;
+}
+
+static void
+hperc_update(struct bpred_t *pred, md_addr_t baddr, int cond, int taken,
+	     struct bpred_update_t *dir_update_ptr)
+{
+  struct bpred_hperc_t *hperc = pred->dirpred.hperc;
+
+  if (!dir_update_ptr->dir.spec)
+    return;
+
+  bpred_hperc_train(hperc, baddr, &dir_update_ptr->perc.hist,
+		    dir_update_ptr->perc.out, taken);
+  if (!dir_update_ptr->dir.fixed
+      && dir_update_ptr->dir.spec_taken != !!taken)
+    perc_hist_repair(&hperc->hist, hperc->hist_bits,
+		     dir_update_ptr, baddr, taken);
+}
+
+static void
+hperc_repair(struct bpred_t *pred, md_addr_t baddr, int taken,
+	     struct bpred_update_t *dir_update_ptr)
+{
+  perc_hist_repair(&pred->dirpred.hperc->hist, pred->dirpred.hperc->hist_bits,
+		   dir_update_ptr, baddr, taken);
+}
+
+/* BPredTage */
+
+static int
+tage_lookup(struct bpred_t *pred, md_addr_t baddr, int cond,
+	    struct bpred_update_t *dir_update_ptr)
+{
+  struct bpred_tage_t *tage = pred->dirpred.tage;
+  int taken;
+
+  /* every control instruction shifts the history, and saves the
+     history it saw for repair */
+  dir_update_ptr->tage.hist = tage->hist;
+  dir_update_ptr->dir.spec = TRUE;
+
+  if (cond)
+    taken = bpred_tage_lookup(tage, baddr, &tage->hist);
+  else
+    taken = TRUE;
+  dir_update_ptr->dir.tage = taken;
+
+  /* speculatively shift in the predicted direction */
+  bpred_tage_hist_push(tage, &tage->hist, baddr, taken);
+  return taken;
+}
+
+static void
+tage_repair(struct bpred_t *pred, md_addr_t baddr, int taken,
+	    struct bpred_update_t *dir_update_ptr)
+{
+  struct bpred_tage_t *tage = pred->dirpred.tage;
+
+  tage->hist = dir_update_ptr->tage.hist;
+  bpred_tage_hist_push(tage, &tage->hist, baddr, taken);
+}
+
+static void
+tage_update(struct bpred_t *pred, md_addr_t baddr, int cond, int taken,
+	    struct bpred_update_t *dir_update_ptr)
+{
+  if (cond)
+    bpred_tage_update(pred->dirpred.tage, baddr, &dir_update_ptr->tage.hist,
+		      dir_update_ptr->dir.tage, taken);
+
+  if (!dir_update_ptr->dir.fixed
+      && dir_update_ptr->dir.spec_taken != !!taken)
+    tage_repair(pred, baddr, taken, dir_update_ptr);
+}
+
+/* BPredAlpha21264; table sizes are specialized in bpred_alpha21264.c */
+
+static int
+alpha21264_lookup(struct bpred_t *pred, md_addr_t baddr, int cond,
+		  struct bpred_update_t *dir_update_ptr)
+{
+  struct bpred_alpha21264_t *alpha = pred->dirpred.alpha21264;
+  int taken;
+
+  /* as for the perceptron: every control instruction checkpoints the
+     history, conditional branches shift in their prediction */
+  bpred_alpha21264_checkpoint(alpha, baddr, &dir_update_ptr->alpha21264.hist);
+  dir_update_ptr->dir.spec = FALSE;
+  if (!cond)
+    return TRUE;
+
+  taken = bpred_alpha21264_lookup(alpha, baddr,
+				  &dir_update_ptr->alpha21264.hist);
+  dir_update_ptr->dir.alpha21264 = taken;
+  dir_update_ptr->dir.second =
+    bpred_alpha21264_choice(alpha, &dir_update_ptr->alpha21264.hist);
+
+  bpred_alpha21264_hist_push(alpha, baddr, taken);
+  dir_update_ptr->dir.spec = TRUE;
+  return taken;
+}
+
+/* roll the Alpha 21264 history back to the checkpoint of the branch at
+   BADDR, described by *DIR_UPDATE_PTR, and shift in its outcome TAKEN if
+   it is a conditional branch */
+static void
+alpha21264_repair(struct bpred_t *pred, md_addr_t baddr, int taken,
+		  struct bpred_update_t *dir_update_ptr)
+{
+  struct bpred_alpha21264_t *alpha = pred->dirpred.alpha21264;
+
+  bpred_alpha21264_hist_restore(alpha, &dir_update_ptr->alpha21264.hist);
+  if (dir_update_ptr->dir.spec)
+    bpred_alpha21264_hist_push(alpha, baddr, taken);
+}
+
+static void
+alpha21264_update(struct bpred_t *pred, md_addr_t baddr, int cond, int taken,
+		  struct bpred_update_t *dir_update_ptr)
+{
+  if (!dir_update_ptr->dir.spec)
+    return;
+
+  /* train the counters this branch was predicted with */
+  bpred_alpha21264_update(pred->dirpred.alpha21264, baddr,
+			  &dir_update_ptr->alpha21264.hist, taken);
+
+  if (!dir_update_ptr->dir.fixed
+      && dir_update_ptr->dir.spec_taken != !!taken)
+    alpha21264_repair(pred, baddr, taken, dir_update_ptr);
+}
+
+/* point PRED at the direction predictor kernels of its class */
+static void
+dir_kernels(struct bpred_t *pred)	/* branch predictor instance */
+{
+  struct bpred_dir_t *perc;
+
+  pred->dir_repair = NULL;
+  switch (pred->class)
+    {
     case BPred2bit:
-      p = &pred_dir->config.bimod.table[BIMOD_HASH(pred_dir, baddr)];
+      pred->dir_lookup = bimod_lookup;
+      pred->dir_update = bimod_update;
+      break;
+    case BPred2Level:
+      pred->dir_lookup = twolev_lookup;
+      pred->dir_update = twolev_update;
+      break;
+    case BPredComb:
+      pred->dir_lookup = comb_lookup;
+      pred->dir_update = comb_update;
+      break;
+    case BPredPerc:
+      perc = pred->dirpred.bimod;
+      if (PERC_DEF_GEOM(perc->config.perc))
+	{
+	  pred->dir_lookup = perc_lookup_def;
+	  pred->dir_update = perc_update_def;
+	  pred->dir_repair = perc_repair_def;
+	}
+      else
+	{
+	  pred->dir_lookup = perc_lookup;
+	  pred->dir_update = perc_update;
+	  pred->dir_repair = perc_repair;
+	}
+      break;
+    case BPredHPerc:
+      pred->dir_lookup = hperc_lookup;
+      pred->dir_update = hperc_update;
+      pred->dir_repair = hperc_repair;
+      break;
+    case BPredTage:
+      pred->dir_lookup = tage_lookup;
+      pred->dir_update = tage_update;
+      pred->dir_repair = tage_repair;
+      break;
+    case BPredAlpha21264:
+      pred->dir_lookup = alpha21264_lookup;
+      pred->dir_update = alpha21264_update;
+      pred->dir_repair = alpha21264_repair;
       break;
     case BPredTaken:
     case BPredNotTaken:
+      /* stateless */
+      pred->dir_lookup = NULL;
+      pred->dir_update = NULL;
       break;
     default:
-      panic("bogus branch direction predictor class");
+      panic("bogus predictor class");
+    }
+}
+
+/* shift outcome TAKEN of the branch at BADDR into the ITTAGE and
+   statistical corrector histories of PRED */
+static void
+comp_hist_push(struct bpred_t *pred,	/* branch predictor instance */
+	       md_addr_t baddr,		/* branch address */
+	       int taken)		/* branch outcome */
+{
+  if (pred->ittage)
+    bpred_ittage_hist_push(pred->ittage, baddr, taken);
+  if (pred->sc)
+    bpred_sc_hist_push(pred->sc, baddr, taken);
+}
+
+/* roll the ITTAGE and statistical corrector histories of PRED back to the
+   checkpoint of the branch at BADDR, described by *DIR_UPDATE_PTR, and
+   shift in its outcome TAKEN */
+static void
+comp_hist_repair(struct bpred_t *pred,	/* branch predictor instance */
+		 struct bpred_update_t *dir_update_ptr,/* pred state */
+		 md_addr_t baddr,	/* branch address */
+		 int taken)		/* actual branch outcome */
+{
+  if (pred->ittage)
+    pred->ittage->hist = dir_update_ptr->ittage.hist;
+  if (pred->sc)
+    pred->sc->hist = dir_update_ptr->sc.hist;
+  comp_hist_push(pred, baddr, dir_update_ptr->dir.uncond || taken);
+}
+
+/* push return address ADDR onto the ret-addr stack */
+static void
+ras_push(struct bpred_t *pred,		/* branch predictor instance */
+	 md_addr_t addr)		/* return address */
+{
+  struct bpred_btb_ent_t *top = &pred->retstack.stack[pred->retstack.tos];
+
+  pred->retstack_pushes++;
+
+  /* a recursive call returns where the one below it does */
+  if (pred->retstack.overflow == RASOverflowRepeat && pred->retstack.depth
+      && top->target == addr && top->count < RAS_MAX_REPEAT)
+    {
+      top->count++;
+      return;
+    }
+
+  if (pred->retstack.depth == pred->retstack.size)
+    pred->retstack_overflows++;
+  else
+    pred->retstack.depth++;
+
+  pred->retstack.tos = (pred->retstack.tos + 1) % pred->retstack.size;
+  top = &pred->retstack.stack[pred->retstack.tos];
+  top->target = addr;
+  top->count = 0;
+}
+
+/* pop the ret-addr stack into *TARGET; returns FALSE, leaving the stack
+   alone, if it is empty and the overflow mode does not wrap around */
+static int
+ras_pop(struct bpred_t *pred,		/* branch predictor instance */
+	md_addr_t *target)		/* predicted return address */
+{
+  struct bpred_btb_ent_t *top = &pred->retstack.stack[pred->retstack.tos];
+
+  if (!pred->retstack.depth)
+    {
+      pred->retstack_underflows++;
+      if (pred->retstack.overflow != RASOverflowWrap)
+	return FALSE;
+    }
+
+  pred->retstack_pops++;
+  *target = top->target;
+
+  if (top->count)
+    {
+      top->count--;
+      return TRUE;
+    }
+
+  if (pred->retstack.depth)
+    pred->retstack.depth--;
+  pred->retstack.tos = (pred->retstack.tos + pred->retstack.size - 1)
+    % pred->retstack.size;
+  return TRUE;
+}
+
+/* save the ret-addr stack TOS, depth and top entries in *DIR_UPDATE_PTR */
+static void
+ras_checkpoint(struct bpred_t *pred,	/* branch predictor instance */
+	       struct bpred_update_t *dir_update_ptr)/* pred state pointer */
+{
+  int i, j;
+
+  dir_update_ptr->ras.tos = pred->retstack.tos;
+  dir_update_ptr->ras.depth = pred->retstack.depth;
+  for (i = 0, j = pred->retstack.tos; i < pred->retstack.ckpt; i++)
+    {
+      dir_update_ptr->ras.target[i] = pred->retstack.stack[j].target;
+      dir_update_ptr->ras.count[i] = pred->retstack.stack[j].count;
+      j = (j + pred->retstack.size - 1) % pred->retstack.size;
     }
+}
+
+/* roll the ret-addr stack back to the checkpoint in *DIR_UPDATE_PTR */
+static void
+ras_restore(struct bpred_t *pred,	/* branch predictor instance */
+	    struct bpred_update_t *dir_update_ptr)/* pred state pointer */
+{
+  int i, j;
 
-  return (char *)p;
+  pred->retstack.tos = dir_update_ptr->ras.tos;
+  pred->retstack.depth = dir_update_ptr->ras.depth;
+  for (i = 0, j = pred->retstack.tos; i < pred->retstack.ckpt; i++)
+    {
+      pred->retstack.stack[j].target = dir_update_ptr->ras.target[i];
+      pred->retstack.stack[j].count = dir_update_ptr->ras.count[i];
+      j = (j + pred->retstack.size - 1) % pred->retstack.size;
+    }
 }
 
 /* probe a predictor for a next fetch address, the predictor is probed
@@ -718,8 +1521,7 @@ bpred_lookup(struct bpred_t *pred,	/* branch predictor instance */
 	     int *stack_recover_idx)	/* Non-speculative top-of-stack;
 					 * used on mispredict recovery */
 {
-  struct bpred_btb_ent_t *pbtb = NULL;
-  int index, i;
+  int index, cond, dir_taken, final_taken;
 
   if (!dir_update_ptr)
     panic("no bpred update record");
@@ -729,197 +1531,146 @@ bpred_lookup(struct bpred_t *pred,	/* branch predictor instance */
     return 0;
 
   pred->lookups++;
+  cond = ((MD_OP_FLAGS(op) & (F_CTRL|F_UNCOND)) != (F_CTRL|F_UNCOND));
 
   dir_update_ptr->dir.ras = FALSE;
+  dir_update_ptr->dir.second = FALSE;
+  dir_update_ptr->dir.weak = FALSE;
+  dir_update_ptr->dir.over = FALSE;
+  dir_update_ptr->dir.fixed = FALSE;
+  dir_update_ptr->dir.comp_spec = FALSE;
+  dir_update_ptr->loop.ent = -1;
   dir_update_ptr->pdir1 = NULL;
   dir_update_ptr->pdir2 = NULL;
   dir_update_ptr->pmeta = NULL;
 
-  /* Except for jumps, get a pointer to direction-prediction bits */
-  switch (pred->class) {
-
-    /* ---------- PERCEPTRON LOOKUP ---------- */
-    case BPredPerc:
-      if ((MD_OP_FLAGS(op) & (F_CTRL|F_UNCOND)) != (F_CTRL|F_UNCOND))
-	    {
-        int hist = pred->dirpred.bimod->config.perc.history;
-        int idx;
-        int y;
-
-        if (hist > MAX_HIST)
-          hist = MAX_HIST;
-
-        /* same index scheme as update */
-        // idx = (baddr >> 2) % pred->dirpred.bimod->config.perc.weight_i;
-        //
-
-        idx = (((baddr >> 2) ^ (baddr >> 13) ^ (baddr >> 17))
-          & (pred->dirpred.bimod->config.perc.weight_i - 1));
-        
-
-        /* dot-product: bias + Σ (w_i * h_i) */
-        y = pred->dirpred.bimod->config.perc.weight_table[idx][0]; /* bias */
-
-        for (i = 1; i < hist; i++)
-          {
-            int x = pred->dirpred.bimod->config.perc.mask_table[i];
-            if (x == 0) x = -1;
-            y += pred->dirpred.bimod->config.perc.weight_table[idx][i] * x;
-          }
-
-        /* stash output and index for update stage */
-        pred->dirpred.bimod->config.perc.lookup_out = y;
-        pred->dirpred.bimod->config.perc.i = idx;
-      }
-      
-      break;
-    /* ---------- END PERCEPTRON LOOKUP ------ */
-    case BPredAlpha21264:
-      if ((MD_OP_FLAGS(op) & (F_CTRL|F_UNCOND)) != (F_CTRL|F_UNCOND))
-      {
-        dir_update_ptr->pdir1 = 
-          (char *)bpred_alpha21264_lookup(pred->dirpred.alpha21264, baddr);
-      }
-      break;
-      
-    case BPredComb:
-      if ((MD_OP_FLAGS(op) & (F_CTRL|F_UNCOND)) != (F_CTRL|F_UNCOND))
-      {
-        char *bimod, *twolev, *meta;
-        bimod = bpred_dir_lookup (pred->dirpred.bimod, baddr);
-        twolev = bpred_dir_lookup (pred->dirpred.twolev, baddr);
-        meta = bpred_dir_lookup (pred->dirpred.meta, baddr);
-        dir_update_ptr->pmeta = meta;
-        dir_update_ptr->dir.meta  = (*meta >= 2);
-        dir_update_ptr->dir.bimod = (*bimod >= 2);
-        dir_update_ptr->dir.twolev  = (*twolev >= 2);
-        if (*meta >= 2)
-          {
-            dir_update_ptr->pdir1 = twolev;
-            dir_update_ptr->pdir2 = bimod;
-          }
-        else
-          {
-            dir_update_ptr->pdir1 = bimod;
-            dir_update_ptr->pdir2 = twolev;
-          }
-      }
-      break;
-
-    case BPred2Level:
-      if ((MD_OP_FLAGS(op) & (F_CTRL|F_UNCOND)) != (F_CTRL|F_UNCOND))
-      {
-        dir_update_ptr->pdir1 =
-          bpred_dir_lookup (pred->dirpred.twolev, baddr);
-      }
-      break;
-
-    case BPred2bit:
-      if ((MD_OP_FLAGS(op) & (F_CTRL|F_UNCOND)) != (F_CTRL|F_UNCOND))
-      {
-        dir_update_ptr->pdir1 =
-          bpred_dir_lookup (pred->dirpred.bimod, baddr);
-      }
-      break;
-    
-    case BPredTaken:
+  /* static predictors have no state to consult */
+  if (!pred->dir_lookup)
+    {
+      if (pred->class == BPredNotTaken && cond)
+	return baddr + sizeof(md_inst_t);
       return btarget;
-    case BPredNotTaken:
-      if ((MD_OP_FLAGS(op) & (F_CTRL|F_UNCOND)) != (F_CTRL|F_UNCOND))
-      {
-        return baddr + sizeof(md_inst_t);
-      }
-          else
-      {
-        return btarget;
-      }
-
-    default:
-      panic("bogus predictor class");
-  }
+    }
 
+  /* predict the direction of conditional branches, pointing the update
+     record at the direction-prediction bits where there are any, and
+     checkpoint and shift the speculative history */
+  dir_taken = pred->dir_lookup(pred, baddr, cond, dir_update_ptr);
 
   /*
    * We have a stateful predictor, and have gotten a pointer into the
    * direction predictor (except for jumps, for which the ptr is null)
    */
 
+  dir_update_ptr->dir.uncond = !cond;
+  dir_update_ptr->dir.spec_taken = TRUE;
+
+  /* every control instruction checkpoints the ITTAGE and corrector
+     histories; jumps shift in a taken bit here, conditional branches
+     their predicted direction below */
+  if (pred->ittage || pred->sc)
+    {
+      if (pred->ittage)
+	dir_update_ptr->ittage.hist = pred->ittage->hist;
+      if (pred->sc)
+	dir_update_ptr->sc.hist = pred->sc->hist;
+      dir_update_ptr->dir.comp_spec = TRUE;
+      dir_update_ptr->dir.comp_fixed = FALSE;
+      if (dir_update_ptr->dir.uncond)
+	comp_hist_push(pred, baddr, TRUE);
+    }
+
   /* record pre-pop TOS; if this branch is executed speculatively
    * and is squashed, we'll restore the TOS and hope the data
    * wasn't corrupted in the meantime. */
   if (pred->retstack.size)
-    *stack_recover_idx = pred->retstack.tos;
+    {
+      *stack_recover_idx = pred->retstack.tos;
+      dir_update_ptr->ras.recover_depth = pred->retstack.depth;
+    }
   else
     *stack_recover_idx = 0;
 
   /* if this is a return, pop return-address stack */
   if (is_return && pred->retstack.size)
   {
-    md_addr_t target = pred->retstack.stack[pred->retstack.tos].target;
-    pred->retstack.tos = (pred->retstack.tos + pred->retstack.size - 1)
-                    % pred->retstack.size;
-    pred->retstack_pops++;
-    dir_update_ptr->dir.ras = TRUE; /* using RAS here */
-    return target;
+    md_addr_t target;
+
+    if (ras_pop(pred, &target))
+      {
+	dir_update_ptr->dir.ras = TRUE; /* using RAS here */
+	ras_checkpoint(pred, dir_update_ptr);
+	return target;
+      }
   }
 
 #ifndef RAS_BUG_COMPATIBLE
   /* if function call, push return-address onto return-address stack */
   if (is_call && pred->retstack.size)
-    {
-      pred->retstack.tos = (pred->retstack.tos + 1)% pred->retstack.size;
-      pred->retstack.stack[pred->retstack.tos].target = 
-	baddr + sizeof(md_inst_t);
-      pred->retstack_pushes++;
-    }
+    ras_push(pred, baddr + sizeof(md_inst_t));
 #endif /* !RAS_BUG_COMPATIBLE */
-  
-  /* not a return. Get a pointer into the BTB */
-  index = (baddr >> MD_BR_SHIFT) & (pred->btb.sets - 1);
 
-  if (pred->btb.assoc > 1)
-  {
-    index *= pred->btb.assoc;
-
-      /* Now we know the set; look for a PC match */
-    for (i = index; i < (index+pred->btb.assoc) ; i++)
-      if (pred->btb.btb_data[i].addr == baddr)
-      {
-        /* match */
-        pbtb = &pred->btb.btb_data[i];
-        break;
-      }
-  }	
-  else
-  {
-    pbtb = &pred->btb.btb_data[index];
-    if (pbtb->addr != baddr)
-    pbtb = NULL;
-  }
+  /* checkpoint the stack as this branch leaves it */
+  if (pred->retstack.size)
+    ras_checkpoint(pred, dir_update_ptr);
+  
+  /* not a return. Look the branch up in the BTB */
+  index = bpred_btb_lookup(&pred->btb, baddr);
 
   /*
-   * We now also have a pointer into the BTB for a hit, or NULL otherwise
+   * We now also have an index into the BTB for a hit, or -1 otherwise
    */
 
   /* if this is a jump, ignore predicted direction; we know it's taken. */
-  if ((MD_OP_FLAGS(op) & (F_CTRL|F_UNCOND)) == (F_CTRL|F_UNCOND))
+  if (!cond)
   {
-    return (pbtb ? pbtb->target : 1);
+    md_addr_t target;
+
+    /* indirect jumps ask the indirect target predictor first */
+    if (pred->ittage && (MD_OP_FLAGS(op) & F_INDIRJMP)
+	&& bpred_ittage_lookup(pred->ittage, baddr,
+			       &dir_update_ptr->ittage.hist, &target))
+      return target;
+
+    return (index >= 0 ? pred->btb.targets[index] : 1);
   }
 
   /* otherwise we have a conditional branch */
-  if (pbtb == NULL)
+
+  /* the statistical corrector and then the loop predictor may reverse
+     the direction predictor, whose history then takes the final
+     direction instead of its own */
+  final_taken = !!dir_taken;
+  if (pred->sc)
+    final_taken = bpred_sc_lookup(pred->sc, baddr, &dir_update_ptr->sc.hist,
+				  final_taken, &dir_update_ptr->sc.ck);
+  if (pred->loop)
+    final_taken = bpred_loop_lookup(pred->loop, baddr, final_taken,
+				    &dir_update_ptr->loop);
+  if (final_taken != !!dir_taken)
+    {
+      dir_update_ptr->dir.over = TRUE;
+      if (pred->dir_repair)
+	pred->dir_repair(pred, baddr, final_taken, dir_update_ptr);
+      dir_taken = final_taken;
+    }
+  dir_update_ptr->dir.spec_taken = final_taken;
+
+  if (dir_update_ptr->dir.comp_spec)
+    comp_hist_push(pred, baddr, final_taken);
+
+  if (index < 0)
   {
     /* BTB miss -- just return a predicted direction */
-    return ((*(dir_update_ptr->pdir1) >= 2)
+    return (dir_taken
       ? /* taken */ 1
       : /* not taken */ 0);
   }
   else
   {
     /* BTB hit, so return target if it's a predicted-taken branch */
-    return ((*(dir_update_ptr->pdir1) >= 2)
-      ? /* taken */ pbtb->target
+    return (dir_taken
+      ? /* taken */ pred->btb.targets[index]
       : /* not taken */ 0);
   }
 }
@@ -931,13 +1682,41 @@ bpred_lookup(struct bpred_t *pred,	/* branch predictor instance */
 void
 bpred_recover(struct bpred_t *pred,	/* branch predictor instance */
 	      md_addr_t baddr,		/* branch address */
-	      int stack_recover_idx)	/* Non-speculative top-of-stack;
+	      int stack_recover_idx,	/* Non-speculative top-of-stack;
 					 * used on mispredict recovery */
+	      struct bpred_update_t *dir_update_ptr,/* pred state pointer */
+	      int taken)		/* non-zero if branch was taken */
 {
   if (pred == NULL)
     return;
 
-  pred->retstack.tos = stack_recover_idx;
+  if (pred->retstack.size
+      && (pred->retstack.ckpt || pred->retstack.overflow != RASOverflowWrap))
+    ras_restore(pred, dir_update_ptr);
+  else
+    {
+      /* restore the depth that goes with the TOS, the one before this
+	 branch's push or pop, or after it (a call recovered at dispatch
+	 keeps its push) */
+      pred->retstack.tos = stack_recover_idx;
+      if (pred->retstack.size)
+	pred->retstack.depth = (stack_recover_idx == dir_update_ptr->ras.tos
+				? dir_update_ptr->ras.depth
+				: dir_update_ptr->ras.recover_depth);
+    }
+
+  if (pred->dir_repair)
+    pred->dir_repair(pred, baddr, taken, dir_update_ptr);
+  dir_update_ptr->dir.fixed = TRUE;
+
+  if (dir_update_ptr->dir.comp_spec)
+    {
+      comp_hist_repair(pred, dir_update_ptr, baddr, taken);
+      dir_update_ptr->dir.comp_fixed = TRUE;
+    }
+
+  if (pred->loop)
+    bpred_loop_recover(pred->loop, &dir_update_ptr->loop, taken);
 }
 
 /* update the branch predictor, only useful for stateful predictors; updates
@@ -958,9 +1737,6 @@ bpred_update(struct bpred_t *pred,	/* branch predictor instance */
 	     enum md_opcode op,		/* opcode of instruction */
 	     struct bpred_update_t *dir_update_ptr)/* pred state pointer */
 {
-  struct bpred_btb_ent_t *pbtb = NULL;
-  struct bpred_btb_ent_t *lruhead = NULL, *lruitem = NULL;
-  int index, i;
 
   /* don't change bpred state for non-branch instructions or if this
    * is a stateless predictor*/
@@ -977,6 +1753,20 @@ bpred_update(struct bpred_t *pred,	/* branch predictor instance */
   else
     pred->misses++;
 
+  if (pred->prof)
+    {
+      struct bpred_prof_ent_t *ent = bpred_prof_find(pred->prof, baddr);
+
+      ent->lookups++;
+      if (!correct)
+	ent->misses++;
+      if (taken)
+	ent->taken++;
+      ent->second += dir_update_ptr->dir.second;
+      ent->weak += dir_update_ptr->dir.weak;
+      ent->over += dir_update_ptr->dir.over;
+    }
+
   if (dir_update_ptr->dir.ras)
   {
     pred->used_ras++;
@@ -990,12 +1780,7 @@ bpred_update(struct bpred_t *pred,	/* branch predictor instance */
     else
       pred->used_bimod++;
   }
-  
-  if ((MD_OP_FLAGS(op) & (F_CTRL|F_UNCOND)) != (F_CTRL|F_UNCOND) &&
-    pred->class == BPredAlpha21264)
-  {
-    bpred_alpha21264_update(pred->dirpred.alpha21264, baddr, taken);
-  }
+
 
   /* keep stats about JR's; also, but don't change any bpred state for JR's
    * which are returns unless there's no retstack */
@@ -1019,7 +1804,7 @@ bpred_update(struct bpred_t *pred,	/* branch predictor instance */
   }
 
   /* Can exit now if this is a stateless predictor */
-  if (pred->class == BPredNotTaken || pred->class == BPredTaken)
+  if (!pred->dir_update)
     return;
 
   /* 
@@ -1030,300 +1815,308 @@ bpred_update(struct bpred_t *pred,	/* branch predictor instance */
 #ifdef RAS_BUG_COMPATIBLE
   /* if function call, push return-address onto return-address stack */
   if (MD_IS_CALL(op) && pred->retstack.size)
-    {
-      pred->retstack.tos = (pred->retstack.tos + 1)% pred->retstack.size;
-      pred->retstack.stack[pred->retstack.tos].target = 
-	    baddr + sizeof(md_inst_t);
-      pred->retstack_pushes++;
-    }
+    ras_push(pred, baddr + sizeof(md_inst_t));
 #endif /* RAS_BUG_COMPATIBLE */
 
-  /* update L1 table if appropriate */
-  /* L1 table is updated unconditionally for combining predictor too */
-  if ((MD_OP_FLAGS(op) & (F_CTRL|F_UNCOND)) != (F_CTRL|F_UNCOND) &&
-      (pred->class == BPred2Level || pred->class == BPredComb))
-  {
-    int l1index, shift_reg;
-    
-    /* also update appropriate L1 history register */
-    l1index = (baddr >> MD_BR_SHIFT) & (pred->dirpred.twolev->config.two.l1size - 1);
-    shift_reg = (pred->dirpred.twolev->config.two.shiftregs[l1index] << 1) | (!!taken);
-    pred->dirpred.twolev->config.two.shiftregs[l1index] = shift_reg & ((1 << pred->dirpred.twolev->config.two.shift_width) - 1);
-  }
+  /* train the direction predictor (but not for jumps) */
+  pred->dir_update(pred, baddr,
+		   (MD_OP_FLAGS(op) & (F_CTRL|F_UNCOND)) != (F_CTRL|F_UNCOND),
+		   taken, dir_update_ptr);
 
-  /* find BTB entry if it's a taken branch (don't allocate for non-taken) */
-  if (taken)
-  {
-    index = (baddr >> MD_BR_SHIFT) & (pred->btb.sets - 1);
-    
-    if (pred->btb.assoc > 1)
+  if (dir_update_ptr->dir.comp_spec)
     {
-      index *= pred->btb.assoc;
-      
-      /* Now we know the set; look for a PC match; also identify
-      * MRU and LRU items */
-      for (i = index; i < (index+pred->btb.assoc) ; i++)
-        {
-          if (pred->btb.btb_data[i].addr == baddr)
-            {
-              /* match */
-              assert(!pbtb);
-              pbtb = &pred->btb.btb_data[i];
-            }
-          
-          dassert(pred->btb.btb_data[i].prev != pred->btb.btb_data[i].next);
-          if (pred->btb.btb_data[i].prev == NULL)
-          {
-            /* this is the head of the lru list, ie current MRU item */
-            dassert(lruhead == NULL);
-            lruhead = &pred->btb.btb_data[i];
-          }
-
-          if (pred->btb.btb_data[i].next == NULL)
-          {
-            /* this is the tail of the lru list, ie the LRU item */
-            dassert(lruitem == NULL);
-            lruitem = &pred->btb.btb_data[i];
-          }
-        }
-      dassert(lruhead && lruitem);
-      
-      if (!pbtb)
-        /* missed in BTB; choose the LRU item in this set as the victim */
-        pbtb = lruitem;	
-      /* else hit, and pbtb points to matching BTB entry */
-      
-      /* Update LRU state: selected item, whether selected because it
-      * matched or because it was LRU and selected as a victim, becomes 
-      * MRU */
-      if (pbtb != lruhead)
-      {
-        /* this splices out the matched entry... */
-        if (pbtb->prev)
-          pbtb->prev->next = pbtb->next;
-        if (pbtb->next)
-          pbtb->next->prev = pbtb->prev;
-        /* ...and this puts the matched entry at the head of the list */
-        pbtb->next = lruhead;
-        pbtb->prev = NULL;
-        lruhead->prev = pbtb;
-        dassert(pbtb->prev || pbtb->next);
-        dassert(pbtb->prev != pbtb->next);
-      }
-      /* else pbtb is already MRU item; do nothing */
+      /* train on the targets of jumps that did not use the RAS */
+      if (pred->ittage && (MD_OP_FLAGS(op) & F_INDIRJMP))
+	bpred_ittage_update(pred->ittage, baddr, &dir_update_ptr->ittage.hist,
+			    btarget, correct);
+
+      /* and on the directions of conditional branches */
+      if (pred->sc && !dir_update_ptr->dir.uncond)
+	bpred_sc_update(pred->sc, baddr, &dir_update_ptr->sc.hist,
+			&dir_update_ptr->sc.ck, taken);
+
+      /* as for the perceptron, undo a wrong guess still in the history */
+      if (!dir_update_ptr->dir.comp_fixed
+	  && dir_update_ptr->dir.spec_taken
+	     != (dir_update_ptr->dir.uncond || !!taken))
+	comp_hist_repair(pred, dir_update_ptr, baddr, taken);
     }
-    else
-      pbtb = &pred->btb.btb_data[index];
-  }
-      
-  /* 
-   * Now 'p' is a possibly null pointer into the direction prediction table, 
-   * and 'pbtb' is a possibly null pointer into the BTB (either to a 
-   * matched-on entry or a victim which was LRU in its set)
-   */
 
-  /* update state (but not for jumps) */
-  if (pred->class == BPredAlpha21264)
-  {
-    /* delegate updates to Alpha 21264 specific updater */
-    if (pred->dirpred.alpha21264)
-      bpred_alpha21264_update(pred->dirpred.alpha21264, baddr, taken);
-  }
-  else
-  {
-    if (dir_update_ptr->pdir1)
-    {
-      if (taken)
-      {
-        if (*dir_update_ptr->pdir1 < 3)
-      ++*dir_update_ptr->pdir1;
-      }
-      else
-      { /* not taken */
-        if (*dir_update_ptr->pdir1 > 0)
-      --*dir_update_ptr->pdir1;
-      }
-    }
+  if (pred->loop && (MD_OP_FLAGS(op) & (F_CTRL|F_COND)) == (F_CTRL|F_COND))
+    bpred_loop_update(pred->loop, baddr, &dir_update_ptr->loop, taken);
 
-      /* combining predictor also updates second predictor and meta predictor */
-      /* second direction predictor */
-    if (dir_update_ptr->pdir2)
-    {
-      if (taken)
-      {
-        if (*dir_update_ptr->pdir2 < 3)
-      ++*dir_update_ptr->pdir2;
-      }
-      else
-      { /* not taken */
-        if (*dir_update_ptr->pdir2 > 0)
-      --*dir_update_ptr->pdir2;
-      }
-    }
+  /* update BTB (but only for taken branches, don't allocate for
+     non-taken) */
+  if (taken)
+    bpred_btb_update(&pred->btb, baddr, btarget, op, correct);
+}
 
-      /* meta predictor */
-    if (dir_update_ptr->pmeta)
-    {
-      if (dir_update_ptr->dir.bimod != dir_update_ptr->dir.twolev)
-      {
-        /* we only update meta predictor if directions were different */
-        if (dir_update_ptr->dir.twolev == (unsigned int)taken)
-        {
-          /* 2-level predictor was correct */
-          if (*dir_update_ptr->pmeta < 3)
-            ++*dir_update_ptr->pmeta;
-        }
-          else
-        {
-          /* bimodal predictor was correct */
-          if (*dir_update_ptr->pmeta > 0)
-            --*dir_update_ptr->pmeta;
-        }
-      }
-    }
-    /* ---------- PERCEPTRON UPDATE SEPARATED FROM BIMODAL ---------- */
-    if (pred->class == BPredPerc)
-    {
-      int idx;
-      int t = taken ? +1 : -1;
-      int y = pred->dirpred.bimod->config.perc.lookup_out;
-      int hist = pred->dirpred.bimod->config.perc.history;
-      int MAXW = pred->dirpred.bimod->config.perc.max_weight;
 
-      if (hist > MAX_HIST)
-        hist = MAX_HIST;
+/* predictor snapshot file magic and format version */
+#define SNAP_MAGIC		0x53534250	/* "SSBP" */
+#define SNAP_VERSION		2
 
-      /* index recomputed (same as lookup) */
-      // idx = (baddr >> 2) % pred->dirpred.bimod->config.perc.weight_i;
-      //
+/* write the SIZE bytes at BUF to snapshot FD if SAVE, else read them */
+static void
+snap_io(FILE *fd, int save, void *buf, size_t size)
+{
+  if (!size)
+    return;
+  if (save ? fwrite(buf, size, 1, fd) != 1 : fread(buf, size, 1, fd) != 1)
+    fatal("predictor snapshot: cannot %s %lu bytes",
+	  save ? "write" : "read", (unsigned long)size);
+}
 
-      idx = (((baddr >> 2) ^ (baddr >> 13) ^ (baddr >> 17))
-        & (pred->dirpred.bimod->config.perc.weight_i - 1));
-        
+/* read or write variable V */
+#define SNAP(FD, SAVE, V)	snap_io((FD), (SAVE), &(V), sizeof(V))
 
-      // {
-        int abs_y = (y < 0 ? -y : y);
-        int theta = (int)(1.93 * hist) + 14;
+/* write geometry value VAL, or check that the snapshot has VAL for WHAT */
+static void
+snap_check(FILE *fd, int save, unsigned int val, char *what)
+{
+  unsigned int snap_val = val;
 
-      /* Extra stabilization for large histories */
-      if (hist > 32)
-        theta += hist / 4;
+  SNAP(fd, save, snap_val);
+  if (snap_val != val)
+    fatal("predictor snapshot has %s %u, this predictor has %u",
+	  what, snap_val, val);
+}
 
-      if ((t * y) <= 0 || abs_y <= theta)
-      {
-        /* bias weight w0 */
-        int w0 = pred->dirpred.bimod->config.perc.weight_table[idx][0];
-        w0 += t;
-        if (w0 > MAXW)  w0 = MAXW;
-        if (w0 < -MAXW) w0 = -MAXW;
-        pred->dirpred.bimod->config.perc.weight_table[idx][0] = w0;
-
-        /* other weights */
-        for (i = 1; i < hist; i++)
-        {
-          int x = pred->dirpred.bimod->config.perc.mask_table[i];
-          if (x == 0) x = -1;
-          int w = pred->dirpred.bimod->config.perc.weight_table[idx][i];
-
-          w += (t == x) ? 1 : -1;
-
-          if (w > MAXW)  w = MAXW;
-          if (w < -MAXW) w = -MAXW;
-
-          pred->dirpred.bimod->config.perc.weight_table[idx][i] = w;
-        }
-      }
-        // }
+/* snap_check() each of the N geometry values at VALS */
+static void
+snap_check_list(FILE *fd, int save, unsigned int *vals, unsigned int n,
+		char *what)
+{
+  unsigned int i;
 
-        /* history shift */
-      
+  for (i = 0; i < n; i++)
+    snap_check(fd, save, vals[i], what);
+}
 
-      /* Correct history shift: move older to the front */
-      for (i = 0; i < hist - 1; i++)
-        pred->dirpred.bimod->config.perc.mask_table[i] =
-            pred->dirpred.bimod->config.perc.mask_table[i + 1];
+/* read or write the state of direction predictor DIR */
+static void
+snap_dir(FILE *fd, int save, struct bpred_dir_t *dir)
+{
+  struct bpred_perc_t *p;
+  size_t esize;
 
-      /* Insert newest outcome at the END */
-      pred->dirpred.bimod->config.perc.mask_table[hist - 1] =
-          (taken ? +1 : -1);
+  snap_check(fd, save, dir->class, "direction predictor class");
+  switch (dir->class)
+    {
+    case BPredPerc:
+      p = dir->config.perc->table;
+      esize = p->wide ? sizeof(shalf_t) : sizeof(sbyte_t);
+      snap_check(fd, save, p->n, "perceptrons");
+      snap_check(fd, save, p->stride, "perceptron row length");
+      snap_check(fd, save, esize, "perceptron weight size");
+      snap_check(fd, save, dir->config.perc->history,
+		 "perceptron history length");
+      snap_check(fd, save, dir->config.perc->weight_bits,
+		 "perceptron weight width");
+      snap_io(fd, save, p->weights, (size_t)p->n * p->stride * esize);
+      snap_io(fd, save, p->bias, (size_t)p->n * esize);
+      SNAP(fd, save, dir->config.perc->theta);
+      SNAP(fd, save, dir->config.perc->hist);
+      break;
+    case BPred2Level:
+      snap_check(fd, save, dir->config.two.l1size, "level-1 size");
+      snap_check(fd, save, dir->config.two.l2size, "level-2 size");
+      snap_check(fd, save, dir->config.two.shift_width,
+		 "level-1 history width");
+      snap_check(fd, save, dir->config.two.xor, "history xor flag");
+      snap_io(fd, save, dir->config.two.shiftregs,
+	      dir->config.two.l1size * sizeof(int));
+      snap_io(fd, save, dir->config.two.l2table, dir->config.two.l2size);
+      break;
+    case BPred2bit:
+      snap_check(fd, save, dir->config.bimod.size, "bimodal size");
+      snap_io(fd, save, dir->config.bimod.table, dir->config.bimod.size);
+      break;
+    default:
+      panic("bogus branch direction predictor class");
+    }
+}
 
+/* read or write the state of PRED, not including stats */
+static void
+snap_pred(FILE *fd, int save, struct bpred_t *pred)
+{
+  struct bpred_alpha21264_t *alpha;
+  struct bpred_tage_t *tage;
+  struct bpred_hperc_t *hperc;
+  unsigned int n;
 
-      /* do NOT touch bimodal counters; done for this branch */
-      return;
+  snap_check(fd, save, pred->class, "predictor class");
+  switch (pred->class)
+    {
+    case BPredComb:
+      snap_dir(fd, save, pred->dirpred.bimod);
+      snap_dir(fd, save, pred->dirpred.twolev);
+      snap_dir(fd, save, pred->dirpred.meta);
+      break;
+    case BPred2Level:
+      snap_dir(fd, save, pred->dirpred.twolev);
+      break;
+    case BPred2bit:
+    case BPredPerc:
+      snap_dir(fd, save, pred->dirpred.bimod);
+      break;
+    case BPredAlpha21264:
+      alpha = pred->dirpred.alpha21264;
+      snap_check(fd, save, alpha->arena_size, "Alpha 21264 table bytes");
+      snap_check(fd, save, alpha->local_size,
+		 "Alpha 21264 local history table size");
+      snap_check(fd, save, alpha->local_hist_width,
+		 "Alpha 21264 local history width");
+      snap_check(fd, save, alpha->local_pred_size,
+		 "Alpha 21264 local predictor size");
+      snap_check(fd, save, alpha->global_hist_width,
+		 "Alpha 21264 global history width");
+      snap_check(fd, save, alpha->global_pred_size,
+		 "Alpha 21264 global predictor size");
+      snap_check(fd, save, alpha->choice_size,
+		 "Alpha 21264 choice predictor size");
+      snap_io(fd, save, alpha->local_pred, alpha->arena_size);
+      SNAP(fd, save, alpha->global_hist);
+      SNAP(fd, save, alpha->log);
+      SNAP(fd, save, alpha->log_pos);
+      break;
+    case BPredTage:
+      tage = pred->dirpred.tage;
+      snap_check(fd, save, tage->base_size, "TAGE base size");
+      snap_check(fd, save, tage->ntables, "TAGE tables");
+      snap_check(fd, save, tage->log_size, "TAGE table size");
+      snap_check(fd, save, tage->tag_bits, "TAGE tag width");
+      snap_check_list(fd, save, tage->hist_len, tage->ntables,
+		      "TAGE history length");
+      snap_io(fd, save, tage->base, tage->base_size);
+      snap_io(fd, save, tage->tables, (size_t)(tage->ntables << tage->log_size)
+	      * sizeof(struct bpred_tage_ent_t));
+      SNAP(fd, save, tage->use_alt_on_na);
+      SNAP(fd, save, tage->tick);
+      SNAP(fd, save, tage->lfsr);
+      SNAP(fd, save, tage->ghist);
+      SNAP(fd, save, tage->hist);
+      break;
+    case BPredHPerc:
+      hperc = pred->dirpred.hperc;
+      snap_check(fd, save, hperc->ntables, "hashed perceptron tables");
+      snap_check(fd, save, hperc->log_size, "hashed perceptron table size");
+      snap_check(fd, save, hperc->hist_bits,
+		 "hashed perceptron history length");
+      snap_check(fd, save, hperc->weight_bits,
+		 "hashed perceptron weight width");
+      snap_check_list(fd, save, hperc->seg_start, hperc->ntables,
+		      "hashed perceptron segment start");
+      snap_check_list(fd, save, hperc->seg_len, hperc->ntables,
+		      "hashed perceptron segment length");
+      snap_io(fd, save, hperc->weights, hperc->ntables << hperc->log_size);
+      SNAP(fd, save, hperc->theta);
+      SNAP(fd, save, hperc->theta_ctr);
+      SNAP(fd, save, hperc->hist);
+      break;
+    case BPredTaken:
+    case BPredNotTaken:
+      break;
+    default:
+      panic("bogus predictor class");
     }
-    /* ---------- END PERCEPTRON UPDATE ----------------------------- */
 
-    /* update state (but not for jumps) */
-    if (dir_update_ptr->pdir1)
+  /* BTB and return-address stack */
+  n = pred->btb.sets * pred->btb.assoc;
+  snap_check(fd, save, pred->btb.sets, "BTB sets");
+  snap_check(fd, save, pred->btb.assoc, "BTB associativity");
+  snap_check(fd, save, pred->btb.tag_bits, "BTB tag width");
+  snap_io(fd, save, pred->btb.tags, n * sizeof(word_t));
+  snap_io(fd, save, pred->btb.targets, n * sizeof(md_addr_t));
+  snap_io(fd, save, pred->btb.kinds, n * sizeof(byte_t));
+  snap_io(fd, save, pred->btb.plru, pred->btb.sets * sizeof(qword_t));
+
+  snap_check(fd, save, pred->retstack.size, "return-address stack size");
+  snap_check(fd, save, pred->retstack.overflow,
+	     "return-address stack overflow policy");
+  snap_io(fd, save, pred->retstack.stack,
+	  pred->retstack.size * sizeof(struct bpred_btb_ent_t));
+  SNAP(fd, save, pred->retstack.tos);
+  SNAP(fd, save, pred->retstack.depth);
+
+  /* components */
+  snap_check(fd, save, pred->ittage ? pred->ittage->ntables : 0,
+	     "ITTAGE tables");
+  if (pred->ittage)
     {
-      if (taken)
-      {
-        if (*dir_update_ptr->pdir1 < 3)
-          ++*dir_update_ptr->pdir1;
-      }
-      else
-      { /* not taken */
-        if (*dir_update_ptr->pdir1 > 0)
-          --*dir_update_ptr->pdir1;
-      }
+      snap_check(fd, save, pred->ittage->log_size, "ITTAGE table size");
+      snap_check(fd, save, pred->ittage->tag_bits, "ITTAGE tag width");
+      snap_check_list(fd, save, pred->ittage->hist_len,
+		      pred->ittage->ntables, "ITTAGE history length");
+      snap_io(fd, save, pred->ittage->tables,
+	      (size_t)(pred->ittage->ntables << pred->ittage->log_size)
+	      * sizeof(struct bpred_ittage_ent_t));
+      SNAP(fd, save, pred->ittage->tick);
+      SNAP(fd, save, pred->ittage->lfsr);
+      SNAP(fd, save, pred->ittage->hist);
     }
 
-    /* combining predictor also updates second predictor and meta predictor */
-    /* second direction predictor */
-    if (dir_update_ptr->pdir2)
+  snap_check(fd, save, pred->sc ? pred->sc->ntables : 0,
+	     "statistical corrector tables");
+  if (pred->sc)
     {
-      if (taken)
-      {
-        if (*dir_update_ptr->pdir2 < 3)
-          ++*dir_update_ptr->pdir2;
-      }
-      else
-      { /* not taken */
-        if (*dir_update_ptr->pdir2 > 0)
-          --*dir_update_ptr->pdir2;
-      }
+      snap_check(fd, save, pred->sc->log_size,
+		 "statistical corrector table size");
+      snap_check_list(fd, save, pred->sc->hist_len, pred->sc->ntables,
+		      "statistical corrector history length");
+      snap_io(fd, save, pred->sc->ctrs,
+	      (pred->sc->ntables + 1) << pred->sc->log_size);
+      SNAP(fd, save, pred->sc->theta);
+      SNAP(fd, save, pred->sc->theta_ctr);
+      SNAP(fd, save, pred->sc->hist);
     }
 
-    /* meta predictor */
-    if (dir_update_ptr->pmeta)
+  snap_check(fd, save, pred->loop ? pred->loop->sets : 0,
+	     "loop predictor sets");
+  if (pred->loop)
     {
-      if (dir_update_ptr->dir.bimod != dir_update_ptr->dir.twolev)
-      {
-        /* we only update meta predictor if directions were different */
-        if (dir_update_ptr->dir.twolev == (unsigned int)taken)
-        {
-          /* 2-level predictor was correct */
-          if (*dir_update_ptr->pmeta < 3)
-      ++*dir_update_ptr->pmeta;
-        }
-        else
-        {
-          /* bimodal predictor was correct */
-          if (*dir_update_ptr->pmeta > 0)
-      --*dir_update_ptr->pmeta;
-        }
-      }
+      snap_io(fd, save, pred->loop->table, pred->loop->sets * LOOP_ASSOC
+	      * sizeof(struct bpred_loop_ent_t));
+      SNAP(fd, save, pred->loop->with_loop);
     }
+}
 
-    /* update BTB (but only for taken branches) */
-    if (pbtb)
-    {
-      /* update current information */
-      dassert(taken);
+/* save the state of PRED (tables, histories, BTB, ret-addr stack and
+   components, but not stats) to snapshot file FNAME */
+void
+bpred_save(struct bpred_t *pred,	/* branch predictor instance */
+	   char *fname)			/* snapshot file name */
+{
+  FILE *fd;
 
-      if (pbtb->addr == baddr)
-    {
-      if (!correct)
-        pbtb->target = btarget;
-    }
-      else
-      {
-        /* enter a new branch in the table */
-        pbtb->addr = baddr;
-        pbtb->op = op;
-        pbtb->target = btarget;
-      }
-    }
-  }
+  if (!(fd = fopen(fname, "wb")))
+    fatal("cannot open predictor snapshot `%s' for writing", fname);
+
+  snap_check(fd, TRUE, SNAP_MAGIC, "magic");
+  snap_check(fd, TRUE, SNAP_VERSION, "version");
+  snap_pred(fd, TRUE, pred);
+
+  if (fclose(fd))
+    fatal("cannot write predictor snapshot `%s'", fname);
 }
 
+/* restore the state of PRED from snapshot file FNAME, which must have been
+   saved from a predictor of the same configuration */
+void
+bpred_load(struct bpred_t *pred,	/* branch predictor instance */
+	   char *fname)			/* snapshot file name */
+{
+  FILE *fd;
+
+  if (!(fd = fopen(fname, "rb")))
+    fatal("cannot open predictor snapshot `%s'", fname);
+
+  snap_check(fd, FALSE, SNAP_MAGIC, "magic");
+  snap_check(fd, FALSE, SNAP_VERSION, "version");
+  snap_pred(fd, FALSE, pred);
+
+  if (fgetc(fd) != EOF)
+    fatal("predictor snapshot `%s' has trailing data", fname);
+  fclose(fd);
+}
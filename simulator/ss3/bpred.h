@@ -61,9 +61,14 @@
 #include "machine.h"
 #include "stats.h"
 #include "bpred_alpha21264.h"
-
-#define MAX_PERC 2048
-#define MAX_HIST 64
+#include "bpred_perc.h"
+#include "bpred_tage.h"
+#include "bpred_hperc.h"
+#include "bpred_btb.h"
+#include "bpred_ittage.h"
+#include "bpred_loop.h"
+#include "bpred_sc.h"
+#include "bpred_prof.h"
 
 /*
  * This module implements a number of branch predictor mechanisms.  The
@@ -99,6 +104,33 @@
  *
  *	BPredNotTaken:  static predict branch not taken
  *
+ *	BPredTage:  TAGE predictor, a bimodal base predictor backed by
+ *		tagged tables indexed with geometrically longer global
+ *		histories (see bpred_tage.h).  Parameters are:
+ *		     B   # entries in the base predictor
+ *		     N   # tagged tables
+ *		     M   # entries per tagged table
+ *		     L   shortest history length
+ *		     H   longest history length
+ *		     T   tag width, in bits
+ *
+ *	BPredHPerc:  hashed perceptron, tables of weights indexed with
+ *		hashes of the branch address and segments of the global
+ *		and path history, with an adaptive training threshold
+ *		(see bpred_hperc.h).  Parameters are:
+ *		     N   # weight tables
+ *		     M   # weights per table
+ *		     W   weight width, in bits
+ *		     H   global history length
+ *
+ * Any stateful predictor can be backed by an ITTAGE indirect target
+ * predictor (see bpred_ittage.h), which then predicts the targets of
+ * indirect jumps that do not use the return-address stack.  Its
+ * conditional branch predictions can be overridden by a statistical
+ * corrector (see bpred_sc.h) and then by a loop predictor (see
+ * bpred_loop.h).  These are attached to the predictor after
+ * bpred_create(), with bpred_components().
+ *
  */
 
 /* branch predictor types */
@@ -117,15 +149,45 @@ enum bpred_class {
   BPredTaken,			/* static predict taken */
   BPredNotTaken,		/* static predict not taken */
   BPredAlpha21264,              /* Alpha 21264 tournament predictor */
+  BPredTage,			/* TAGE geometric history predictor */
+  BPredHPerc,			/* hashed perceptron */
   BPred_NUM
 };
 
-/* an entry in a BTB */
+/* what the return-address stack does past its ends */
+enum bpred_ras_overflow {
+  RASOverflowWrap,		/* circular: pushes overwrite the oldest
+				   entries, pops wrap around to them */
+  RASOverflowStop,		/* as Wrap, but returns that find the stack
+				   empty are not predicted by it */
+  RASOverflowRepeat,		/* as Stop, and recursive calls pushing the
+				   same return address share one entry */
+  RASOverflow_NUM
+};
+
+/* most ret-addr stack entries checkpointed per branch */
+#define RAS_CKPT_MAX		16
+
+/* most pushes of one return address an entry counts (RASOverflowRepeat) */
+#define RAS_MAX_REPEAT		255
+
+/* an entry in the return-address stack (the BTB is in bpred_btb.h) */
 struct bpred_btb_ent_t {
   md_addr_t addr;		/* address of branch being tracked */
   enum md_opcode op;		/* opcode of branch corresp. to addr */
   md_addr_t target;		/* last destination of branch when taken */
-  struct bpred_btb_ent_t *prev, *next; /* lru chaining pointers */
+  byte_t count;			/* further pushes of TARGET (RASOverflowRepeat) */
+};
+
+/* perceptron direction predictor state (BPredPerc), allocated by
+   bpred_dir_create() and sized to its configuration */
+struct bpred_dir_perc_t {
+  int weight_i;			/* number of perceptrons */
+  int weight_bits;		/* weight bits */
+  int history;			/* history length, including the bias */
+  int theta;			/* training threshold */
+  struct bpred_perc_t *table;	/* packed weights */
+  struct bpred_perc_hist_t hist;/* speculative global history */
 };
 
 /* direction predictor def */
@@ -133,20 +195,10 @@ struct bpred_dir_t {
   enum bpred_class class;	/* type of predictor */
   union {
     // -Project ///////////////////////////////////////////// Perceptron //////
-  // Structure 'perc': Defines the perceptron predictor's internal mechanism.
-  // It includes the perceptron's weight table, which maps various branch history 
-  // patterns to their corresponding weights, and a mask table used to select certain history bits.
-  // This structure is pivotal for the perceptron algorithm's learning and prediction processes.
-    struct{
-      int weight_i;		                    /* weightt indices */
-      int weight_bits;	                  /* weight bits */
-      int history;		                    /* history length for global history */ 
-      int lookup_out;		                  /* output of each lookup*/  
-       int max_weight;                      /* NEW: saturation limit */ 
-      signed int weight_table[MAX_PERC][MAX_HIST];	/* weight table, 2 dimensional array with an arbitrary large number to accomodate multiple scenarios */ 
-      signed int mask_table[MAX_HIST];         /* masks table */
-      int i;		                          /* index */   
-    } perc;
+  // Pointer 'perc': the perceptron predictor's state (see bpred_dir_perc_t),
+  // allocated on its own so that the bimod, 2-level and meta tables of the
+  // other classes do not carry the perceptron's global history around.
+    struct bpred_dir_perc_t *perc;
   // -Project ///////////////////////////////////////////// Perceptron //////
 
     struct {
@@ -164,25 +216,47 @@ struct bpred_dir_t {
   } config;
 };
 
+struct bpred_update_t;
+
 /* branch predictor def */
 struct bpred_t {
   enum bpred_class class;	/* type of predictor */
+  char *name;			/* stats name, NULL for the class default */
+
+  /* direction predictor kernels of CLASS, set up by bpred_create() so the
+     lookup and update paths do not switch on it: DIR_LOOKUP predicts
+     (conditional branches) or checkpoints (jumps), DIR_UPDATE trains,
+     DIR_REPAIR rebuilds the speculative history after a misprediction;
+     NULL for the static predictors, DIR_REPAIR also for predictors whose
+     history is only shifted at update */
+  int (*dir_lookup)(struct bpred_t *pred, md_addr_t baddr, int cond,
+		    struct bpred_update_t *dir_update_ptr);
+  void (*dir_update)(struct bpred_t *pred, md_addr_t baddr, int cond,
+		     int taken, struct bpred_update_t *dir_update_ptr);
+  void (*dir_repair)(struct bpred_t *pred, md_addr_t baddr, int taken,
+		     struct bpred_update_t *dir_update_ptr);
   struct {
     struct bpred_dir_t *bimod;	  /* first direction predictor */
     struct bpred_dir_t *twolev;	  /* second direction predictor */
     struct bpred_dir_t *meta;	  /* meta predictor */
     struct bpred_alpha21264_t *alpha21264;  /* Alpha 21264 predictor */
+    struct bpred_tage_t *tage;	  /* TAGE predictor */
+    struct bpred_hperc_t *hperc;  /* hashed perceptron */
   } dirpred;
 
-  struct {
-    int sets;			/* num BTB sets */
-    int assoc;			/* BTB associativity */
-    struct bpred_btb_ent_t *btb_data; /* BTB addr-prediction table */
-  } btb;
+  struct bpred_btb_t btb;	/* BTB addr-prediction table */
+
+  struct bpred_ittage_t *ittage;/* indirect target predictor, or NULL */
+  struct bpred_sc_t *sc;	/* statistical corrector, or NULL */
+  struct bpred_loop_t *loop;	/* loop predictor, or NULL */
+  struct bpred_prof_t *prof;	/* per-branch profile, or NULL */
 
   struct {
     int size;			/* return-address stack size */
     int tos;			/* top-of-stack */
+    int depth;			/* valid entries, at most SIZE */
+    int ckpt;			/* top entries checkpointed per branch */
+    enum bpred_ras_overflow overflow;/* behavior past the stack's ends */
     struct bpred_btb_ent_t *stack; /* return-address stack */
   } retstack;
 
@@ -201,6 +275,8 @@ struct bpred_t {
   counter_t lookups;		/* num lookups */
   counter_t retstack_pops;	/* number of times a value was popped */
   counter_t retstack_pushes;	/* number of times a value was pushed */
+  counter_t retstack_overflows;	/* pushes onto a full stack */
+  counter_t retstack_underflows;/* pops from an empty stack */
   counter_t ras_hits;		/* num correct return-address predictions */
 };
 
@@ -214,7 +290,52 @@ struct bpred_update_t {
     unsigned int bimod  : 1;    /* bimodal predictor */
     unsigned int twolev : 1;    /* 2-level predictor */
     unsigned int meta   : 1;    /* meta predictor (0..bimod / 1..2lev) */
+    unsigned int perc   : 1;    /* perceptron predictor */
+    unsigned int tage   : 1;    /* TAGE predictor */
+    unsigned int alpha21264 : 1;/* Alpha 21264 predictor */
+    unsigned int spec : 1;	/* direction predictor history shifted at
+				   lookup (BPredPerc, BPredHPerc,
+				   BPredAlpha21264; BPredTage always) */
+    unsigned int fixed : 1;	/* ... and repaired at recovery */
+    unsigned int uncond : 1;	/* unconditional jump */
+    unsigned int spec_taken : 1;/* direction shifted into the histories at
+				   lookup, after any override */
+    unsigned int comp_spec : 1;	/* ITTAGE/corrector histories shifted at
+				   lookup */
+    unsigned int comp_fixed : 1;/* ... and repaired at recovery */
+    unsigned int second : 1;	/* second component chosen: 2-level
+				   (BPredComb), global (BPredAlpha21264) */
+    unsigned int weak : 1;	/* perceptron output within theta */
+    unsigned int over : 1;	/* direction predictor overridden */
   } dir;
+  struct {		/* perceptron state at lookup (BPredPerc, BPredHPerc) */
+    int out;			/* perceptron output */
+    unsigned int idx;		/* perceptron table row */
+    struct bpred_perc_hist_t hist;/* global history seen by this branch */
+  } perc;
+  struct {		/* TAGE state at lookup (BPredTage) */
+    struct bpred_tage_hist_t hist;/* global history seen by this branch */
+  } tage;
+  struct {		/* Alpha 21264 state at lookup (BPredAlpha21264) */
+    struct bpred_alpha21264_hist_t hist;/* history seen by this branch */
+  } alpha21264;
+  struct {		/* ret-addr stack after this branch's push or pop */
+    int tos;			/* top-of-stack */
+    int depth;			/* valid entries */
+    int recover_depth;		/* valid entries before the push or pop,
+				   with the TOS in stack_recover_idx */
+    md_addr_t target[RAS_CKPT_MAX];/* top entries, newest first */
+    byte_t count[RAS_CKPT_MAX];	/* ... and their repeat counts */
+  } ras;
+  struct {		/* ITTAGE state at lookup (bpred_t.ittage) */
+    struct bpred_perc_hist_t hist;/* global history seen by this branch */
+  } ittage;
+  struct {		/* corrector state at lookup (bpred_t.sc) */
+    struct bpred_perc_hist_t hist;/* global history seen by this branch */
+    struct bpred_sc_ckpt_t ck;	/* output and directions */
+  } sc;
+  struct bpred_loop_ckpt_t loop;/* loop predictor state at lookup
+				   (bpred_t.loop) */
 };
 
 /* create a branch predictor */
@@ -228,8 +349,38 @@ bpred_create(enum bpred_class class,	/* type of predictor to create */
 	     unsigned int xor,		/* history xor address flag */
 	     unsigned int btb_sets,	/* number of sets in BTB */ 
 	     unsigned int btb_assoc,	/* BTB associativity */
+	     unsigned int btb_tag_bits,	/* BTB partial tag width, 0 for full */
 	     unsigned int retstack_size);/* num entries in ret-addr stack */
 
+/* set the return-address stack of PRED to checkpoint its CKPT top entries
+   with every branch, and to behave as OVERFLOW past its ends */
+void
+bpred_retstack_mode(struct bpred_t *pred,/* branch predictor instance */
+		    unsigned int ckpt,	/* top entries to checkpoint */
+		    enum bpred_ras_overflow overflow);/* overflow behavior */
+
+/* attach to PRED the indirect target predictor ITTAGE, the statistical
+   corrector SC and the loop predictor LOOP, any of them NULL for none; the
+   corrector and then the loop predictor may override the direction
+   predictor's prediction for conditional branches */
+void
+bpred_components(struct bpred_t *pred,	/* branch predictor instance */
+		 struct bpred_ittage_t *ittage,/* indirect target predictor */
+		 struct bpred_sc_t *sc,	/* statistical corrector */
+		 struct bpred_loop_t *loop);/* loop predictor */
+
+/* keep a per-branch misprediction profile for PRED */
+void
+bpred_profile(struct bpred_t *pred);	/* branch predictor instance */
+
+/* print the TOPN branches of the profile of PRED with the most
+   mispredictions, with the functions SYM says they are in, if non-NULL */
+void
+bpred_profile_print(struct bpred_t *pred,/* branch predictor instance */
+		    int topn,		/* branches to print */
+		    bpred_prof_sym_t sym,/* function namer, or NULL */
+		    FILE *stream);	/* output stream */
+
 /* create a branch direction predictor */
 struct bpred_dir_t *		/* branch direction predictor instance */
 bpred_dir_create (
@@ -244,6 +395,11 @@ void
 bpred_config(struct bpred_t *pred,	/* branch predictor instance */
 	     FILE *stream);		/* output stream */
 
+/* host bytes held by PRED: its tables, BTB, ret-addr stack, components and
+   profile, and the structures holding them */
+size_t					/* bytes of host memory */
+bpred_host_bytes(struct bpred_t *pred);	/* branch predictor instance */
+
 /* print predictor stats */
 void
 bpred_stats(struct bpred_t *pred,	/* branch predictor instance */
@@ -278,12 +434,22 @@ bpred_lookup(struct bpred_t *pred,	/* branch predictor instance */
 /* Speculative execution can corrupt the ret-addr stack.  So for each
  * lookup we return the top-of-stack (TOS) at that point; a mispredicted
  * branch, as part of its recovery, restores the TOS using this value --
- * hopefully this uncorrupts the stack. */
+ * hopefully this uncorrupts the stack.  With checkpointing on, or an
+ * overflow mode other than RASOverflowWrap (see bpred_retstack_mode()),
+ * the TOS, depth and checkpointed top entries are instead restored to
+ * their state just after the branch, from *DIR_UPDATE_PTR, and
+ * STACK_RECOVER_IDX is ignored.  Predictors that update their
+ * history at lookup (BPredPerc, BPredHPerc, BPredTage, BPredAlpha21264, the
+ * ITTAGE target predictor, the statistical corrector and the loop
+ * predictor) rebuild it from the history saved in *DIR_UPDATE_PTR and the
+ * branch's actual outcome TAKEN. */
 void
 bpred_recover(struct bpred_t *pred,	/* branch predictor instance */
 	      md_addr_t baddr,		/* branch address */
-	      int stack_recover_idx);	/* Non-speculative top-of-stack;
+	      int stack_recover_idx,	/* Non-speculative top-of-stack;
 					 * used on mispredict recovery */
+	      struct bpred_update_t *dir_update_ptr,/* pred state pointer */
+	      int taken);		/* non-zero if branch was taken */
 
 /* update the branch predictor, only useful for stateful predictors; updates
    entry for instruction type OP at address BADDR.  BTB only gets updated
@@ -303,6 +469,17 @@ bpred_update(struct bpred_t *pred,	/* branch predictor instance */
 	     enum md_opcode op,		/* opcode of instruction */
 	     struct bpred_update_t *dir_update_ptr); /* pred state pointer */
 
+/* save the state of PRED (tables, histories, BTB, ret-addr stack and
+   components, but not stats) to snapshot file FNAME */
+void
+bpred_save(struct bpred_t *pred,	/* branch predictor instance */
+	   char *fname);		/* snapshot file name */
+
+/* restore the state of PRED from snapshot file FNAME, which must have been
+   saved from a predictor of the same configuration */
+void
+bpred_load(struct bpred_t *pred,	/* branch predictor instance */
+	   char *fname);		/* snapshot file name */
 
 #ifdef foo0
 /* OBSOLETE */
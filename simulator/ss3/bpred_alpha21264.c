@@ -7,6 +7,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #include "host.h"
@@ -14,6 +15,211 @@
 #include "machine.h"
 #include "bpred_alpha21264.h"
 
+/* 2-bit counter I of packed table T */
+#define CTR_GET(T, I)                                                   \
+  (((T)[(I) >> 2] >> (((I) & 3) << 1)) & 3)
+
+/* set 2-bit counter I of packed table T to V */
+#define CTR_SET(T, I, V)                                                \
+  ((T)[(I) >> 2] = ((T)[(I) >> 2] & ~(3 << (((I) & 3) << 1)))          \
+                   | ((V) << (((I) & 3) << 1)))
+
+/* move 2-bit counter I of packed table T toward TAKEN, saturating */
+static void
+ctr_update(byte_t *t, unsigned int i, int taken)
+{
+  unsigned int v = CTR_GET(t, i);
+
+  if (taken)
+  {
+    if (v < 3)
+      CTR_SET(t, i, v + 1);
+  }
+  else
+  {
+    if (v > 0)
+      CTR_SET(t, i, v - 1);
+  }
+}
+
+/* bytes spanned by a packed local history entry, at most 30 bits at
+   any bit offset */
+#define HIST_SPAN                   5
+
+/* entry I, WIDTH bits wide, of packed local history table T */
+static INLINE unsigned int
+hist_get(const byte_t *t, unsigned int width, unsigned int i)
+{
+  unsigned int bit = i * width;
+  const byte_t *p = &t[bit >> 3];
+  qword_t v = 0;
+  int b;
+
+  for (b = HIST_SPAN - 1; b >= 0; b--)
+    v = (v << 8) | p[b];
+  return (unsigned int)(v >> (bit & 7)) & ((1U << width) - 1);
+}
+
+/* set entry I, WIDTH bits wide, of packed local history table T to VAL */
+static INLINE void
+hist_set(byte_t *t, unsigned int width, unsigned int i, unsigned int val)
+{
+  unsigned int bit = i * width;
+  byte_t *p = &t[bit >> 3];
+  qword_t v = 0, mask;
+  int b;
+
+  for (b = HIST_SPAN - 1; b >= 0; b--)
+    v = (v << 8) | p[b];
+  mask = (qword_t)((1U << width) - 1) << (bit & 7);
+  v = (v & ~mask) | ((qword_t)val << (bit & 7));
+  for (b = 0; b < HIST_SPAN; b++, v >>= 8)
+    p[b] = (byte_t)v;
+}
+
+/*
+ * Table kernels.  Each body takes the geometry as arguments: the generic
+ * kernels pass the predictor's own, the kernels for the default geometry
+ * (1K 10-bit local histories, 1K-entry local and global tables, a
+ * 4K-entry choice table) pass constants, so an optimizing compiler folds
+ * the masks and the local history field arithmetic.
+ */
+
+/* default geometry */
+#define DEF_LOCAL_SIZE          1024
+#define DEF_PRED_SIZE           1024
+#define DEF_HIST_WIDTH          10
+#define DEF_CHOICE_SIZE         4096
+
+static INLINE void
+checkpoint_k(struct bpred_alpha21264_t *pred, md_addr_t baddr,
+             struct bpred_alpha21264_hist_t *h,
+             unsigned int local_size, unsigned int width)
+{
+  h->global_hist = pred->global_hist;
+  h->local_hist = hist_get(pred->local_hist, width,
+                           (baddr >> MD_BR_SHIFT) & (local_size - 1));
+  h->log_pos = pred->log_pos;
+}
+
+static INLINE int
+lookup_k(struct bpred_alpha21264_t *pred, struct bpred_alpha21264_hist_t *h,
+         unsigned int pred_size, unsigned int choice_size)
+{
+  /* choice predictor selects between local and global:
+   * >= 2 means use global predictor
+   * < 2 means use local predictor */
+  if (CTR_GET(pred->choice, h->global_hist & (choice_size - 1)) >= 2)
+    return CTR_GET(pred->global_pred, h->global_hist & (pred_size - 1)) >= 2;
+  else
+    return CTR_GET(pred->local_pred, h->local_hist & (pred_size - 1)) >= 2;
+}
+
+static INLINE void
+hist_push_k(struct bpred_alpha21264_t *pred, md_addr_t baddr, int taken,
+            unsigned int local_size, unsigned int width)
+{
+  unsigned int local_idx, local_hist_val, slot;
+
+  /* update local history for this branch, logging the old value */
+  local_idx = (baddr >> MD_BR_SHIFT) & (local_size - 1);
+  local_hist_val = hist_get(pred->local_hist, width, local_idx);
+  slot = pred->log_pos++ % ALPHA21264_LOG_SIZE;
+  pred->log[slot].idx = local_idx;
+  pred->log[slot].val = local_hist_val;
+  hist_set(pred->local_hist, width, local_idx,
+           ((local_hist_val << 1) | (!!taken)) & ((1 << width) - 1));
+
+  /* update global history register */
+  pred->global_hist =
+    ((pred->global_hist << 1) | (!!taken)) & ((1 << width) - 1);
+}
+
+static INLINE void
+update_k(struct bpred_alpha21264_t *pred, struct bpred_alpha21264_hist_t *h,
+         int taken, unsigned int pred_size, unsigned int choice_size)
+{
+  unsigned int local_pred_idx = h->local_hist & (pred_size - 1);
+  unsigned int global_pred_idx = h->global_hist & (pred_size - 1);
+  int local_correct, global_correct;
+
+  /* determine which predictor was correct */
+  local_correct = ((CTR_GET(pred->local_pred, local_pred_idx) >= 2) == !!taken);
+  global_correct = ((CTR_GET(pred->global_pred, global_pred_idx) >= 2) == !!taken);
+
+  /* update local and global predictors (2-bit saturating counters) */
+  ctr_update(pred->local_pred, local_pred_idx, taken);
+  ctr_update(pred->global_pred, global_pred_idx, taken);
+
+  /* update choice predictor only if predictors disagreed; toward global
+     (3) if global was correct, else toward local (0) */
+  if (local_correct != global_correct)
+    ctr_update(pred->choice, h->global_hist & (choice_size - 1),
+               global_correct);
+}
+
+static void
+checkpoint_gen(struct bpred_alpha21264_t *pred, md_addr_t baddr,
+               struct bpred_alpha21264_hist_t *h)
+{
+  checkpoint_k(pred, baddr, h, pred->local_size, pred->local_hist_width);
+}
+
+static int
+lookup_gen(struct bpred_alpha21264_t *pred, struct bpred_alpha21264_hist_t *h)
+{
+  return lookup_k(pred, h, pred->local_pred_size, pred->choice_size);
+}
+
+static void
+hist_push_gen(struct bpred_alpha21264_t *pred, md_addr_t baddr, int taken)
+{
+  hist_push_k(pred, baddr, taken, pred->local_size, pred->local_hist_width);
+}
+
+static void
+update_gen(struct bpred_alpha21264_t *pred, struct bpred_alpha21264_hist_t *h,
+           int taken)
+{
+  update_k(pred, h, taken, pred->local_pred_size, pred->choice_size);
+}
+
+static void
+checkpoint_def(struct bpred_alpha21264_t *pred, md_addr_t baddr,
+               struct bpred_alpha21264_hist_t *h)
+{
+  checkpoint_k(pred, baddr, h, DEF_LOCAL_SIZE, DEF_HIST_WIDTH);
+}
+
+static int
+lookup_def(struct bpred_alpha21264_t *pred, struct bpred_alpha21264_hist_t *h)
+{
+  return lookup_k(pred, h, DEF_PRED_SIZE, DEF_CHOICE_SIZE);
+}
+
+static void
+hist_push_def(struct bpred_alpha21264_t *pred, md_addr_t baddr, int taken)
+{
+  hist_push_k(pred, baddr, taken, DEF_LOCAL_SIZE, DEF_HIST_WIDTH);
+}
+
+static void
+update_def(struct bpred_alpha21264_t *pred, struct bpred_alpha21264_hist_t *h,
+           int taken)
+{
+  update_k(pred, h, taken, DEF_PRED_SIZE, DEF_CHOICE_SIZE);
+}
+
+static struct bpred_alpha21264_kern_t kern_gen =
+  { "generic", checkpoint_gen, lookup_gen, hist_push_gen, update_gen };
+
+static struct bpred_alpha21264_kern_t kern_def =
+  { "1K/1K/4K", checkpoint_def, lookup_def, hist_push_def, update_def };
+
+/* round N bytes up to whole cache lines */
+#define LINE_ROUND(N)                                                   \
+  (((N) + ALPHA21264_LINE_SIZE - 1) & ~(ALPHA21264_LINE_SIZE - 1))
+
 /* create an Alpha 21264 tournament predictor */
 struct bpred_alpha21264_t *         /* Alpha 21264 predictor instance */
 bpred_alpha21264_create(
@@ -23,8 +229,8 @@ bpred_alpha21264_create(
   unsigned int choice_size)         /* choice predictor table size */
 {
   struct bpred_alpha21264_t *pred;
-  unsigned int i;
-  int flipflop;
+  unsigned int pred_bytes, choice_bytes, hist_bytes;
+  byte_t *base;
   
   /* allocate predictor structure */
   pred = (struct bpred_alpha21264_t *)calloc(1, sizeof(struct bpred_alpha21264_t));
@@ -49,182 +255,124 @@ bpred_alpha21264_create(
   pred->local_hist_width = hist_width;
   pred->local_pred_size = pred_table_size;
   
-  /* allocate local history table */
-  pred->local_hist = (unsigned int *)calloc(local_size, sizeof(unsigned int));
-  if (!pred->local_hist)
-    fatal("out of virtual memory");
-  
-  /* allocate local predictor table */
-  pred->local_pred = (unsigned char *)calloc(pred_table_size, sizeof(unsigned char));
-  if (!pred->local_pred)
-    fatal("out of virtual memory");
-  
   /* initialize global predictor components */
   pred->global_hist_width = hist_width;
   pred->global_hist = 0;
   pred->global_pred_size = pred_table_size;
   
-  /* allocate global predictor table */
-  pred->global_pred = (unsigned char *)calloc(pred_table_size, sizeof(unsigned char));
-  if (!pred->global_pred)
-    fatal("out of virtual memory");
-  
   /* initialize choice predictor components */
   pred->choice_size = choice_size;
   
-  /* allocate choice predictor table */
-  pred->choice = (unsigned char *)calloc(choice_size, sizeof(unsigned char));
-  if (!pred->choice)
+  /* lay out the tables in one arena, each starting on a cache line; the
+     local history table gets slack for its multi-byte accesses */
+  pred_bytes = LINE_ROUND((pred_table_size + 3) / 4);
+  choice_bytes = LINE_ROUND((choice_size + 3) / 4);
+  hist_bytes =
+    LINE_ROUND(((qword_t)local_size * hist_width + 7) / 8 + HIST_SPAN);
+  pred->arena_size = 2 * pred_bytes + choice_bytes + hist_bytes;
+  
+  pred->arena = calloc(pred->arena_size + ALPHA21264_LINE_SIZE - 1, 1);
+  if (!pred->arena)
     fatal("out of virtual memory");
+  base = (byte_t *)LINE_ROUND((unsigned long)pred->arena);
   
-  /* initialize all predictor counters to weakly predict one way or the other */
-  flipflop = 1;
-  for (i = 0; i < pred_table_size; i++)
-  {
-    pred->local_pred[i] = flipflop;
-    pred->global_pred[i] = flipflop;
-    flipflop = 3 - flipflop;  /* alternate between 1 and 2 */
-  }
+  pred->local_pred = base;
+  pred->global_pred = pred->local_pred + pred_bytes;
+  pred->choice = pred->global_pred + pred_bytes;
+  pred->local_hist = pred->choice + choice_bytes;
   
-  /* initialize choice predictor to weakly prefer global (2) or local (1) */
-  flipflop = 2;
-  for (i = 0; i < choice_size; i++)
-  {
-    pred->choice[i] = flipflop;
-    flipflop = 3 - flipflop;  /* alternate between 2 and 1 */
-  }
+  /* initialize all predictor counters to weakly predict one way or the
+     other, alternating 1, 2, 1, 2, ... */
+  memset(pred->local_pred, 0x99, pred_bytes);
+  memset(pred->global_pred, 0x99, pred_bytes);
   
+  /* initialize choice predictor to weakly prefer global (2) or local (1),
+     alternating 2, 1, 2, 1, ... */
+  memset(pred->choice, 0x66, choice_bytes);
+
+  if (local_size == DEF_LOCAL_SIZE && pred_table_size == DEF_PRED_SIZE
+      && hist_width == DEF_HIST_WIDTH && choice_size == DEF_CHOICE_SIZE)
+    pred->kern = &kern_def;
+  else
+    pred->kern = &kern_gen;
+
   return pred;
 }
 
-/* probe the Alpha 21264 predictor for a prediction */
-unsigned char *                     /* pointer to pred counter */
+/* save in H the history seen by the branch at BADDR */
+void
+bpred_alpha21264_checkpoint(
+  struct bpred_alpha21264_t *pred,  /* predictor instance */
+  md_addr_t baddr,                  /* branch address */
+  struct bpred_alpha21264_hist_t *h) /* history checkpoint */
+{
+  pred->kern->checkpoint(pred, baddr, h);
+}
+
+/* probe the Alpha 21264 predictor for a prediction of the branch at
+   BADDR, with history H */
+int                                 /* non-zero if predicted taken */
 bpred_alpha21264_lookup(
   struct bpred_alpha21264_t *pred,  /* predictor instance */
-  md_addr_t baddr)                  /* branch address */
+  md_addr_t baddr,                  /* branch address */
+  struct bpred_alpha21264_hist_t *h) /* history checkpoint */
 {
-  unsigned int local_idx;
-  unsigned int local_hist_val;
-  unsigned int local_pred_idx;
-  unsigned int global_pred_idx;
-  unsigned int choice_idx;
-  unsigned char choice_pred;
-  
-  if (!pred)
-    panic("Alpha 21264 predictor is NULL");
-  
-  /* compute local history table index from branch address */
-  local_idx = (baddr >> MD_BR_SHIFT) & (pred->local_size - 1);
-  
-  /* get local history value for this branch */
-  local_hist_val = pred->local_hist[local_idx];
-  
-  /* index into local predictor table using local history */
-  local_pred_idx = local_hist_val & (pred->local_pred_size - 1);
-  
-  /* index into global predictor table using global history */
-  global_pred_idx = pred->global_hist & (pred->global_pred_size - 1);
-  
-  /* index into choice predictor using global history */
-  choice_idx = pred->global_hist & (pred->choice_size - 1);
-  
-  /* get choice predictor value */
-  choice_pred = pred->choice[choice_idx];
-  
-  /* choice predictor selects between local and global:
-   * >= 2 means use global predictor
-   * < 2 means use local predictor */
-  if (choice_pred >= 2)
-    return &pred->global_pred[global_pred_idx];
-  else
-    return &pred->local_pred[local_pred_idx];
+  return pred->kern->lookup(pred, h);
 }
 
-/* update the Alpha 21264 predictor */
+/* non-zero if the choice predictor picks the global predictor for a
+   branch with history H */
+int                                 /* non-zero if global chosen */
+bpred_alpha21264_choice(
+  struct bpred_alpha21264_t *pred,  /* predictor instance */
+  struct bpred_alpha21264_hist_t *h) /* history checkpoint */
+{
+  return CTR_GET(pred->choice, h->global_hist & (pred->choice_size - 1)) >= 2;
+}
+
+/* speculatively shift outcome TAKEN of the branch at BADDR into the
+   global and local history */
 void
-bpred_alpha21264_update(
+bpred_alpha21264_hist_push(
   struct bpred_alpha21264_t *pred,  /* predictor instance */
   md_addr_t baddr,                  /* branch address */
-  int taken)                        /* actual branch outcome */
+  int taken)                        /* branch outcome */
 {
-  unsigned int local_idx;
-  unsigned int local_hist_val;
-  unsigned int local_pred_idx;
-  unsigned int global_pred_idx;
-  unsigned int choice_idx;
-  unsigned char local_pred;
-  unsigned char global_pred;
-  int local_correct;
-  int global_correct;
-  
-  if (!pred)
-    panic("Alpha 21264 predictor is NULL");
-  
-  /* compute indices (same as in lookup) */
-  local_idx = (baddr >> MD_BR_SHIFT) & (pred->local_size - 1);
-  local_hist_val = pred->local_hist[local_idx];
-  local_pred_idx = local_hist_val & (pred->local_pred_size - 1);
-  global_pred_idx = pred->global_hist & (pred->global_pred_size - 1);
-  choice_idx = pred->global_hist & (pred->choice_size - 1);
-  
-  /* get current predictions */
-  local_pred = pred->local_pred[local_pred_idx];
-  global_pred = pred->global_pred[global_pred_idx];
-  
-  /* determine which predictor was correct */
-  local_correct = ((local_pred >= 2) == !!taken);
-  global_correct = ((global_pred >= 2) == !!taken);
-  
-  /* update local predictor (2-bit saturating counter) */
-  if (taken)
-  {
-    if (pred->local_pred[local_pred_idx] < 3)
-      pred->local_pred[local_pred_idx]++;
-  }
-  else
-  {
-    if (pred->local_pred[local_pred_idx] > 0)
-      pred->local_pred[local_pred_idx]--;
-  }
-  
-  /* update global predictor (2-bit saturating counter) */
-  if (taken)
-  {
-    if (pred->global_pred[global_pred_idx] < 3)
-      pred->global_pred[global_pred_idx]++;
-  }
-  else
-  {
-    if (pred->global_pred[global_pred_idx] > 0)
-      pred->global_pred[global_pred_idx]--;
-  }
+  pred->kern->hist_push(pred, baddr, taken);
+}
+
+/* roll the history back to checkpoint H, undoing younger updates */
+void
+bpred_alpha21264_hist_restore(
+  struct bpred_alpha21264_t *pred,  /* predictor instance */
+  struct bpred_alpha21264_hist_t *h) /* history checkpoint */
+{
+  unsigned int slot;
   
-  /* update choice predictor only if predictors disagreed */
-  if (local_correct != global_correct)
+  /* undo local history updates newest first; updates that have already
+     left the log are kept */
+  if (pred->log_pos - h->log_pos > ALPHA21264_LOG_SIZE)
+    h->log_pos = pred->log_pos - ALPHA21264_LOG_SIZE;
+  while (pred->log_pos != h->log_pos)
   {
-    if (global_correct)
-    {
-      /* global was correct, increment toward global (3) */
-      if (pred->choice[choice_idx] < 3)
-        pred->choice[choice_idx]++;
-    }
-    else
-    {
-      /* local was correct, decrement toward local (0) */
-      if (pred->choice[choice_idx] > 0)
-        pred->choice[choice_idx]--;
-    }
+    slot = --pred->log_pos % ALPHA21264_LOG_SIZE;
+    hist_set(pred->local_hist, pred->local_hist_width, pred->log[slot].idx,
+             pred->log[slot].val);
   }
   
-  /* update local history for this branch */
-  pred->local_hist[local_idx] = 
-    ((local_hist_val << 1) | (!!taken)) & 
-    ((1 << pred->local_hist_width) - 1);
-  
-  /* update global history register */
-  pred->global_hist = 
-    ((pred->global_hist << 1) | (!!taken)) & 
-    ((1 << pred->global_hist_width) - 1);
+  pred->global_hist = h->global_hist;
+}
+
+/* train the Alpha 21264 predictor with outcome TAKEN of the branch at
+   BADDR, which saw history H */
+void
+bpred_alpha21264_update(
+  struct bpred_alpha21264_t *pred,  /* predictor instance */
+  md_addr_t baddr,                  /* branch address */
+  struct bpred_alpha21264_hist_t *h, /* history checkpoint */
+  int taken)                        /* actual branch outcome */
+{
+  pred->kern->update(pred, h, taken);
 }
 
 /* print Alpha 21264 predictor configuration */
@@ -254,6 +402,9 @@ bpred_alpha21264_config(
   fprintf(stream,
     "  choice table: %d entries, 2-bit counters\n",
     pred->choice_size);
+  fprintf(stream,
+    "  table storage: %d bytes, %s kernels\n",
+    pred->arena_size, pred->kern->name);
 }
 
 /* print Alpha 21264 predictor statistics */
@@ -276,7 +427,7 @@ bpred_alpha21264_stats(
   /* count predictor counter distributions */
   for (i = 0; i < pred->local_pred_size; i++)
   {
-    switch (pred->local_pred[i])
+    switch (CTR_GET(pred->local_pred, i))
     {
       case 0: local_strong_nottaken++; break;
       case 1: local_weak_nottaken++; break;
@@ -287,7 +438,7 @@ bpred_alpha21264_stats(
   
   for (i = 0; i < pred->global_pred_size; i++)
   {
-    switch (pred->global_pred[i])
+    switch (CTR_GET(pred->global_pred, i))
     {
       case 0: global_strong_nottaken++; break;
       case 1: global_weak_nottaken++; break;
@@ -298,7 +449,7 @@ bpred_alpha21264_stats(
   
   for (i = 0; i < pred->choice_size; i++)
   {
-    switch (pred->choice[i])
+    switch (CTR_GET(pred->choice, i))
     {
       case 0: choice_strong_local++; break;
       case 1: choice_weak_local++; break;
@@ -361,17 +512,8 @@ bpred_alpha21264_free(
   if (!pred)
     return;
   
-  if (pred->local_hist)
-    free(pred->local_hist);
-  
-  if (pred->local_pred)
-    free(pred->local_pred);
-  
-  if (pred->global_pred)
-    free(pred->global_pred);
-  
-  if (pred->choice)
-    free(pred->choice);
+  if (pred->arena)
+    free(pred->arena);
   
   free(pred);
 }
\ No newline at end of file
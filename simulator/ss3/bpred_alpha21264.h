@@ -22,26 +22,83 @@
  *   - Local Predictor: Uses per-branch local history
  *   - Global Predictor: Uses global branch history 
  *   - Choice Predictor: Selects between local and global
+ *
+ * Counters are packed four 2-bit counters per byte and local history
+ * entries LOCAL_HIST_WIDTH bits each, all in one cache-line aligned
+ * arena, so the host footprint is the modeled hardware budget (rounded
+ * to cache lines) and large tables stay cache resident.
+ *
+ * As in the hardware, global and local history are updated speculatively
+ * with the predicted direction at lookup.  Each branch carries a history
+ * checkpoint: the global history, its own local history, and a position
+ * in a log of the local history entries overwritten since, which is
+ * unwound to undo the local history updates of squashed younger branches.
+ *
+ * The table accesses run through a kernel set chosen at creation: one
+ * compiled for the default geometry, with constant table sizes and
+ * history width, or a generic one that reads them from the predictor.
  */
 
+/* host cache line size, arena regions are aligned to it */
+#define ALPHA21264_LINE_SIZE        64
+
+/* speculative local history updates that can be undone; must cover the
+   branches in flight */
+#define ALPHA21264_LOG_SIZE         1024
+
+/* history checkpoint, taken at lookup */
+struct bpred_alpha21264_hist_t {
+  unsigned int global_hist;         /* global history */
+  unsigned int local_hist;          /* local history of this branch */
+  unsigned int log_pos;             /* local history log position */
+};
+
+struct bpred_alpha21264_t;
+
+/* table kernels, specialized by geometry */
+struct bpred_alpha21264_kern_t {
+  char *name;                       /* geometry the kernels are for */
+  void (*checkpoint)(struct bpred_alpha21264_t *pred, md_addr_t baddr,
+                     struct bpred_alpha21264_hist_t *h);
+  int (*lookup)(struct bpred_alpha21264_t *pred,
+                struct bpred_alpha21264_hist_t *h);
+  void (*hist_push)(struct bpred_alpha21264_t *pred, md_addr_t baddr,
+                    int taken);
+  void (*update)(struct bpred_alpha21264_t *pred,
+                 struct bpred_alpha21264_hist_t *h, int taken);
+};
+
 /* Alpha 21264 tournament predictor structure */
 struct bpred_alpha21264_t {
   /* local predictor components */
   int local_size;                   /* local history table size */
   int local_hist_width;             /* local history register width */
-  unsigned int *local_hist;         /* local history table */
-  unsigned char *local_pred;        /* local predictor table */
+  byte_t *local_hist;               /* local history table, packed */
+  byte_t *local_pred;               /* local predictor table, packed */
   int local_pred_size;              /* local predictor table size */
   
   /* global predictor components */
   int global_hist_width;            /* global history register width */
   unsigned int global_hist;         /* global history register */
-  unsigned char *global_pred;       /* global predictor table */
+  byte_t *global_pred;              /* global predictor table, packed */
   int global_pred_size;             /* global predictor table size */
   
   /* choice predictor components */
   int choice_size;                  /* choice predictor table size */
-  unsigned char *choice;            /* choice predictor table */
+  byte_t *choice;                   /* choice predictor table, packed */
+
+  /* backing store for all tables */
+  void *arena;                      /* arena allocation */
+  unsigned int arena_size;          /* arena bytes in use */
+
+  struct bpred_alpha21264_kern_t *kern; /* table kernels */
+
+  /* speculative local history updates, oldest overwritten first */
+  struct {
+    unsigned int idx;               /* local history table index */
+    unsigned int val;               /* value before the update */
+  } log[ALPHA21264_LOG_SIZE];
+  unsigned int log_pos;             /* updates logged, ever */
 };
 
 /* create an Alpha 21264 tournament predictor */
@@ -52,17 +109,49 @@ bpred_alpha21264_create(
   unsigned int hist_width,          /* history register width */
   unsigned int choice_size);        /* choice predictor table size */
 
-/* probe the Alpha 21264 predictor for a prediction */
-unsigned char *                     /* pointer to pred counter */
+/* save in H the history seen by the branch at BADDR */
+void
+bpred_alpha21264_checkpoint(
+  struct bpred_alpha21264_t *pred,  /* predictor instance */
+  md_addr_t baddr,                  /* branch address */
+  struct bpred_alpha21264_hist_t *h); /* history checkpoint */
+
+/* non-zero if the choice predictor picks the global predictor for a
+   branch with history H */
+int                                 /* non-zero if global chosen */
+bpred_alpha21264_choice(
+  struct bpred_alpha21264_t *pred,  /* predictor instance */
+  struct bpred_alpha21264_hist_t *h); /* history checkpoint */
+
+/* probe the Alpha 21264 predictor for a prediction of the branch at
+   BADDR, with history H */
+int                                 /* non-zero if predicted taken */
 bpred_alpha21264_lookup(
   struct bpred_alpha21264_t *pred,  /* predictor instance */
-  md_addr_t baddr);                 /* branch address */
+  md_addr_t baddr,                  /* branch address */
+  struct bpred_alpha21264_hist_t *h); /* history checkpoint */
+
+/* speculatively shift outcome TAKEN of the branch at BADDR into the
+   global and local history */
+void
+bpred_alpha21264_hist_push(
+  struct bpred_alpha21264_t *pred,  /* predictor instance */
+  md_addr_t baddr,                  /* branch address */
+  int taken);                       /* branch outcome */
+
+/* roll the history back to checkpoint H, undoing younger updates */
+void
+bpred_alpha21264_hist_restore(
+  struct bpred_alpha21264_t *pred,  /* predictor instance */
+  struct bpred_alpha21264_hist_t *h); /* history checkpoint */
 
-/* update the Alpha 21264 predictor */
+/* train the Alpha 21264 predictor with outcome TAKEN of the branch at
+   BADDR, which saw history H */
 void
 bpred_alpha21264_update(
   struct bpred_alpha21264_t *pred,  /* predictor instance */
   md_addr_t baddr,                  /* branch address */
+  struct bpred_alpha21264_hist_t *h, /* history checkpoint */
   int taken);                       /* actual branch outcome */
 
 /* print Alpha 21264 predictor configuration */
@@ -0,0 +1,224 @@
+/* bpred_btb.c - set-associative branch target buffer */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "bpred_btb.h"
+
+/* vector tag compares need GCC-style per-function target attributes;
+   define BPRED_BTB_NO_SIMD to build the portable compare only */
+#if !defined(BPRED_BTB_NO_SIMD) && defined(__GNUC__)			\
+    && (defined(__x86_64__) || defined(__i386__))
+#define BTB_X86
+#include <immintrin.h>
+#endif
+
+/*
+ * tag compare kernels
+ */
+
+static int
+find_c(const word_t *tags, unsigned int assoc, word_t tag)
+{
+  unsigned int i;
+
+  for (i = 0; i < assoc; i++)
+    if (tags[i] == tag)
+      return i;
+  return -1;
+}
+
+#ifdef BTB_X86
+
+/* four ways per compare, ASSOC is a multiple of 4 */
+__attribute__((target("sse2")))
+static int
+find_sse2(const word_t *tags, unsigned int assoc, word_t tag)
+{
+  __m128i t = _mm_set1_epi32(tag);
+  unsigned int i;
+  int m;
+
+  for (i = 0; i < assoc; i += 4)
+    {
+      m = _mm_movemask_ps(_mm_castsi128_ps(
+	    _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(tags + i)), t)));
+      if (m)
+	return i + __builtin_ctz(m);
+    }
+  return -1;
+}
+
+/* eight ways per compare, ASSOC is a multiple of 8 */
+__attribute__((target("avx2")))
+static int
+find_avx2(const word_t *tags, unsigned int assoc, word_t tag)
+{
+  __m256i t = _mm256_set1_epi32(tag);
+  unsigned int i;
+  int m;
+
+  for (i = 0; i < assoc; i += 8)
+    {
+      m = _mm256_movemask_ps(_mm256_castsi256_ps(
+	    _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(tags + i)),
+			       t)));
+      if (m)
+	return i + __builtin_ctz(m);
+    }
+  return -1;
+}
+
+#endif /* BTB_X86 */
+
+/* set up BTB to hold SETS x ASSOC entries with TAG_BITS-bit partial tags,
+   or full tags if TAG_BITS is 0 */
+void
+bpred_btb_init(struct bpred_btb_t *btb,	/* BTB to set up */
+	       unsigned int sets,	/* number of sets */
+	       unsigned int assoc,	/* associativity */
+	       unsigned int tag_bits)	/* partial tag width, 0 for full */
+{
+  if (!sets || (sets & (sets-1)) != 0)
+    fatal("number of BTB sets must be non-zero and a power of two");
+  if (!assoc || (assoc & (assoc-1)) != 0 || assoc > BTB_MAX_ASSOC)
+    fatal("BTB associativity must be a power of two between 1 and %d",
+	  BTB_MAX_ASSOC);
+  if (tag_bits > 31)
+    fatal("BTB tag width `%d' must be at most 31 bits", tag_bits);
+
+  btb->sets = sets;
+  btb->assoc = assoc;
+  btb->tag_bits = tag_bits ? tag_bits : 31;
+  for (btb->log_sets = 0; (1U << btb->log_sets) < sets; btb->log_sets++)
+    /* nada */;
+
+  if (!(btb->tags = calloc(sets * assoc, sizeof(word_t)))
+      || !(btb->targets = calloc(sets * assoc, sizeof(md_addr_t)))
+      || !(btb->kinds = calloc(sets * assoc, sizeof(byte_t)))
+      || !(btb->plru = calloc(sets, sizeof(qword_t))))
+    fatal("cannot allocate BTB");
+
+  btb->find = find_c;
+#ifdef BTB_X86
+  __builtin_cpu_init();
+  if (assoc >= 8 && __builtin_cpu_supports("avx2"))
+    btb->find = find_avx2;
+  else if (assoc >= 4 && __builtin_cpu_supports("sse2"))
+    btb->find = find_sse2;
+#endif /* BTB_X86 */
+}
+
+/* set and tag of the branch at BADDR */
+#define BTB_SET(BTB, ADDR)						\
+  (((ADDR) >> MD_BR_SHIFT) & ((BTB)->sets - 1))
+#define BTB_TAG(BTB, ADDR)						\
+  (((word_t)(((ADDR) >> MD_BR_SHIFT) >> (BTB)->log_sets)		\
+    & ((1U << (BTB)->tag_bits) - 1)) | BTB_VALID)
+
+/* look up the branch at BADDR */
+int					/* entry index, or -1 on a miss */
+bpred_btb_lookup(struct bpred_btb_t *btb,/* BTB instance */
+		 md_addr_t baddr)	/* branch address */
+{
+  unsigned int base = BTB_SET(btb, baddr) * btb->assoc;
+  int way = btb->find(btb->tags + base, btb->assoc, BTB_TAG(btb, baddr));
+
+  return way < 0 ? -1 : (int)base + way;
+}
+
+/* make WAY the most recently used of the set with tree-PLRU bits *PLRU:
+   node N's children are 2N and 2N+1, a set bit points the victim search
+   right, away from the ways just used on the left */
+static void
+plru_touch(qword_t *plru, unsigned int assoc, unsigned int way)
+{
+  unsigned int node = 1, bit, level;
+
+  for (level = assoc >> 1; level; level >>= 1)
+    {
+      bit = (way & level) != 0;
+      if (bit)
+	*plru &= ~(ULL(1) << node);
+      else
+	*plru |= ULL(1) << node;
+      node = 2 * node + bit;
+    }
+}
+
+/* pseudo-LRU way of the set with tree-PLRU bits PLRU */
+static unsigned int
+plru_victim(qword_t plru, unsigned int assoc)
+{
+  unsigned int node = 1;
+
+  while (node < assoc)
+    node = 2 * node + (unsigned int)((plru >> node) & 1);
+  return node - assoc;
+}
+
+/* record that the branch at BADDR with opcode OP was taken to BTARGET,
+   allocating an entry for it on a miss; CORRECT is non-zero if its target
+   was predicted correctly */
+void
+bpred_btb_update(struct bpred_btb_t *btb,/* BTB instance */
+		 md_addr_t baddr,	/* branch address */
+		 md_addr_t btarget,	/* resolved branch target */
+		 enum md_opcode op,	/* opcode of instruction */
+		 int correct)		/* was the target prediction ok? */
+{
+  unsigned int set = BTB_SET(btb, baddr), base = set * btb->assoc;
+  word_t tag = BTB_TAG(btb, baddr);
+  int way = btb->find(btb->tags + base, btb->assoc, tag);
+
+  if (way >= 0)
+    {
+      /* hit, fix up the target if it was wrong */
+      if (!correct)
+	btb->targets[base + way] = btarget;
+    }
+  else
+    {
+      /* miss, fill an empty way or replace the pseudo-LRU one */
+      way = btb->find(btb->tags + base, btb->assoc, 0);
+      if (way < 0)
+	way = plru_victim(btb->plru[set], btb->assoc);
+
+      btb->tags[base + way] = tag;
+      btb->targets[base + way] = btarget;
+      btb->kinds[base + way] =
+	(((MD_OP_FLAGS(op) & F_COND) ? BTB_KIND_COND : 0)
+	 | ((MD_OP_FLAGS(op) & F_CALL) ? BTB_KIND_CALL : 0)
+	 | ((MD_OP_FLAGS(op) & F_INDIRJMP) ? BTB_KIND_INDIR : 0));
+    }
+
+  if (btb->assoc > 1)
+    plru_touch(&btb->plru[set], btb->assoc, way);
+}
+
+/* print BTB configuration */
+void
+bpred_btb_config(struct bpred_btb_t *btb,/* BTB instance */
+		 FILE *stream)		/* output stream */
+{
+  fprintf(stream, "btb: %d sets x %d associativity, %d-bit tags\n",
+	  btb->sets, btb->assoc, btb->tag_bits);
+}
+
+/* free BTB resources */
+void
+bpred_btb_free(struct bpred_btb_t *btb)	/* BTB instance */
+{
+  free(btb->tags);
+  free(btb->targets);
+  free(btb->kinds);
+  free(btb->plru);
+}
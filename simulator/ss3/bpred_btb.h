@@ -0,0 +1,86 @@
+/* bpred_btb.h - set-associative branch target buffer */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ */
+
+#ifndef BPRED_BTB_H
+#define BPRED_BTB_H
+
+#include <stdio.h>
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+
+/*
+ * This module implements the branch target buffer as a struct of arrays:
+ * one array of tags, one of targets and one of branch kinds, each laid
+ * out set by set, so a lookup compares a whole set of packed 32-bit tags
+ * at once (with SSE2 or AVX2 where the host has them) and touches the
+ * target of the matching way only.
+ *
+ * Replacement is tree pseudo-LRU, ASSOC-1 bits per set, which is exact
+ * LRU for 2-way sets.  Tags are either full (all branch address bits
+ * above the set index, up to 31 bits) or partial, keeping only the low
+ * TAG_BITS bits, so that different branches can alias as in hardware.
+ */
+
+/* most ways per set */
+#define BTB_MAX_ASSOC		64
+
+/* tag of a valid way; an empty way's tag is 0 */
+#define BTB_VALID		0x80000000
+
+/* branch kinds */
+#define BTB_KIND_COND		0x01	/* conditional branch */
+#define BTB_KIND_CALL		0x02	/* function call */
+#define BTB_KIND_INDIR		0x04	/* indirect jump */
+
+/* branch target buffer */
+struct bpred_btb_t {
+  int sets;			/* num BTB sets */
+  int assoc;			/* BTB associativity */
+  unsigned int log_sets;	/* log2 sets */
+  unsigned int tag_bits;	/* partial tag width, 0 for full tags */
+  word_t *tags;			/* SETS x ASSOC tags, BTB_VALID or'ed in */
+  md_addr_t *targets;		/* SETS x ASSOC branch targets */
+  byte_t *kinds;		/* SETS x ASSOC branch kinds */
+  qword_t *plru;		/* per set tree-PLRU bits */
+  /* way of ASSOC tags at TAGS equal to TAG, or -1 */
+  int (*find)(const word_t *tags, unsigned int assoc, word_t tag);
+};
+
+/* set up BTB to hold SETS x ASSOC entries with TAG_BITS-bit partial tags,
+   or full tags if TAG_BITS is 0 */
+void
+bpred_btb_init(struct bpred_btb_t *btb,	/* BTB to set up */
+	       unsigned int sets,	/* number of sets */
+	       unsigned int assoc,	/* associativity */
+	       unsigned int tag_bits);	/* partial tag width, 0 for full */
+
+/* look up the branch at BADDR */
+int					/* entry index, or -1 on a miss */
+bpred_btb_lookup(struct bpred_btb_t *btb,/* BTB instance */
+		 md_addr_t baddr);	/* branch address */
+
+/* record that the branch at BADDR with opcode OP was taken to BTARGET,
+   allocating an entry for it on a miss; CORRECT is non-zero if its target
+   was predicted correctly */
+void
+bpred_btb_update(struct bpred_btb_t *btb,/* BTB instance */
+		 md_addr_t baddr,	/* branch address */
+		 md_addr_t btarget,	/* resolved branch target */
+		 enum md_opcode op,	/* opcode of instruction */
+		 int correct);		/* was the target prediction ok? */
+
+/* print BTB configuration */
+void
+bpred_btb_config(struct bpred_btb_t *btb,/* BTB instance */
+		 FILE *stream);		/* output stream */
+
+/* free BTB resources */
+void
+bpred_btb_free(struct bpred_btb_t *btb);/* BTB instance */
+
+#endif /* BPRED_BTB_H */
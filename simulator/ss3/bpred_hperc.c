@@ -0,0 +1,231 @@
+/* bpred_hperc.c - hashed perceptron branch direction predictor */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "stats.h"
+#include "bpred_perc.h"
+#include "bpred_hperc.h"
+
+/* theta moves by one after this many more mispredictions than correct
+   low-margin predictions, or the other way around */
+#define HPERC_THETA_CTR		64
+
+/* branches whose address bits the path history holds */
+#define PATH_BRANCHES		32
+
+/* create a hashed perceptron of NTABLES tables of TABLE_SIZE weights,
+   WEIGHT_BITS wide, over HIST_BITS bits of global history */
+struct bpred_hperc_t *			/* hashed perceptron instance */
+bpred_hperc_create(unsigned int ntables,/* number of weight tables */
+		   unsigned int table_size,/* weights per table */
+		   unsigned int weight_bits,/* weight width, in bits */
+		   unsigned int hist_bits)/* global history length */
+{
+  struct bpred_hperc_t *hp;
+  unsigned int i, end, prev_end = 0;
+
+  if (ntables < 2 || ntables > HPERC_MAX_TABLES)
+    fatal("hashed perceptron: number of tables `%d' must be between 2 "
+	  "and %d", ntables, HPERC_MAX_TABLES);
+  if (table_size < 16 || (table_size & (table_size - 1)) != 0)
+    fatal("hashed perceptron: table size `%d' must be a power of two, "
+	  "at least 16", table_size);
+  if (weight_bits < 2 || weight_bits > 8)
+    fatal("hashed perceptron: weight width `%d' must be between 2 and 8 "
+	  "bits", weight_bits);
+  if (hist_bits < ntables - 1 || hist_bits > PERC_HIST_MAX)
+    fatal("hashed perceptron: history length `%d' must be at least one "
+	  "bit per history table and at most %d", hist_bits, PERC_HIST_MAX);
+
+  if (!(hp = calloc(1, sizeof(struct bpred_hperc_t))))
+    fatal("out of virtual memory");
+
+  hp->ntables = ntables;
+  hp->hist_bits = hist_bits;
+  hp->weight_bits = weight_bits;
+  hp->max_weight = (1 << (weight_bits - 1)) - 1;
+  for (hp->log_size = 0; (1U << hp->log_size) < table_size; hp->log_size++)
+    /* nada */;
+
+  /* table 0 is the bias, the others take history segments that double
+     in length, the last one ending at the oldest history bit */
+  for (i = 1; i < ntables; i++)
+    {
+      end = hist_bits >> (ntables - 1 - i);
+      if (end <= prev_end)
+	end = prev_end + 1;
+      hp->seg_start[i] = prev_end;
+      hp->seg_len[i] = end - prev_end;
+      prev_end = end;
+    }
+
+  if (!(hp->weights = calloc(ntables << hp->log_size, sizeof(sbyte_t))))
+    fatal("cannot allocate hashed perceptron weights");
+
+  /* start from the plain perceptron's threshold for as many inputs */
+  hp->theta = (int)(1.93 * ntables) + 14;
+
+  bpred_perc_hist_init(&hp->hist);
+  return hp;
+}
+
+/* fold V into WIDTH bits */
+static word_t
+fold(qword_t v, unsigned int width)
+{
+  word_t f = 0;
+
+  for (; v; v >>= width)
+    f ^= (word_t)v & ((1U << width) - 1);
+  return f;
+}
+
+/* index of the branch at (pre-shifted) address PC into table K, given
+   global history H */
+static unsigned int
+hperc_index(struct bpred_hperc_t *hp, word_t pc, unsigned int k,
+	    struct bpred_perc_hist_t *h)
+{
+  unsigned int mask = (1U << hp->log_size) - 1;
+  unsigned int start, n, r;
+  word_t hf, pf = 0;
+
+  if (!k)
+    return (pc ^ (pc >> hp->log_size)) & mask;
+
+  /* global history segment */
+  hf = bpred_perc_hist_fold(h, hp->seg_start[k], hp->seg_len[k],
+			    hp->log_size);
+
+  /* path history over the same branches, as far as it reaches */
+  start = hp->seg_start[k];
+  if (start < PATH_BRANCHES)
+    {
+      n = MIN(hp->seg_len[k], PATH_BRANCHES - start);
+      pf = fold((h->path >> (2 * start))
+		& (n < PATH_BRANCHES ? ((qword_t)1 << (2 * n)) - 1 : ~0ULL),
+		hp->log_size);
+      r = k % hp->log_size;
+      pf = ((pf << r) | (pf >> (hp->log_size - r))) & mask;
+    }
+
+  return (pc ^ (pc >> (hp->log_size - k % hp->log_size)) ^ hf ^ pf) & mask;
+}
+
+/* compute the output for the branch at BADDR with global history H */
+int					/* perceptron output y */
+bpred_hperc_output(struct bpred_hperc_t *hp,/* hashed perceptron */
+		   md_addr_t baddr,	/* branch address */
+		   struct bpred_perc_hist_t *h)/* global history */
+{
+  word_t pc = baddr >> MD_BR_SHIFT;
+  unsigned int k;
+  int y = 0;
+
+  for (k = 0; k < hp->ntables; k++)
+    y += hp->weights[(k << hp->log_size) + hperc_index(hp, pc, k, h)];
+  return y;
+}
+
+/* train toward outcome TAKEN the weights of the branch at BADDR, which
+   saw global history H and had output Y, and adapt theta */
+void
+bpred_hperc_train(struct bpred_hperc_t *hp,/* hashed perceptron */
+		  md_addr_t baddr,	/* branch address */
+		  struct bpred_perc_hist_t *h,/* history seen at lookup */
+		  int y,		/* output at lookup */
+		  int taken)		/* actual branch outcome */
+{
+  word_t pc = baddr >> MD_BR_SHIFT;
+  int mispred = (y >= 0) != !!taken;
+  int abs_y = (y < 0 ? -y : y);
+  unsigned int k;
+  sbyte_t *w;
+
+  if (!mispred && abs_y > hp->theta)
+    return;
+
+  for (k = 0; k < hp->ntables; k++)
+    {
+      w = &hp->weights[(k << hp->log_size) + hperc_index(hp, pc, k, h)];
+      if (taken)
+	{
+	  if (*w < hp->max_weight)
+	    ++*w;
+	}
+      else
+	{
+	  if (*w > -hp->max_weight)
+	    --*w;
+	}
+    }
+
+  /* mispredictions call for a higher threshold, correct predictions that
+     still got trained for a lower one */
+  if (mispred)
+    {
+      if (++hp->theta_ctr >= HPERC_THETA_CTR)
+	{
+	  hp->theta++;
+	  hp->theta_ctr = 0;
+	}
+    }
+  else if (--hp->theta_ctr <= -HPERC_THETA_CTR)
+    {
+      if (hp->theta > 1)
+	hp->theta--;
+      hp->theta_ctr = 0;
+    }
+}
+
+/* print hashed perceptron configuration */
+void
+bpred_hperc_config(struct bpred_hperc_t *hp,/* hashed perceptron */
+		   char name[],		/* predictor name */
+		   FILE *stream)	/* output stream */
+{
+  unsigned int k;
+
+  fprintf(stream,
+	  "pred_dir: %s: hashed perceptron: %d tables x %d weights, "
+	  "%d-bit weights, history=%d, segments",
+	  name, hp->ntables, 1 << hp->log_size, hp->weight_bits,
+	  hp->hist_bits);
+  for (k = 1; k < hp->ntables; k++)
+    fprintf(stream, " %d-%d", hp->seg_start[k],
+	    hp->seg_start[k] + hp->seg_len[k] - 1);
+  fprintf(stream, "\n");
+}
+
+/* register hashed perceptron stats under NAME */
+void
+bpred_hperc_reg_stats(struct bpred_hperc_t *hp,/* hashed perceptron */
+		      char *name,	/* stats name prefix */
+		      struct stat_sdb_t *sdb)/* stats database */
+{
+  char buf[512];
+
+  sprintf(buf, "%s.hperc_theta", name);
+  stat_reg_int(sdb, buf, "training threshold at the end of the run",
+	       &hp->theta, hp->theta, NULL);
+}
+
+/* free hashed perceptron resources */
+void
+bpred_hperc_free(struct bpred_hperc_t *hp)/* hashed perceptron */
+{
+  if (!hp)
+    return;
+
+  free(hp->weights);
+  free(hp);
+}
@@ -0,0 +1,98 @@
+/* bpred_hperc.h - hashed perceptron branch direction predictor */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ */
+
+#ifndef BPRED_HPERC_H
+#define BPRED_HPERC_H
+
+#include <stdio.h>
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "stats.h"
+#include "bpred_perc.h"
+
+/*
+ * This module implements a hashed perceptron: rather than one row of
+ * weights per branch, with one weight per history bit, it has several
+ * tables of single weights.  Table 0 is indexed by the branch address
+ * alone and acts as the bias; table K > 0 is indexed by a hash of the
+ * branch address with a segment of the global history and of the path
+ * history.  Segments double in length from table to table and together
+ * cover the whole history, so storage is set by the number and size of
+ * the tables, not by the history length, and histories of hundreds of
+ * bits cost no more than short ones.
+ *
+ * The prediction is the sign of the sum of the selected weights.  They
+ * are trained, as in the plain perceptron, on a misprediction or when the
+ * sum is within the threshold theta of zero; theta itself adapts at run
+ * time (as in O-GEHL): mispredictions push it up and correct low-margin
+ * predictions pull it down, balancing the two.
+ *
+ * The global history register is the perceptron's bit-packed one
+ * (bpred_perc.h), with its path history of 2 address bits per branch.
+ */
+
+/* most weight tables */
+#define HPERC_MAX_TABLES	16
+
+/* hashed perceptron */
+struct bpred_hperc_t {
+  unsigned int ntables;		/* number of weight tables */
+  unsigned int log_size;	/* log2 weights per table */
+  unsigned int hist_bits;	/* global history length */
+  unsigned int seg_start[HPERC_MAX_TABLES];/* history segment per table */
+  unsigned int seg_len[HPERC_MAX_TABLES];
+  unsigned int weight_bits;	/* weight width */
+  int max_weight;		/* weights saturate at +/- max_weight */
+  sbyte_t *weights;		/* NTABLES x 2^LOG_SIZE weights */
+
+  int theta;			/* training threshold */
+  int theta_ctr;		/* theta adaptation counter */
+
+  struct bpred_perc_hist_t hist;/* speculative global history */
+};
+
+/* create a hashed perceptron of NTABLES tables of TABLE_SIZE weights,
+   WEIGHT_BITS wide, over HIST_BITS bits of global history */
+struct bpred_hperc_t *			/* hashed perceptron instance */
+bpred_hperc_create(unsigned int ntables,/* number of weight tables */
+		   unsigned int table_size,/* weights per table */
+		   unsigned int weight_bits,/* weight width, in bits */
+		   unsigned int hist_bits);/* global history length */
+
+/* compute the output for the branch at BADDR with global history H */
+int					/* perceptron output y */
+bpred_hperc_output(struct bpred_hperc_t *hp,/* hashed perceptron */
+		   md_addr_t baddr,	/* branch address */
+		   struct bpred_perc_hist_t *h);/* global history */
+
+/* train toward outcome TAKEN the weights of the branch at BADDR, which
+   saw global history H and had output Y, and adapt theta */
+void
+bpred_hperc_train(struct bpred_hperc_t *hp,/* hashed perceptron */
+		  md_addr_t baddr,	/* branch address */
+		  struct bpred_perc_hist_t *h,/* history seen at lookup */
+		  int y,		/* output at lookup */
+		  int taken);		/* actual branch outcome */
+
+/* print hashed perceptron configuration */
+void
+bpred_hperc_config(struct bpred_hperc_t *hp,/* hashed perceptron */
+		   char name[],		/* predictor name */
+		   FILE *stream);	/* output stream */
+
+/* register hashed perceptron stats under NAME */
+void
+bpred_hperc_reg_stats(struct bpred_hperc_t *hp,/* hashed perceptron */
+		      char *name,	/* stats name prefix */
+		      struct stat_sdb_t *sdb);/* stats database */
+
+/* free hashed perceptron resources */
+void
+bpred_hperc_free(struct bpred_hperc_t *hp);/* hashed perceptron */
+
+#endif /* BPRED_HPERC_H */
@@ -0,0 +1,389 @@
+/* bpred_ittage.c - ITTAGE indirect branch target predictor */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "stats.h"
+#include "bpred_perc.h"
+#include "bpred_ittage.h"
+
+/* updates between useful counter agings */
+#define ITTAGE_U_PERIOD		(1 << 16)
+
+/* branches whose address bits the path history holds */
+#define PATH_BRANCHES		32
+
+/* entry IDX of tagged table I (0-based) */
+#define ITTAGE_ENT(T, I, IDX)	(&(T)->tables[((I) << (T)->log_size) + (IDX)])
+
+/* table lookup result for one jump */
+struct ittage_probe_t {
+  unsigned int idx[ITTAGE_MAX_TABLES];	/* index into each tagged table */
+  half_t tag[ITTAGE_MAX_TABLES];	/* tag for each tagged table */
+  int provider;			/* providing table, 1-based, 0 for none */
+  int alt;			/* alternate table, 1-based, 0 for none */
+  int used_alt;			/* alternate overrode the provider */
+  md_addr_t target;		/* predicted target, if PROVIDER */
+};
+
+/* create an ITTAGE predictor of NTABLES tagged tables of TABLE_SIZE
+   entries with TAG_BITS-bit tags, using history lengths from MIN_HIST to
+   MAX_HIST */
+struct bpred_ittage_t *			/* ITTAGE predictor instance */
+bpred_ittage_create(unsigned int ntables,/* number of tagged tables */
+		    unsigned int table_size,/* entries per tagged table */
+		    unsigned int min_hist,/* shortest history length */
+		    unsigned int max_hist,/* longest history length */
+		    unsigned int tag_bits)/* partial tag width */
+{
+  struct bpred_ittage_t *it;
+  unsigned int i, len;
+
+  if (!ntables || ntables > ITTAGE_MAX_TABLES)
+    fatal("ITTAGE: number of tagged tables `%d' must be between 1 and %d",
+	  ntables, ITTAGE_MAX_TABLES);
+  if (table_size < 16 || (table_size & (table_size - 1)) != 0)
+    fatal("ITTAGE: table size `%d' must be a power of two, at least 16",
+	  table_size);
+  if (!min_hist || max_hist < min_hist + ntables - 1
+      || max_hist > PERC_HIST_MAX)
+    fatal("ITTAGE: history lengths `%d..%d' must be non-zero, increasing by "
+	  "at least one per table, and at most %d",
+	  min_hist, max_hist, PERC_HIST_MAX);
+  if (tag_bits < 4 || tag_bits > 16)
+    fatal("ITTAGE: tag width `%d' must be between 4 and 16 bits", tag_bits);
+
+  if (!(it = calloc(1, sizeof(struct bpred_ittage_t))))
+    fatal("out of virtual memory");
+
+  it->ntables = ntables;
+  it->tag_bits = tag_bits;
+  for (it->log_size = 0; (1U << it->log_size) < table_size; it->log_size++)
+    /* nada */;
+
+  /* geometric history lengths, kept strictly increasing */
+  for (i = 0; i < ntables; i++)
+    {
+      if (ntables == 1)
+	len = min_hist;
+      else
+	len = (unsigned int)(min_hist
+			     * pow((double)max_hist / min_hist,
+				   (double)i / (ntables - 1)) + 0.5);
+      if (i && len <= it->hist_len[i-1])
+	len = it->hist_len[i-1] + 1;
+      it->hist_len[i] = len;
+    }
+
+  if (!(it->tables = calloc(ntables << it->log_size,
+			    sizeof(struct bpred_ittage_ent_t))))
+    fatal("cannot allocate ITTAGE tables");
+
+  it->lfsr = 1;
+  bpred_perc_hist_init(&it->hist);
+  return it;
+}
+
+/* fold the path history of the newest LEN branches of H, as far as it
+   reaches, into WIDTH bits */
+static word_t
+path_fold(struct bpred_perc_hist_t *h, unsigned int len, unsigned int width)
+{
+  qword_t v = h->path;
+  word_t f = 0;
+
+  if (len < PATH_BRANCHES)
+    v &= (ULL(1) << (2 * len)) - 1;
+  for (; v; v >>= width)
+    f ^= (word_t)v & ((1U << width) - 1);
+  return f;
+}
+
+/* look the jump at BADDR up in all tables with global history H */
+static void
+ittage_probe(struct bpred_ittage_t *it,	/* ITTAGE instance */
+	     md_addr_t baddr,		/* branch address */
+	     struct bpred_perc_hist_t *h,/* global history */
+	     struct ittage_probe_t *p)	/* lookup result */
+{
+  word_t pc = baddr >> MD_BR_SHIFT;
+  unsigned int i, r, len, mask = (1U << it->log_size) - 1;
+  word_t pf;
+  struct bpred_ittage_ent_t *e;
+
+  p->provider = p->alt = 0;
+  p->used_alt = FALSE;
+
+  for (i = 0; i < it->ntables; i++)
+    {
+      len = it->hist_len[i];
+
+      /* rotate the path by table so that tables see different mixes */
+      pf = path_fold(h, len, it->log_size);
+      r = (i + 1) % it->log_size;
+      if (r)
+	pf = ((pf << r) | (pf >> (it->log_size - r))) & mask;
+
+      p->idx[i] = (pc ^ (pc >> (it->log_size - r))
+		   ^ bpred_perc_hist_fold(h, 0, len, it->log_size) ^ pf)
+	& mask;
+      p->tag[i] = (pc ^ bpred_perc_hist_fold(h, 0, len, it->tag_bits)
+		   ^ (bpred_perc_hist_fold(h, 0, len, it->tag_bits - 1) << 1))
+	& ((1U << it->tag_bits) - 1);
+    }
+
+  /* longest and second longest matching tables */
+  for (i = it->ntables; i > 0; i--)
+    {
+      e = ITTAGE_ENT(it, i-1, p->idx[i-1]);
+      if (e->tag == p->tag[i-1] && e->target)
+	{
+	  if (!p->provider)
+	    p->provider = i;
+	  else
+	    {
+	      p->alt = i;
+	      break;
+	    }
+	}
+    }
+
+  if (!p->provider)
+    return;
+
+  e = ITTAGE_ENT(it, p->provider-1, p->idx[p->provider-1]);
+  p->used_alt = (!e->ctr && p->alt);
+  if (p->used_alt)
+    e = ITTAGE_ENT(it, p->alt-1, p->idx[p->alt-1]);
+  p->target = e->target;
+}
+
+/* predict the target of the indirect jump at BADDR with global history H;
+   returns non-zero and sets *TARGET if a table provided one */
+int					/* non-zero if predicted */
+bpred_ittage_lookup(struct bpred_ittage_t *it,/* ITTAGE instance */
+		    md_addr_t baddr,	/* branch address */
+		    struct bpred_perc_hist_t *h,/* global history */
+		    md_addr_t *target)	/* predicted target */
+{
+  struct ittage_probe_t p;
+
+  ittage_probe(it, baddr, h, &p);
+  if (!p.provider)
+    return FALSE;
+
+  *target = p.target;
+  return TRUE;
+}
+
+/* step the confidence of entry E toward target BTARGET, replacing its
+   target once it has no confidence left */
+static void
+target_update(struct bpred_ittage_ent_t *e, md_addr_t btarget)
+{
+  if (e->target == btarget)
+    {
+      if (e->ctr < 3)
+	e->ctr++;
+    }
+  else if (e->ctr)
+    e->ctr--;
+  else
+    e->target = btarget;
+}
+
+/* next allocation random bit source */
+static word_t
+lfsr_next(struct bpred_ittage_t *it)
+{
+  it->lfsr = (it->lfsr >> 1) ^ (-(it->lfsr & 1) & 0xd0000001U);
+  return it->lfsr;
+}
+
+/* train the predictor with target BTARGET of the indirect jump at BADDR,
+   which saw global history H; CORRECT is non-zero if the target actually
+   used for it was right */
+void
+bpred_ittage_update(struct bpred_ittage_t *it,/* ITTAGE instance */
+		    md_addr_t baddr,	/* branch address */
+		    struct bpred_perc_hist_t *h,/* history seen at lookup */
+		    md_addr_t btarget,	/* resolved branch target */
+		    int correct)	/* was the target prediction ok? */
+{
+  struct ittage_probe_t p;
+  struct bpred_ittage_ent_t *e = NULL, *alt = NULL;
+  int provider_ok = FALSE, alt_ok = FALSE;
+  unsigned int i, j;
+
+  ittage_probe(it, baddr, h, &p);
+
+  it->lookups++;
+  if (p.provider)
+    {
+      it->provided++;
+      if (p.target == btarget)
+	it->provided_hits++;
+
+      e = ITTAGE_ENT(it, p.provider-1, p.idx[p.provider-1]);
+      provider_ok = (e->target == btarget);
+      if (p.alt)
+	{
+	  alt = ITTAGE_ENT(it, p.alt-1, p.idx[p.alt-1]);
+	  alt_ok = (alt->target == btarget);
+	}
+    }
+
+  /* on a target misprediction, allocate an entry in a longer-history
+     table; not when only the alternate standing in for the provider was
+     wrong */
+  if (!correct && p.provider < (int)it->ntables
+      && !(p.used_alt && provider_ok))
+    {
+      i = p.provider;
+
+      /* half the time skip a table, so allocations spread out */
+      if (i + 1 < it->ntables && (lfsr_next(it) & 1))
+	i++;
+
+      for (j = i; j < it->ntables; j++)
+	{
+	  struct bpred_ittage_ent_t *a = ITTAGE_ENT(it, j, p.idx[j]);
+
+	  if (!a->u)
+	    {
+	      a->tag = p.tag[j];
+	      a->target = btarget;
+	      a->ctr = 0;
+	      it->allocs++;
+	      break;
+	    }
+	}
+      if (j == it->ntables)
+	{
+	  /* no victim; make room for next time */
+	  for (j = p.provider; j < it->ntables; j++)
+	    {
+	      struct bpred_ittage_ent_t *a = ITTAGE_ENT(it, j, p.idx[j]);
+
+	      if (a->u)
+		a->u--;
+	    }
+	  it->alloc_fails++;
+	}
+    }
+
+  if (e)
+    {
+      /* useful when it was right where the alternate was not */
+      if (alt && provider_ok != alt_ok)
+	{
+	  if (provider_ok)
+	    {
+	      if (e->u < 3)
+		e->u++;
+	    }
+	  else if (e->u)
+	    e->u--;
+	}
+
+      /* train the provider, and the alternate that stood in for it */
+      target_update(e, btarget);
+      if (p.used_alt)
+	target_update(alt, btarget);
+    }
+
+  /* age useful counters so that stale entries can be replaced */
+  if (++it->tick % ITTAGE_U_PERIOD == 0)
+    {
+      for (i = 0; i < (it->ntables << it->log_size); i++)
+	it->tables[i].u >>= 1;
+    }
+}
+
+/* shift outcome TAKEN of the branch at BADDR into the global history */
+void
+bpred_ittage_hist_push(struct bpred_ittage_t *it,/* ITTAGE instance */
+		       md_addr_t baddr,	/* branch address */
+		       int taken)	/* branch outcome */
+{
+  bpred_perc_hist_push(&it->hist, it->hist_len[it->ntables-1], taken,
+		       baddr >> MD_BR_SHIFT);
+}
+
+/* print ITTAGE predictor configuration */
+void
+bpred_ittage_config(struct bpred_ittage_t *it,/* ITTAGE instance */
+		    FILE *stream)	/* output stream */
+{
+  unsigned int i;
+
+  fprintf(stream,
+	  "ittage: %d tables x %d entries, %d-bit tags, history lengths",
+	  it->ntables, 1 << it->log_size, it->tag_bits);
+  for (i = 0; i < it->ntables; i++)
+    fprintf(stream, " %d", it->hist_len[i]);
+  fprintf(stream, "\n");
+}
+
+/* register ITTAGE predictor stats under NAME */
+void
+bpred_ittage_reg_stats(struct bpred_ittage_t *it,/* ITTAGE instance */
+		       char *name,	/* stats name prefix */
+		       struct stat_sdb_t *sdb)/* stats database */
+{
+  char buf[512], buf1[512];
+
+  sprintf(buf, "%s.ittage_lookups", name);
+  stat_reg_counter(sdb, buf,
+		   "non-return indirect jumps trained by the ITTAGE predictor",
+		   &it->lookups, 0, NULL);
+  sprintf(buf, "%s.ittage_provided", name);
+  stat_reg_counter(sdb, buf, "... of which a tagged table provided a target",
+		   &it->provided, 0, NULL);
+  sprintf(buf, "%s.ittage_provided_hits", name);
+  stat_reg_counter(sdb, buf, "... of which the target was correct",
+		   &it->provided_hits, 0, NULL);
+  sprintf(buf, "%s.ittage_rate", name);
+  sprintf(buf1, "%s.ittage_provided_hits / %s.ittage_provided", name, name);
+  stat_reg_formula(sdb, buf,
+		   "ITTAGE target-prediction rate (i.e., hits/provided)",
+		   buf1, "%9.4f");
+  sprintf(buf, "%s.ittage_allocs", name);
+  stat_reg_counter(sdb, buf, "ITTAGE entries allocated on target misses",
+		   &it->allocs, 0, NULL);
+  sprintf(buf, "%s.ittage_alloc_fails", name);
+  stat_reg_counter(sdb, buf,
+		   "target misses that found no ITTAGE entry to allocate",
+		   &it->alloc_fails, 0, NULL);
+}
+
+/* reset ITTAGE predictor stats */
+void
+bpred_ittage_reset_stats(struct bpred_ittage_t *it)/* ITTAGE instance */
+{
+  it->lookups = 0;
+  it->provided = 0;
+  it->provided_hits = 0;
+  it->allocs = 0;
+  it->alloc_fails = 0;
+}
+
+/* free ITTAGE predictor resources */
+void
+bpred_ittage_free(struct bpred_ittage_t *it)/* ITTAGE instance */
+{
+  if (!it)
+    return;
+
+  free(it->tables);
+  free(it);
+}
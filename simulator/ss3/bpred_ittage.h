@@ -0,0 +1,129 @@
+/* bpred_ittage.h - ITTAGE indirect branch target predictor */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ */
+
+#ifndef BPRED_ITTAGE_H
+#define BPRED_ITTAGE_H
+
+#include <stdio.h>
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "stats.h"
+#include "bpred_perc.h"
+
+/*
+ * This module implements an ITTAGE indirect branch target predictor, the
+ * target counterpart of TAGE (bpred_tage.h): a number of partially tagged
+ * tables, each indexed with a hash of the branch address and an ever
+ * longer slice of the global history, whose entries hold a full target
+ * address, a confidence counter and a useful counter.  It is consulted
+ * for indirect jumps that do not use the return-address stack, which
+ * otherwise only get the last target recorded in the BTB.
+ *
+ * The longest-history table whose tag matches provides the target; the
+ * next matching table is the alternate, used instead while the provider
+ * has no confidence in its target.  With no matching table there is no
+ * prediction and the BTB target is used.  A wrong provider loses
+ * confidence and, once it has none, takes on the new target.  When the
+ * target of a jump was mispredicted an entry is allocated in a
+ * longer-history table whose useful counter is zero; useful counters
+ * track when the provider was right and the alternate was not, and are
+ * aged periodically.
+ *
+ * The global history is the perceptron's bit-packed register
+ * (bpred_perc.h), shifted by every control instruction: conditional
+ * branches shift in their direction, unconditional ones a taken bit, and
+ * the path history takes 2 address bits of each.  Targets are not part of
+ * the history, since sim-outorder does not know them at lookup.
+ */
+
+/* most tagged tables */
+#define ITTAGE_MAX_TABLES	16
+
+/* tagged table entry */
+struct bpred_ittage_ent_t {
+  half_t tag;			/* partial tag */
+  byte_t ctr;			/* 2-bit target confidence */
+  byte_t u;			/* 2-bit useful counter */
+  md_addr_t target;		/* predicted target */
+};
+
+/* ITTAGE predictor */
+struct bpred_ittage_t {
+  unsigned int ntables;		/* number of tagged tables */
+  unsigned int log_size;	/* log2 entries per tagged table */
+  unsigned int tag_bits;	/* partial tag width */
+  unsigned int hist_len[ITTAGE_MAX_TABLES];/* history length per table */
+
+  struct bpred_ittage_ent_t *tables;/* NTABLES x 2^LOG_SIZE entries */
+  counter_t tick;		/* updates, drives useful counter aging */
+  word_t lfsr;			/* allocation randomizer */
+
+  struct bpred_perc_hist_t hist;/* speculative global history */
+
+  /* stats */
+  counter_t lookups;		/* non-return indirect jumps trained */
+  counter_t provided;		/* ... for which a table provided a target */
+  counter_t provided_hits;	/* ... that was correct */
+  counter_t allocs;		/* entries allocated */
+  counter_t alloc_fails;	/* target misses with nowhere to allocate */
+};
+
+/* create an ITTAGE predictor of NTABLES tagged tables of TABLE_SIZE
+   entries with TAG_BITS-bit tags, using history lengths from MIN_HIST to
+   MAX_HIST */
+struct bpred_ittage_t *			/* ITTAGE predictor instance */
+bpred_ittage_create(unsigned int ntables,/* number of tagged tables */
+		    unsigned int table_size,/* entries per tagged table */
+		    unsigned int min_hist,/* shortest history length */
+		    unsigned int max_hist,/* longest history length */
+		    unsigned int tag_bits);/* partial tag width */
+
+/* predict the target of the indirect jump at BADDR with global history H;
+   returns non-zero and sets *TARGET if a table provided one */
+int					/* non-zero if predicted */
+bpred_ittage_lookup(struct bpred_ittage_t *it,/* ITTAGE instance */
+		    md_addr_t baddr,	/* branch address */
+		    struct bpred_perc_hist_t *h,/* global history */
+		    md_addr_t *target);	/* predicted target */
+
+/* train the predictor with target BTARGET of the indirect jump at BADDR,
+   which saw global history H; CORRECT is non-zero if the target actually
+   used for it was right */
+void
+bpred_ittage_update(struct bpred_ittage_t *it,/* ITTAGE instance */
+		    md_addr_t baddr,	/* branch address */
+		    struct bpred_perc_hist_t *h,/* history seen at lookup */
+		    md_addr_t btarget,	/* resolved branch target */
+		    int correct);	/* was the target prediction ok? */
+
+/* shift outcome TAKEN of the branch at BADDR into the global history */
+void
+bpred_ittage_hist_push(struct bpred_ittage_t *it,/* ITTAGE instance */
+		       md_addr_t baddr,	/* branch address */
+		       int taken);	/* branch outcome */
+
+/* print ITTAGE predictor configuration */
+void
+bpred_ittage_config(struct bpred_ittage_t *it,/* ITTAGE instance */
+		    FILE *stream);	/* output stream */
+
+/* register ITTAGE predictor stats under NAME */
+void
+bpred_ittage_reg_stats(struct bpred_ittage_t *it,/* ITTAGE instance */
+		       char *name,	/* stats name prefix */
+		       struct stat_sdb_t *sdb);/* stats database */
+
+/* reset ITTAGE predictor stats */
+void
+bpred_ittage_reset_stats(struct bpred_ittage_t *it);/* ITTAGE instance */
+
+/* free ITTAGE predictor resources */
+void
+bpred_ittage_free(struct bpred_ittage_t *it);/* ITTAGE instance */
+
+#endif /* BPRED_ITTAGE_H */
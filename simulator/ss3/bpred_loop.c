@@ -0,0 +1,305 @@
+/* bpred_loop.c - loop predictor */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "stats.h"
+#include "bpred_loop.h"
+
+/* replacement protection of a new entry, worn down by failed allocations
+   and built up by useful predictions */
+#define LOOP_AGE_INIT		8
+#define LOOP_AGE_MAX		255
+
+/* create a loop predictor of ENTRIES entries */
+struct bpred_loop_t *			/* loop predictor instance */
+bpred_loop_create(unsigned int entries)	/* number of entries */
+{
+  struct bpred_loop_t *lp;
+
+  if (entries < LOOP_ASSOC || (entries & (entries - 1)) != 0)
+    fatal("loop predictor: size `%d' must be a power of two, at least %d",
+	  entries, LOOP_ASSOC);
+
+  if (!(lp = calloc(1, sizeof(struct bpred_loop_t))))
+    fatal("out of virtual memory");
+
+  lp->sets = entries / LOOP_ASSOC;
+  for (lp->log_sets = 0; (1U << lp->log_sets) < lp->sets; lp->log_sets++)
+    /* nada */;
+
+  if (!(lp->table = calloc(entries, sizeof(struct bpred_loop_ent_t))))
+    fatal("cannot allocate loop predictor table");
+
+  /* earn the right to override first */
+  lp->with_loop = -1;
+
+  return lp;
+}
+
+/* set and tag of the branch at BADDR */
+#define LOOP_SET(LP, ADDR)						\
+  (((ADDR) >> MD_BR_SHIFT) & ((LP)->sets - 1))
+#define LOOP_TAG(LP, ADDR)						\
+  ((half_t)((((ADDR) >> MD_BR_SHIFT) >> (LP)->log_sets)		\
+	    & (LOOP_VALID - 1)) | LOOP_VALID)
+
+/* entry of the branch at BADDR, or -1 */
+static int
+loop_find(struct bpred_loop_t *lp, md_addr_t baddr)
+{
+  unsigned int base = LOOP_SET(lp, baddr) * LOOP_ASSOC, i;
+  half_t tag = LOOP_TAG(lp, baddr);
+
+  for (i = 0; i < LOOP_ASSOC; i++)
+    if (lp->table[base + i].tag == tag)
+      return base + i;
+  return -1;
+}
+
+/* count outcome TAKEN into the fetched iterations of entry E */
+static void
+spec_advance(struct bpred_loop_ent_t *e, int taken)
+{
+  if (!!taken == e->dir)
+    {
+      if (e->spec_iter < LOOP_MAX_ITER)
+	e->spec_iter++;
+    }
+  else
+    e->spec_iter = 0;
+}
+
+/* predict the direction of the conditional branch at BADDR, which the
+   direction predictor predicts IN_TAKEN, saving the state needed to
+   update and repair the predictor in *CK */
+int					/* non-zero if predicted taken */
+bpred_loop_lookup(struct bpred_loop_t *lp,/* loop predictor instance */
+		  md_addr_t baddr,	/* branch address */
+		  int in_taken,		/* direction predictor's direction */
+		  struct bpred_loop_ckpt_t *ck)/* lookup state */
+{
+  struct bpred_loop_ent_t *e;
+
+  int pred_taken;
+
+  ck->in = !!in_taken;
+  ck->pred = ck->in;
+  ck->used = FALSE;
+  ck->over = FALSE;
+  ck->ent = loop_find(lp, baddr);
+  if (ck->ent < 0)
+    return ck->in;
+
+  e = &lp->table[ck->ent];
+  ck->tag = e->tag;
+  ck->spec_iter = e->spec_iter;
+
+  /* a confident entry predicts the exit after TRIP iterations */
+  if (e->conf >= LOOP_CONF_MAX)
+    {
+      ck->used = TRUE;
+      ck->pred = (e->spec_iter == e->trip) ? !e->dir : e->dir;
+      ck->over = (ck->pred != ck->in && lp->with_loop >= 0);
+    }
+
+  pred_taken = ck->over ? ck->pred : ck->in;
+  spec_advance(e, pred_taken);
+  return pred_taken;
+}
+
+/* rebuild the fetched iteration count of the branch with lookup state CK
+   from its outcome TAKEN */
+void
+bpred_loop_recover(struct bpred_loop_t *lp,/* loop predictor instance */
+		   struct bpred_loop_ckpt_t *ck,/* lookup state */
+		   int taken)		/* actual branch outcome */
+{
+  struct bpred_loop_ent_t *e;
+
+  if (ck->ent < 0)
+    return;
+
+  /* unless the entry went to another branch since */
+  e = &lp->table[ck->ent];
+  if (e->tag != ck->tag)
+    return;
+
+  e->spec_iter = ck->spec_iter;
+  spec_advance(e, taken);
+}
+
+/* train the predictor with outcome TAKEN of the branch at BADDR, with
+   lookup state CK */
+void
+bpred_loop_update(struct bpred_loop_t *lp,/* loop predictor instance */
+		  md_addr_t baddr,	/* branch address */
+		  struct bpred_loop_ckpt_t *ck,/* lookup state */
+		  int taken)		/* actual branch outcome */
+{
+  struct bpred_loop_ent_t *e;
+  unsigned int base, i;
+  int ent;
+
+  taken = !!taken;
+  ent = loop_find(lp, baddr);
+
+  if (ent >= 0)
+    {
+      e = &lp->table[ent];
+
+      if (ck->used && ck->ent == ent)
+	{
+	  lp->used++;
+	  if (ck->over)
+	    {
+	      lp->overrides++;
+	      if (ck->pred == taken)
+		lp->override_hits++;
+	    }
+
+	  /* would overriding have been right? */
+	  if (ck->pred != ck->in)
+	    {
+	      if (ck->pred == taken)
+		{
+		  if (lp->with_loop < LOOP_WITH_MAX)
+		    lp->with_loop++;
+		}
+	      else if (lp->with_loop > -LOOP_WITH_MAX - 1)
+		lp->with_loop--;
+	    }
+
+	  /* not a loop after all, or not with this trip count */
+	  if (ck->pred != taken)
+	    {
+	      e->tag = 0;
+	      return;
+	    }
+	  if (ck->pred != ck->in && e->age < LOOP_AGE_MAX)
+	    e->age++;
+	}
+
+      if (taken == e->dir)
+	{
+	  /* another iteration */
+	  if (e->iter == LOOP_MAX_ITER)
+	    e->tag = 0;
+	  else
+	    e->iter++;
+	}
+      else
+	{
+	  /* the run is over, a loop has at least one iteration */
+	  if (!e->iter)
+	    {
+	      e->tag = 0;
+	      return;
+	    }
+	  if (e->iter == e->trip)
+	    {
+	      if (e->conf < LOOP_CONF_MAX)
+		e->conf++;
+	    }
+	  else
+	    {
+	      e->trip = e->iter;
+	      e->conf = 0;
+	    }
+	  e->iter = 0;
+	}
+      return;
+    }
+
+  /* the direction predictor missed; take this to be a loop exit */
+  if (ck->in == taken)
+    return;
+
+  base = LOOP_SET(lp, baddr) * LOOP_ASSOC;
+  for (i = 0; i < LOOP_ASSOC; i++)
+    if (!lp->table[base + i].tag || !lp->table[base + i].age)
+      break;
+  if (i == LOOP_ASSOC)
+    {
+      /* no victim; make room for next time */
+      for (i = 0; i < LOOP_ASSOC; i++)
+	lp->table[base + i].age--;
+      return;
+    }
+
+  e = &lp->table[base + i];
+  e->tag = LOOP_TAG(lp, baddr);
+  e->dir = !taken;
+  e->trip = 0;
+  e->iter = 0;
+  e->spec_iter = 0;
+  e->conf = 0;
+  e->age = LOOP_AGE_INIT;
+  lp->allocs++;
+}
+
+/* print loop predictor configuration */
+void
+bpred_loop_config(struct bpred_loop_t *lp,/* loop predictor instance */
+		  FILE *stream)		/* output stream */
+{
+  fprintf(stream, "loop: %d sets x %d associativity\n",
+	  lp->sets, LOOP_ASSOC);
+}
+
+/* register loop predictor stats under NAME */
+void
+bpred_loop_reg_stats(struct bpred_loop_t *lp,/* loop predictor instance */
+		     char *name,	/* stats name prefix */
+		     struct stat_sdb_t *sdb)/* stats database */
+{
+  char buf[512], buf1[512];
+
+  sprintf(buf, "%s.loop_used", name);
+  stat_reg_counter(sdb, buf, "confident loop predictor predictions",
+		   &lp->used, 0, NULL);
+  sprintf(buf, "%s.loop_overrides", name);
+  stat_reg_counter(sdb, buf,
+		   "... that overrode the direction predictor",
+		   &lp->overrides, 0, NULL);
+  sprintf(buf, "%s.loop_override_hits", name);
+  stat_reg_counter(sdb, buf, "... and were correct",
+		   &lp->override_hits, 0, NULL);
+  sprintf(buf, "%s.loop_override_rate", name);
+  sprintf(buf1, "%s.loop_override_hits / %s.loop_overrides", name, name);
+  stat_reg_formula(sdb, buf,
+		   "loop predictor override rate (i.e., hits/overrides)",
+		   buf1, "%9.4f");
+  sprintf(buf, "%s.loop_allocs", name);
+  stat_reg_counter(sdb, buf, "loop predictor entries allocated",
+		   &lp->allocs, 0, NULL);
+}
+
+/* reset loop predictor stats */
+void
+bpred_loop_reset_stats(struct bpred_loop_t *lp)/* loop predictor instance */
+{
+  lp->used = 0;
+  lp->overrides = 0;
+  lp->override_hits = 0;
+  lp->allocs = 0;
+}
+
+/* free loop predictor resources */
+void
+bpred_loop_free(struct bpred_loop_t *lp)/* loop predictor instance */
+{
+  if (!lp)
+    return;
+
+  free(lp->table);
+  free(lp);
+}
@@ -0,0 +1,138 @@
+/* bpred_loop.h - loop predictor */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ */
+
+#ifndef BPRED_LOOP_H
+#define BPRED_LOOP_H
+
+#include <stdio.h>
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "stats.h"
+
+/*
+ * This module implements a loop predictor, as in L-TAGE: a small
+ * set-associative table of conditional branches that behave as loops,
+ * going one way a fixed number of times (the trip count) and then the
+ * other way once.  Each entry counts the iterations of the current run,
+ * both as committed and as fetched, and gains confidence each time a run
+ * ends after the same trip count.  Once confident, the entry predicts the
+ * loop exit on the last iteration and overrides the direction predictor,
+ * which can rarely learn exits of loops longer than its history.  As in
+ * L-TAGE, a global counter tracks whether confident predictions that
+ * disagree with the direction predictor turn out right more often than
+ * not, and overrides are only made while they do.
+ *
+ * An entry is allocated when the direction predictor mispredicts a branch
+ * that has none, taking that outcome to be the loop exit.  It is freed
+ * when a confident prediction turns out wrong, when a run has no
+ * iterations, or when the iteration count overflows.  Each branch
+ * carries the fetched iteration count of its entry, from which the count
+ * is rebuilt after a misprediction.
+ */
+
+/* ways per set */
+#define LOOP_ASSOC		4
+
+/* tag of a valid entry; a free entry's tag is 0 */
+#define LOOP_VALID		0x8000
+
+/* runs in a row with the same trip count before predictions are used */
+#define LOOP_CONF_MAX		3
+
+/* longest trip count */
+#define LOOP_MAX_ITER		0xffff
+
+/* override counter range */
+#define LOOP_WITH_MAX		63
+
+/* loop table entry */
+struct bpred_loop_ent_t {
+  half_t tag;			/* partial tag, LOOP_VALID or'ed in */
+  half_t trip;			/* iterations per run */
+  half_t iter;			/* iterations of the current run, committed */
+  half_t spec_iter;		/* ... and as fetched */
+  byte_t conf;			/* runs in a row with TRIP iterations */
+  byte_t age;			/* replacement protection */
+  byte_t dir;			/* direction of the iterations */
+};
+
+/* loop predictor state at lookup, travels with the branch */
+struct bpred_loop_ckpt_t {
+  int ent;			/* entry of the branch, or -1 */
+  half_t tag;			/* ... and its tag */
+  half_t spec_iter;		/* fetched iteration count before it */
+  byte_t in;			/* direction predicted without the loop
+				   predictor */
+  byte_t used;			/* non-zero if the entry was confident */
+  byte_t pred;			/* ... and its predicted direction */
+  byte_t over;			/* non-zero if that overrode IN */
+};
+
+/* loop predictor */
+struct bpred_loop_t {
+  unsigned int sets;		/* number of sets */
+  unsigned int log_sets;	/* log2 sets */
+  struct bpred_loop_ent_t *table;/* SETS x LOOP_ASSOC entries */
+  int with_loop;		/* overrides are made while non-negative */
+
+  /* stats */
+  counter_t used;		/* confident predictions */
+  counter_t overrides;		/* ... that reversed the direction
+				   predictor */
+  counter_t override_hits;	/* ... and were correct */
+  counter_t allocs;		/* entries allocated */
+};
+
+/* create a loop predictor of ENTRIES entries */
+struct bpred_loop_t *			/* loop predictor instance */
+bpred_loop_create(unsigned int entries);/* number of entries */
+
+/* predict the direction of the conditional branch at BADDR, which the
+   direction predictor predicts IN_TAKEN, saving the state needed to
+   update and repair the predictor in *CK */
+int					/* non-zero if predicted taken */
+bpred_loop_lookup(struct bpred_loop_t *lp,/* loop predictor instance */
+		  md_addr_t baddr,	/* branch address */
+		  int in_taken,		/* direction predictor's direction */
+		  struct bpred_loop_ckpt_t *ck);/* lookup state */
+
+/* rebuild the fetched iteration count of the branch with lookup state CK
+   from its outcome TAKEN */
+void
+bpred_loop_recover(struct bpred_loop_t *lp,/* loop predictor instance */
+		   struct bpred_loop_ckpt_t *ck,/* lookup state */
+		   int taken);		/* actual branch outcome */
+
+/* train the predictor with outcome TAKEN of the branch at BADDR, with
+   lookup state CK */
+void
+bpred_loop_update(struct bpred_loop_t *lp,/* loop predictor instance */
+		  md_addr_t baddr,	/* branch address */
+		  struct bpred_loop_ckpt_t *ck,/* lookup state */
+		  int taken);		/* actual branch outcome */
+
+/* print loop predictor configuration */
+void
+bpred_loop_config(struct bpred_loop_t *lp,/* loop predictor instance */
+		  FILE *stream);	/* output stream */
+
+/* register loop predictor stats under NAME */
+void
+bpred_loop_reg_stats(struct bpred_loop_t *lp,/* loop predictor instance */
+		     char *name,	/* stats name prefix */
+		     struct stat_sdb_t *sdb);/* stats database */
+
+/* reset loop predictor stats */
+void
+bpred_loop_reset_stats(struct bpred_loop_t *lp);/* loop predictor instance */
+
+/* free loop predictor resources */
+void
+bpred_loop_free(struct bpred_loop_t *lp);/* loop predictor instance */
+
+#endif /* BPRED_LOOP_H */
@@ -0,0 +1,552 @@
+/* bpred_perc.c - packed perceptron weight tables */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+#include "misc.h"
+#include "bpred_perc.h"
+
+/* vector kernels need GCC-style per-function target attributes; define
+   BPRED_PERC_NO_SIMD to build the portable kernels only */
+#if !defined(BPRED_PERC_NO_SIMD) && defined(__GNUC__)			\
+    && (defined(__x86_64__) || defined(__i386__))
+#define PERC_X86
+#include <immintrin.h>
+#endif
+
+/* NB (<= 32) bits of history register H starting at bit K, where K is a
+   multiple of NB so the field never straddles two words */
+#define HBITS(H, K, NB)							\
+  ((word_t)((H)[(K) >> 6] >> ((K) & 63)) & (word_t)((ULL(1) << (NB)) - 1))
+
+/* mask of the bits of an NB-bit field at bit K that fall below NBITS */
+#define VBITS(NBITS, K, NB)						\
+  ((NBITS) - (K) >= (NB)						\
+   ? (word_t)((ULL(1) << (NB)) - 1) : (word_t)((ULL(1) << ((NBITS) - (K))) - 1))
+
+/* dot-product and training kernels over the low NBITS bits of history H */
+struct perc_kernel_t {
+  char *name;
+  int (*dot8)(const sbyte_t *w, const qword_t *h, unsigned int nbits);
+  void (*train8)(sbyte_t *w, const qword_t *h, unsigned int nbits,
+		 int t, int maxw);
+  int (*dot16)(const shalf_t *w, const qword_t *h, unsigned int nbits);
+  void (*train16)(shalf_t *w, const qword_t *h, unsigned int nbits,
+		  int t, int maxw);
+};
+
+/*
+ * portable kernels
+ */
+
+/* history input of age K, +1 if taken, else -1 */
+#define HINPUT(H, K)	((((H)[(K) >> 6] >> ((K) & 63)) & 1) ? 1 : -1)
+
+static int
+dot8_c(const sbyte_t *w, const qword_t *h, unsigned int nbits)
+{
+  unsigned int k;
+  int y = 0;
+
+  for (k = 0; k < nbits; k++)
+    y += w[k] * HINPUT(h, k);
+  return y;
+}
+
+static void
+train8_c(sbyte_t *w, const qword_t *h, unsigned int nbits, int t, int maxw)
+{
+  unsigned int k;
+  int v;
+
+  for (k = 0; k < nbits; k++)
+    {
+      v = w[k] + t * HINPUT(h, k);
+      w[k] = (v > maxw) ? maxw : ((v < -maxw) ? -maxw : v);
+    }
+}
+
+static int
+dot16_c(const shalf_t *w, const qword_t *h, unsigned int nbits)
+{
+  unsigned int k;
+  int y = 0;
+
+  for (k = 0; k < nbits; k++)
+    y += w[k] * HINPUT(h, k);
+  return y;
+}
+
+static void
+train16_c(shalf_t *w, const qword_t *h, unsigned int nbits, int t, int maxw)
+{
+  unsigned int k;
+  int v;
+
+  for (k = 0; k < nbits; k++)
+    {
+      v = w[k] + t * HINPUT(h, k);
+      w[k] = (v > maxw) ? maxw : ((v < -maxw) ? -maxw : v);
+    }
+}
+
+static struct perc_kernel_t perc_kernel_c =
+  { "c", dot8_c, train8_c, dot16_c, train16_c };
+
+#ifdef PERC_X86
+
+/*
+ * SSE4.1 kernels: history bits are expanded to lane masks with PSHUFB and
+ * a compare against per-lane bit selectors, turned into +1/-1 inputs, and
+ * w*x is computed with PSIGN; products are widened to 32 bits with
+ * PMADDUBSW/PMADDWD
+ */
+
+/* 16 history bits -> 16 byte lanes, -1 where the bit is set */
+__attribute__((target("sse4.1")))
+static __m128i
+mask8_sse(word_t bits)
+{
+  __m128i v = _mm_shuffle_epi8(_mm_set1_epi16(bits),
+			       _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0,
+					     1, 1, 1, 1, 1, 1, 1, 1));
+  __m128i sel = _mm_set1_epi64x(LL(0x8040201008040201));
+  return _mm_cmpeq_epi8(_mm_and_si128(v, sel), sel);
+}
+
+/* 8 history bits -> 8 halfword lanes, -1 where the bit is set */
+__attribute__((target("sse4.1")))
+static __m128i
+mask16_sse(word_t bits)
+{
+  __m128i sel = _mm_setr_epi16(0x01, 0x02, 0x04, 0x08,
+			       0x10, 0x20, 0x40, 0x80);
+  return _mm_cmpeq_epi16(_mm_and_si128(_mm_set1_epi16(bits), sel), sel);
+}
+
+__attribute__((target("sse4.1")))
+static int
+hsum_sse(__m128i v)
+{
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(v);
+}
+
+__attribute__((target("sse4.1")))
+static int
+dot8_sse(const sbyte_t *w, const qword_t *h, unsigned int nbits)
+{
+  unsigned int k;
+  __m128i acc = _mm_setzero_si128();
+  __m128i ones8 = _mm_set1_epi8(1), twos8 = _mm_set1_epi8(2);
+  __m128i ones16 = _mm_set1_epi16(1);
+
+  for (k = 0; k < nbits; k += 16)
+    {
+      __m128i x = _mm_sub_epi8(_mm_and_si128(mask8_sse(HBITS(h, k, 16)),
+					     twos8), ones8);
+      __m128i p = _mm_sign_epi8(_mm_loadu_si128((const __m128i *)(w + k)), x);
+      acc = _mm_add_epi32(acc,
+			  _mm_madd_epi16(_mm_maddubs_epi16(ones8, p), ones16));
+    }
+  return hsum_sse(acc);
+}
+
+__attribute__((target("sse4.1")))
+static void
+train8_sse(sbyte_t *w, const qword_t *h, unsigned int nbits, int t, int maxw)
+{
+  unsigned int k;
+  __m128i ones8 = _mm_set1_epi8(1), twos8 = _mm_set1_epi8(2);
+  __m128i tv = _mm_set1_epi8(t);
+  __m128i hi = _mm_set1_epi8(maxw), lo = _mm_set1_epi8(-maxw);
+
+  for (k = 0; k < nbits; k += 16)
+    {
+      __m128i v = _mm_loadu_si128((const __m128i *)(w + k));
+      __m128i x = _mm_sub_epi8(_mm_and_si128(mask8_sse(HBITS(h, k, 16)),
+					     twos8), ones8);
+      __m128i dx = _mm_and_si128(_mm_sign_epi8(x, tv),
+				 mask8_sse(VBITS(nbits, k, 16)));
+      v = _mm_min_epi8(_mm_max_epi8(_mm_adds_epi8(v, dx), lo), hi);
+      _mm_storeu_si128((__m128i *)(w + k), v);
+    }
+}
+
+__attribute__((target("sse4.1")))
+static int
+dot16_sse(const shalf_t *w, const qword_t *h, unsigned int nbits)
+{
+  unsigned int k;
+  __m128i acc = _mm_setzero_si128();
+  __m128i ones16 = _mm_set1_epi16(1), twos16 = _mm_set1_epi16(2);
+
+  for (k = 0; k < nbits; k += 8)
+    {
+      __m128i x = _mm_sub_epi16(_mm_and_si128(mask16_sse(HBITS(h, k, 8)),
+					      twos16), ones16);
+      __m128i p = _mm_sign_epi16(_mm_loadu_si128((const __m128i *)(w + k)),
+				 x);
+      acc = _mm_add_epi32(acc, _mm_madd_epi16(p, ones16));
+    }
+  return hsum_sse(acc);
+}
+
+__attribute__((target("sse4.1")))
+static void
+train16_sse(shalf_t *w, const qword_t *h, unsigned int nbits, int t, int maxw)
+{
+  unsigned int k;
+  __m128i ones16 = _mm_set1_epi16(1), twos16 = _mm_set1_epi16(2);
+  __m128i tv = _mm_set1_epi16(t);
+  __m128i hi = _mm_set1_epi16(maxw), lo = _mm_set1_epi16(-maxw);
+
+  for (k = 0; k < nbits; k += 8)
+    {
+      __m128i v = _mm_loadu_si128((const __m128i *)(w + k));
+      __m128i x = _mm_sub_epi16(_mm_and_si128(mask16_sse(HBITS(h, k, 8)),
+					      twos16), ones16);
+      __m128i dx = _mm_and_si128(_mm_sign_epi16(x, tv),
+				 mask16_sse(VBITS(nbits, k, 8)));
+      v = _mm_min_epi16(_mm_max_epi16(_mm_adds_epi16(v, dx), lo), hi);
+      _mm_storeu_si128((__m128i *)(w + k), v);
+    }
+}
+
+static struct perc_kernel_t perc_kernel_sse =
+  { "sse4.1", dot8_sse, train8_sse, dot16_sse, train16_sse };
+
+/*
+ * AVX2 kernels, same scheme as the SSE4.1 kernels at twice the width
+ */
+
+/* 32 history bits -> 32 byte lanes, -1 where the bit is set */
+__attribute__((target("avx2")))
+static __m256i
+mask8_avx2(word_t bits)
+{
+  __m256i v =
+    _mm256_shuffle_epi8(_mm256_set1_epi32(bits),
+			_mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0,
+					 1, 1, 1, 1, 1, 1, 1, 1,
+					 2, 2, 2, 2, 2, 2, 2, 2,
+					 3, 3, 3, 3, 3, 3, 3, 3));
+  __m256i sel = _mm256_set1_epi64x(LL(0x8040201008040201));
+  return _mm256_cmpeq_epi8(_mm256_and_si256(v, sel), sel);
+}
+
+/* 16 history bits -> 16 halfword lanes, -1 where the bit is set */
+__attribute__((target("avx2")))
+static __m256i
+mask16_avx2(word_t bits)
+{
+  __m256i sel = _mm256_setr_epi16(0x0001, 0x0002, 0x0004, 0x0008,
+				  0x0010, 0x0020, 0x0040, 0x0080,
+				  0x0100, 0x0200, 0x0400, 0x0800,
+				  0x1000, 0x2000, 0x4000, (short)0x8000);
+  return _mm256_cmpeq_epi16(_mm256_and_si256(_mm256_set1_epi16(bits), sel),
+			    sel);
+}
+
+__attribute__((target("avx2")))
+static int
+hsum_avx2(__m256i v)
+{
+  __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v),
+			    _mm256_extracti128_si256(v, 1));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(s);
+}
+
+__attribute__((target("avx2")))
+static int
+dot8_avx2(const sbyte_t *w, const qword_t *h, unsigned int nbits)
+{
+  unsigned int k;
+  __m256i acc = _mm256_setzero_si256();
+  __m256i ones8 = _mm256_set1_epi8(1), twos8 = _mm256_set1_epi8(2);
+  __m256i ones16 = _mm256_set1_epi16(1);
+
+  for (k = 0; k < nbits; k += 32)
+    {
+      __m256i x =
+	_mm256_sub_epi8(_mm256_and_si256(mask8_avx2(HBITS(h, k, 32)), twos8),
+			ones8);
+      __m256i p =
+	_mm256_sign_epi8(_mm256_loadu_si256((const __m256i *)(w + k)), x);
+      acc = _mm256_add_epi32(acc,
+			     _mm256_madd_epi16(_mm256_maddubs_epi16(ones8, p),
+					       ones16));
+    }
+  return hsum_avx2(acc);
+}
+
+__attribute__((target("avx2")))
+static void
+train8_avx2(sbyte_t *w, const qword_t *h, unsigned int nbits, int t, int maxw)
+{
+  unsigned int k;
+  __m256i ones8 = _mm256_set1_epi8(1), twos8 = _mm256_set1_epi8(2);
+  __m256i tv = _mm256_set1_epi8(t);
+  __m256i hi = _mm256_set1_epi8(maxw), lo = _mm256_set1_epi8(-maxw);
+
+  for (k = 0; k < nbits; k += 32)
+    {
+      __m256i v = _mm256_loadu_si256((const __m256i *)(w + k));
+      __m256i x =
+	_mm256_sub_epi8(_mm256_and_si256(mask8_avx2(HBITS(h, k, 32)), twos8),
+			ones8);
+      __m256i dx = _mm256_and_si256(_mm256_sign_epi8(x, tv),
+				    mask8_avx2(VBITS(nbits, k, 32)));
+      v = _mm256_min_epi8(_mm256_max_epi8(_mm256_adds_epi8(v, dx), lo), hi);
+      _mm256_storeu_si256((__m256i *)(w + k), v);
+    }
+}
+
+__attribute__((target("avx2")))
+static int
+dot16_avx2(const shalf_t *w, const qword_t *h, unsigned int nbits)
+{
+  unsigned int k;
+  __m256i acc = _mm256_setzero_si256();
+  __m256i ones16 = _mm256_set1_epi16(1), twos16 = _mm256_set1_epi16(2);
+
+  for (k = 0; k < nbits; k += 16)
+    {
+      __m256i x =
+	_mm256_sub_epi16(_mm256_and_si256(mask16_avx2(HBITS(h, k, 16)),
+					  twos16), ones16);
+      __m256i p =
+	_mm256_sign_epi16(_mm256_loadu_si256((const __m256i *)(w + k)), x);
+      acc = _mm256_add_epi32(acc, _mm256_madd_epi16(p, ones16));
+    }
+  return hsum_avx2(acc);
+}
+
+__attribute__((target("avx2")))
+static void
+train16_avx2(shalf_t *w, const qword_t *h, unsigned int nbits,
+	     int t, int maxw)
+{
+  unsigned int k;
+  __m256i ones16 = _mm256_set1_epi16(1), twos16 = _mm256_set1_epi16(2);
+  __m256i tv = _mm256_set1_epi16(t);
+  __m256i hi = _mm256_set1_epi16(maxw), lo = _mm256_set1_epi16(-maxw);
+
+  for (k = 0; k < nbits; k += 16)
+    {
+      __m256i v = _mm256_loadu_si256((const __m256i *)(w + k));
+      __m256i x =
+	_mm256_sub_epi16(_mm256_and_si256(mask16_avx2(HBITS(h, k, 16)),
+					  twos16), ones16);
+      __m256i dx = _mm256_and_si256(_mm256_sign_epi16(x, tv),
+				    mask16_avx2(VBITS(nbits, k, 16)));
+      v = _mm256_min_epi16(_mm256_max_epi16(_mm256_adds_epi16(v, dx), lo),
+			   hi);
+      _mm256_storeu_si256((__m256i *)(w + k), v);
+    }
+}
+
+static struct perc_kernel_t perc_kernel_avx2 =
+  { "avx2", dot8_avx2, train8_avx2, dot16_avx2, train16_avx2 };
+
+#endif /* PERC_X86 */
+
+/* bit K of a history word, for the inline kernels of bpred_perc.h */
+const word_t bpred_perc_bit[32] = {
+  0x00000001, 0x00000002, 0x00000004, 0x00000008,
+  0x00000010, 0x00000020, 0x00000040, 0x00000080,
+  0x00000100, 0x00000200, 0x00000400, 0x00000800,
+  0x00001000, 0x00002000, 0x00004000, 0x00008000,
+  0x00010000, 0x00020000, 0x00040000, 0x00080000,
+  0x00100000, 0x00200000, 0x00400000, 0x00800000,
+  0x01000000, 0x02000000, 0x04000000, 0x08000000,
+  0x10000000, 0x20000000, 0x40000000, 0x80000000
+};
+
+/* kernels selected for this host, set up by the first bpred_perc_create() */
+static struct perc_kernel_t *perc_kernel = NULL;
+
+static void
+perc_kernel_select(void)
+{
+  perc_kernel = &perc_kernel_c;
+#ifdef PERC_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    perc_kernel = &perc_kernel_avx2;
+  else if (__builtin_cpu_supports("sse4.1"))
+    perc_kernel = &perc_kernel_sse;
+#endif /* PERC_X86 */
+}
+
+/* create a packed weight table of N perceptrons with HIST_BITS history
+   inputs each, plus a bias input, with WEIGHT_BITS-bit signed weights */
+struct bpred_perc_t *			/* weight table instance */
+bpred_perc_create(unsigned int n,	/* number of perceptrons */
+		  unsigned int hist_bits,/* history inputs per perceptron */
+		  unsigned int weight_bits)/* weight width, in bits */
+{
+  struct bpred_perc_t *p;
+  unsigned int esize;
+
+  if (!n)
+    fatal("perceptron: number of perceptrons must be non-zero");
+  if (hist_bits > PERC_HIST_MAX)
+    fatal("perceptron: history length `%d' must be at most %d bits",
+	  hist_bits, PERC_HIST_MAX);
+  if (weight_bits < 2 || weight_bits > 16)
+    fatal("perceptron: weight width `%d' must be between 2 and 16 bits",
+	  weight_bits);
+
+  if (!perc_kernel)
+    perc_kernel_select();
+
+  if (!(p = calloc(1, sizeof(struct bpred_perc_t))))
+    fatal("out of virtual memory");
+
+  p->n = n;
+  p->hist_bits = hist_bits;
+  p->stride = ROUND_UP(MAX(hist_bits, 1), PERC_VLEN);
+  p->wide = (weight_bits > 8);
+  p->max_weight = (1 << (weight_bits - 1)) - 1;
+  esize = p->wide ? sizeof(shalf_t) : sizeof(sbyte_t);
+
+  if (!(p->weights = calloc((size_t)n * p->stride, esize)))
+    fatal("cannot allocate perceptron weight table");
+  if (!(p->bias = calloc(n, esize)))
+    fatal("cannot allocate perceptron weight table");
+
+  return p;
+}
+
+/* compute the output of perceptron ROW for global history H */
+int					/* perceptron output y */
+bpred_perc_output(struct bpred_perc_t *p,/* weight table instance */
+		  unsigned int row,	/* perceptron to evaluate */
+		  struct bpred_perc_hist_t *h)/* global history */
+{
+  /* y = w0 (bias, input always +1) + sum(w[k] * x[k]) */
+  if (p->wide)
+    return ((shalf_t *)p->bias)[row]
+      + perc_kernel->dot16((shalf_t *)p->weights + row * p->stride,
+			   h->bits, p->hist_bits);
+  else
+    return ((sbyte_t *)p->bias)[row]
+      + perc_kernel->dot8((sbyte_t *)p->weights + row * p->stride,
+			  h->bits, p->hist_bits);
+}
+
+/* train perceptron ROW toward outcome TAKEN for global history H */
+void
+bpred_perc_train(struct bpred_perc_t *p,/* weight table instance */
+		 unsigned int row,	/* perceptron to train */
+		 struct bpred_perc_hist_t *h,/* global history */
+		 int taken)		/* actual branch outcome */
+{
+  int t = taken ? 1 : -1, w0;
+
+  if (p->wide)
+    {
+      w0 = ((shalf_t *)p->bias)[row] + t;
+      if (w0 >= -p->max_weight && w0 <= p->max_weight)
+	((shalf_t *)p->bias)[row] = w0;
+      perc_kernel->train16((shalf_t *)p->weights + row * p->stride,
+			   h->bits, p->hist_bits, t, p->max_weight);
+    }
+  else
+    {
+      w0 = ((sbyte_t *)p->bias)[row] + t;
+      if (w0 >= -p->max_weight && w0 <= p->max_weight)
+	((sbyte_t *)p->bias)[row] = w0;
+      perc_kernel->train8((sbyte_t *)p->weights + row * p->stride,
+			  h->bits, p->hist_bits, t, p->max_weight);
+    }
+}
+
+/* reset a global history register to all taken */
+void
+bpred_perc_hist_init(struct bpred_perc_hist_t *h)/* global history */
+{
+  memset(h->bits, 0xff, sizeof(h->bits));
+  h->path = 0;
+}
+
+/* shift outcome TAKEN of the branch at (pre-shifted) address PC into the
+   low NBITS bits of global history H */
+void
+bpred_perc_hist_push(struct bpred_perc_hist_t *h,/* global history */
+		     unsigned int nbits,/* history bits in use */
+		     int taken,		/* branch outcome */
+		     word_t pc)		/* branch address >> MD_BR_SHIFT */
+{
+  int i;
+
+  /* only the words holding live history move; bits shifted past NBITS
+     are never read */
+  for (i = (MAX(nbits, 1) - 1) >> 6; i > 0; i--)
+    h->bits[i] = (h->bits[i] << 1) | (h->bits[i-1] >> 63);
+  h->bits[0] = (h->bits[0] << 1) | (qword_t)!!taken;
+
+  h->path = (h->path << 2) | (qword_t)(pc & 3);
+}
+
+/* XOR-fold history bits [START, START+LEN) of global history H into
+   WIDTH bits */
+word_t					/* folded history */
+bpred_perc_hist_fold(struct bpred_perc_hist_t *h,/* global history */
+		     unsigned int start,/* newest history bit to fold */
+		     unsigned int len,	/* history bits to fold */
+		     unsigned int width)/* folded width, in bits */
+{
+  unsigned int w, s, n;
+  word_t f = 0;
+  qword_t v;
+
+  for (; len; len -= n, start += n)
+    {
+      /* up to 64 bits from START, from at most two words */
+      n = MIN(len, 64);
+      w = start >> 6;
+      s = start & 63;
+      v = h->bits[w] >> s;
+      if (s && s + n > 64)
+	v |= h->bits[w+1] << (64 - s);
+      if (n < 64)
+	v &= (ULL(1) << n) - 1;
+
+      for (; v; v >>= width)
+	f ^= (word_t)v & ((1U << width) - 1);
+    }
+  return f;
+}
+
+/* name of the dot-product kernel selected for this host */
+char *
+bpred_perc_kernel_name(void)
+{
+  if (!perc_kernel)
+    perc_kernel_select();
+  return perc_kernel->name;
+}
+
+/* free a packed weight table */
+void
+bpred_perc_free(struct bpred_perc_t *p)	/* weight table instance */
+{
+  if (!p)
+    return;
+
+  free(p->weights);
+  free(p->bias);
+  free(p);
+}
@@ -0,0 +1,159 @@
+/* bpred_perc.h - packed perceptron weight tables */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ */
+
+#ifndef BPRED_PERC_H
+#define BPRED_PERC_H
+
+#include <stdio.h>
+#include "host.h"
+#include "misc.h"
+
+/*
+ * This module holds the weight storage and the global history register
+ * for the perceptron predictor.
+ *
+ * Weights are kept packed, one row per perceptron, as signed 8-bit values
+ * when the configured weight width fits in a byte and as signed 16-bit
+ * values otherwise.  Row weight K is paired with the history bit of age K
+ * (K = 0 is the most recent branch); the bias weights live in their own
+ * array.  Rows are padded to a multiple of PERC_VLEN weights so the dot
+ * product and the training rule run as a handful of vector operations; the
+ * padding weights are never trained and stay zero.
+ *
+ * The global history is a bit-packed multiword shift register, bit K of
+ * the register holds the outcome of the branch of age K.  The kernels read
+ * it directly, turning each set bit into a +1 input and each clear bit
+ * into a -1 input, so a history update is a single register shift no
+ * matter how long the history is.
+ *
+ * The dot-product and training kernels are chosen once at run time from
+ * the best instruction set the host supports (AVX2, SSE4.1, or portable C).
+ */
+
+/* row padding granularity, in weights (one AVX2 vector of 8-bit weights) */
+#define PERC_VLEN		32
+
+/* longest supported global history, in bits */
+#define PERC_HIST_MAX		512
+#define PERC_HIST_WORDS		(PERC_HIST_MAX / 64)
+
+/* global history register */
+struct bpred_perc_hist_t {
+  qword_t bits[PERC_HIST_WORDS];/* outcome history, bit 0 is the newest */
+  qword_t path;			/* path history, 2 address bits per branch */
+};
+
+/* packed perceptron weight table */
+struct bpred_perc_t {
+  unsigned int n;		/* number of perceptrons (rows) */
+  unsigned int hist_bits;	/* history inputs per perceptron */
+  unsigned int stride;		/* row length in weights, incl. padding */
+  int wide;			/* non-zero: 16-bit weights, else 8-bit */
+  int max_weight;		/* weights saturate at +/- max_weight */
+  void *weights;		/* N x STRIDE history weight rows */
+  void *bias;			/* N bias weights */
+};
+
+/* create a packed weight table of N perceptrons with HIST_BITS history
+   inputs each, plus a bias input, with WEIGHT_BITS-bit signed weights */
+struct bpred_perc_t *			/* weight table instance */
+bpred_perc_create(unsigned int n,	/* number of perceptrons */
+		  unsigned int hist_bits,/* history inputs per perceptron */
+		  unsigned int weight_bits);/* weight width, in bits */
+
+/* compute the output of perceptron ROW for global history H */
+int					/* perceptron output y */
+bpred_perc_output(struct bpred_perc_t *p,/* weight table instance */
+		  unsigned int row,	/* perceptron to evaluate */
+		  struct bpred_perc_hist_t *h);/* global history */
+
+/* train perceptron ROW toward outcome TAKEN for global history H */
+void
+bpred_perc_train(struct bpred_perc_t *p,/* weight table instance */
+		 unsigned int row,	/* perceptron to train */
+		 struct bpred_perc_hist_t *h,/* global history */
+		 int taken);		/* actual branch outcome */
+
+/* bit K of a history word, for the inline kernels below */
+extern const word_t bpred_perc_bit[32];
+
+/* bpred_perc_output() and bpred_perc_train() for a table of 8-bit weights
+   with NBITS (<= 32) history inputs, for callers that know the geometry
+   at compile time: with a constant NBITS the loops have a constant trip
+   count over one history word and test each bit against a mask instead
+   of a variable shift, so an optimizing build (e.g., GCC -O3) unrolls
+   and vectorizes them in place, instead of calling the host kernel with
+   the configured length */
+static INLINE int			/* perceptron output y */
+bpred_perc_output8_n(struct bpred_perc_t *p,/* weight table instance */
+		     unsigned int row,	/* perceptron to evaluate */
+		     struct bpred_perc_hist_t *h,/* global history */
+		     unsigned int nbits)/* history inputs, constant */
+{
+  const sbyte_t *w = (sbyte_t *)p->weights + row * p->stride;
+  word_t hist = (word_t)h->bits[0];
+  unsigned int k;
+  int y = ((sbyte_t *)p->bias)[row];
+
+  /* history bit K is input +1 if set, else -1 */
+  for (k = 0; k < nbits; k++)
+    y += (hist & bpred_perc_bit[k]) ? w[k] : -w[k];
+  return y;
+}
+
+static INLINE void
+bpred_perc_train8_n(struct bpred_perc_t *p,/* weight table instance */
+		    unsigned int row,	/* perceptron to train */
+		    struct bpred_perc_hist_t *h,/* global history */
+		    int taken,		/* actual branch outcome */
+		    unsigned int nbits)	/* history inputs, constant */
+{
+  sbyte_t *w = (sbyte_t *)p->weights + row * p->stride;
+  word_t hist = (word_t)h->bits[0];
+  int t = taken ? 1 : -1, maxw = p->max_weight, v;
+  unsigned int k;
+
+  v = ((sbyte_t *)p->bias)[row] + t;
+  if (v >= -maxw && v <= maxw)
+    ((sbyte_t *)p->bias)[row] = v;
+
+  for (k = 0; k < nbits; k++)
+    {
+      v = w[k] + ((hist & bpred_perc_bit[k]) ? t : -t);
+      w[k] = (v > maxw) ? maxw : ((v < -maxw) ? -maxw : v);
+    }
+}
+
+/* reset a global history register to all taken */
+void
+bpred_perc_hist_init(struct bpred_perc_hist_t *h);/* global history */
+
+/* shift outcome TAKEN of the branch at (pre-shifted) address PC into the
+   low NBITS bits of global history H */
+void
+bpred_perc_hist_push(struct bpred_perc_hist_t *h,/* global history */
+		     unsigned int nbits,/* history bits in use */
+		     int taken,		/* branch outcome */
+		     word_t pc);	/* branch address >> MD_BR_SHIFT */
+
+/* XOR-fold history bits [START, START+LEN) of global history H into
+   WIDTH bits */
+word_t					/* folded history */
+bpred_perc_hist_fold(struct bpred_perc_hist_t *h,/* global history */
+		     unsigned int start,/* newest history bit to fold */
+		     unsigned int len,	/* history bits to fold */
+		     unsigned int width);/* folded width, in bits */
+
+/* name of the dot-product kernel selected for this host */
+char *
+bpred_perc_kernel_name(void);
+
+/* free a packed weight table */
+void
+bpred_perc_free(struct bpred_perc_t *p);/* weight table instance */
+
+#endif /* BPRED_PERC_H */
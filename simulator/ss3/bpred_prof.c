@@ -0,0 +1,165 @@
+/* bpred_prof.c - per-branch misprediction profile */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "bpred_prof.h"
+
+/* initial table entries */
+#define PROF_INIT_SIZE		1024
+
+/* home slot of the branch at BADDR in a table of SIZE entries */
+static unsigned int
+prof_hash(md_addr_t baddr, unsigned int size)
+{
+  word_t h = (word_t)(baddr >> MD_BR_SHIFT) * 0x9e3779b1U;
+
+  return (h ^ (h >> 16)) & (size - 1);
+}
+
+/* allocate a table of SIZE free entries for PROF */
+static void
+prof_alloc(struct bpred_prof_t *prof, unsigned int size)
+{
+  prof->size = size;
+  prof->used = 0;
+  if (!(prof->table = calloc(size, sizeof(struct bpred_prof_ent_t))))
+    fatal("cannot allocate branch profile table");
+}
+
+/* create an empty per-branch profile */
+struct bpred_prof_t *			/* profile instance */
+bpred_prof_create(void)
+{
+  struct bpred_prof_t *prof;
+
+  if (!(prof = calloc(1, sizeof(struct bpred_prof_t))))
+    fatal("out of virtual memory");
+
+  prof_alloc(prof, PROF_INIT_SIZE);
+  return prof;
+}
+
+/* profile entry of the branch at BADDR, created if new */
+struct bpred_prof_ent_t *		/* profile entry */
+bpred_prof_find(struct bpred_prof_t *prof,/* profile instance */
+		md_addr_t baddr)	/* branch address */
+{
+  struct bpred_prof_ent_t *old, *e;
+  unsigned int i, old_size;
+
+  for (i = prof_hash(baddr, prof->size); ; i = (i + 1) & (prof->size - 1))
+    {
+      e = &prof->table[i];
+      if (e->pc == baddr)
+	return e;
+      if (!e->pc)
+	break;
+    }
+
+  /* a new branch; keep the table at most half full */
+  if (2 * (prof->used + 1) > prof->size)
+    {
+      old = prof->table;
+      old_size = prof->size;
+      prof_alloc(prof, 2 * old_size);
+      for (i = 0; i < old_size; i++)
+	if (old[i].pc)
+	  *bpred_prof_find(prof, old[i].pc) = old[i];
+      free(old);
+      return bpred_prof_find(prof, baddr);
+    }
+
+  e->pc = baddr;
+  prof->used++;
+  return e;
+}
+
+/* order profile entries by decreasing mispredictions, then executions */
+static int
+prof_cmp(const void *a, const void *b)
+{
+  const struct bpred_prof_ent_t *x = *(const struct bpred_prof_ent_t **)a;
+  const struct bpred_prof_ent_t *y = *(const struct bpred_prof_ent_t **)b;
+
+  if (x->misses != y->misses)
+    return x->misses < y->misses ? 1 : -1;
+  if (x->lookups != y->lookups)
+    return x->lookups < y->lookups ? 1 : -1;
+  return x->pc < y->pc ? -1 : (x->pc > y->pc);
+}
+
+/* percentage of N in D */
+#define PROF_PCT(N, D)		((D) ? 100.0 * (double)(N) / (double)(D) : 0.0)
+
+/* print the TOPN branches of profile PROF of predictor NAME with the most
+   mispredictions, with the functions SYM says they are in, if non-NULL */
+void
+bpred_prof_print(struct bpred_prof_t *prof,/* profile instance */
+		 char *name,		/* predictor name */
+		 int topn,		/* branches to print */
+		 bpred_prof_sym_t sym,	/* function namer, or NULL */
+		 FILE *stream)		/* output stream */
+{
+  struct bpred_prof_ent_t **order;
+  char *fn;
+  counter_t misses = 0, cum = 0;
+  unsigned int i, n = 0;
+  int offset;
+
+  if (!(order = calloc(prof->used + 1, sizeof(struct bpred_prof_ent_t *))))
+    fatal("out of virtual memory");
+  for (i = 0; i < prof->size; i++)
+    if (prof->table[i].pc)
+      {
+	order[n++] = &prof->table[i];
+	misses += prof->table[i].misses;
+      }
+  qsort(order, n, sizeof(struct bpred_prof_ent_t *), prof_cmp);
+
+  fprintf(stream, "\n%s: %u static branches, top %d by mispredictions\n",
+	  name, n, MIN(topn, (int)n));
+  fprintf(stream, "%-10s %12s %10s %6s %6s %6s %6s %6s %6s  %s\n",
+	  "pc", "lookups", "misses", "miss%", "cum%", "taken%", "2nd%",
+	  "weak%", "over%", "function");
+
+  for (i = 0; i < n && (int)i < topn; i++)
+    {
+      struct bpred_prof_ent_t *e = order[i];
+
+      cum += e->misses;
+      myfprintf(stream, "0x%08p", e->pc);
+      fprintf(stream, " %12.0f %10.0f %6.2f %6.2f %6.2f %6.2f %6.2f %6.2f  ",
+	      (double)e->lookups, (double)e->misses,
+	      PROF_PCT(e->misses, e->lookups), PROF_PCT(cum, misses),
+	      PROF_PCT(e->taken, e->lookups), PROF_PCT(e->second, e->lookups),
+	      PROF_PCT(e->weak, e->lookups), PROF_PCT(e->over, e->lookups));
+
+      fn = sym ? sym(e->pc, &offset) : NULL;
+      if (fn)
+	fprintf(stream, "%s+%d\n", fn, offset);
+      else
+	fprintf(stream, "?\n");
+    }
+
+  free(order);
+}
+
+/* free profile resources */
+void
+bpred_prof_free(struct bpred_prof_t *prof)/* profile instance */
+{
+  if (!prof)
+    return;
+
+  free(prof->table);
+  free(prof);
+}
@@ -0,0 +1,76 @@
+/* bpred_prof.h - per-branch misprediction profile */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ */
+
+#ifndef BPRED_PROF_H
+#define BPRED_PROF_H
+
+#include <stdio.h>
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+
+/*
+ * This module keeps a profile of every static control instruction a
+ * predictor sees: how often it executed, was mispredicted and was taken,
+ * and which part of the predictor predicted it.  Entries live in a flat
+ * open-addressed table keyed by branch address, with linear probing; the
+ * table doubles when half full, so an update is a hash and, almost
+ * always, a single probe however long the run.  At the end of the run the
+ * branches with the most mispredictions are printed, with the function
+ * each is in.  Functions are named by the caller, so the predictors link
+ * without the program loader and its symbol table.
+ */
+
+/* name of the function containing PC, with the offset of PC into it in
+   *OFFSET, or NULL if not known */
+typedef char *(*bpred_prof_sym_t)(md_addr_t pc, int *offset);
+
+/* per-branch profile entry */
+struct bpred_prof_ent_t {
+  md_addr_t pc;			/* branch address, 0 for a free entry */
+  counter_t lookups;		/* executions */
+  counter_t misses;		/* address mispredictions */
+  counter_t taken;		/* taken executions */
+  counter_t second;		/* predictions by the second component:
+				   2-level (BPredComb), global
+				   (BPredAlpha21264) */
+  counter_t weak;		/* perceptron outputs within theta
+				   (BPredPerc, BPredHPerc) */
+  counter_t over;		/* direction predictions overridden by the
+				   corrector or loop predictor */
+};
+
+/* per-branch profile */
+struct bpred_prof_t {
+  unsigned int size;		/* table entries, a power of two */
+  unsigned int used;		/* entries in use */
+  struct bpred_prof_ent_t *table;/* entries */
+};
+
+/* create an empty per-branch profile */
+struct bpred_prof_t *			/* profile instance */
+bpred_prof_create(void);
+
+/* profile entry of the branch at BADDR, created if new */
+struct bpred_prof_ent_t *		/* profile entry */
+bpred_prof_find(struct bpred_prof_t *prof,/* profile instance */
+		md_addr_t baddr);	/* branch address */
+
+/* print the TOPN branches of profile PROF of predictor NAME with the most
+   mispredictions, with the functions SYM says they are in, if non-NULL */
+void
+bpred_prof_print(struct bpred_prof_t *prof,/* profile instance */
+		 char *name,		/* predictor name */
+		 int topn,		/* branches to print */
+		 bpred_prof_sym_t sym,	/* function namer, or NULL */
+		 FILE *stream);		/* output stream */
+
+/* free profile resources */
+void
+bpred_prof_free(struct bpred_prof_t *prof);/* profile instance */
+
+#endif /* BPRED_PROF_H */
@@ -0,0 +1,263 @@
+/* bpred_sc.c - statistical corrector */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "stats.h"
+#include "bpred_perc.h"
+#include "bpred_sc.h"
+
+/* counters saturate at these values (6 bits) */
+#define SC_CTR_MAX		31
+#define SC_CTR_MIN		(-32)
+
+/* theta moves by one after this many more mispredictions than correct
+   low-margin outputs, or the other way around */
+#define SC_THETA_CTR		64
+
+/* create a statistical corrector of NTABLES history tables, plus a bias
+   table, of TABLE_SIZE counters each, using history lengths from
+   MIN_HIST to MAX_HIST */
+struct bpred_sc_t *			/* statistical corrector instance */
+bpred_sc_create(unsigned int ntables,	/* number of history tables */
+		unsigned int table_size,/* counters per table */
+		unsigned int min_hist,	/* shortest history length */
+		unsigned int max_hist)	/* longest history length */
+{
+  struct bpred_sc_t *sc;
+  unsigned int i, len;
+
+  if (!ntables || ntables > SC_MAX_TABLES)
+    fatal("statistical corrector: number of history tables `%d' must be "
+	  "between 1 and %d", ntables, SC_MAX_TABLES);
+  if (table_size < 16 || (table_size & (table_size - 1)) != 0)
+    fatal("statistical corrector: table size `%d' must be a power of two, "
+	  "at least 16", table_size);
+  if (!min_hist || max_hist < min_hist + ntables - 1
+      || max_hist > PERC_HIST_MAX)
+    fatal("statistical corrector: history lengths `%d..%d' must be "
+	  "non-zero, increasing by at least one per table, and at most %d",
+	  min_hist, max_hist, PERC_HIST_MAX);
+
+  if (!(sc = calloc(1, sizeof(struct bpred_sc_t))))
+    fatal("out of virtual memory");
+
+  sc->ntables = ntables;
+  for (sc->log_size = 0; (1U << sc->log_size) < table_size; sc->log_size++)
+    /* nada */;
+
+  /* geometric history lengths, kept strictly increasing */
+  for (i = 0; i < ntables; i++)
+    {
+      if (ntables == 1)
+	len = min_hist;
+      else
+	len = (unsigned int)(min_hist
+			     * pow((double)max_hist / min_hist,
+				   (double)i / (ntables - 1)) + 0.5);
+      if (i && len <= sc->hist_len[i-1])
+	len = sc->hist_len[i-1] + 1;
+      sc->hist_len[i] = len;
+    }
+
+  if (!(sc->ctrs = calloc((ntables + 1) << sc->log_size, sizeof(sbyte_t))))
+    fatal("cannot allocate statistical corrector tables");
+
+  /* the output of a table is 2c+1, so theta starts at an average
+     counter magnitude of one per table */
+  sc->theta = 3 * (ntables + 1);
+
+  bpred_perc_hist_init(&sc->hist);
+  return sc;
+}
+
+/* counter of table K (0 is the bias table) for the branch at (pre-shifted)
+   address PC with base prediction BASE, given global history H */
+static sbyte_t *
+sc_ctr(struct bpred_sc_t *sc, word_t pc, int base, unsigned int k,
+       struct bpred_perc_hist_t *h)
+{
+  unsigned int mask = (1U << sc->log_size) - 1;
+  unsigned int idx, r;
+
+  if (!k)
+    idx = ((pc ^ (pc >> sc->log_size)) << 1) | base;
+  else
+    {
+      r = k % sc->log_size;
+      idx = pc ^ (pc >> (sc->log_size - r))
+	^ bpred_perc_hist_fold(h, 0, sc->hist_len[k-1], sc->log_size)
+	^ (base << (sc->log_size - 1));
+    }
+  return &sc->ctrs[(k << sc->log_size) + (idx & mask)];
+}
+
+/* predict the direction of the conditional branch at BADDR with global
+   history H, which the direction predictor predicts BASE_TAKEN, saving
+   the state needed for the update in *CK */
+int					/* non-zero if predicted taken */
+bpred_sc_lookup(struct bpred_sc_t *sc,	/* statistical corrector */
+		md_addr_t baddr,	/* branch address */
+		struct bpred_perc_hist_t *h,/* global history */
+		int base_taken,		/* direction predictor's direction */
+		struct bpred_sc_ckpt_t *ck)/* lookup state */
+{
+  word_t pc = baddr >> MD_BR_SHIFT;
+  unsigned int k;
+  int y = 0;
+
+  ck->base = !!base_taken;
+  for (k = 0; k <= sc->ntables; k++)
+    y += 2 * *sc_ctr(sc, pc, ck->base, k, h) + 1;
+  ck->out = y;
+
+  /* reverse the base only with a margin */
+  ck->pred = ck->base;
+  if ((y >= 0) != ck->base && (y < 0 ? -y : y) > sc->theta)
+    ck->pred = !ck->base;
+
+  return ck->pred;
+}
+
+/* train the corrector with outcome TAKEN of the branch at BADDR, which
+   saw global history H and lookup state CK */
+void
+bpred_sc_update(struct bpred_sc_t *sc,	/* statistical corrector */
+		md_addr_t baddr,	/* branch address */
+		struct bpred_perc_hist_t *h,/* history seen at lookup */
+		struct bpred_sc_ckpt_t *ck,/* lookup state */
+		int taken)		/* actual branch outcome */
+{
+  word_t pc = baddr >> MD_BR_SHIFT;
+  int y = ck->out;
+  int mispred = (y >= 0) != !!taken;
+  int abs_y = (y < 0 ? -y : y);
+  unsigned int k;
+  sbyte_t *c;
+
+  sc->lookups++;
+  if (ck->pred != ck->base)
+    {
+      sc->overrides++;
+      if (ck->pred == !!taken)
+	sc->override_hits++;
+    }
+
+  if (!mispred && abs_y > sc->theta)
+    return;
+
+  for (k = 0; k <= sc->ntables; k++)
+    {
+      c = sc_ctr(sc, pc, ck->base, k, h);
+      if (taken)
+	{
+	  if (*c < SC_CTR_MAX)
+	    ++*c;
+	}
+      else
+	{
+	  if (*c > SC_CTR_MIN)
+	    --*c;
+	}
+    }
+
+  /* as in the hashed perceptron, balance mispredictions against correct
+     low-margin outputs */
+  if (mispred)
+    {
+      if (++sc->theta_ctr >= SC_THETA_CTR)
+	{
+	  sc->theta++;
+	  sc->theta_ctr = 0;
+	}
+    }
+  else if (--sc->theta_ctr <= -SC_THETA_CTR)
+    {
+      if (sc->theta > 1)
+	sc->theta--;
+      sc->theta_ctr = 0;
+    }
+}
+
+/* shift outcome TAKEN of the branch at BADDR into the global history */
+void
+bpred_sc_hist_push(struct bpred_sc_t *sc,/* statistical corrector */
+		   md_addr_t baddr,	/* branch address */
+		   int taken)		/* branch outcome */
+{
+  bpred_perc_hist_push(&sc->hist, sc->hist_len[sc->ntables-1], taken,
+		       baddr >> MD_BR_SHIFT);
+}
+
+/* print statistical corrector configuration */
+void
+bpred_sc_config(struct bpred_sc_t *sc,	/* statistical corrector */
+		FILE *stream)		/* output stream */
+{
+  unsigned int i;
+
+  fprintf(stream,
+	  "sc: %d tables x %d counters, 6-bit counters, history lengths",
+	  sc->ntables + 1, 1 << sc->log_size);
+  for (i = 0; i < sc->ntables; i++)
+    fprintf(stream, " %d", sc->hist_len[i]);
+  fprintf(stream, "\n");
+}
+
+/* register statistical corrector stats under NAME */
+void
+bpred_sc_reg_stats(struct bpred_sc_t *sc,/* statistical corrector */
+		   char *name,		/* stats name prefix */
+		   struct stat_sdb_t *sdb)/* stats database */
+{
+  char buf[512], buf1[512];
+
+  sprintf(buf, "%s.sc_lookups", name);
+  stat_reg_counter(sdb, buf,
+		   "conditional branches trained by the statistical corrector",
+		   &sc->lookups, 0, NULL);
+  sprintf(buf, "%s.sc_overrides", name);
+  stat_reg_counter(sdb, buf,
+		   "... whose predicted direction the corrector reversed",
+		   &sc->overrides, 0, NULL);
+  sprintf(buf, "%s.sc_override_hits", name);
+  stat_reg_counter(sdb, buf, "... correctly",
+		   &sc->override_hits, 0, NULL);
+  sprintf(buf, "%s.sc_override_rate", name);
+  sprintf(buf1, "%s.sc_override_hits / %s.sc_overrides", name, name);
+  stat_reg_formula(sdb, buf,
+		   "statistical corrector override rate (i.e., hits/overrides)",
+		   buf1, "%9.4f");
+  sprintf(buf, "%s.sc_theta", name);
+  stat_reg_int(sdb, buf, "corrector threshold at the end of the run",
+	       &sc->theta, sc->theta, NULL);
+}
+
+/* reset statistical corrector stats */
+void
+bpred_sc_reset_stats(struct bpred_sc_t *sc)/* statistical corrector */
+{
+  sc->lookups = 0;
+  sc->overrides = 0;
+  sc->override_hits = 0;
+}
+
+/* free statistical corrector resources */
+void
+bpred_sc_free(struct bpred_sc_t *sc)	/* statistical corrector */
+{
+  if (!sc)
+    return;
+
+  free(sc->ctrs);
+  free(sc);
+}
@@ -0,0 +1,122 @@
+/* bpred_sc.h - statistical corrector */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ */
+
+#ifndef BPRED_SC_H
+#define BPRED_SC_H
+
+#include <stdio.h>
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "stats.h"
+#include "bpred_perc.h"
+
+/*
+ * This module implements a statistical corrector, as in TAGE-SC-L: a
+ * small GEHL-style adder of signed counters that sits behind a direction
+ * predictor and reverses its prediction when that prediction is known to
+ * be statistically biased the wrong way.  It works with any direction
+ * predictor, whose prediction (the base) is one of its inputs.
+ *
+ * A bias table is indexed by the branch address and the base; history
+ * table K is indexed by a hash of the branch address, the base and the
+ * newest HIST_LEN[K] bits of the global history, lengths growing
+ * geometrically.  Counters are 6 bits wide and add up, as 2c+1, to the
+ * output.  When its sign disagrees with the base and its magnitude is
+ * above the threshold theta, the base is reversed.  Counters train on a
+ * wrong output sign or a magnitude within theta, and theta adapts as in
+ * the hashed perceptron (bpred_hperc.h).
+ *
+ * The global history is the perceptron's bit-packed register
+ * (bpred_perc.h), shifted by every control instruction, as for ITTAGE
+ * (bpred_ittage.h).
+ */
+
+/* most history tables */
+#define SC_MAX_TABLES		16
+
+/* statistical corrector state at lookup, travels with the branch */
+struct bpred_sc_ckpt_t {
+  int out;			/* corrector output */
+  byte_t base;			/* direction predicted without the
+				   corrector */
+  byte_t pred;			/* predicted direction */
+};
+
+/* statistical corrector */
+struct bpred_sc_t {
+  unsigned int ntables;		/* number of history tables */
+  unsigned int log_size;	/* log2 counters per table */
+  unsigned int hist_len[SC_MAX_TABLES];/* history length per table */
+  sbyte_t *ctrs;		/* bias table, then NTABLES history tables,
+				   2^LOG_SIZE counters each */
+
+  int theta;			/* override and training threshold */
+  int theta_ctr;		/* theta adaptation counter */
+
+  struct bpred_perc_hist_t hist;/* speculative global history */
+
+  /* stats */
+  counter_t lookups;		/* conditional branches trained */
+  counter_t overrides;		/* ... whose base the corrector reversed */
+  counter_t override_hits;	/* ... correctly */
+};
+
+/* create a statistical corrector of NTABLES history tables, plus a bias
+   table, of TABLE_SIZE counters each, using history lengths from
+   MIN_HIST to MAX_HIST */
+struct bpred_sc_t *			/* statistical corrector instance */
+bpred_sc_create(unsigned int ntables,	/* number of history tables */
+		unsigned int table_size,/* counters per table */
+		unsigned int min_hist,	/* shortest history length */
+		unsigned int max_hist);	/* longest history length */
+
+/* predict the direction of the conditional branch at BADDR with global
+   history H, which the direction predictor predicts BASE_TAKEN, saving
+   the state needed for the update in *CK */
+int					/* non-zero if predicted taken */
+bpred_sc_lookup(struct bpred_sc_t *sc,	/* statistical corrector */
+		md_addr_t baddr,	/* branch address */
+		struct bpred_perc_hist_t *h,/* global history */
+		int base_taken,		/* direction predictor's direction */
+		struct bpred_sc_ckpt_t *ck);/* lookup state */
+
+/* train the corrector with outcome TAKEN of the branch at BADDR, which
+   saw global history H and lookup state CK */
+void
+bpred_sc_update(struct bpred_sc_t *sc,	/* statistical corrector */
+		md_addr_t baddr,	/* branch address */
+		struct bpred_perc_hist_t *h,/* history seen at lookup */
+		struct bpred_sc_ckpt_t *ck,/* lookup state */
+		int taken);		/* actual branch outcome */
+
+/* shift outcome TAKEN of the branch at BADDR into the global history */
+void
+bpred_sc_hist_push(struct bpred_sc_t *sc,/* statistical corrector */
+		   md_addr_t baddr,	/* branch address */
+		   int taken);		/* branch outcome */
+
+/* print statistical corrector configuration */
+void
+bpred_sc_config(struct bpred_sc_t *sc,	/* statistical corrector */
+		FILE *stream);		/* output stream */
+
+/* register statistical corrector stats under NAME */
+void
+bpred_sc_reg_stats(struct bpred_sc_t *sc,/* statistical corrector */
+		   char *name,		/* stats name prefix */
+		   struct stat_sdb_t *sdb);/* stats database */
+
+/* reset statistical corrector stats */
+void
+bpred_sc_reset_stats(struct bpred_sc_t *sc);/* statistical corrector */
+
+/* free statistical corrector resources */
+void
+bpred_sc_free(struct bpred_sc_t *sc);	/* statistical corrector */
+
+#endif /* BPRED_SC_H */
@@ -0,0 +1,476 @@
+/* bpred_tage.c - TAGE branch direction predictor */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "stats.h"
+#include "bpred_tage.h"
+
+/* branches between useful counter agings */
+#define TAGE_U_PERIOD		(1 << 18)
+
+/* direction counter limits, 3-bit signed */
+#define CTR_MAX			3
+#define CTR_MIN			(-4)
+
+/* path history bits folded into table indices */
+#define PATH_BITS		16
+
+#define HIST_MASK		(TAGE_HIST_BUF - 1)
+
+/* entry IDX of tagged table I (0-based) */
+#define TAGE_ENT(T, I, IDX)	(&(T)->tables[((I) << (T)->log_size) + (IDX)])
+
+/* table lookup result for one branch */
+struct tage_probe_t {
+  unsigned int idx[TAGE_MAX_TABLES];	/* index into each tagged table */
+  half_t tag[TAGE_MAX_TABLES];		/* tag for each tagged table */
+  unsigned int base_idx;		/* index into the base predictor */
+  int provider;			/* providing table, 1-based, 0 for base */
+  int alt;			/* alternate table, 1-based, 0 for base */
+  int provider_pred;		/* provider's direction */
+  int alt_pred;			/* alternate's direction */
+  int weak;			/* provider entry is weak (likely new) */
+  int used_alt;			/* alternate overrode the provider */
+  int pred;			/* final direction */
+};
+
+/* create a TAGE predictor with a BASE_SIZE-entry bimodal base predictor
+   and NTABLES tagged tables of TABLE_SIZE entries with TAG_BITS-bit tags,
+   using history lengths from MIN_HIST to MAX_HIST */
+struct bpred_tage_t *			/* TAGE predictor instance */
+bpred_tage_create(unsigned int base_size,/* base predictor entries */
+		  unsigned int ntables,	/* number of tagged tables */
+		  unsigned int table_size,/* entries per tagged table */
+		  unsigned int min_hist,/* shortest history length */
+		  unsigned int max_hist,/* longest history length */
+		  unsigned int tag_bits)/* partial tag width */
+{
+  struct bpred_tage_t *t;
+  unsigned int i, len;
+  int flipflop;
+
+  if (!base_size || (base_size & (base_size - 1)) != 0)
+    fatal("TAGE: base predictor size `%d' must be non-zero and a power "
+	  "of two", base_size);
+  if (!ntables || ntables > TAGE_MAX_TABLES)
+    fatal("TAGE: number of tagged tables `%d' must be between 1 and %d",
+	  ntables, TAGE_MAX_TABLES);
+  if (table_size < 16 || (table_size & (table_size - 1)) != 0)
+    fatal("TAGE: tagged table size `%d' must be a power of two, at least 16",
+	  table_size);
+  if (!min_hist || max_hist < min_hist + ntables - 1
+      || max_hist > TAGE_HIST_MAX)
+    fatal("TAGE: history lengths `%d..%d' must be non-zero, increasing by "
+	  "at least one per table, and at most %d",
+	  min_hist, max_hist, TAGE_HIST_MAX);
+  if (tag_bits < 4 || tag_bits > 16)
+    fatal("TAGE: tag width `%d' must be between 4 and 16 bits", tag_bits);
+
+  if (!(t = calloc(1, sizeof(struct bpred_tage_t))))
+    fatal("out of virtual memory");
+
+  t->ntables = ntables;
+  t->tag_bits = tag_bits;
+  t->base_size = base_size;
+  for (t->log_size = 0; (1U << t->log_size) < table_size; t->log_size++)
+    /* nada */;
+
+  /* geometric history lengths, kept strictly increasing */
+  for (i = 0; i < ntables; i++)
+    {
+      if (ntables == 1)
+	len = min_hist;
+      else
+	len = (unsigned int)(min_hist
+			     * pow((double)max_hist / min_hist,
+				   (double)i / (ntables - 1)) + 0.5);
+      if (i && len <= t->hist_len[i-1])
+	len = t->hist_len[i-1] + 1;
+      t->hist_len[i] = len;
+    }
+
+  t->fold_len[TAGE_FOLD_IDX] = t->log_size;
+  t->fold_len[TAGE_FOLD_TAG0] = tag_bits;
+  t->fold_len[TAGE_FOLD_TAG1] = tag_bits - 1;
+
+  /* base predictor counters start out weakly this-or-that */
+  if (!(t->base = calloc(base_size, sizeof(unsigned char))))
+    fatal("cannot allocate TAGE base predictor");
+  flipflop = 1;
+  for (i = 0; i < base_size; i++)
+    {
+      t->base[i] = flipflop;
+      flipflop = 3 - flipflop;
+    }
+
+  if (!(t->tables = calloc(ntables << t->log_size,
+			   sizeof(struct bpred_tage_ent_t))))
+    fatal("cannot allocate TAGE tagged tables");
+
+  t->lfsr = 1;
+
+  /* all-not-taken history, its folded copies are all zero */
+  return t;
+}
+
+/* fold the newest path history bits of PATH, up to LEN of them, into a
+   table index, rotated by table I so that tables see different mixes */
+static unsigned int
+path_hash(struct bpred_tage_t *t, word_t path, unsigned int len,
+	  unsigned int i)
+{
+  unsigned int mask = (1U << t->log_size) - 1, r = i % t->log_size;
+  word_t h = 0;
+
+  path &= (1U << MIN(len, PATH_BITS)) - 1;
+  for (; path; path >>= t->log_size)
+    h ^= path & mask;
+  return r ? (((h << r) | (h >> (t->log_size - r))) & mask) : h;
+}
+
+/* look the branch at BADDR up in all tables with global history H */
+static void
+tage_probe(struct bpred_tage_t *t,	/* TAGE predictor instance */
+	   md_addr_t baddr,		/* branch address */
+	   struct bpred_tage_hist_t *h,	/* global history */
+	   struct tage_probe_t *p)	/* lookup result */
+{
+  word_t pc = baddr >> MD_BR_SHIFT;
+  unsigned int i, shift, mask = (1U << t->log_size) - 1;
+  struct bpred_tage_ent_t *e;
+
+  p->base_idx = pc & (t->base_size - 1);
+  p->provider = p->alt = 0;
+
+  for (i = 0; i < t->ntables; i++)
+    {
+      shift = (t->log_size > i + 1 ? t->log_size - i - 1 : i + 1 - t->log_size)
+	+ 1;
+      p->idx[i] = (pc ^ (pc >> shift) ^ h->fold[i][TAGE_FOLD_IDX]
+		   ^ path_hash(t, h->path, t->hist_len[i], i + 1)) & mask;
+      p->tag[i] = (pc ^ h->fold[i][TAGE_FOLD_TAG0]
+		   ^ (h->fold[i][TAGE_FOLD_TAG1] << 1))
+	& ((1U << t->tag_bits) - 1);
+    }
+
+  /* longest and second longest matching tables */
+  for (i = t->ntables; i > 0; i--)
+    {
+      if (TAGE_ENT(t, i-1, p->idx[i-1])->tag == p->tag[i-1])
+	{
+	  if (!p->provider)
+	    p->provider = i;
+	  else
+	    {
+	      p->alt = i;
+	      break;
+	    }
+	}
+    }
+
+  if (p->alt)
+    p->alt_pred = TAGE_ENT(t, p->alt-1, p->idx[p->alt-1])->ctr >= 0;
+  else
+    p->alt_pred = t->base[p->base_idx] >= 2;
+
+  if (!p->provider)
+    {
+      p->provider_pred = p->pred = p->alt_pred;
+      p->weak = p->used_alt = FALSE;
+      return;
+    }
+
+  e = TAGE_ENT(t, p->provider-1, p->idx[p->provider-1]);
+  p->provider_pred = e->ctr >= 0;
+  p->weak = (e->ctr == 0 || e->ctr == -1);
+  p->used_alt = p->weak && t->use_alt_on_na >= 0;
+  p->pred = p->used_alt ? p->alt_pred : p->provider_pred;
+}
+
+/* predict the direction of the branch at BADDR with global history H */
+int					/* non-zero if predicted taken */
+bpred_tage_lookup(struct bpred_tage_t *t,/* TAGE predictor instance */
+		  md_addr_t baddr,	/* branch address */
+		  struct bpred_tage_hist_t *h)/* global history */
+{
+  struct tage_probe_t p;
+
+  tage_probe(t, baddr, h, &p);
+  return p.pred;
+}
+
+/* step signed counter *CTR toward outcome TAKEN */
+static void
+ctr_update(signed char *ctr, int taken)
+{
+  if (taken)
+    {
+      if (*ctr < CTR_MAX)
+	++*ctr;
+    }
+  else
+    {
+      if (*ctr > CTR_MIN)
+	--*ctr;
+    }
+}
+
+/* step 2-bit base counter *CTR toward outcome TAKEN */
+static void
+base_update(unsigned char *ctr, int taken)
+{
+  if (taken)
+    {
+      if (*ctr < 3)
+	++*ctr;
+    }
+  else
+    {
+      if (*ctr > 0)
+	--*ctr;
+    }
+}
+
+/* next allocation random bit source */
+static word_t
+lfsr_next(struct bpred_tage_t *t)
+{
+  t->lfsr = (t->lfsr >> 1) ^ (-(t->lfsr & 1) & 0xd0000001U);
+  return t->lfsr;
+}
+
+/* train the predictor with outcome TAKEN of the branch at BADDR, which
+   saw global history H and was predicted PRED_TAKEN */
+void
+bpred_tage_update(struct bpred_tage_t *t,/* TAGE predictor instance */
+		  md_addr_t baddr,	/* branch address */
+		  struct bpred_tage_hist_t *h,/* history seen at lookup */
+		  int pred_taken,	/* predicted direction */
+		  int taken)		/* actual branch outcome */
+{
+  struct tage_probe_t p;
+  struct bpred_tage_ent_t *e = NULL;
+  unsigned int i, j;
+
+  taken = !!taken;
+  tage_probe(t, baddr, h, &p);
+
+  t->provided[p.provider]++;
+  if (p.provider_pred == taken)
+    t->provided_hits[p.provider]++;
+  if (p.used_alt)
+    t->used_alt++;
+
+  if (p.provider)
+    {
+      e = TAGE_ENT(t, p.provider-1, p.idx[p.provider-1]);
+
+      /* learn whether weak (new) entries beat the alternate */
+      if (p.weak && p.provider_pred != p.alt_pred)
+	{
+	  if (p.alt_pred == taken)
+	    {
+	      if (t->use_alt_on_na < 7)
+		t->use_alt_on_na++;
+	    }
+	  else if (t->use_alt_on_na > -8)
+	    t->use_alt_on_na--;
+	}
+    }
+
+  /* on a misprediction, allocate an entry in a longer-history table;
+     not when a weak provider was right and only the alternate was not */
+  if (!!pred_taken != taken && p.provider < (int)t->ntables
+      && !(p.provider && p.weak && p.provider_pred == taken))
+    {
+      i = p.provider;
+
+      /* half the time skip a table, so allocations spread out */
+      if (i + 1 < t->ntables && (lfsr_next(t) & 1))
+	i++;
+
+      for (j = i; j < t->ntables; j++)
+	{
+	  struct bpred_tage_ent_t *a = TAGE_ENT(t, j, p.idx[j]);
+
+	  if (!a->u)
+	    {
+	      a->tag = p.tag[j];
+	      a->ctr = taken ? 0 : -1;
+	      t->allocs++;
+	      break;
+	    }
+	}
+      if (j == t->ntables)
+	{
+	  /* no victim; make room for next time */
+	  for (j = p.provider; j < t->ntables; j++)
+	    {
+	      struct bpred_tage_ent_t *a = TAGE_ENT(t, j, p.idx[j]);
+
+	      if (a->u)
+		a->u--;
+	    }
+	  t->alloc_fails++;
+	}
+    }
+
+  if (e)
+    {
+      /* useful when it was right where the alternate was not */
+      if (p.provider_pred != p.alt_pred)
+	{
+	  if (p.provider_pred == taken)
+	    {
+	      if (e->u < 3)
+		e->u++;
+	    }
+	  else if (e->u)
+	    e->u--;
+	}
+
+      /* train the provider, and the alternate until the provider has
+	 proven useful */
+      ctr_update(&e->ctr, taken);
+      if (!e->u)
+	{
+	  if (p.alt)
+	    ctr_update(&TAGE_ENT(t, p.alt-1, p.idx[p.alt-1])->ctr, taken);
+	  else
+	    base_update(&t->base[p.base_idx], taken);
+	}
+    }
+  else
+    base_update(&t->base[p.base_idx], taken);
+
+  /* age useful counters so that stale entries can be replaced */
+  if (++t->tick % TAGE_U_PERIOD == 0)
+    {
+      for (i = 0; i < (t->ntables << t->log_size); i++)
+	t->tables[i].u >>= 1;
+    }
+}
+
+/* shift history bit IN into folded history *F of width CLEN, for a history
+   of length OLEN whose oldest bit OUT drops out */
+static void
+fold_push(word_t *f, unsigned int clen, unsigned int olen, int in, int out)
+{
+  word_t c = (*f << 1) | in;
+
+  c ^= (word_t)out << (olen % clen);
+  c ^= c >> clen;
+  *f = c & ((1U << clen) - 1);
+}
+
+/* shift outcome TAKEN of the branch at BADDR into global history H */
+void
+bpred_tage_hist_push(struct bpred_tage_t *t,/* TAGE predictor instance */
+		     struct bpred_tage_hist_t *h,/* global history */
+		     md_addr_t baddr,	/* branch address */
+		     int taken)		/* branch outcome */
+{
+  unsigned int i, k;
+  int out;
+
+  taken = !!taken;
+  h->ptr = (h->ptr - 1) & HIST_MASK;
+  t->ghist[h->ptr] = taken;
+  h->path = ((h->path << 1) | ((baddr >> MD_BR_SHIFT) & 1))
+    & ((1U << PATH_BITS) - 1);
+
+  for (i = 0; i < t->ntables; i++)
+    {
+      out = t->ghist[(h->ptr + t->hist_len[i]) & HIST_MASK];
+      for (k = 0; k < TAGE_NUM_FOLDS; k++)
+	fold_push(&h->fold[i][k], t->fold_len[k], t->hist_len[i], taken, out);
+    }
+}
+
+/* print TAGE predictor configuration */
+void
+bpred_tage_config(struct bpred_tage_t *t,/* TAGE predictor instance */
+		  char name[],		/* predictor name */
+		  FILE *stream)		/* output stream */
+{
+  unsigned int i;
+
+  fprintf(stream,
+	  "pred_dir: %s: TAGE: %d-entry base, %d tables x %d entries, "
+	  "%d-bit tags, history lengths",
+	  name, t->base_size, t->ntables, 1 << t->log_size, t->tag_bits);
+  for (i = 0; i < t->ntables; i++)
+    fprintf(stream, " %d", t->hist_len[i]);
+  fprintf(stream, "\n");
+}
+
+/* register TAGE predictor stats under NAME */
+void
+bpred_tage_reg_stats(struct bpred_tage_t *t,/* TAGE predictor instance */
+		     char *name,	/* stats name prefix */
+		     struct stat_sdb_t *sdb)/* stats database */
+{
+  char buf[512], buf1[512];
+  unsigned int i;
+
+  for (i = 0; i <= t->ntables; i++)
+    {
+      sprintf(buf, "%s.tage_provider_%d", name, i);
+      if (i)
+	sprintf(buf1, "predictions provided by tagged table %d "
+		"(history %d)", i, t->hist_len[i-1]);
+      else
+	sprintf(buf1, "predictions provided by the base predictor");
+      stat_reg_counter(sdb, buf, buf1, &t->provided[i], 0, NULL);
+
+      sprintf(buf, "%s.tage_provider_hits_%d", name, i);
+      stat_reg_counter(sdb, buf, "... of which the provider was correct",
+		       &t->provided_hits[i], 0, NULL);
+    }
+  sprintf(buf, "%s.tage_used_alt", name);
+  stat_reg_counter(sdb, buf,
+		   "alternate predictions used over weak providers",
+		   &t->used_alt, 0, NULL);
+  sprintf(buf, "%s.tage_allocs", name);
+  stat_reg_counter(sdb, buf, "tagged entries allocated on mispredictions",
+		   &t->allocs, 0, NULL);
+  sprintf(buf, "%s.tage_alloc_fails", name);
+  stat_reg_counter(sdb, buf,
+		   "mispredictions that found no entry to allocate",
+		   &t->alloc_fails, 0, NULL);
+}
+
+/* reset TAGE predictor stats */
+void
+bpred_tage_reset_stats(struct bpred_tage_t *t)/* TAGE predictor instance */
+{
+  unsigned int i;
+
+  for (i = 0; i <= TAGE_MAX_TABLES; i++)
+    t->provided[i] = t->provided_hits[i] = 0;
+  t->used_alt = 0;
+  t->allocs = 0;
+  t->alloc_fails = 0;
+}
+
+/* free TAGE predictor resources */
+void
+bpred_tage_free(struct bpred_tage_t *t)	/* TAGE predictor instance */
+{
+  if (!t)
+    return;
+
+  free(t->base);
+  free(t->tables);
+  free(t);
+}
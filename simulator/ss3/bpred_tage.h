@@ -0,0 +1,148 @@
+/* bpred_tage.h - TAGE branch direction predictor */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ */
+
+#ifndef BPRED_TAGE_H
+#define BPRED_TAGE_H
+
+#include <stdio.h>
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "stats.h"
+
+/*
+ * This module implements a TAGE (TAgged GEometric history length)
+ * direction predictor: a bimodal base predictor backed by a number of
+ * partially tagged tables, each indexed with a hash of the branch address
+ * and an ever longer slice of the global history.  History lengths form a
+ * geometric series between the configured minimum and maximum.
+ *
+ * The longest-history table whose tag matches provides the prediction
+ * (the provider); the next matching table, or the base predictor, gives
+ * the alternate prediction, which is used instead while the provider
+ * entry is newly allocated and still weak.  On a misprediction an entry
+ * is allocated in a longer-history table whose useful counter is zero;
+ * useful counters track when the provider was right and the alternate
+ * was not, and are aged periodically so stale entries can be replaced.
+ *
+ * Table indices and tags hash the global history through folded
+ * (circular-shift compressed) copies of it, kept up to date one bit per
+ * branch.  The history itself lives in a circular buffer, so a history
+ * checkpoint is the buffer position plus the folded registers, and every
+ * branch carries one for repair after a misprediction.
+ */
+
+/* most tagged tables */
+#define TAGE_MAX_TABLES		16
+
+/* longest supported history, and the circular history buffer; the slack
+   covers the branches in flight past a checkpoint */
+#define TAGE_HIST_MAX		1024
+#define TAGE_HIST_BUF		4096
+
+/* folded copies of the history kept per tagged table */
+#define TAGE_FOLD_IDX		0	/* table index */
+#define TAGE_FOLD_TAG0		1	/* tag */
+#define TAGE_FOLD_TAG1		2	/* tag, one bit shorter */
+#define TAGE_NUM_FOLDS		3
+
+/* global history checkpoint */
+struct bpred_tage_hist_t {
+  unsigned int ptr;		/* buffer position of the newest outcome */
+  word_t path;			/* path history, 1 address bit per branch */
+  word_t fold[TAGE_MAX_TABLES][TAGE_NUM_FOLDS];	/* folded histories */
+};
+
+/* tagged table entry */
+struct bpred_tage_ent_t {
+  half_t tag;			/* partial tag */
+  signed char ctr;		/* 3-bit signed direction counter */
+  byte_t u;			/* 2-bit useful counter */
+};
+
+/* TAGE predictor */
+struct bpred_tage_t {
+  unsigned int ntables;		/* number of tagged tables */
+  unsigned int log_size;	/* log2 entries per tagged table */
+  unsigned int tag_bits;	/* partial tag width */
+  unsigned int base_size;	/* base predictor entries */
+  unsigned int hist_len[TAGE_MAX_TABLES];/* history length per table */
+  unsigned int fold_len[TAGE_NUM_FOLDS];/* folded history widths */
+
+  unsigned char *base;		/* base predictor, 2-bit counters */
+  struct bpred_tage_ent_t *tables;/* NTABLES x 2^LOG_SIZE tagged entries */
+  int use_alt_on_na;		/* 4-bit signed: trust alternate over weak
+				   new entries when non-negative */
+  counter_t tick;		/* updates, drives useful counter aging */
+  word_t lfsr;			/* allocation randomizer */
+
+  byte_t ghist[TAGE_HIST_BUF];	/* global history, circular */
+  struct bpred_tage_hist_t hist;/* speculative global history */
+
+  /* stats */
+  counter_t provided[TAGE_MAX_TABLES + 1];/* predictions by provider,
+					     0 is the base predictor */
+  counter_t provided_hits[TAGE_MAX_TABLES + 1];/* ... that were correct */
+  counter_t used_alt;		/* alternate used over the provider */
+  counter_t allocs;		/* entries allocated */
+  counter_t alloc_fails;	/* mispredictions with nowhere to allocate */
+};
+
+/* create a TAGE predictor with a BASE_SIZE-entry bimodal base predictor
+   and NTABLES tagged tables of TABLE_SIZE entries with TAG_BITS-bit tags,
+   using history lengths from MIN_HIST to MAX_HIST */
+struct bpred_tage_t *			/* TAGE predictor instance */
+bpred_tage_create(unsigned int base_size,/* base predictor entries */
+		  unsigned int ntables,	/* number of tagged tables */
+		  unsigned int table_size,/* entries per tagged table */
+		  unsigned int min_hist,/* shortest history length */
+		  unsigned int max_hist,/* longest history length */
+		  unsigned int tag_bits);/* partial tag width */
+
+/* predict the direction of the branch at BADDR with global history H */
+int					/* non-zero if predicted taken */
+bpred_tage_lookup(struct bpred_tage_t *t,/* TAGE predictor instance */
+		  md_addr_t baddr,	/* branch address */
+		  struct bpred_tage_hist_t *h);/* global history */
+
+/* train the predictor with outcome TAKEN of the branch at BADDR, which
+   saw global history H and was predicted PRED_TAKEN */
+void
+bpred_tage_update(struct bpred_tage_t *t,/* TAGE predictor instance */
+		  md_addr_t baddr,	/* branch address */
+		  struct bpred_tage_hist_t *h,/* history seen at lookup */
+		  int pred_taken,	/* predicted direction */
+		  int taken);		/* actual branch outcome */
+
+/* shift outcome TAKEN of the branch at BADDR into global history H */
+void
+bpred_tage_hist_push(struct bpred_tage_t *t,/* TAGE predictor instance */
+		     struct bpred_tage_hist_t *h,/* global history */
+		     md_addr_t baddr,	/* branch address */
+		     int taken);	/* branch outcome */
+
+/* print TAGE predictor configuration */
+void
+bpred_tage_config(struct bpred_tage_t *t,/* TAGE predictor instance */
+		  char name[],		/* predictor name */
+		  FILE *stream);	/* output stream */
+
+/* register TAGE predictor stats under NAME */
+void
+bpred_tage_reg_stats(struct bpred_tage_t *t,/* TAGE predictor instance */
+		     char *name,	/* stats name prefix */
+		     struct stat_sdb_t *sdb);/* stats database */
+
+/* reset TAGE predictor stats */
+void
+bpred_tage_reset_stats(struct bpred_tage_t *t);/* TAGE predictor instance */
+
+/* free TAGE predictor resources */
+void
+bpred_tage_free(struct bpred_tage_t *t);/* TAGE predictor instance */
+
+#endif /* BPRED_TAGE_H */
@@ -0,0 +1,284 @@
+/* bptrace.c - compact binary branch traces */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "bptrace.h"
+
+#define BPTRACE_MAGIC		"SSBPTRC"
+#define BPTRACE_VERSION		1
+
+/* block header, blocks are packed back to back so it is copied out */
+struct bptrace_blk_t {
+  word_t nrecs;			/* records in the block */
+  word_t nbytes;		/* encoded record bytes that follow */
+};
+
+/* longest varint encoding of a qword_t */
+#define VARINT_MAX		10
+
+/* encoded size limit of one block */
+#define BLOCK_BUF_SIZE		(BPTRACE_BLOCK_RECS * 3 * VARINT_MAX)
+
+/* signed <-> unsigned mapping that keeps small magnitudes small */
+#define ZIGZAG(D)	(((qword_t)(D) << 1) ^ (qword_t)((D) >> 63))
+#define UNZIGZAG(V)	((sqword_t)((V) >> 1) ^ -(sqword_t)((V) & 1))
+
+static byte_t *
+put_varint(byte_t *p, qword_t v)
+{
+  while (v >= 0x80)
+    {
+      *p++ = (byte_t)(v | 0x80);
+      v >>= 7;
+    }
+  *p++ = (byte_t)v;
+  return p;
+}
+
+static qword_t
+get_varint(struct bptrace_t *t, struct bptrace_cursor_t *c)
+{
+  qword_t v = 0;
+  int shift = 0;
+  byte_t b;
+
+  do {
+    if (c->pos >= c->block_end || shift >= 64)
+      fatal("branch trace `%s' is corrupt", t->fname);
+    b = *c->pos++;
+    v |= (qword_t)(b & 0x7f) << shift;
+    shift += 7;
+  } while (b & 0x80);
+
+  return v;
+}
+
+/* create branch trace file FNAME for capture; tracing starts at START_PC */
+struct bptrace_t *			/* branch trace */
+bptrace_create(char *fname,		/* trace file name */
+	       md_addr_t start_pc)	/* first traced instruction */
+{
+  struct bptrace_t *t;
+
+  if (!(t = calloc(1, sizeof(struct bptrace_t))))
+    fatal("out of virtual memory");
+
+  t->fname = mystrdup(fname);
+  if (!(t->fd = fopen(fname, "wb")))
+    fatal("cannot open branch trace file `%s'", fname);
+  if (!(t->buf = malloc(BLOCK_BUF_SIZE)))
+    fatal("out of virtual memory");
+
+  strcpy(t->hdr.magic, BPTRACE_MAGIC);
+  t->hdr.version = BPTRACE_VERSION;
+  t->hdr.inst_size = sizeof(md_inst_t);
+  t->hdr.start_pc = start_pc;
+
+  /* placeholder header, rewritten with the totals at close */
+  if (fwrite(&t->hdr, sizeof(t->hdr), 1, t->fd) != 1)
+    fatal("cannot write branch trace file `%s'", fname);
+
+  return t;
+}
+
+/* write out the buffered block of trace T */
+static void
+bptrace_flush(struct bptrace_t *t)
+{
+  struct bptrace_blk_t blk;
+
+  if (!t->buf_recs)
+    return;
+
+  blk.nrecs = t->buf_recs;
+  blk.nbytes = t->buf_len;
+  if (fwrite(&blk, sizeof(blk), 1, t->fd) != 1
+      || fwrite(t->buf, t->buf_len, 1, t->fd) != 1)
+    fatal("cannot write branch trace file `%s'", t->fname);
+
+  t->hdr.nblocks++;
+  t->buf_recs = 0;
+  t->buf_len = 0;
+  t->last_pc = 0;
+}
+
+/* append a branch record to trace T */
+void
+bptrace_write(struct bptrace_t *t,	/* branch trace */
+	      md_addr_t pc,		/* branch address */
+	      md_addr_t target,		/* branch target if taken */
+	      enum md_opcode op,	/* branch opcode */
+	      int taken,		/* non-zero if branch was taken */
+	      int is_call,		/* non-zero if branch is fn call */
+	      int is_return)		/* non-zero if branch is fn return */
+{
+  byte_t *p = t->buf + t->buf_len;
+  sqword_t pc_delta, target_delta;
+
+  if ((pc | target) & (sizeof(md_inst_t) - 1))
+    fatal("branch @ 0x%08p to 0x%08p is not instruction aligned",
+	  pc, target);
+
+  pc_delta = ((sqword_t)pc - (sqword_t)t->last_pc)
+    / (sqword_t)sizeof(md_inst_t);
+  target_delta = ((sqword_t)target - (sqword_t)pc)
+    / (sqword_t)sizeof(md_inst_t);
+
+  p = put_varint(p, (qword_t)op);
+  p = put_varint(p, (ZIGZAG(pc_delta) << 3) | (!!is_return << 2)
+		 | (!!is_call << 1) | !!taken);
+  p = put_varint(p, ZIGZAG(target_delta));
+
+  t->buf_len = p - t->buf;
+  t->last_pc = pc;
+  t->hdr.nrecs++;
+
+  if (++t->buf_recs == BPTRACE_BLOCK_RECS)
+    bptrace_flush(t);
+}
+
+/* finish capture to trace T, which covered NINSTS instructions */
+void
+bptrace_close(struct bptrace_t *t,	/* branch trace */
+	      counter_t ninsts)		/* instructions executed */
+{
+  bptrace_flush(t);
+
+  t->hdr.ninsts = ninsts;
+  if (fseek(t->fd, 0, SEEK_SET) != 0
+      || fwrite(&t->hdr, sizeof(t->hdr), 1, t->fd) != 1
+      || fclose(t->fd) != 0)
+    fatal("cannot write branch trace file `%s'", t->fname);
+
+  free(t->buf);
+  free(t->fname);
+  free(t);
+}
+
+/* open branch trace file FNAME for replay */
+struct bptrace_t *			/* branch trace */
+bptrace_open(char *fname)		/* trace file name */
+{
+  struct bptrace_t *t;
+  struct stat sbuf;
+  int fd;
+
+  if (!(t = calloc(1, sizeof(struct bptrace_t))))
+    fatal("out of virtual memory");
+  t->fname = mystrdup(fname);
+
+  if ((fd = open(fname, O_RDONLY)) < 0)
+    fatal("cannot open branch trace file `%s'", fname);
+  if (fstat(fd, &sbuf) < 0)
+    fatal("cannot stat branch trace file `%s'", fname);
+  if ((size_t)sbuf.st_size < sizeof(struct bptrace_hdr_t))
+    fatal("`%s' is not a branch trace", fname);
+
+  t->map_size = sbuf.st_size;
+  t->map = mmap(NULL, t->map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (t->map == MAP_FAILED)
+    fatal("cannot map branch trace file `%s'", fname);
+  close(fd);
+
+  /* records are decoded front to back, once */
+  madvise(t->map, t->map_size, MADV_SEQUENTIAL);
+
+  memcpy(&t->hdr, t->map, sizeof(t->hdr));
+  if (strncmp(t->hdr.magic, BPTRACE_MAGIC, sizeof(t->hdr.magic)))
+    fatal("`%s' is not a branch trace", fname);
+  if (t->hdr.version != BPTRACE_VERSION)
+    fatal("branch trace `%s' has an unsupported version or byte order",
+	  fname);
+  if (t->hdr.inst_size != sizeof(md_inst_t))
+    fatal("branch trace `%s' was captured for another target", fname);
+
+  return t;
+}
+
+/* point cursor C at the first record of trace T */
+void
+bptrace_rewind(struct bptrace_t *t,	/* branch trace */
+	       struct bptrace_cursor_t *c)/* replay cursor */
+{
+  c->pos = t->map + sizeof(struct bptrace_hdr_t);
+  c->block_end = c->pos;
+  c->block_left = 0;
+  c->last_pc = 0;
+}
+
+/* decode the record of trace T at cursor C into *REC and advance C,
+   returns FALSE at the end of the trace */
+int					/* non-zero if *REC is valid */
+bptrace_read(struct bptrace_t *t,	/* branch trace */
+	     struct bptrace_cursor_t *c,/* replay cursor */
+	     struct bptrace_rec_t *rec)	/* record to fill */
+{
+  byte_t *end = t->map + t->map_size;
+  qword_t v;
+
+  /* step to the next non-empty block */
+  while (!c->block_left)
+    {
+      struct bptrace_blk_t blk;
+
+      if (c->block_end == end)
+	return FALSE;
+      if ((size_t)(end - c->block_end) < sizeof(blk))
+	fatal("branch trace `%s' is truncated", t->fname);
+
+      memcpy(&blk, c->block_end, sizeof(blk));
+      c->pos = c->block_end + sizeof(blk);
+      if ((size_t)(end - c->pos) < blk.nbytes)
+	fatal("branch trace `%s' is truncated", t->fname);
+
+      c->block_end = c->pos + blk.nbytes;
+      c->block_left = blk.nrecs;
+      c->last_pc = 0;
+    }
+
+  rec->op = (enum md_opcode)get_varint(t, c);
+  v = get_varint(t, c);
+  rec->taken = (int)(v & 1);
+  rec->is_call = (int)((v >> 1) & 1);
+  rec->is_return = (int)((v >> 2) & 1);
+  rec->pc = c->last_pc
+    + (md_addr_t)(UNZIGZAG(v >> 3) * (sqword_t)sizeof(md_inst_t));
+  v = get_varint(t, c);
+  rec->target = rec->pc
+    + (md_addr_t)(UNZIGZAG(v) * (sqword_t)sizeof(md_inst_t));
+
+  if (rec->op <= OP_NA || rec->op >= OP_MAX
+      || !(MD_OP_FLAGS(rec->op) & F_CTRL))
+    fatal("branch trace `%s' is corrupt", t->fname);
+
+  c->last_pc = rec->pc;
+  c->block_left--;
+  return TRUE;
+}
+
+/* unmap and free replay trace T */
+void
+bptrace_free(struct bptrace_t *t)	/* branch trace */
+{
+  if (!t)
+    return;
+
+  munmap(t->map, t->map_size);
+  free(t->fname);
+  free(t);
+}
@@ -0,0 +1,128 @@
+/* bptrace.h - compact binary branch traces */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ */
+
+#ifndef BPTRACE_H
+#define BPTRACE_H
+
+#include <stdio.h>
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+
+/*
+ * This module writes and replays branch traces: one record per executed
+ * control instruction, holding its PC, target, taken bit, opcode and
+ * call/return flags, which is all bpred_lookup() and bpred_update() need.
+ *
+ * A trace is a header followed by blocks of up to BPTRACE_BLOCK_RECS
+ * records.  Each record is three varints:
+ *
+ *   opcode
+ *   zigzag(PC delta) << 3 | is_return << 2 | is_call << 1 | taken
+ *   zigzag(target - PC)
+ *
+ * with deltas counted in instructions.  The PC delta is taken against
+ * the previous record of the same block, so blocks decode on their own
+ * and a typical record fits in 4-5 bytes.
+ *
+ * Traces are replayed straight out of an mmap()'ed file.  They are
+ * written in host byte order; replaying on a host of the other order is
+ * refused.
+ */
+
+/* records per trace block */
+#define BPTRACE_BLOCK_RECS	4096
+
+/* trace file header */
+struct bptrace_hdr_t {
+  char magic[8];		/* BPTRACE_MAGIC */
+  word_t version;		/* BPTRACE_VERSION, also tells byte order */
+  word_t inst_size;		/* sizeof(md_inst_t) of the traced target */
+  qword_t start_pc;		/* PC of the first traced instruction */
+  qword_t ninsts;		/* instructions executed while tracing */
+  qword_t nrecs;		/* branch records */
+  qword_t nblocks;		/* record blocks */
+};
+
+/* one branch record */
+struct bptrace_rec_t {
+  md_addr_t pc;			/* branch address */
+  md_addr_t target;		/* branch target if taken */
+  enum md_opcode op;		/* branch opcode */
+  int taken;			/* non-zero if branch was taken */
+  int is_call;			/* non-zero if branch is fn call */
+  int is_return;		/* non-zero if branch is fn return */
+};
+
+/* branch trace, open for capture or for replay */
+struct bptrace_t {
+  char *fname;			/* trace file name */
+  struct bptrace_hdr_t hdr;	/* trace header */
+
+  /* capture state */
+  FILE *fd;			/* trace file */
+  byte_t *buf;			/* encoded records of the current block */
+  unsigned int buf_len;		/* bytes in BUF */
+  unsigned int buf_recs;	/* records in BUF */
+
+  md_addr_t last_pc;		/* PC of the previous record in the block */
+
+  /* replay state */
+  byte_t *map;			/* mapped trace file */
+  size_t map_size;		/* size of the mapping */
+};
+
+/* replay position in a trace; a trace is only read during replay, so any
+   number of cursors (e.g., one per thread) can walk it at once */
+struct bptrace_cursor_t {
+  byte_t *pos;			/* next byte to decode */
+  byte_t *block_end;		/* end of the current block */
+  unsigned int block_left;	/* records left in the current block */
+  md_addr_t last_pc;		/* PC of the previous record in the block */
+};
+
+/* create branch trace file FNAME for capture; tracing starts at START_PC */
+struct bptrace_t *			/* branch trace */
+bptrace_create(char *fname,		/* trace file name */
+	       md_addr_t start_pc);	/* first traced instruction */
+
+/* append a branch record to trace T */
+void
+bptrace_write(struct bptrace_t *t,	/* branch trace */
+	      md_addr_t pc,		/* branch address */
+	      md_addr_t target,		/* branch target if taken */
+	      enum md_opcode op,	/* branch opcode */
+	      int taken,		/* non-zero if branch was taken */
+	      int is_call,		/* non-zero if branch is fn call */
+	      int is_return);		/* non-zero if branch is fn return */
+
+/* finish capture to trace T, which covered NINSTS instructions */
+void
+bptrace_close(struct bptrace_t *t,	/* branch trace */
+	      counter_t ninsts);	/* instructions executed */
+
+/* open branch trace file FNAME for replay */
+struct bptrace_t *			/* branch trace */
+bptrace_open(char *fname);		/* trace file name */
+
+/* point cursor C at the first record of trace T */
+void
+bptrace_rewind(struct bptrace_t *t,	/* branch trace */
+	       struct bptrace_cursor_t *c);/* replay cursor */
+
+/* decode the record of trace T at cursor C into *REC and advance C,
+   returns FALSE at the end of the trace */
+int					/* non-zero if *REC is valid */
+bptrace_read(struct bptrace_t *t,	/* branch trace */
+	     struct bptrace_cursor_t *c,/* replay cursor */
+	     struct bptrace_rec_t *rec);/* record to fill */
+
+/* unmap and free replay trace T */
+void
+bptrace_free(struct bptrace_t *t);	/* branch trace */
+
+#endif /* BPTRACE_H */
@@ -51,6 +51,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #include "host.h"
@@ -58,23 +59,26 @@
 #include "machine.h"
 #include "cache.h"
 
+/* vector tag compares need GCC-style per-function target attributes;
+   define CACHE_NO_SIMD to build the portable compare only */
+#if !defined(CACHE_NO_SIMD) && defined(__GNUC__)			\
+    && (defined(__x86_64__) || defined(__i386__))
+#define CACHE_X86
+#include <immintrin.h>
+#endif
+
 /* cache access macros */
-#define CACHE_TAG(cp, addr)	((addr) >> (cp)->tag_shift)
 #define CACHE_SET(cp, addr)	(((addr) >> (cp)->set_shift) & (cp)->set_mask)
 #define CACHE_BLK(cp, addr)	((addr) & (cp)->blk_mask)
 #define CACHE_TAGSET(cp, addr)	((addr) & (cp)->tagset_mask)
 
+/* tag array entry of a valid, clean block holding address ADDR */
+#define CACHE_KEY(cp, addr)	(CACHE_TAGSET(cp, addr) | CACHE_BLK_VALID)
+
 /* extract/reconstruct a block address */
 #define CACHE_BADDR(cp, addr)	((addr) & ~(cp)->blk_mask)
-#define CACHE_MK_BADDR(cp, tag, set)					\
-  (((tag) << (cp)->tag_shift)|((set) << (cp)->set_shift))
-
-/* index an array of cache blocks, non-trivial due to variable length blocks */
-#define CACHE_BINDEX(cp, blks, i)					\
-  ((struct cache_blk_t *)(((char *)(blks)) +				\
-			  (i)*(sizeof(struct cache_blk_t) +		\
-			       ((cp)->balloc				\
-				? (cp)->bsize*sizeof(byte_t) : 0))))
+#define CACHE_TAG_BADDR(tag)						\
+  ((tag) & ~(md_addr_t)(CACHE_BLK_VALID|CACHE_BLK_DIRTY))
 
 /* cache data block accessor, type parameterized */
 #define __CACHE_ACCESS(type, data, bofs)				\
@@ -87,12 +91,6 @@
 #define CACHE_HALF(data, bofs)	  __CACHE_ACCESS(unsigned short, data, bofs)
 #define CACHE_BYTE(data, bofs)	  __CACHE_ACCESS(unsigned char, data, bofs)
 
-/* cache block hashing macros, this macro is used to index into a cache
-   set hash table (to find the correct block on N in an N-way cache), the
-   cache set index function is CACHE_SET, defined above */
-#define CACHE_HASH(cp, key)						\
-  (((key >> 24) ^ (key >> 16) ^ (key >> 8) ^ key) & ((cp)->hsize-1))
-
 /* copy data out of a cache block to buffer indicated by argument pointer p */
 #define CACHE_BCOPY(cmd, blk, bofs, p, nbytes)	\
   if (cmd == Read)							\
@@ -139,118 +137,144 @@
 /* bound sqword_t/dfloat_t to positive int */
 #define BOUND_POS(N)		((int)(MIN(MAX(0, (N)), 2147483647)))
 
-/* unlink BLK from the hash table bucket chain in SET */
-static void
-unlink_htab_ent(struct cache_t *cp,		/* cache to update */
-		struct cache_set_t *set,	/* set containing bkt chain */
-		struct cache_blk_t *blk)	/* block to unlink */
+/* prefetch throttling, the fraction of each CACHE_PF_INTERVAL prefetches
+   used lowers the degree below CACHE_PF_ACC_LOW and raises it from
+   CACHE_PF_ACC_HIGH */
+#define CACHE_PF_INTERVAL	256
+#define CACHE_PF_ACC_LOW	0.40
+#define CACHE_PF_ACC_HIGH	0.75
+
+/*
+ * way compare kernels, the dirty bit is masked off each tag before it is
+ * compared with KEY, which has only the valid bit set
+ */
+
+static int
+find_c(const md_addr_t *tags, int assoc, md_addr_t key)
+{
+  int i;
+
+  for (i = 0; i < assoc; i++)
+    if ((tags[i] & ~(md_addr_t)CACHE_BLK_DIRTY) == key)
+      return i;
+  return -1;
+}
+
+#ifdef CACHE_X86
+
+#ifndef MD_QWORD_ADDRS
+
+/* four ways per compare, ASSOC is a multiple of 4 */
+__attribute__((target("sse2")))
+static int
+find_sse2(const md_addr_t *tags, int assoc, md_addr_t key)
 {
-  struct cache_blk_t *prev, *ent;
-  int index = CACHE_HASH(cp, blk->tag);
+  __m128i k = _mm_set1_epi32(key), m = _mm_set1_epi32(~CACHE_BLK_DIRTY);
+  int i, r;
 
-  /* locate the block in the hash table bucket chain */
-  for (prev=NULL,ent=set->hash[index];
-       ent;
-       prev=ent,ent=ent->hash_next)
+  for (i = 0; i < assoc; i += 4)
     {
-      if (ent == blk)
-	break;
+      r = _mm_movemask_ps(_mm_castsi128_ps(
+	    _mm_cmpeq_epi32(_mm_and_si128(
+	      _mm_loadu_si128((const __m128i *)(tags + i)), m), k)));
+      if (r)
+	return i + __builtin_ctz(r);
     }
-  assert(ent);
+  return -1;
+}
+
+/* eight ways per compare, ASSOC is a multiple of 8 */
+__attribute__((target("avx2")))
+static int
+find_avx2(const md_addr_t *tags, int assoc, md_addr_t key)
+{
+  __m256i k = _mm256_set1_epi32(key), m = _mm256_set1_epi32(~CACHE_BLK_DIRTY);
+  int i, r;
 
-  /* unlink the block from the hash table bucket chain */
-  if (!prev)
+  for (i = 0; i < assoc; i += 8)
     {
-      /* head of hash bucket list */
-      set->hash[index] = ent->hash_next;
+      r = _mm256_movemask_ps(_mm256_castsi256_ps(
+	    _mm256_cmpeq_epi32(_mm256_and_si256(
+	      _mm256_loadu_si256((const __m256i *)(tags + i)), m), k)));
+      if (r)
+	return i + __builtin_ctz(r);
     }
-  else
+  return -1;
+}
+
+#else /* MD_QWORD_ADDRS */
+
+/* two ways per compare, ASSOC is a multiple of 2 */
+__attribute__((target("sse4.1")))
+static int
+find_sse41(const md_addr_t *tags, int assoc, md_addr_t key)
+{
+  __m128i k = _mm_set1_epi64x(key), m = _mm_set1_epi64x(~CACHE_BLK_DIRTY);
+  int i, r;
+
+  for (i = 0; i < assoc; i += 2)
     {
-      /* middle or end of hash bucket list */
-      prev->hash_next = ent->hash_next;
+      r = _mm_movemask_pd(_mm_castsi128_pd(
+	    _mm_cmpeq_epi64(_mm_and_si128(
+	      _mm_loadu_si128((const __m128i *)(tags + i)), m), k)));
+      if (r)
+	return i + __builtin_ctz(r);
     }
-  ent->hash_next = NULL;
+  return -1;
 }
 
-/* insert BLK onto the head of the hash table bucket chain in SET */
-static void
-link_htab_ent(struct cache_t *cp,		/* cache to update */
-	      struct cache_set_t *set,		/* set containing bkt chain */
-	      struct cache_blk_t *blk)		/* block to insert */
+/* four ways per compare, ASSOC is a multiple of 4 */
+__attribute__((target("avx2")))
+static int
+find_avx2(const md_addr_t *tags, int assoc, md_addr_t key)
 {
-  int index = CACHE_HASH(cp, blk->tag);
+  __m256i k = _mm256_set1_epi64x(key), m = _mm256_set1_epi64x(~CACHE_BLK_DIRTY);
+  int i, r;
 
-  /* insert block onto the head of the bucket chain */
-  blk->hash_next = set->hash[index];
-  set->hash[index] = blk;
+  for (i = 0; i < assoc; i += 4)
+    {
+      r = _mm256_movemask_pd(_mm256_castsi256_pd(
+	    _mm256_cmpeq_epi64(_mm256_and_si256(
+	      _mm256_loadu_si256((const __m256i *)(tags + i)), m), k)));
+      if (r)
+	return i + __builtin_ctz(r);
+    }
+  return -1;
 }
 
-/* where to insert a block onto the ordered way chain */
+#endif /* MD_QWORD_ADDRS */
+
+#endif /* CACHE_X86 */
+
+/* where to move a way in the replacement order of its set */
 enum list_loc_t { Head, Tail };
 
-/* insert BLK into the order way chain in SET at location WHERE */
+/* move WAY to location WHERE in the replacement order ORDER of a set of
+   ASSOC ways */
 static void
-update_way_list(struct cache_set_t *set,	/* set contained way chain */
-		struct cache_blk_t *blk,	/* block to insert */
-		enum list_loc_t where)		/* insert location */
+update_way_order(half_t *order,		/* replacement order of the set */
+		 int assoc,		/* ways in the set */
+		 int way,		/* way to move */
+		 enum list_loc_t where)	/* move location */
 {
-  /* unlink entry from the way list */
-  if (!blk->way_prev && !blk->way_next)
-    {
-      /* only one entry in list (direct-mapped), no action */
-      assert(set->way_head == blk && set->way_tail == blk);
-      /* Head/Tail order already */
-      return;
-    }
-  /* else, more than one element in the list */
-  else if (!blk->way_prev)
-    {
-      assert(set->way_head == blk && set->way_tail != blk);
-      if (where == Head)
-	{
-	  /* already there */
-	  return;
-	}
-      /* else, move to tail */
-      set->way_head = blk->way_next;
-      blk->way_next->way_prev = NULL;
-    }
-  else if (!blk->way_next)
-    {
-      /* end of list (and not front of list) */
-      assert(set->way_head != blk && set->way_tail == blk);
-      if (where == Tail)
-	{
-	  /* already there */
-	  return;
-	}
-      set->way_tail = blk->way_prev;
-      blk->way_prev->way_next = NULL;
-    }
-  else
-    {
-      /* middle of list (and not front or end of list) */
-      assert(set->way_head != blk && set->way_tail != blk);
-      blk->way_prev->way_next = blk->way_next;
-      blk->way_next->way_prev = blk->way_prev;
-    }
+  int i;
+
+  /* locate the way in the order */
+  for (i = 0; i < assoc && order[i] != way; i++)
+    /* nada */;
+  assert(i < assoc);
 
-  /* link BLK back into the list */
   if (where == Head)
     {
-      /* link to the head of the way list */
-      blk->way_next = set->way_head;
-      blk->way_prev = NULL;
-      set->way_head->way_prev = blk;
-      set->way_head = blk;
+      /* shift the ways used since down, this way becomes the MRU way */
+      memmove(&order[1], &order[0], i * sizeof(half_t));
+      order[0] = way;
     }
   else if (where == Tail)
     {
-      /* link to the tail of the way list */
-      blk->way_prev = set->way_tail;
-      blk->way_next = NULL;
-      set->way_tail->way_next = blk;
-      set->way_tail = blk;
+      /* shift the ways used before up, this way becomes the LRU way */
+      memmove(&order[i], &order[i+1], (assoc - 1 - i) * sizeof(half_t));
+      order[assoc - 1] = way;
     }
   else
     panic("bogus WHERE designator");
@@ -292,12 +316,14 @@ cache_create(char *name,		/* name of the cache */
     fatal("cache associativity `%d' must be non-zero and positive", assoc);
   if ((assoc & (assoc-1)) != 0)
     fatal("cache associativity `%d' must be a power of two", assoc);
+  if (assoc > CACHE_MAX_ASSOC)
+    fatal("cache associativity `%d' must be at most %d",
+	  assoc, CACHE_MAX_ASSOC);
   if (!blk_access_fn)
     fatal("must specify miss/replacement functions");
 
   /* allocate the cache structure */
-  cp = (struct cache_t *)
-    calloc(1, sizeof(struct cache_t) + (nsets-1)*sizeof(struct cache_set_t));
+  cp = (struct cache_t *)calloc(1, sizeof(struct cache_t));
   if (!cp)
     fatal("out of virtual memory");
 
@@ -315,7 +341,6 @@ cache_create(char *name,		/* name of the cache */
   cp->blk_access_fn = blk_access_fn;
 
   /* compute derived parameters */
-  cp->hsize = CACHE_HIGHLY_ASSOC(cp) ? (assoc >> 2) : 0;
   cp->blk_mask = bsize-1;
   cp->set_shift = log_base2(bsize);
   cp->set_mask = nsets-1;
@@ -325,7 +350,6 @@ cache_create(char *name,		/* name of the cache */
   cp->bus_free = 0;
 
   /* print derived parameters during debug */
-  debug("%s: cp->hsize     = %d", cp->name, cp->hsize);
   debug("%s: cp->blk_mask  = 0x%08x", cp->name, cp->blk_mask);
   debug("%s: cp->set_shift = %d", cp->name, cp->set_shift);
   debug("%s: cp->set_mask  = 0x%08x", cp->name, cp->set_mask);
@@ -340,8 +364,32 @@ cache_create(char *name,		/* name of the cache */
   cp->invalidations = 0;
 
   /* blow away the last block accessed */
-  cp->last_tagset = 0;
-  cp->last_blk = NULL;
+  cp->last_tagset = CACHE_NO_TAGSET;
+  cp->last_way = -1;
+
+  /* allocate the tag store, all blocks start out invalid */
+  cp->tags = (md_addr_t *)calloc(nsets * assoc, sizeof(md_addr_t));
+  cp->ready = (tick_t *)calloc(nsets * assoc, sizeof(tick_t));
+  cp->order = (half_t *)calloc(nsets * assoc, sizeof(half_t));
+  if (!cp->tags || !cp->ready || !cp->order)
+    fatal("out of virtual memory");
+
+  /* pick the widest way compare the host supports */
+  cp->find = find_c;
+#ifdef CACHE_X86
+  __builtin_cpu_init();
+#ifndef MD_QWORD_ADDRS
+  if (assoc >= 8 && __builtin_cpu_supports("avx2"))
+    cp->find = find_avx2;
+  else if (assoc >= 4 && __builtin_cpu_supports("sse2"))
+    cp->find = find_sse2;
+#else /* MD_QWORD_ADDRS */
+  if (assoc >= 4 && __builtin_cpu_supports("avx2"))
+    cp->find = find_avx2;
+  else if (assoc >= 2 && __builtin_cpu_supports("sse4.1"))
+    cp->find = find_sse41;
+#endif /* MD_QWORD_ADDRS */
+#endif /* CACHE_X86 */
 
   /* allocate data blocks */
   cp->data = (byte_t *)calloc(nsets * assoc,
@@ -350,57 +398,140 @@ cache_create(char *name,		/* name of the cache */
   if (!cp->data)
     fatal("out of virtual memory");
 
-  /* slice up the data blocks */
+  /* NOTE: all the blocks in a set *must* be allocated contiguously, block
+     BINDEX is way BINDEX % ASSOC of set BINDEX / ASSOC */
   for (bindex=0,i=0; i<nsets; i++)
     {
-      cp->sets[i].way_head = NULL;
-      cp->sets[i].way_tail = NULL;
-      /* get a hash table, if needed */
-      if (cp->hsize)
-	{
-	  cp->sets[i].hash =
-	    (struct cache_blk_t **)calloc(cp->hsize,
-					  sizeof(struct cache_blk_t *));
-	  if (!cp->sets[i].hash)
-	    fatal("out of virtual memory");
-	}
-      /* NOTE: all the blocks in a set *must* be allocated contiguously,
-	 otherwise, block accesses through SET->BLKS will fail (used
-	 during random replacement selection) */
-      cp->sets[i].blks = CACHE_BINDEX(cp, cp->data, bindex);
-      
-      /* link the data blocks into ordered way chain and hash table bucket
-         chains, if hash table exists */
       for (j=0; j<assoc; j++)
 	{
 	  /* locate next cache block */
 	  blk = CACHE_BINDEX(cp, cp->data, bindex);
-	  bindex++;
-
-	  /* invalidate new cache block */
-	  blk->status = 0;
-	  blk->tag = 0;
-	  blk->ready = 0;
 	  blk->user_data = (usize != 0
 			    ? (byte_t *)calloc(usize, sizeof(byte_t)) : NULL);
 
-	  /* insert cache block into set hash table */
-	  if (cp->hsize)
-	    link_htab_ent(cp, &cp->sets[i], blk);
-
-	  /* insert into head of way list, order is arbitrary at this point */
-	  blk->way_next = cp->sets[i].way_head;
-	  blk->way_prev = NULL;
-	  if (cp->sets[i].way_head)
-	    cp->sets[i].way_head->way_prev = blk;
-	  cp->sets[i].way_head = blk;
-	  if (!cp->sets[i].way_tail)
-	    cp->sets[i].way_tail = blk;
+	  /* replacement order is arbitrary at this point, the last way is
+	     the first to be used */
+	  cp->order[bindex] = assoc - 1 - j;
+	  bindex++;
 	}
     }
   return cp;
 }
 
+/* give cache CP NENTRIES MSHRs of NTARGETS targets each, limiting its
+   outstanding misses, NENTRIES of 0 lifts the limit */
+void
+cache_set_mshrs(struct cache_t *cp,	/* cache instance */
+		int nentries,		/* number of MSHRs */
+		int ntargets)		/* accesses merged into each MSHR */
+{
+  if (nentries < 0)
+    fatal("cache: %s: number of MSHRs `%d' must be non-negative",
+	  cp->name, nentries);
+  if (nentries > 0 && ntargets < 1)
+    fatal("cache: %s: MSHR targets `%d' must be at least 1",
+	  cp->name, ntargets);
+
+  if (cp->mshrs)
+    free(cp->mshrs);
+  cp->mshrs = NULL;
+  cp->mshr_nentries = nentries;
+  cp->mshr_ntargets = ntargets;
+  cp->mshr_last_stall = -1;
+  if (nentries)
+    {
+      /* all MSHRs start out free */
+      cp->mshrs = (struct cache_mshr_t *)
+	calloc(nentries, sizeof(struct cache_mshr_t));
+      if (!cp->mshrs)
+	fatal("out of virtual memory");
+    }
+}
+
+/* give cache CP a CLASS hardware prefetcher, of NENTRIES RPT entries or
+   stream buffers, prefetching DEGREE blocks ahead, throttled to its
+   accuracy if THROTTLE is non-zero */
+void
+cache_set_prefetcher(struct cache_t *cp,/* cache instance */
+		     enum cache_pf_class class,/* type of prefetcher */
+		     int nentries,	/* RPT entries or stream buffers */
+		     int degree,	/* blocks prefetched ahead */
+		     int throttle)	/* adapt degree to accuracy? */
+{
+  struct cache_pf_t *pf;
+  int i;
+
+  if (cp->pf)
+    fatal("cache: %s: cache already has a prefetcher", cp->name);
+  if (degree < 1)
+    fatal("cache: %s: prefetch degree `%d' must be at least 1",
+	  cp->name, degree);
+
+  switch (class) {
+  case PF_NextLine:
+    break;
+  case PF_Stride:
+    if (nentries <= 0 || (nentries & (nentries-1)) != 0)
+      fatal("cache: %s: RPT size `%d' must be a non-zero power of two",
+	    cp->name, nentries);
+    break;
+  case PF_Stream:
+    if (nentries <= 0)
+      fatal("cache: %s: number of stream buffers `%d' must be non-zero",
+	    cp->name, nentries);
+    /* stream buffers hold no block data */
+    if (cp->balloc || cp->usize)
+      fatal("cache: %s: stream buffers need a cache without block data",
+	    cp->name);
+    break;
+  default:
+    panic("bogus prefetcher class");
+  }
+
+  pf = (struct cache_pf_t *)calloc(1, sizeof(struct cache_pf_t));
+  if (!pf)
+    fatal("out of virtual memory");
+  pf->class = class;
+  pf->nentries = nentries;
+  pf->degree = degree;
+  pf->cur_degree = degree;
+  pf->throttle = throttle;
+
+  if (class == PF_Stream)
+    {
+      /* all stream buffers start out empty */
+      pf->streams = (struct cache_stream_t *)
+	calloc(nentries, sizeof(struct cache_stream_t));
+      if (!pf->streams)
+	fatal("out of virtual memory");
+      for (i=0; i<nentries; i++)
+	{
+	  pf->streams[i].baddrs =
+	    (md_addr_t *)calloc(degree, sizeof(md_addr_t));
+	  pf->streams[i].ready = (tick_t *)calloc(degree, sizeof(tick_t));
+	  if (!pf->streams[i].baddrs || !pf->streams[i].ready)
+	    fatal("out of virtual memory");
+	}
+    }
+  else
+    {
+      /* prefetch into the cache, tracking the prefetched blocks */
+      pf->prefetched = (byte_t *)calloc(cp->nsets * cp->assoc,
+					 sizeof(byte_t));
+      if (!pf->prefetched)
+	fatal("out of virtual memory");
+      if (class == PF_Stride)
+	{
+	  pf->rpt = (struct cache_rpt_ent_t *)
+	    calloc(nentries, sizeof(struct cache_rpt_ent_t));
+	  if (!pf->rpt)
+	    fatal("out of virtual memory");
+	}
+    }
+
+  cp->pf = pf;
+}
+
 /* parse policy */
 enum cache_policy			/* replacement policy enum */
 cache_char2policy(char c)		/* replacement policy as a char */
@@ -413,6 +544,21 @@ cache_char2policy(char c)		/* replacement policy as a char */
   }
 }
 
+/* parse prefetcher type */
+enum cache_pf_class			/* prefetcher type enum */
+cache_str2pf(char *s)			/* prefetcher type as a string */
+{
+  if (!mystricmp(s, "next"))
+    return PF_NextLine;
+  else if (!mystricmp(s, "stride"))
+    return PF_Stride;
+  else if (!mystricmp(s, "stream"))
+    return PF_Stream;
+
+  fatal("bogus prefetcher type, `%s'", s);
+  return PF_NUM;
+}
+
 /* print cache configuration */
 void
 cache_config(struct cache_t *cp,	/* cache instance */
@@ -428,6 +574,31 @@ cache_config(struct cache_t *cp,	/* cache instance */
 	  : cp->policy == Random ? "Random"
 	  : cp->policy == FIFO ? "FIFO"
 	  : (abort(), ""));
+  if (cp->mshr_nentries)
+    fprintf(stream,
+	    "cache: %s: %d MSHRs, %d targets/MSHR\n",
+	    cp->name, cp->mshr_nentries, cp->mshr_ntargets);
+  if (cp->pf)
+    {
+      switch (cp->pf->class) {
+      case PF_NextLine:
+	fprintf(stream, "cache: %s: next-line prefetcher, %d blocks ahead",
+		cp->name, cp->pf->degree);
+	break;
+      case PF_Stride:
+	fprintf(stream,
+		"cache: %s: stride prefetcher, %d-entry RPT, %d blocks ahead",
+		cp->name, cp->pf->nentries, cp->pf->degree);
+	break;
+      case PF_Stream:
+	fprintf(stream, "cache: %s: %d stream buffers of %d blocks",
+		cp->name, cp->pf->nentries, cp->pf->degree);
+	break;
+      default:
+	panic("bogus prefetcher class");
+      }
+      fprintf(stream, "%s\n", cp->pf->throttle ? ", throttled" : "");
+    }
 }
 
 /* register cache stats */
@@ -471,6 +642,95 @@ cache_reg_stats(struct cache_t *cp,	/* cache instance */
   sprintf(buf, "%s.inv_rate", name);
   sprintf(buf1, "%s.invalidations / %s.accesses", name, name);
   stat_reg_formula(sdb, buf, "invalidation rate (i.e., invs/ref)", buf1, NULL);
+
+  if (cp->mshr_nentries)
+    {
+      sprintf(buf, "%s.mshr_merges", name);
+      stat_reg_counter(sdb, buf, "total number of misses merged into an MSHR",
+		       &cp->mshr_merges, 0, NULL);
+      sprintf(buf, "%s.mshr_target_stalls", name);
+      stat_reg_counter(sdb, buf,
+		       "total number of misses retried, MSHR targets full",
+		       &cp->mshr_target_stalls, 0, NULL);
+      sprintf(buf, "%s.mshr_full_stalls", name);
+      stat_reg_counter(sdb, buf, "total number of misses retried, MSHRs full",
+		       &cp->mshr_full_stalls, 0, NULL);
+      sprintf(buf, "%s.mshr_stall_cycles", name);
+      stat_reg_counter(sdb, buf,
+		       "total cycles with an access retried for an MSHR",
+		       &cp->mshr_stall_cycles, 0, NULL);
+      sprintf(buf, "%s.mshr_queued", name);
+      stat_reg_counter(sdb, buf,
+		       "total number of unprobed misses queued, MSHRs full",
+		       &cp->mshr_queued, 0, NULL);
+      sprintf(buf, "%s.mshr_queue_cycles", name);
+      stat_reg_counter(sdb, buf,
+		       "total cycles unprobed misses queued for an MSHR",
+		       &cp->mshr_queue_cycles, 0, NULL);
+      sprintf(buf, "%s.mshr_busy_cycles", name);
+      stat_reg_counter(sdb, buf, "cumulative MSHR occupancy (MSHR-cycles)",
+		       &cp->mshr_busy_cycles, 0, NULL);
+      sprintf(buf, "%s.mshr_occ_at_miss", name);
+      cp->mshr_occ = stat_reg_dist(sdb, buf, "busy MSHRs seen by each miss",
+				   /* initial value */0,
+				   /* array size */cp->mshr_nentries + 1,
+				   /* bucket size */1,
+				   /* print format */(PF_COUNT|PF_PDF),
+				   /* format */NULL, /* index map */NULL,
+				   /* print fn */NULL);
+    }
+
+  if (cp->pf)
+    {
+      sprintf(buf, "%s.pf_issued", name);
+      stat_reg_counter(sdb, buf, "total number of prefetches issued",
+		       &cp->pf->issued, 0, NULL);
+      sprintf(buf, "%s.pf_useful", name);
+      stat_reg_counter(sdb, buf,
+		       "total number of prefetched blocks accessed on demand",
+		       &cp->pf->useful, 0, NULL);
+      sprintf(buf, "%s.pf_late", name);
+      stat_reg_counter(sdb, buf,
+		       "total number of prefetched blocks accessed in flight",
+		       &cp->pf->late, 0, NULL);
+      sprintf(buf, "%s.pf_useless", name);
+      stat_reg_counter(sdb, buf,
+		       "total number of prefetched blocks discarded unused",
+		       &cp->pf->useless, 0, NULL);
+      sprintf(buf, "%s.pf_dropped", name);
+      stat_reg_counter(sdb, buf,
+		       "total number of prefetches dropped, no free MSHR",
+		       &cp->pf->dropped, 0, NULL);
+      sprintf(buf, "%s.pf_accuracy", name);
+      sprintf(buf1, "%s.pf_useful / %s.pf_issued", name, name);
+      stat_reg_formula(sdb, buf, "prefetch accuracy (i.e., useful/issued)",
+		       buf1, NULL);
+      sprintf(buf, "%s.pf_coverage", name);
+      if (cp->pf->class == PF_Stream)
+	/* misses served from stream buffers are still misses */
+	sprintf(buf1, "%s.pf_useful / %s.misses", name, name);
+      else
+	sprintf(buf1, "%s.pf_useful / (%s.pf_useful + %s.misses)",
+		name, name, name);
+      stat_reg_formula(sdb, buf,
+		       "prefetch coverage (i.e., useful/(misses w/o prefetch))",
+		       buf1, NULL);
+      sprintf(buf, "%s.pf_late_rate", name);
+      sprintf(buf1, "%s.pf_late / %s.pf_useful", name, name);
+      stat_reg_formula(sdb, buf, "late prefetch rate (i.e., late/useful)",
+		       buf1, NULL);
+      if (cp->pf->throttle)
+	{
+	  sprintf(buf, "%s.pf_throttle_ups", name);
+	  stat_reg_counter(sdb, buf,
+			   "total number of prefetch degree increases",
+			   &cp->pf->throttle_ups, 0, NULL);
+	  sprintf(buf, "%s.pf_throttle_downs", name);
+	  stat_reg_counter(sdb, buf,
+			   "total number of prefetch degree decreases",
+			   &cp->pf->throttle_downs, 0, NULL);
+	}
+    }
 }
 
 /* print cache stats */
@@ -491,6 +751,466 @@ cache_stats(struct cache_t *cp,		/* cache instance */
 	  (double)cp->invalidations/sum);
 }
 
+/* claim an MSHR of CP for a miss at NOW; callers that did not check
+   cache_mshr_free() first (e.g., misses from the level above) may find all
+   MSHRs busy, such a miss queues for the first busy MSHR to complete and
+   the wait is added to *LAT */
+static struct cache_mshr_t *		/* MSHR claimed */
+mshr_alloc(struct cache_t *cp,		/* cache missed in */
+	   tick_t now,			/* time of the miss */
+	   int *lat)			/* latency of the miss so far */
+{
+  struct cache_mshr_t *m, *free_m = NULL, *first = NULL;
+  int i, busy = 0;
+
+  for (i=0; i<cp->mshr_nentries; i++)
+    {
+      m = &cp->mshrs[i];
+      if (m->ready > now)
+	{
+	  busy++;
+	  if (!first || m->ready < first->ready)
+	    first = m;
+	}
+      else if (!free_m)
+	free_m = m;
+    }
+  if (cp->mshr_occ)
+    stat_add_sample(cp->mshr_occ, busy);
+
+  if (free_m)
+    return free_m;
+
+  /* all MSHRs busy, queue for the first to complete */
+  cp->mshr_queued++;
+  cp->mshr_queue_cycles += first->ready - now;
+  *lat += BOUND_POS(first->ready - now);
+  return first;
+}
+
+/* the MSHR of CP fetching block BADDR at NOW, or NULL */
+static struct cache_mshr_t *		/* MSHR of the fetch */
+mshr_find(struct cache_t *cp,		/* cache instance */
+	  md_addr_t baddr,		/* block address being fetched */
+	  tick_t now)			/* time of access */
+{
+  int i;
+
+  for (i=0; i<cp->mshr_nentries; i++)
+    if (cp->mshrs[i].ready > now && cp->mshrs[i].baddr == baddr)
+      return &cp->mshrs[i];
+  return NULL;
+}
+
+/* an access at NOW to block BADDR of CP, still being fetched, merges into
+   the fetch's MSHR, returns the extra latency of waiting for the fill and
+   retrying if all the MSHR's targets are taken */
+static int				/* extra latency */
+mshr_merge(struct cache_t *cp,		/* cache accessed */
+	   md_addr_t baddr,		/* block address accessed */
+	   tick_t now)			/* time of access */
+{
+  struct cache_mshr_t *m = mshr_find(cp, baddr, now);
+
+  /* no MSHR, the block was filled by a write or an invalidation */
+  if (!m)
+    return 0;
+
+  if (m->targets < cp->mshr_ntargets)
+    {
+      m->targets++;
+      cp->mshr_merges++;
+      return 0;
+    }
+  cp->mshr_target_stalls++;
+  return cp->hit_latency;
+}
+
+/* return non-zero if an access to ADDR at NOW can proceed without waiting
+   for an MSHR of CP, i.e., it hits, merges into a pending fetch with a
+   target to spare, or misses with an MSHR free; an access refused counts
+   as a stall and should be retried at a later cycle */
+int					/* non-zero if access can proceed */
+cache_mshr_free(struct cache_t *cp,	/* cache instance */
+		md_addr_t addr,		/* address of access */
+		tick_t now)		/* time of access */
+{
+  int i, way, base = (int)CACHE_SET(cp, addr) * cp->assoc;
+  struct cache_mshr_t *m;
+
+  if (!cp->mshrs)
+    return TRUE;
+
+  way = cp->find(&cp->tags[base], cp->assoc, CACHE_KEY(cp, addr));
+  if (way >= 0)
+    {
+      /* a hit, or a merge into the pending fetch */
+      if (cp->ready[base + way] <= now)
+	return TRUE;
+      m = mshr_find(cp, CACHE_BADDR(cp, addr), now);
+      if (!m || m->targets < cp->mshr_ntargets)
+	return TRUE;
+      cp->mshr_target_stalls++;
+    }
+  else
+    {
+      /* a miss, which needs a free MSHR */
+      for (i=0; i<cp->mshr_nentries; i++)
+	if (cp->mshrs[i].ready <= now)
+	  return TRUE;
+      cp->mshr_full_stalls++;
+    }
+
+  /* count each cycle with a refused access once */
+  if (cp->mshr_last_stall != now)
+    {
+      cp->mshr_stall_cycles++;
+      cp->mshr_last_stall = now;
+    }
+  return FALSE;
+}
+
+/* select the way of a set of CP to replace, given the set's replacement
+   order ORDER, and move it to the appropriate place in the order */
+static int				/* way to replace */
+repl_way(struct cache_t *cp,		/* cache instance */
+	 half_t *order)			/* replacement order of the set */
+{
+  int way;
+
+  switch (cp->policy) {
+  case LRU:
+  case FIFO:
+    way = order[cp->assoc - 1];
+    memmove(&order[1], &order[0], (cp->assoc - 1) * sizeof(half_t));
+    order[0] = way;
+    break;
+  case Random:
+    way = myrand() & (cp->assoc - 1);
+    break;
+  default:
+    panic("bogus replacement policy");
+  }
+  return way;
+}
+
+/* block BINDEX of CP is replaced or invalidated, a prefetched block that
+   was never accessed was a useless prefetch */
+static void
+pf_discard(struct cache_t *cp,		/* cache instance */
+	   int bindex)			/* block index */
+{
+  struct cache_pf_t *pf = cp->pf;
+
+  if (pf->prefetched && pf->prefetched[bindex])
+    {
+      pf->useless++;
+      pf->prefetched[bindex] = 0;
+    }
+}
+
+/* prefetch block BADDR into CP at NOW, unless it is there (or on its way)
+   already */
+static void
+pf_fill(struct cache_t *cp,		/* cache instance */
+	md_addr_t baddr,		/* block address to prefetch */
+	tick_t now)			/* time of prefetch */
+{
+  struct cache_pf_t *pf = cp->pf;
+  int base = (int)CACHE_SET(cp, baddr) * cp->assoc;
+  md_addr_t *tags = &cp->tags[base];
+  struct cache_mshr_t *mshr = NULL;
+  struct cache_blk_t *blk;
+  int i, way, lat = 0;
+
+  if (cp->find(tags, cp->assoc, CACHE_KEY(cp, baddr)) >= 0)
+    return;
+
+  /* a prefetch takes a free MSHR, never waits for one */
+  if (cp->mshrs)
+    {
+      for (i=0; i<cp->mshr_nentries && cp->mshrs[i].ready > now; i++)
+	/* nada */;
+      if (i == cp->mshr_nentries)
+	{
+	  pf->dropped++;
+	  return;
+	}
+      mshr = &cp->mshrs[i];
+    }
+
+  way = repl_way(cp, &cp->order[base]);
+  blk = CACHE_BINDEX(cp, cp->data, base + way);
+
+  if (tags[way] & CACHE_BLK_VALID)
+    {
+      pf_discard(cp, base + way);
+
+      /* blow away the last block to hit, if it is replaced */
+      if ((tags[way] & cp->tagset_mask) == cp->last_tagset)
+	{
+	  cp->last_tagset = CACHE_NO_TAGSET;
+	  cp->last_way = -1;
+	}
+
+      /* don't replace the block until outstanding misses are satisfied */
+      lat += BOUND_POS(cp->ready[base + way] - now);
+    }
+
+  /* stall until the bus to next level of memory is available */
+  lat += BOUND_POS(cp->bus_free - (now + lat));
+
+  /* track bus resource usage */
+  cp->bus_free = MAX(cp->bus_free, (now + lat)) + 1;
+
+  if (tags[way] & CACHE_BLK_DIRTY)
+    {
+      /* write back the replaced block */
+      cp->writebacks++;
+      lat += cp->blk_access_fn(Write, CACHE_TAG_BADDR(tags[way]),
+			       cp->bsize, blk, now+lat);
+    }
+
+  /* fetch the block, accessible when it arrives */
+  tags[way] = CACHE_KEY(cp, baddr);
+  lat += cp->blk_access_fn(Read, baddr, cp->bsize, blk, now+lat);
+  cp->ready[base + way] = now+lat;
+  pf->prefetched[base + way] = 1;
+  pf->issued++;
+  pf->int_issued++;
+
+  /* the MSHR is busy until the block arrives, with no accesses waiting */
+  if (mshr)
+    {
+      cp->mshr_busy_cycles += lat;
+      mshr->baddr = baddr;
+      mshr->ready = now+lat;
+      mshr->targets = 0;
+    }
+}
+
+/* top up stream buffer S of CP at NOW to the current prefetch degree */
+static void
+pf_stream_fetch(struct cache_t *cp,	/* cache instance */
+		struct cache_stream_t *s,/* stream buffer */
+		tick_t now)		/* time of prefetch */
+{
+  struct cache_pf_t *pf = cp->pf;
+  struct cache_mshr_t *mshr = NULL;
+  int i, lat;
+
+  while (s->count < pf->cur_degree)
+    {
+      /* a prefetch takes a free MSHR, never waits for one */
+      if (cp->mshrs)
+	{
+	  for (i=0; i<cp->mshr_nentries && cp->mshrs[i].ready > now; i++)
+	    /* nada */;
+	  if (i == cp->mshr_nentries)
+	    {
+	      /* dropped, the buffer fills no further until its next hit */
+	      pf->dropped++;
+	      return;
+	    }
+	  mshr = &cp->mshrs[i];
+	}
+
+      /* stall until the bus to next level of memory is available */
+      lat = BOUND_POS(cp->bus_free - now);
+
+      /* track bus resource usage */
+      cp->bus_free = MAX(cp->bus_free, now) + 1;
+
+      /* the buffer holds no block data, there is no block to fill */
+      i = (s->head + s->count) % pf->degree;
+      s->baddrs[i] = s->next;
+      s->ready[i] = now + lat
+	+ cp->blk_access_fn(Read, s->next, cp->bsize, NULL, now + lat);
+      pf->issued++;
+      pf->int_issued++;
+
+      /* the MSHR is busy until the block arrives, with no accesses
+	 waiting */
+      if (mshr)
+	{
+	  cp->mshr_busy_cycles += s->ready[i] - now;
+	  mshr->baddr = s->next;
+	  mshr->ready = s->ready[i];
+	  mshr->targets = 0;
+	}
+
+      s->count++;
+      s->next += cp->bsize;
+    }
+}
+
+/* read block BADDR of a miss in CP at NOW from a stream buffer, or from
+   the next level of memory into BLK if no stream buffer holds it, then
+   starting a stream of the blocks after it in the LRU stream buffer,
+   returns the latency of the read */
+static int				/* latency of block read */
+pf_stream_read(struct cache_t *cp,	/* cache instance */
+	       md_addr_t baddr,		/* block address missed */
+	       struct cache_blk_t *blk,	/* block to fill */
+	       tick_t now)		/* time of read */
+{
+  struct cache_pf_t *pf = cp->pf;
+  struct cache_stream_t *s, *lru = NULL;
+  int i, j, k, lat;
+
+  for (i=0; i<pf->nentries; i++)
+    {
+      s = &pf->streams[i];
+      for (j=0; j<s->count; j++)
+	{
+	  k = (s->head + j) % pf->degree;
+	  if (s->baddrs[k] != baddr)
+	    continue;
+
+	  /* a stream buffer hit, the blocks ahead of it were skipped */
+	  pf->useless += j;
+	  pf->useful++;
+	  pf->int_useful++;
+	  if (s->ready[k] > now)
+	    pf->late++;
+	  lat = MAX((int)cp->hit_latency, BOUND_POS(s->ready[k] - now));
+
+	  /* the block moves into the cache, the stream goes on */
+	  s->head = (k + 1) % pf->degree;
+	  s->count -= j + 1;
+	  s->last_use = now;
+	  pf_stream_fetch(cp, s, now);
+	  return lat;
+	}
+      if (!lru || s->last_use < lru->last_use)
+	lru = s;
+    }
+
+  /* read the block from the next level of memory */
+  lat = cp->blk_access_fn(Read, baddr, cp->bsize, blk, now);
+
+  /* and replace the LRU stream with one of the blocks after it */
+  pf->useless += lru->count;
+  lru->head = 0;
+  lru->count = 0;
+  lru->next = baddr + cp->bsize;
+  lru->last_use = now;
+  pf_stream_fetch(cp, lru, now);
+
+  return lat;
+}
+
+/* lower the degree of prefetcher PF if too few of the last interval's
+   prefetches were used, raise it if most were, after feedback-directed
+   prefetching (Srinath et al.) */
+static void
+pf_throttle(struct cache_pf_t *pf)	/* prefetcher instance */
+{
+  double acc = (double)pf->int_useful / (double)pf->int_issued;
+
+  if (acc < CACHE_PF_ACC_LOW && pf->cur_degree > 1)
+    {
+      pf->cur_degree--;
+      pf->throttle_downs++;
+    }
+  else if (acc >= CACHE_PF_ACC_HIGH && pf->cur_degree < pf->degree)
+    {
+      pf->cur_degree++;
+      pf->throttle_ups++;
+    }
+
+  /* start a new interval */
+  pf->int_issued = 0;
+  pf->int_useful = 0;
+}
+
+/* train the prefetcher of CP on a demand access at NOW to ADDR, found in
+   (or filled into) block BINDEX, MISS is non-zero if it missed, and issue
+   the prefetches it calls for */
+static void
+pf_access(struct cache_t *cp,		/* cache instance */
+	  md_addr_t addr,		/* address of access */
+	  int bindex,			/* block accessed */
+	  int miss,			/* access missed? */
+	  tick_t now)			/* time of access */
+{
+  struct cache_pf_t *pf = cp->pf;
+  struct cache_rpt_ent_t *rpt;
+  md_addr_t baddr = CACHE_BADDR(cp, addr);
+  sword_t stride, step;
+  int i, pf_hit = FALSE;
+
+  /* the first access to a prefetched block makes its prefetch useful */
+  if (pf->prefetched && pf->prefetched[bindex])
+    {
+      pf->prefetched[bindex] = 0;
+      pf->useful++;
+      pf->int_useful++;
+      if (cp->ready[bindex] > now)
+	pf->late++;
+      pf_hit = TRUE;
+    }
+
+  switch (pf->class) {
+  case PF_NextLine:
+    /* tagged, prefetch after misses and first hits to prefetched blocks */
+    if (miss || pf_hit)
+      for (i=1; i<=pf->cur_degree; i++)
+	pf_fill(cp, baddr + i * cp->bsize, now);
+    break;
+
+  case PF_Stride:
+    /* only loads and stores train the table, not instruction fetches */
+    if (!cp->pf_pc)
+      break;
+
+    rpt = &pf->rpt[(cp->pf_pc >> MD_BR_SHIFT) & (pf->nentries - 1)];
+    if (rpt->pc != cp->pf_pc)
+      {
+	/* a new load or store */
+	rpt->pc = cp->pf_pc;
+	rpt->last_addr = addr;
+	rpt->stride = 0;
+	rpt->state = RPT_Initial;
+	break;
+      }
+
+    /* update the stride and its state */
+    stride = (sword_t)(addr - rpt->last_addr);
+    rpt->last_addr = addr;
+    if (stride == rpt->stride)
+      rpt->state = (rpt->state == RPT_NoPred ? RPT_Transient : RPT_Steady);
+    else if (rpt->state == RPT_Steady)
+      rpt->state = RPT_Initial;
+    else
+      {
+	rpt->state = (rpt->state == RPT_Initial ? RPT_Transient : RPT_NoPred);
+	rpt->stride = stride;
+      }
+
+    if (rpt->state != RPT_Steady || rpt->stride == 0)
+      break;
+
+    /* strides within a block prefetch the next blocks in their direction */
+    step = rpt->stride;
+    if (step > -cp->bsize && step < cp->bsize)
+      step = (step < 0 ? -cp->bsize : cp->bsize);
+    for (i=1; i<=pf->cur_degree; i++)
+      pf_fill(cp, CACHE_BADDR(cp, addr + (md_addr_t)(i * step)), now);
+    break;
+
+  case PF_Stream:
+    /* trained on misses only, by pf_stream_read() */
+    break;
+
+  default:
+    panic("bogus prefetcher class");
+  }
+
+  if (pf->throttle && pf->int_issued >= CACHE_PF_INTERVAL)
+    pf_throttle(pf);
+}
+
 /* access a cache, perform a CMD operation on cache CP at address ADDR,
    places NBYTES of data at *P, returns latency of operation if initiated
    at NOW, places pointer to block user data in *UDATA, *P is untouched if
@@ -507,11 +1227,14 @@ cache_access(struct cache_t *cp,	/* cache to access */
 	     md_addr_t *repl_addr)	/* for address of replaced block */
 {
   byte_t *p = vp;
-  md_addr_t tag = CACHE_TAG(cp, addr);
   md_addr_t set = CACHE_SET(cp, addr);
   md_addr_t bofs = CACHE_BLK(cp, addr);
-  struct cache_blk_t *blk, *repl;
-  int lat = 0;
+  int base = (int)set * cp->assoc;
+  md_addr_t *tags = &cp->tags[base];
+  half_t *order = &cp->order[base];
+  struct cache_blk_t *blk;
+  struct cache_mshr_t *mshr = NULL;
+  int way, lat = 0, extra;
 
   /* default replacement address */
   if (repl_addr)
@@ -533,76 +1256,46 @@ cache_access(struct cache_t *cp,	/* cache to access */
   if (CACHE_TAGSET(cp, addr) == cp->last_tagset)
     {
       /* hit in the same block */
-      blk = cp->last_blk;
+      way = cp->last_way;
       goto cache_fast_hit;
     }
-    
-  if (cp->hsize)
-    {
-      /* higly-associativity cache, access through the per-set hash tables */
-      int hindex = CACHE_HASH(cp, tag);
 
-      for (blk=cp->sets[set].hash[hindex];
-	   blk;
-	   blk=blk->hash_next)
-	{
-	  if (blk->tag == tag && (blk->status & CACHE_BLK_VALID))
-	    goto cache_hit;
-	}
-    }
-  else
-    {
-      /* low-associativity cache, linear search the way list */
-      for (blk=cp->sets[set].way_head;
-	   blk;
-	   blk=blk->way_next)
-	{
-	  if (blk->tag == tag && (blk->status & CACHE_BLK_VALID))
-	    goto cache_hit;
-	}
-    }
+  /* compare all the ways of the set at once */
+  way = cp->find(tags, cp->assoc, CACHE_KEY(cp, addr));
+  if (way >= 0)
+    goto cache_hit;
 
   /* cache block not found */
 
   /* **MISS** */
   cp->misses++;
 
-  /* select the appropriate block to replace, and re-link this entry to
-     the appropriate place in the way list */
-  switch (cp->policy) {
-  case LRU:
-  case FIFO:
-    repl = cp->sets[set].way_tail;
-    update_way_list(&cp->sets[set], repl, Head);
-    break;
-  case Random:
-    {
-      int bindex = myrand() & (cp->assoc - 1);
-      repl = CACHE_BINDEX(cp, cp->sets[set].blks, bindex);
-    }
-    break;
-  default:
-    panic("bogus replacement policy");
-  }
+  /* a primary miss needs an MSHR, waiting for one if all are busy */
+  if (cp->mshrs)
+    mshr = mshr_alloc(cp, now, &lat);
 
-  /* remove this block from the hash bucket chain, if hash exists */
-  if (cp->hsize)
-    unlink_htab_ent(cp, &cp->sets[set], repl);
+  /* select the appropriate block to replace, and move it to the
+     appropriate place in the replacement order */
+  way = repl_way(cp, order);
+  blk = CACHE_BINDEX(cp, cp->data, base + way);
 
   /* blow away the last block to hit */
-  cp->last_tagset = 0;
-  cp->last_blk = NULL;
+  cp->last_tagset = CACHE_NO_TAGSET;
+  cp->last_way = -1;
 
   /* write back replaced block data */
-  if (repl->status & CACHE_BLK_VALID)
+  if (tags[way] & CACHE_BLK_VALID)
     {
       cp->replacements++;
 
+      if (cp->pf)
+	pf_discard(cp, base + way);
+
       if (repl_addr)
-	*repl_addr = CACHE_MK_BADDR(cp, repl->tag, set);
+	*repl_addr = CACHE_TAG_BADDR(tags[way]);
  
       /* don't replace the block until outstanding misses are satisfied */
-      lat += BOUND_POS(repl->ready - now);
+      lat += BOUND_POS(cp->ready[base + way] - (now + lat));
  
       /* stall until the bus to next level of memory is available */
       lat += BOUND_POS(cp->bus_free - (now + lat));
@@ -610,44 +1303,54 @@ cache_access(struct cache_t *cp,	/* cache to access */
       /* track bus resource usage */
       cp->bus_free = MAX(cp->bus_free, (now + lat)) + 1;
 
-      if (repl->status & CACHE_BLK_DIRTY)
+      if (tags[way] & CACHE_BLK_DIRTY)
 	{
 	  /* write back the cache block */
 	  cp->writebacks++;
-	  lat += cp->blk_access_fn(Write,
-				   CACHE_MK_BADDR(cp, repl->tag, set),
-				   cp->bsize, repl, now+lat);
+	  lat += cp->blk_access_fn(Write, CACHE_TAG_BADDR(tags[way]),
+				   cp->bsize, blk, now+lat);
 	}
     }
 
   /* update block tags */
-  repl->tag = tag;
-  repl->status = CACHE_BLK_VALID;	/* dirty bit set on update */
+  tags[way] = CACHE_KEY(cp, addr);	/* dirty bit set on update */
 
-  /* read data block */
-  lat += cp->blk_access_fn(Read, CACHE_BADDR(cp, addr), cp->bsize,
-			   repl, now+lat);
+  /* read data block, from a stream buffer if one holds it */
+  if (cp->pf && cp->pf->class == PF_Stream)
+    lat += pf_stream_read(cp, CACHE_BADDR(cp, addr), blk, now+lat);
+  else
+    lat += cp->blk_access_fn(Read, CACHE_BADDR(cp, addr), cp->bsize,
+			     blk, now+lat);
 
   /* copy data out of cache block */
   if (cp->balloc)
     {
-      CACHE_BCOPY(cmd, repl, bofs, p, nbytes);
+      CACHE_BCOPY(cmd, blk, bofs, p, nbytes);
     }
 
   /* update dirty status */
   if (cmd == Write)
-    repl->status |= CACHE_BLK_DIRTY;
+    tags[way] |= CACHE_BLK_DIRTY;
 
   /* get user block data, if requested and it exists */
   if (udata)
-    *udata = repl->user_data;
+    *udata = blk->user_data;
 
   /* update block status */
-  repl->ready = now+lat;
+  cp->ready[base + way] = now+lat;
+
+  /* the MSHR is busy until the block arrives */
+  if (mshr)
+    {
+      cp->mshr_busy_cycles += now + lat - MAX(mshr->ready, now);
+      mshr->baddr = CACHE_BADDR(cp, addr);
+      mshr->ready = now + lat;
+      mshr->targets = 1;
+    }
 
-  /* link this entry back into the hash table */
-  if (cp->hsize)
-    link_htab_ent(cp, &cp->sets[set], repl);
+  /* train the prefetcher, which may prefetch the blocks after this one */
+  if (cp->pf)
+    pf_access(cp, addr, base + way, /* miss */TRUE, now);
 
   /* return latency of the operation */
   return lat;
@@ -661,32 +1364,43 @@ cache_access(struct cache_t *cp,	/* cache to access */
   /* copy data out of cache block, if block exists */
   if (cp->balloc)
     {
+      blk = CACHE_BINDEX(cp, cp->data, base + way);
       CACHE_BCOPY(cmd, blk, bofs, p, nbytes);
     }
 
   /* update dirty status */
   if (cmd == Write)
-    blk->status |= CACHE_BLK_DIRTY;
+    tags[way] |= CACHE_BLK_DIRTY;
 
-  /* if LRU replacement and this is not the first element of list, reorder */
-  if (blk->way_prev && cp->policy == LRU)
+  /* if LRU replacement and this is not the MRU way, reorder */
+  if (order[0] != way && cp->policy == LRU)
     {
-      /* move this block to head of the way (MRU) list */
-      update_way_list(&cp->sets[set], blk, Head);
+      /* move this block to head of the replacement order */
+      update_way_order(order, cp->assoc, way, Head);
     }
 
-  /* tag is unchanged, so hash links (if they exist) are still valid */
-
   /* record the last block to hit */
   cp->last_tagset = CACHE_TAGSET(cp, addr);
-  cp->last_blk = blk;
+  cp->last_way = way;
 
   /* get user block data, if requested and it exists */
   if (udata)
-    *udata = blk->user_data;
+    *udata = CACHE_BINDEX(cp, cp->data, base + way)->user_data;
+
+  /* a miss to a block still being fetched merges into its MSHR */
+  extra = 0;
+  if (cp->mshrs && cp->ready[base + way] > now)
+    extra = mshr_merge(cp, CACHE_BADDR(cp, addr), now);
+
+  /* first cycle data is available to access */
+  lat = (int) MAX(cp->hit_latency, (cp->ready[base + way] - now)) + extra;
+
+  /* train the prefetcher, after which the block may be gone */
+  if (cp->pf)
+    pf_access(cp, addr, base + way, /* miss */FALSE, now);
 
   /* return first cycle data is available to access */
-  return (int) MAX(cp->hit_latency, (blk->ready - now));
+  return lat;
 
  cache_fast_hit: /* fast hit handler */
   
@@ -696,27 +1410,38 @@ cache_access(struct cache_t *cp,	/* cache to access */
   /* copy data out of cache block, if block exists */
   if (cp->balloc)
     {
+      blk = CACHE_BINDEX(cp, cp->data, base + way);
       CACHE_BCOPY(cmd, blk, bofs, p, nbytes);
     }
 
   /* update dirty status */
   if (cmd == Write)
-    blk->status |= CACHE_BLK_DIRTY;
-
-  /* this block hit last, no change in the way list */
+    tags[way] |= CACHE_BLK_DIRTY;
 
-  /* tag is unchanged, so hash links (if they exist) are still valid */
+  /* this block hit last, no change in the replacement order */
 
   /* get user block data, if requested and it exists */
   if (udata)
-    *udata = blk->user_data;
+    *udata = CACHE_BINDEX(cp, cp->data, base + way)->user_data;
 
   /* record the last block to hit */
   cp->last_tagset = CACHE_TAGSET(cp, addr);
-  cp->last_blk = blk;
+  cp->last_way = way;
+
+  /* a miss to a block still being fetched merges into its MSHR */
+  extra = 0;
+  if (cp->mshrs && cp->ready[base + way] > now)
+    extra = mshr_merge(cp, CACHE_BADDR(cp, addr), now);
+
+  /* first cycle data is available to access */
+  lat = (int) MAX(cp->hit_latency, (cp->ready[base + way] - now)) + extra;
+
+  /* train the prefetcher, after which the block may be gone */
+  if (cp->pf)
+    pf_access(cp, addr, base + way, /* miss */FALSE, now);
 
   /* return first cycle data is available to access */
-  return (int) MAX(cp->hit_latency, (blk->ready - now));
+  return lat;
 }
 
 /* return non-zero if block containing address ADDR is contained in cache
@@ -726,39 +1451,12 @@ int					/* non-zero if access would hit */
 cache_probe(struct cache_t *cp,		/* cache instance to probe */
 	    md_addr_t addr)		/* address of block to probe */
 {
-  md_addr_t tag = CACHE_TAG(cp, addr);
   md_addr_t set = CACHE_SET(cp, addr);
-  struct cache_blk_t *blk;
 
   /* permissions are checked on cache misses */
 
-  if (cp->hsize)
-  {
-    /* higly-associativity cache, access through the per-set hash tables */
-    int hindex = CACHE_HASH(cp, tag);
-    
-    for (blk=cp->sets[set].hash[hindex];
-	 blk;
-	 blk=blk->hash_next)
-    {	
-      if (blk->tag == tag && (blk->status & CACHE_BLK_VALID))
-	  return TRUE;
-    }
-  }
-  else
-  {
-    /* low-associativity cache, linear search the way list */
-    for (blk=cp->sets[set].way_head;
-	 blk;
-	 blk=blk->way_next)
-    {
-      if (blk->tag == tag && (blk->status & CACHE_BLK_VALID))
-	  return TRUE;
-    }
-  }
-  
-  /* cache block not found */
-  return FALSE;
+  return cp->find(&cp->tags[set * cp->assoc], cp->assoc,
+		  CACHE_KEY(cp, addr)) >= 0;
 }
 
 /* flush the entire cache, returns latency of the operation */
@@ -766,35 +1464,49 @@ unsigned int				/* latency of the flush operation */
 cache_flush(struct cache_t *cp,		/* cache instance to flush */
 	    tick_t now)			/* time of cache flush */
 {
-  int i, lat = cp->hit_latency; /* min latency to probe cache */
-  struct cache_blk_t *blk;
+  int i, j, bindex, lat = cp->hit_latency; /* min latency to probe cache */
+  md_addr_t tag;
 
   /* blow away the last block to hit */
-  cp->last_tagset = 0;
-  cp->last_blk = NULL;
+  cp->last_tagset = CACHE_NO_TAGSET;
+  cp->last_way = -1;
 
-  /* no way list updates required because all blocks are being invalidated */
+  /* no order updates required because all blocks are being invalidated,
+     blocks are written back in replacement order, MRU first */
   for (i=0; i<cp->nsets; i++)
     {
-      for (blk=cp->sets[i].way_head; blk; blk=blk->way_next)
+      for (j=0; j<cp->assoc; j++)
 	{
-	  if (blk->status & CACHE_BLK_VALID)
+	  bindex = i * cp->assoc + cp->order[i * cp->assoc + j];
+	  tag = cp->tags[bindex];
+	  if (tag & CACHE_BLK_VALID)
 	    {
 	      cp->invalidations++;
-	      blk->status &= ~CACHE_BLK_VALID;
+	      cp->tags[bindex] = 0;
+	      if (cp->pf)
+		pf_discard(cp, bindex);
 
-	      if (blk->status & CACHE_BLK_DIRTY)
+	      if (tag & CACHE_BLK_DIRTY)
 		{
 		  /* write back the invalidated block */
           	  cp->writebacks++;
-		  lat += cp->blk_access_fn(Write,
-					   CACHE_MK_BADDR(cp, blk->tag, i),
-					   cp->bsize, blk, now+lat);
+		  lat += cp->blk_access_fn(Write, CACHE_TAG_BADDR(tag),
+					   cp->bsize,
+					   CACHE_BINDEX(cp, cp->data, bindex),
+					   now+lat);
 		}
 	    }
 	}
     }
 
+  /* the stream buffers are emptied too */
+  if (cp->pf && cp->pf->streams)
+    for (i=0; i<cp->pf->nentries; i++)
+      {
+	cp->pf->useless += cp->pf->streams[i].count;
+	cp->pf->streams[i].count = 0;
+      }
+
   /* return latency of the flush operation */
   return lat;
 }
@@ -806,55 +1518,34 @@ cache_flush_addr(struct cache_t *cp,	/* cache instance to flush */
 		 md_addr_t addr,	/* address of block to flush */
 		 tick_t now)		/* time of cache flush */
 {
-  md_addr_t tag = CACHE_TAG(cp, addr);
   md_addr_t set = CACHE_SET(cp, addr);
-  struct cache_blk_t *blk;
-  int lat = cp->hit_latency; /* min latency to probe cache */
+  int base = (int)set * cp->assoc;
+  int way, lat = cp->hit_latency; /* min latency to probe cache */
+  md_addr_t tag;
 
-  if (cp->hsize)
-    {
-      /* higly-associativity cache, access through the per-set hash tables */
-      int hindex = CACHE_HASH(cp, tag);
-
-      for (blk=cp->sets[set].hash[hindex];
-	   blk;
-	   blk=blk->hash_next)
-	{
-	  if (blk->tag == tag && (blk->status & CACHE_BLK_VALID))
-	    break;
-	}
-    }
-  else
-    {
-      /* low-associativity cache, linear search the way list */
-      for (blk=cp->sets[set].way_head;
-	   blk;
-	   blk=blk->way_next)
-	{
-	  if (blk->tag == tag && (blk->status & CACHE_BLK_VALID))
-	    break;
-	}
-    }
-
-  if (blk)
+  way = cp->find(&cp->tags[base], cp->assoc, CACHE_KEY(cp, addr));
+  if (way >= 0)
     {
+      tag = cp->tags[base + way];
       cp->invalidations++;
-      blk->status &= ~CACHE_BLK_VALID;
+      cp->tags[base + way] = 0;
+      if (cp->pf)
+	pf_discard(cp, base + way);
 
       /* blow away the last block to hit */
-      cp->last_tagset = 0;
-      cp->last_blk = NULL;
+      cp->last_tagset = CACHE_NO_TAGSET;
+      cp->last_way = -1;
 
-      if (blk->status & CACHE_BLK_DIRTY)
+      if (tag & CACHE_BLK_DIRTY)
 	{
 	  /* write back the invalidated block */
           cp->writebacks++;
-	  lat += cp->blk_access_fn(Write,
-				   CACHE_MK_BADDR(cp, blk->tag, set),
-				   cp->bsize, blk, now+lat);
+	  lat += cp->blk_access_fn(Write, CACHE_TAG_BADDR(tag), cp->bsize,
+				   CACHE_BINDEX(cp, cp->data, base + way),
+				   now+lat);
 	}
-      /* move this block to tail of the way (LRU) list */
-      update_way_list(&cp->sets[set], blk, Tail);
+      /* move this block to tail of the replacement order */
+      update_way_order(&cp->order[base], cp->assoc, way, Tail);
     }
 
   /* return latency of the operation */
@@ -78,9 +78,12 @@
  * physical page address information, etc...
  *
  * The caches implemented by this module provide efficient storage management
- * and fast access for all cache geometries.  When sets become highly
- * associative, a hash table (indexed by address) is allocated for each set
- * in the cache.
+ * and fast access for all cache geometries.  Lookups only touch a tag array
+ * that holds each set's block addresses contiguously, with the block status
+ * bits folded in, so all the ways of a set are compared at once (with vector
+ * compares where the host has them).  Replacement order and ready times live
+ * in arrays of their own, and the block records holding data and user data
+ * are only touched when they are asked for.
  *
  * This module also tracks latency of accessing the data cache, each cache has
  * a hit latency defined when instantiated, miss latency is returned by the
@@ -89,14 +92,36 @@
  * of outstanding misses or the number of hits under misses as per the
  * limitations of the particular microarchitecture being simulated.
  *
+ * A cache may instead be given a file of miss status holding registers
+ * (MSHRs), cache_set_mshrs(), to limit its outstanding misses: each MSHR
+ * tracks one block fetch and the accesses (targets) merged into it.  A
+ * miss to a block already being fetched merges into its MSHR, waiting for
+ * the fill and a retry if all targets are taken.  The simulator checks
+ * with cache_mshr_free() that an access can get an MSHR before making it,
+ * and retries it at a later cycle if not; a miss made anyway with all
+ * MSHRs busy (e.g., from the level above) queues for the first of them to
+ * complete.  Writebacks do not take an MSHR (write buffers are unlimited).
+ *
+ * Any cache can also be given a hardware prefetcher, cache_set_prefetcher(),
+ * trained on its demand hits and misses: a next-line prefetcher fetches the
+ * blocks after each miss (and after the first hit to a prefetched block), a
+ * PC-indexed stride prefetcher keeps a reference prediction table of the
+ * stride of each load and store (after Chen and Baer) and fetches ahead of
+ * the steady ones, and stream buffers (after Jouppi) fetch the blocks after
+ * a miss into FIFOs beside the cache, which later misses are served
+ * from.  Prefetches go through the block access function and hold the bus
+ * like misses, and take a free MSHR if the cache has MSHRs, but never wait
+ * for one: with no MSHR free a prefetch is dropped.  The prefetcher can
+ * throttle itself, lowering its degree while too few of its prefetches are
+ * used and raising it again as they become accurate.
+ *
  * Due to the organization of this cache implementation, the latency of a
  * request cannot be affected by a later request to this module.  As a result,
  * reordering of requests in the memory hierarchy is not possible.
  */
 
-/* highly associative caches are implemented using a hash table lookup to
-   speed block access, this macro decides if a cache is "highly associative" */
-#define CACHE_HIGHLY_ASSOC(cp)	((cp)->assoc > 4)
+/* largest associativity, ways are numbered in a half_t */
+#define CACHE_MAX_ASSOC		65536
 
 /* cache replacement policy */
 enum cache_policy {
@@ -105,24 +130,15 @@ enum cache_policy {
   FIFO		/* replace the oldest block in the set */
 };
 
-/* block status values */
+/* block status values, or'ed into the (at least 8-byte aligned) block
+   address in the tag array */
 #define CACHE_BLK_VALID		0x00000001	/* block in valid, in use */
 #define CACHE_BLK_DIRTY		0x00000002	/* dirty block */
 
-/* cache block (or line) definition */
+/* cache block (or line) definition, the block address, status and ready
+   time are kept in the tag, status and ready arrays of the cache */
 struct cache_blk_t
 {
-  struct cache_blk_t *way_next;	/* next block in the ordered way chain, used
-				   to order blocks for replacement */
-  struct cache_blk_t *way_prev;	/* previous block in the order way chain */
-  struct cache_blk_t *hash_next;/* next block in the hash bucket chain, only
-				   used in highly-associative caches */
-  /* since hash table lists are typically small, there is no previous
-     pointer, deletion requires a trip through the hash table bucket list */
-  md_addr_t tag;		/* data block tag value */
-  unsigned int status;		/* block status, see CACHE_BLK_* defs above */
-  tick_t ready;		/* time when block will be accessible, field
-				   is set when a miss fetch is initiated */
   byte_t *user_data;		/* pointer to user defined data, e.g.,
 				   pre-decode data or physical page address */
   /* DATA should be pointer-aligned due to preceeding field */
@@ -132,16 +148,81 @@ struct cache_blk_t
 				   should probably be a multiple of 8 */
 };
 
-/* cache set definition (one or more blocks sharing the same set index) */
-struct cache_set_t
+/* miss status holding register, one outstanding block fetch */
+struct cache_mshr_t
+{
+  md_addr_t baddr;		/* address of the block being fetched */
+  tick_t ready;			/* time when the fetch completes, the MSHR
+				   is free from then on */
+  int targets;			/* accesses waiting on the fetch */
+};
+
+/* hardware prefetchers */
+enum cache_pf_class {
+  PF_NextLine,			/* next blocks after misses, tagged */
+  PF_Stride,			/* PC-indexed stride, reference prediction
+				   table */
+  PF_Stream,			/* sequential stream buffers */
+  PF_NUM
+};
+
+/* reference prediction table entry states */
+enum cache_rpt_state {
+  RPT_Initial,			/* new, or stride just broke */
+  RPT_Transient,		/* stride changed, seen once */
+  RPT_Steady,			/* stride seen repeatedly, prefetch it */
+  RPT_NoPred			/* no regular stride */
+};
+
+/* reference prediction table entry, one per load or store PC */
+struct cache_rpt_ent_t
+{
+  md_addr_t pc;			/* PC of the load or store */
+  md_addr_t last_addr;		/* address it last accessed */
+  sword_t stride;		/* last stride between its accesses */
+  enum cache_rpt_state state;	/* confidence in STRIDE */
+};
+
+/* stream buffer, a FIFO of prefetched blocks beside the cache */
+struct cache_stream_t
 {
-  struct cache_blk_t **hash;	/* hash table: for fast access w/assoc, NULL
-				   for low-assoc caches */
-  struct cache_blk_t *way_head;	/* head of way list */
-  struct cache_blk_t *way_tail;	/* tail pf way list */
-  struct cache_blk_t *blks;	/* cache blocks, allocated sequentially, so
-				   this pointer can also be used for random
-				   access to cache blocks */
+  md_addr_t *baddrs;		/* addresses of the blocks, from HEAD */
+  tick_t *ready;		/* times when the blocks arrive */
+  int head;			/* oldest block */
+  int count;			/* blocks in the FIFO */
+  md_addr_t next;		/* block to prefetch next */
+  tick_t last_use;		/* time of last allocation or hit, for LRU
+				   replacement of streams */
+};
+
+/* hardware prefetcher of a cache */
+struct cache_pf_t
+{
+  enum cache_pf_class class;	/* type of prefetcher */
+  int nentries;			/* RPT entries or number of stream buffers */
+  int degree;			/* most blocks prefetched ahead (stream
+				   buffer depth) */
+  int cur_degree;		/* blocks prefetched ahead now, DEGREE or
+				   less when throttled */
+  int throttle;			/* adjust CUR_DEGREE to accuracy? */
+
+  struct cache_rpt_ent_t *rpt;	/* reference prediction table (PF_Stride) */
+  struct cache_stream_t *streams;/* stream buffers (PF_Stream) */
+  byte_t *prefetched;		/* non-zero for each cache block brought in
+				   by a prefetch and not yet accessed */
+
+  /* throttling interval */
+  counter_t int_issued;		/* prefetches issued this interval */
+  counter_t int_useful;		/* prefetches used this interval */
+
+  /* stats */
+  counter_t issued;		/* prefetches issued */
+  counter_t useful;		/* prefetched blocks accessed by demand */
+  counter_t late;		/* useful prefetches still in flight */
+  counter_t useless;		/* prefetched blocks discarded unused */
+  counter_t dropped;		/* prefetches dropped, no free MSHR */
+  counter_t throttle_ups;	/* degree increases */
+  counter_t throttle_downs;	/* degree decreases */
 };
 
 /* cache definition */
@@ -174,7 +255,6 @@ struct cache_t
 		     tick_t now);		/* when fetch was initiated */
 
   /* derived data, for fast decoding */
-  int hsize;			/* cache set hash table size */
   md_addr_t blk_mask;
   int set_shift;
   md_addr_t set_mask;		/* use *after* shift */
@@ -199,16 +279,48 @@ struct cache_t
   counter_t writebacks;		/* total number of writebacks at misses */
   counter_t invalidations;	/* total number of external invalidations */
 
+  /* miss status holding registers, no limit on misses if MSHR_NENTRIES
+     is 0 */
+  int mshr_nentries;		/* number of MSHRs */
+  int mshr_ntargets;		/* accesses that can wait on one MSHR */
+  struct cache_mshr_t *mshrs;	/* MSHR file */
+
+  /* per-cache MSHR stats */
+  counter_t mshr_merges;	/* misses merged into a pending fetch */
+  counter_t mshr_target_stalls;	/* misses retried, all targets taken */
+  counter_t mshr_full_stalls;	/* misses retried, all MSHRs busy */
+  counter_t mshr_stall_cycles;	/* cycles with an access refused */
+  counter_t mshr_queued;	/* unprobed misses queued, MSHRs full */
+  counter_t mshr_queue_cycles;	/* cycles unprobed misses queued */
+  tick_t mshr_last_stall;	/* last cycle with an access refused */
+  counter_t mshr_busy_cycles;	/* sum of MSHR lifetimes, in cycles */
+  struct stat_stat_t *mshr_occ;	/* busy MSHRs seen by each miss */
+
+  /* hardware prefetcher, or NULL */
+  struct cache_pf_t *pf;
+  md_addr_t pf_pc;		/* PC of the load or store accessing the
+				   cache, set by the simulator for the stride
+				   prefetcher, 0 for other accesses (e.g.,
+				   instruction fetch), which do not train it */
+
   /* last block to hit, used to optimize cache hit processing */
   md_addr_t last_tagset;	/* tag of last line accessed */
-  struct cache_blk_t *last_blk;	/* cache block last accessed */
+  int last_way;			/* index of the cache block last accessed */
+
+  /* tag store, NSETS x ASSOC entries, the ways of a set are contiguous */
+  md_addr_t *tags;		/* block address with the CACHE_BLK_* status
+				   bits or'ed in, 0 for an unused block */
+  tick_t *ready;		/* time when block will be accessible, set
+				   when a miss fetch is initiated */
+  half_t *order;		/* ways of each set in replacement order, most
+				   recently used (or filled) first */
+
+  /* way compare kernel, index of the way in TAGS[0..ASSOC-1] that holds
+     valid block address KEY, or -1 */
+  int (*find)(const md_addr_t *tags, int assoc, md_addr_t key);
 
   /* data blocks */
   byte_t *data;			/* pointer to data blocks allocation */
-
-  /* NOTE: this is a variable-size tail array, this must be the LAST field
-     defined in this structure! */
-  struct cache_set_t sets[1];	/* each entry is a set */
 };
 
 /* create and initialize a general cache structure */
@@ -227,10 +339,40 @@ cache_create(char *name,		/* name of the cache */
 					   tick_t now),
 	     unsigned int hit_latency);/* latency in cycles for a hit */
 
+/* give cache CP NENTRIES MSHRs of NTARGETS targets each, limiting its
+   outstanding misses, NENTRIES of 0 lifts the limit */
+void
+cache_set_mshrs(struct cache_t *cp,	/* cache instance */
+		int nentries,		/* number of MSHRs */
+		int ntargets);		/* accesses merged into each MSHR */
+
+/* give cache CP a CLASS hardware prefetcher, of NENTRIES RPT entries or
+   stream buffers, prefetching DEGREE blocks ahead, throttled to its
+   accuracy if THROTTLE is non-zero */
+void
+cache_set_prefetcher(struct cache_t *cp,/* cache instance */
+		     enum cache_pf_class class,/* type of prefetcher */
+		     int nentries,	/* RPT entries or stream buffers */
+		     int degree,	/* blocks prefetched ahead */
+		     int throttle);	/* adapt degree to accuracy? */
+
+/* return non-zero if an access to ADDR at NOW can proceed without waiting
+   for an MSHR of CP, i.e., it hits, merges into a pending fetch with a
+   target to spare, or misses with an MSHR free; an access refused counts
+   as a stall and should be retried at a later cycle */
+int					/* non-zero if access can proceed */
+cache_mshr_free(struct cache_t *cp,	/* cache instance */
+		md_addr_t addr,		/* address of access */
+		tick_t now);		/* time of access */
+
 /* parse policy */
 enum cache_policy			/* replacement policy enum */
 cache_char2policy(char c);		/* replacement policy as a char */
 
+/* parse prefetcher type */
+enum cache_pf_class			/* prefetcher type enum */
+cache_str2pf(char *s);			/* prefetcher type as a string */
+
 /* print cache configuration */
 void
 cache_config(struct cache_t *cp,	/* cache instance */
@@ -264,6 +406,82 @@ cache_access(struct cache_t *cp,	/* cache to access */
 	     byte_t **udata,		/* for return of user data ptr */
 	     md_addr_t *repl_addr);	/* for address of replaced block */
 
+/* index an array of cache blocks, non-trivial due to variable length blocks */
+#define CACHE_BINDEX(cp, blks, i)					\
+  ((struct cache_blk_t *)(((char *)(blks)) +				\
+			  (i)*(sizeof(struct cache_blk_t) +		\
+			       ((cp)->balloc				\
+				? (cp)->bsize*sizeof(byte_t) : 0))))
+
+/* last_tagset of a cache with no block last accessed, block addresses
+   never have their low bit set */
+#define CACHE_NO_TAGSET		((md_addr_t)CACHE_BLK_VALID)
+
+/* access a cache exactly as cache_access() does, for callers on the hot
+   path (e.g., instruction fetch and loads/stores to the L1 caches and
+   TLBs): hits in the block last accessed or in the most recently used way
+   of its set are handled inline, without a call, everything else (misses,
+   caches with data blocks or prefetchers, bad sizes or alignments) goes to
+   cache_access() */
+static INLINE unsigned int		/* latency of access in cycles */
+cache_access_fast(struct cache_t *cp,	/* cache to access */
+		  enum mem_cmd cmd,	/* access type, Read or Write */
+		  md_addr_t addr,	/* address of access */
+		  void *vp,		/* ptr to buffer for input/output */
+		  int nbytes,		/* number of bytes to access */
+		  tick_t now,		/* time of access */
+		  byte_t **udata,	/* for return of user data ptr */
+		  md_addr_t *repl_addr)	/* for address of replaced block */
+{
+  md_addr_t tagset = addr & cp->tagset_mask;
+  int base, way;
+
+  /* a power-of-two size, aligned, fits in a block */
+  if (cp->balloc || cp->pf
+      || ((addr | nbytes) & (nbytes - 1)) != 0 || nbytes > cp->bsize)
+    return cache_access(cp, cmd, addr, vp, nbytes, now, udata, repl_addr);
+
+  base = (int)((addr >> cp->set_shift) & cp->set_mask) * cp->assoc;
+  if (tagset == cp->last_tagset)
+    {
+      /* hit in the same block */
+      way = cp->last_way;
+    }
+  else
+    {
+      /* hit in the MRU way needs no reordering under any policy */
+      way = cp->order[base];
+      if ((cp->tags[base + way] & ~(md_addr_t)CACHE_BLK_DIRTY)
+	  != (tagset | CACHE_BLK_VALID))
+	return cache_access(cp, cmd, addr, vp, nbytes, now, udata, repl_addr);
+    }
+
+  /* misses merging into a pending fetch are tracked by cache_access() */
+  if (cp->mshrs && cp->ready[base + way] > now)
+    return cache_access(cp, cmd, addr, vp, nbytes, now, udata, repl_addr);
+
+  /* **HIT** */
+  cp->hits++;
+
+  if (repl_addr)
+    *repl_addr = 0;
+
+  /* update dirty status */
+  if (cmd == Write)
+    cp->tags[base + way] |= CACHE_BLK_DIRTY;
+
+  /* get user block data, if requested and it exists */
+  if (udata)
+    *udata = CACHE_BINDEX(cp, cp->data, base + way)->user_data;
+
+  /* record the last block to hit */
+  cp->last_tagset = tagset;
+  cp->last_way = way;
+
+  /* return first cycle data is available to access */
+  return (int) MAX(cp->hit_latency, (cp->ready[base + way] - now));
+}
+
 /* cache access functions, these are safe, they check alignment and
    permissions */
 #define cache_double(cp, cmd, addr, p, now, udata)	\
@@ -0,0 +1,309 @@
+/* cbptrace.c - Championship Branch Prediction (BT9) trace reader */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "bptrace.h"
+#include "cbptrace.h"
+
+#define BT9_MAGIC		"BT9_SPA_TRACE_FORMAT"
+
+/* most fields looked at on a NODE or EDGE line */
+#define MAX_TOKENS		16
+
+/* stand-in opcodes, with the predecode flags of each branch class */
+#if defined(TARGET_PISA)
+#define OP_COND		BNE
+#define OP_JUMP		JUMP
+#define OP_CALL		JAL
+#define OP_IJUMP	JR
+#define OP_ICALL	JALR
+#define OP_RETURN	JR
+#elif defined(TARGET_ALPHA)
+#define OP_COND		BNE
+#define OP_JUMP		BR
+#define OP_CALL		BSR
+#define OP_IJUMP	JMP
+#define OP_ICALL	JSR
+#define OP_RETURN	RETN
+#else
+#error No stand-in branch opcodes for this target
+#endif
+
+/* trace address (4-byte instructions) to simulated address */
+#define CBP_ADDR(A)	((md_addr_t)((A) * (sizeof(md_inst_t) / 4)))
+
+/* read the next line of trace T into T->BUF, without its newline;
+   returns NULL at end of file */
+static char *
+read_line(struct cbptrace_t *t)
+{
+  size_t len = 0;
+
+  for (;;)
+    {
+      if (!fgets(t->buf + len, (int)(t->buf_size - len), t->fd))
+	{
+	  if (!len)
+	    return NULL;
+	  break;
+	}
+      len += strlen(t->buf + len);
+      if (len && t->buf[len-1] == '\n')
+	break;
+
+      /* line does not fit, make room for the rest of it */
+      t->buf_size *= 2;
+      if (!(t->buf = realloc(t->buf, t->buf_size)))
+	fatal("out of virtual memory");
+    }
+
+  while (len && isspace((int)t->buf[len-1]))
+    t->buf[--len] = '\0';
+  t->line++;
+  return t->buf;
+}
+
+/* split LINE in place into at most MAX whitespace separated tokens */
+static int
+split(char *line, char **tok, int max)
+{
+  int n = 0;
+
+  while (n < max)
+    {
+      while (isspace((int)*line))
+	line++;
+      if (!*line)
+	break;
+      tok[n++] = line;
+      while (*line && !isspace((int)*line))
+	line++;
+      if (*line)
+	*line++ = '\0';
+    }
+  return n;
+}
+
+/* parse number token S of trace T, hex with a 0x prefix */
+static qword_t
+parse_num(struct cbptrace_t *t, char *s)
+{
+  char *end;
+  qword_t v = strtoull(s, &end, 0);
+
+  if (end == s || *end)
+    fatal("CBP trace `%s', line %d: bad number `%s'",
+	  t->fname, (int)t->line, s);
+  return v;
+}
+
+/* grow table *TAB of *N elements of SIZE bytes to hold index I */
+static void
+grow(void **tab, unsigned int *n, size_t size, unsigned int i)
+{
+  unsigned int new_n = *n ? *n : 1024;
+
+  if (i < *n)
+    return;
+  while (new_n <= i)
+    new_n *= 2;
+  if (!(*tab = realloc(*tab, new_n * size)))
+    fatal("out of virtual memory");
+  memset((char *)*tab + *n * size, 0, (new_n - *n) * size);
+  *n = new_n;
+}
+
+/* map a BT9 branch class, e.g., "JMP+DIR+CND", onto node N */
+static void
+node_class(struct cbptrace_t *t, struct cbp_node_t *n, char *cls)
+{
+  int is_ind = strstr(cls, "IND") != NULL;
+
+  n->is_call = !strncmp(cls, "CALL", 4);
+  n->is_return = !strncmp(cls, "RET", 3);
+  if (!n->is_call && !n->is_return && strncmp(cls, "JMP", 3))
+    fatal("CBP trace `%s', line %d: unknown branch class `%s'",
+	  t->fname, (int)t->line, cls);
+
+  if (strstr(cls, "CND"))
+    n->op = OP_COND;
+  else if (n->is_return)
+    n->op = OP_RETURN;
+  else if (n->is_call)
+    n->op = is_ind ? OP_ICALL : OP_CALL;
+  else
+    n->op = is_ind ? OP_IJUMP : OP_JUMP;
+}
+
+/* NODE <id> <vaddr> <paddr> <opcode> <size> [class: <class>] ... */
+static void
+parse_node(struct cbptrace_t *t, char *line)
+{
+  char *tok[MAX_TOKENS];
+  struct cbp_node_t *n;
+  unsigned int id;
+  int i, ntok = split(line, tok, MAX_TOKENS);
+
+  if (ntok < 6)
+    fatal("CBP trace `%s', line %d: bad node", t->fname, (int)t->line);
+
+  id = (unsigned int)parse_num(t, tok[1]);
+  grow((void **)&t->nodes, &t->nnodes, sizeof(struct cbp_node_t), id);
+  n = &t->nodes[id];
+  n->op = OP_NA;
+
+  /* the first node stands for program entry and has no class */
+  for (i = 6; i < ntok - 1; i++)
+    {
+      if (!strcmp(tok[i], "class:"))
+	{
+	  n->pc = CBP_ADDR(parse_num(t, tok[2]));
+	  node_class(t, n, tok[i+1]);
+	  break;
+	}
+    }
+}
+
+/* EDGE <id> <src> <dest> <T|N> <vtarget> <ptarget> <inst_cnt> ... */
+static void
+parse_edge(struct cbptrace_t *t, char *line)
+{
+  char *tok[MAX_TOKENS];
+  struct cbp_edge_t *e;
+  unsigned int id;
+
+  if (split(line, tok, MAX_TOKENS) < 8)
+    fatal("CBP trace `%s', line %d: bad edge", t->fname, (int)t->line);
+
+  id = (unsigned int)parse_num(t, tok[1]);
+  grow((void **)&t->edges, &t->nedges, sizeof(struct cbp_edge_t), id);
+  e = &t->edges[id];
+  e->src = (unsigned int)parse_num(t, tok[2]);
+  e->taken = !strcmp(tok[4], "T");
+  e->target = CBP_ADDR(parse_num(t, tok[5]));
+  e->ninsts = parse_num(t, tok[7]);
+}
+
+/* open BT9 trace FNAME (raw or .gz) and read its node and edge tables */
+struct cbptrace_t *			/* BT9 trace */
+cbptrace_open(char *fname)		/* trace file name */
+{
+  struct cbptrace_t *t;
+  char *line;
+  enum { hdr, nodes, edges } sect = hdr;
+
+  if (!(t = calloc(1, sizeof(struct cbptrace_t))))
+    fatal("out of virtual memory");
+  t->fname = mystrdup(fname);
+  t->buf_size = 1024;
+  if (!(t->buf = malloc(t->buf_size)))
+    fatal("out of virtual memory");
+
+  /* gzopen() hands back a pipe for compressed traces, catch a missing
+     file here rather than as an empty trace */
+  if (access(fname, R_OK) != 0 || !(t->fd = gzopen(fname, "r")))
+    fatal("cannot open CBP trace file `%s'", fname);
+
+  line = read_line(t);
+  if (!line || strcmp(line, BT9_MAGIC))
+    fatal("`%s' is not a CBP (BT9) trace", fname);
+
+  /* header and tables, up to the start of the edge sequence */
+  while ((line = read_line(t)) != NULL)
+    {
+      if (!*line || *line == '#')
+	continue;
+
+      if (!strcmp(line, "BT9_NODES"))
+	sect = nodes;
+      else if (!strcmp(line, "BT9_EDGES"))
+	sect = edges;
+      else if (!strcmp(line, "BT9_EDGE_SEQUENCE"))
+	break;
+      else if (sect == hdr)
+	continue;		/* header fields are informational */
+      else if (sect == nodes && !strncmp(line, "NODE", 4))
+	parse_node(t, line);
+      else if (sect == edges && !strncmp(line, "EDGE", 4))
+	parse_edge(t, line);
+      else
+	fatal("CBP trace `%s', line %d: unexpected `%s'",
+	      fname, (int)t->line, line);
+    }
+  if (!line)
+    fatal("CBP trace `%s' has no edge sequence", fname);
+
+  return t;
+}
+
+/* read the next dynamic branch of trace T into *REC and the number of
+   instructions it accounts for, itself included, into *NINSTS; returns
+   FALSE at the end of the trace */
+int					/* non-zero if *REC is valid */
+cbptrace_read(struct cbptrace_t *t,	/* BT9 trace */
+	      struct bptrace_rec_t *rec,/* record to fill */
+	      counter_t *ninsts)	/* instructions covered */
+{
+  char *line;
+  struct cbp_edge_t *e;
+  struct cbp_node_t *n;
+  qword_t id;
+
+  *ninsts = 0;
+  while ((line = read_line(t)) != NULL)
+    {
+      if (!*line || *line == '#')
+	continue;
+      if (!strcmp(line, "EOF"))
+	break;
+
+      id = parse_num(t, line);
+      if (id >= t->nedges || (e = &t->edges[id])->src >= t->nnodes)
+	fatal("CBP trace `%s', line %d: unknown edge %d",
+	      t->fname, (int)t->line, (int)id);
+
+      /* edges out of the entry node only carry instructions */
+      n = &t->nodes[e->src];
+      *ninsts += e->ninsts;
+      if (n->op == OP_NA)
+	continue;
+
+      rec->pc = n->pc;
+      rec->target = e->target;
+      rec->op = n->op;
+      rec->taken = e->taken;
+      rec->is_call = n->is_call;
+      rec->is_return = n->is_return;
+      *ninsts += 1;
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+/* close and free trace T */
+void
+cbptrace_close(struct cbptrace_t *t)	/* BT9 trace */
+{
+  if (!t)
+    return;
+
+  gzclose(t->fd);
+  free(t->nodes);
+  free(t->edges);
+  free(t->buf);
+  free(t->fname);
+  free(t);
+}
@@ -0,0 +1,81 @@
+/* cbptrace.h - Championship Branch Prediction (BT9) trace reader */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ */
+
+#ifndef CBPTRACE_H
+#define CBPTRACE_H
+
+#include <stdio.h>
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "bptrace.h"
+
+/*
+ * This module streams branch traces in the BT9 format of the
+ * Championship Branch Prediction contest, raw or gzip'ed (through
+ * gzopen()), and hands them out as branch trace records, so they can
+ * drive the predictors like a trace captured by sim-bpred.
+ *
+ * A BT9 trace lists its static branches (NODEs) and control flow edges
+ * (EDGEs) up front, then the dynamic edge sequence, one edge id per line.
+ * Only the node and edge tables are kept in memory, the sequence is read
+ * a line at a time, so memory use does not grow with trace length.
+ *
+ * Branch classes are mapped to target opcodes with the same predecode
+ * flags (on PISA, conditional: BNE, direct jump/call: JUMP/JAL, indirect
+ * jump/call: JR/JALR, return: JR).  Trace addresses (4-byte instructions)
+ * are scaled to the target's instruction size, so the predictors' index
+ * functions see neighboring branches apart, and truncated to md_addr_t.
+ */
+
+/* one static branch */
+struct cbp_node_t {
+  md_addr_t pc;			/* scaled branch address */
+  enum md_opcode op;		/* stand-in opcode, OP_NA if not a branch */
+  int is_call;			/* non-zero if branch is fn call */
+  int is_return;		/* non-zero if branch is fn return */
+};
+
+/* one control flow edge */
+struct cbp_edge_t {
+  unsigned int src;		/* node executed */
+  int taken;			/* non-zero if the edge is the taken path */
+  md_addr_t target;		/* scaled branch target */
+  counter_t ninsts;		/* non-branch insts that follow the branch */
+};
+
+/* BT9 trace being streamed */
+struct cbptrace_t {
+  char *fname;			/* trace file name */
+  FILE *fd;			/* trace stream */
+  char *buf;			/* current line */
+  size_t buf_size;		/* size of BUF */
+  counter_t line;		/* current line number, for diagnostics */
+
+  unsigned int nnodes;		/* static branches */
+  struct cbp_node_t *nodes;	/* static branches, by node id */
+  unsigned int nedges;		/* control flow edges */
+  struct cbp_edge_t *edges;	/* control flow edges, by edge id */
+};
+
+/* open BT9 trace FNAME (raw or .gz) and read its node and edge tables */
+struct cbptrace_t *			/* BT9 trace */
+cbptrace_open(char *fname);		/* trace file name */
+
+/* read the next dynamic branch of trace T into *REC and the number of
+   instructions it accounts for, itself included, into *NINSTS; returns
+   FALSE at the end of the trace */
+int					/* non-zero if *REC is valid */
+cbptrace_read(struct cbptrace_t *t,	/* BT9 trace */
+	      struct bptrace_rec_t *rec,/* record to fill */
+	      counter_t *ninsts);	/* instructions covered */
+
+/* close and free trace T */
+void
+cbptrace_close(struct cbptrace_t *t);	/* BT9 trace */
+
+#endif /* CBPTRACE_H */
@@ -0,0 +1,466 @@
+/* cheetah.c - single-pass simulation of many LRU caches */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "stats.h"
+#include "cheetah.h"
+
+/* most sets and largest blocks and caches, log2 */
+#define CHEETAH_MAX_LOG_SETS	24
+#define CHEETAH_MAX_LOG_BSIZE	16
+#define CHEETAH_MAX_LOG_ASSOC	8
+
+/* allocate an instance named NAME of kind KIND */
+static struct cheetah_t *
+cheetah_new(char *name, enum cheetah_kind kind)
+{
+  struct cheetah_t *ch;
+
+  if (!(ch = calloc(1, sizeof(struct cheetah_t))))
+    fatal("out of virtual memory");
+  ch->name = mystrdup(name);
+  ch->kind = kind;
+  return ch;
+}
+
+/* set up geometry G: 2^LOG_SETS sets of 2^LOG_BSIZE byte blocks, stacks
+   2^LOG_DEPTH deep, one set in 2^LOG_SAMPLE simulated */
+static void
+geom_init(struct cheetah_geom_t *g, unsigned int log_sets,
+	  unsigned int log_bsize, unsigned int log_depth,
+	  unsigned int log_sample)
+{
+  g->log_sets = log_sets;
+  g->log_bsize = log_bsize;
+  g->depth = 1 << log_depth;
+  g->nassoc = log_depth + 1;
+
+  /* with fewer sets than the sampling ratio, only set 0 is simulated */
+  g->sample_mask = (1 << MIN(log_sample, log_sets)) - 1;
+
+  if (!(g->stacks = calloc((size_t)g->depth << log_sets, sizeof(md_addr_t)))
+      || !(g->misses = calloc(g->nassoc, sizeof(counter_t))))
+    fatal("cannot allocate cache stacks");
+}
+
+/* create a set-associative analysis of all caches with 2^MIN_LOG_SETS to
+   2^MAX_LOG_SETS sets of 2^MIN_LOG_BSIZE to 2^MAX_LOG_BSIZE byte blocks
+   and 1 to 2^MAX_LOG_ASSOC ways, simulating one set in 2^LOG_SAMPLE */
+struct cheetah_t *			/* cheetah instance */
+cheetah_create_sa(char *name,		/* stats name prefix */
+		  unsigned int min_log_sets,/* fewest sets, log2 */
+		  unsigned int max_log_sets,/* most sets, log2 */
+		  unsigned int min_log_bsize,/* smallest block, log2 */
+		  unsigned int max_log_bsize,/* largest block, log2 */
+		  unsigned int max_log_assoc,/* most ways, log2 */
+		  unsigned int log_sample)/* set sampling ratio, log2 */
+{
+  struct cheetah_t *ch;
+  unsigned int b, s, i = 0;
+
+  if (min_log_sets > max_log_sets || max_log_sets > CHEETAH_MAX_LOG_SETS)
+    fatal("cheetah: set counts 2^%d..2^%d must be increasing, at most 2^%d",
+	  min_log_sets, max_log_sets, CHEETAH_MAX_LOG_SETS);
+  if (min_log_bsize > max_log_bsize || max_log_bsize > CHEETAH_MAX_LOG_BSIZE)
+    fatal("cheetah: block sizes 2^%d..2^%d must be increasing, at most 2^%d",
+	  min_log_bsize, max_log_bsize, CHEETAH_MAX_LOG_BSIZE);
+  if (max_log_assoc > CHEETAH_MAX_LOG_ASSOC)
+    fatal("cheetah: associativity 2^%d must be at most 2^%d",
+	  max_log_assoc, CHEETAH_MAX_LOG_ASSOC);
+
+  ch = cheetah_new(name, CheetahSA);
+  ch->ngeoms = (max_log_bsize - min_log_bsize + 1)
+    * (max_log_sets - min_log_sets + 1);
+  if (!(ch->geoms = calloc(ch->ngeoms, sizeof(struct cheetah_geom_t))))
+    fatal("out of virtual memory");
+
+  for (b = min_log_bsize; b <= max_log_bsize; b++)
+    for (s = min_log_sets; s <= max_log_sets; s++)
+      geom_init(&ch->geoms[i++], s, b, max_log_assoc, log_sample);
+
+  return ch;
+}
+
+/* create a direct-mapped analysis of caches of 2^LOG_SIZE bytes with
+   2^MIN_LOG_BSIZE to 2^MAX_LOG_BSIZE byte blocks, simulating one set in
+   2^LOG_SAMPLE */
+struct cheetah_t *			/* cheetah instance */
+cheetah_create_dm(char *name,		/* stats name prefix */
+		  unsigned int log_size,/* cache size, log2 */
+		  unsigned int min_log_bsize,/* smallest block, log2 */
+		  unsigned int max_log_bsize,/* largest block, log2 */
+		  unsigned int log_sample)/* set sampling ratio, log2 */
+{
+  struct cheetah_t *ch;
+  unsigned int b, i = 0;
+
+  if (min_log_bsize > max_log_bsize || max_log_bsize > log_size)
+    fatal("cheetah: block sizes 2^%d..2^%d must be increasing, at most the "
+	  "cache size 2^%d", min_log_bsize, max_log_bsize, log_size);
+  if (log_size - min_log_bsize > CHEETAH_MAX_LOG_SETS)
+    fatal("cheetah: a 2^%d byte cache of 2^%d byte blocks has more than 2^%d "
+	  "sets", log_size, min_log_bsize, CHEETAH_MAX_LOG_SETS);
+
+  ch = cheetah_new(name, CheetahDM);
+  ch->ngeoms = max_log_bsize - min_log_bsize + 1;
+  if (!(ch->geoms = calloc(ch->ngeoms, sizeof(struct cheetah_geom_t))))
+    fatal("out of virtual memory");
+
+  for (b = min_log_bsize; b <= max_log_bsize; b++)
+    geom_init(&ch->geoms[i++], log_size - b, b, /* 1 way */0, log_sample);
+
+  return ch;
+}
+
+/* create a fully-associative analysis of caches of SIZE_INCR, 2 x
+   SIZE_INCR, ..., MAX_SIZE bytes with 2^LOG_BSIZE byte blocks */
+struct cheetah_t *			/* cheetah instance */
+cheetah_create_fa(char *name,		/* stats name prefix */
+		  unsigned int log_bsize,/* block size, log2 */
+		  unsigned int size_incr,/* cache size increment */
+		  unsigned int max_size)/* largest cache size */
+{
+  struct cheetah_t *ch;
+  unsigned int i;
+
+  if (log_bsize > CHEETAH_MAX_LOG_BSIZE)
+    fatal("cheetah: block size 2^%d must be at most 2^%d",
+	  log_bsize, CHEETAH_MAX_LOG_BSIZE);
+  if (!size_incr || (size_incr & ((1 << log_bsize) - 1)) != 0)
+    fatal("cheetah: cache size increment `%d' must be a non-zero multiple "
+	  "of the block size", size_incr);
+  if (max_size < size_incr || max_size % size_incr != 0
+      || max_size / size_incr > CHEETAH_MAX_SIZES)
+    fatal("cheetah: largest cache size `%d' must be a multiple of the size "
+	  "increment, at most %d of them", max_size, CHEETAH_MAX_SIZES);
+
+  ch = cheetah_new(name, CheetahFA);
+  ch->log_bsize = log_bsize;
+  ch->nsizes = max_size / size_incr;
+  if (!(ch->lines = calloc(ch->nsizes, sizeof(unsigned int)))
+      || !(ch->fa_misses = calloc(ch->nsizes, sizeof(counter_t))))
+    fatal("out of virtual memory");
+  for (i = 0; i < ch->nsizes; i++)
+    ch->lines[i] = ((i + 1) * size_incr) >> log_bsize;
+
+  /* renumber after as many stamps again as the largest cache has blocks,
+     keeping the block table at most half full */
+  ch->cap = 2 * ch->lines[ch->nsizes - 1];
+  for (ch->table_size = 1; ch->table_size < 2 * ch->cap; ch->table_size <<= 1)
+    /* nada */;
+  if (!(ch->tree = calloc(ch->cap + 1, sizeof(int)))
+      || !(ch->table = calloc(ch->table_size, sizeof(struct cheetah_blk_t))))
+    fatal("cannot allocate fully-associative cache state");
+
+  return ch;
+}
+
+/* simulate a reference to block number plus one KEY in geometry G */
+static void
+geom_access(struct cheetah_geom_t *g, md_addr_t key)
+{
+  unsigned int set = (unsigned int)((key - 1) & ((1 << g->log_sets) - 1));
+  md_addr_t *stack;
+  unsigned int d, k;
+
+  if (set & g->sample_mask)
+    return;
+  g->refs++;
+
+  stack = &g->stacks[(size_t)set * g->depth];
+  for (d = 0; d < g->depth && stack[d] != key; d++)
+    /* nada */;
+
+  /* found at depth D: a miss in every cache of D ways or fewer */
+  for (k = 0; k < g->nassoc && d >= (1U << k); k++)
+    g->misses[k]++;
+
+  /* move to the top, pushing out the least recent block on a miss */
+  if (d == g->depth)
+    d = g->depth - 1;
+  memmove(&stack[1], &stack[0], d * sizeof(md_addr_t));
+  stack[0] = key;
+}
+
+/* add INC to the count of stamp STAMP in the Fenwick tree of CH */
+static void
+tree_add(struct cheetah_t *ch, unsigned int stamp, int inc)
+{
+  for (; stamp <= ch->cap; stamp += stamp & -stamp)
+    ch->tree[stamp] += inc;
+}
+
+/* number of live blocks stamped STAMP or earlier */
+static unsigned int
+tree_sum(struct cheetah_t *ch, unsigned int stamp)
+{
+  int sum = 0;
+
+  for (; stamp; stamp -= stamp & -stamp)
+    sum += ch->tree[stamp];
+  return sum;
+}
+
+/* block table entry of KEY, free if KEY is not live */
+static struct cheetah_blk_t *
+blk_find(struct cheetah_t *ch, md_addr_t key)
+{
+  word_t h = ((word_t)key ^ (word_t)(key >> 16 >> 16)) * 0x9e3779b1U;
+  unsigned int i;
+
+  for (i = (h ^ (h >> 16)) & (ch->table_size - 1);
+       ch->table[i].key && ch->table[i].key != key;
+       i = (i + 1) & (ch->table_size - 1))
+    /* nada */;
+  return &ch->table[i];
+}
+
+/* order blocks by decreasing stamp */
+static int
+blk_cmp(const void *a, const void *b)
+{
+  const struct cheetah_blk_t *x = a, *y = b;
+
+  return x->stamp < y->stamp ? 1 : (x->stamp > y->stamp ? -1 : 0);
+}
+
+/* stamps ran out: restamp the blocks that fit in the largest cache 1..N,
+   oldest first, and forget the rest */
+static void
+fa_renumber(struct cheetah_t *ch)
+{
+  struct cheetah_blk_t *blks;
+  unsigned int i, n = 0, keep = ch->lines[ch->nsizes - 1];
+
+  if (!(blks = calloc(ch->live, sizeof(struct cheetah_blk_t))))
+    fatal("out of virtual memory");
+  for (i = 0; i < ch->table_size; i++)
+    if (ch->table[i].key)
+      blks[n++] = ch->table[i];
+  qsort(blks, n, sizeof(struct cheetah_blk_t), blk_cmp);
+  n = MIN(n, keep);
+
+  memset(ch->table, 0, ch->table_size * sizeof(struct cheetah_blk_t));
+  memset(ch->tree, 0, (ch->cap + 1) * sizeof(int));
+  for (i = 0; i < n; i++)
+    {
+      struct cheetah_blk_t *e = blk_find(ch, blks[i].key);
+
+      e->key = blks[i].key;
+      e->stamp = n - i;
+      tree_add(ch, e->stamp, 1);
+    }
+  ch->live = n;
+  ch->now = n;
+  free(blks);
+}
+
+/* simulate a reference to block number plus one KEY in every
+   fully-associative cache of CH */
+static void
+fa_access(struct cheetah_t *ch, md_addr_t key)
+{
+  struct cheetah_blk_t *e;
+  unsigned int d, k;
+
+  if (ch->now == ch->cap)
+    fa_renumber(ch);
+  ch->refs++;
+
+  e = blk_find(ch, key);
+  if (e->key)
+    {
+      /* stack distance: the live blocks stamped since */
+      d = ch->live - tree_sum(ch, e->stamp);
+      tree_add(ch, e->stamp, -1);
+    }
+  else
+    {
+      /* first reference, or pushed out of the largest cache */
+      d = ch->lines[ch->nsizes - 1];
+      e->key = key;
+      ch->live++;
+    }
+
+  /* a miss in every cache of D blocks or fewer */
+  for (k = 0; k < ch->nsizes && d >= ch->lines[k]; k++)
+    ch->fa_misses[k]++;
+
+  e->stamp = ++ch->now;
+  tree_add(ch, e->stamp, 1);
+}
+
+/* simulate a reference to ADDR in every cache of CH */
+void
+cheetah_access(struct cheetah_t *ch,	/* cheetah instance */
+	       md_addr_t addr)		/* address referenced */
+{
+  unsigned int i;
+
+  if (ch->kind == CheetahFA)
+    fa_access(ch, (addr >> ch->log_bsize) + 1);
+  else
+    for (i = 0; i < ch->ngeoms; i++)
+      geom_access(&ch->geoms[i],
+		  (addr >> ch->geoms[i].log_bsize) + 1);
+}
+
+/* print the configuration of CH */
+void
+cheetah_config(struct cheetah_t *ch,	/* cheetah instance */
+	       FILE *stream)		/* output stream */
+{
+  struct cheetah_geom_t *first = &ch->geoms[0], *last;
+
+  switch (ch->kind)
+    {
+    case CheetahSA:
+      last = &ch->geoms[ch->ngeoms - 1];
+      fprintf(stream, "%s: set-associative LRU, %d..%d sets, %d..%d byte "
+	      "blocks, 1..%d ways, 1 in %d sets simulated\n", ch->name,
+	      1 << first->log_sets, 1 << last->log_sets,
+	      1 << first->log_bsize, 1 << last->log_bsize,
+	      first->depth, first->sample_mask + 1);
+      break;
+    case CheetahDM:
+      last = &ch->geoms[ch->ngeoms - 1];
+      fprintf(stream, "%s: direct-mapped, %d bytes, %d..%d byte blocks, "
+	      "1 in %d sets simulated\n", ch->name,
+	      1 << (first->log_sets + first->log_bsize),
+	      1 << first->log_bsize, 1 << last->log_bsize,
+	      first->sample_mask + 1);
+      break;
+    case CheetahFA:
+      fprintf(stream, "%s: fully-associative LRU, %d byte blocks, %d..%d "
+	      "bytes\n", ch->name, 1 << ch->log_bsize,
+	      ch->lines[0] << ch->log_bsize,
+	      ch->lines[ch->nsizes - 1] << ch->log_bsize);
+      break;
+    default:
+      panic("bogus cheetah kind");
+    }
+}
+
+/* register the stats of CH, the references and misses of every cache */
+void
+cheetah_reg_stats(struct cheetah_t *ch,	/* cheetah instance */
+		  struct stat_sdb_t *sdb)/* stats database */
+{
+  char buf[512], buf1[512], geom[128];
+  unsigned int i, k;
+
+  if (ch->kind == CheetahFA)
+    {
+      sprintf(geom, "%s.b%d_fa", ch->name, 1 << ch->log_bsize);
+      sprintf(buf, "%s.refs", geom);
+      stat_reg_counter(sdb, buf, "total number of references",
+		       &ch->refs, 0, NULL);
+      for (k = 0; k < ch->nsizes; k++)
+	{
+	  sprintf(buf, "%s_%d.misses", geom, ch->lines[k] << ch->log_bsize);
+	  stat_reg_counter(sdb, buf, "total number of misses",
+			   &ch->fa_misses[k], 0, NULL);
+	  sprintf(buf, "%s_%d.miss_rate", geom,
+		  ch->lines[k] << ch->log_bsize);
+	  sprintf(buf1, "%s_%d.misses / %s.refs", geom,
+		  ch->lines[k] << ch->log_bsize, geom);
+	  stat_reg_formula(sdb, buf, "miss rate (i.e., misses/ref)",
+			   buf1, NULL);
+	}
+      return;
+    }
+
+  for (i = 0; i < ch->ngeoms; i++)
+    {
+      struct cheetah_geom_t *g = &ch->geoms[i];
+
+      sprintf(geom, "%s.b%d_s%d", ch->name,
+	      1 << g->log_bsize, 1 << g->log_sets);
+      sprintf(buf, "%s.refs", geom);
+      stat_reg_counter(sdb, buf,
+		       g->sample_mask
+		       ? "total number of references to simulated sets"
+		       : "total number of references",
+		       &g->refs, 0, NULL);
+      for (k = 0; k < g->nassoc; k++)
+	{
+	  sprintf(buf, "%s_a%d.misses", geom, 1 << k);
+	  stat_reg_counter(sdb, buf, "total number of misses",
+			   &g->misses[k], 0, NULL);
+	  sprintf(buf, "%s_a%d.miss_rate", geom, 1 << k);
+	  sprintf(buf1, "%s_a%d.misses / %s.refs", geom, 1 << k, geom);
+	  stat_reg_formula(sdb, buf, "miss rate (i.e., misses/ref)",
+			   buf1, NULL);
+	}
+    }
+}
+
+/* miss ratio of MISSES in REFS */
+#define MISS_RATIO(MISSES, REFS)					\
+  ((REFS) ? (double)(MISSES) / (double)(REFS) : 0.0)
+
+/* print the miss ratios of all caches of CH as tables */
+void
+cheetah_print(struct cheetah_t *ch,	/* cheetah instance */
+	      FILE *stream)		/* output stream */
+{
+  struct cheetah_geom_t *g;
+  unsigned int i, k;
+
+  fprintf(stream, "\n%s: miss ratios\n", ch->name);
+  if (ch->kind == CheetahFA)
+    {
+      fprintf(stream, "%12s %10s\n", "size", "miss_rate");
+      for (k = 0; k < ch->nsizes; k++)
+	fprintf(stream, "%12d %10.6f\n", ch->lines[k] << ch->log_bsize,
+		MISS_RATIO(ch->fa_misses[k], ch->refs));
+      return;
+    }
+
+  /* one row per geometry, one column per associativity */
+  fprintf(stream, "%8s %8s", "bsize", "sets");
+  for (k = 0; k < ch->geoms[0].nassoc; k++)
+    fprintf(stream, "    %3d-way", 1 << k);
+  fprintf(stream, "\n");
+  for (i = 0; i < ch->ngeoms; i++)
+    {
+      g = &ch->geoms[i];
+      fprintf(stream, "%8d %8d", 1 << g->log_bsize, 1 << g->log_sets);
+      for (k = 0; k < g->nassoc; k++)
+	fprintf(stream, " %10.6f", MISS_RATIO(g->misses[k], g->refs));
+      fprintf(stream, "\n");
+    }
+}
+
+/* free CH */
+void
+cheetah_free(struct cheetah_t *ch)	/* cheetah instance */
+{
+  unsigned int i;
+
+  if (!ch)
+    return;
+
+  for (i = 0; i < ch->ngeoms; i++)
+    {
+      free(ch->geoms[i].stacks);
+      free(ch->geoms[i].misses);
+    }
+  free(ch->geoms);
+  free(ch->lines);
+  free(ch->fa_misses);
+  free(ch->tree);
+  free(ch->table);
+  free(ch->name);
+  free(ch);
+}
@@ -0,0 +1,159 @@
+/* cheetah.h - single-pass simulation of many LRU caches */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved.
+ */
+
+#ifndef CHEETAH_H
+#define CHEETAH_H
+
+#include <stdio.h>
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "stats.h"
+
+/*
+ * This module simulates a whole grid of LRU caches in one pass over an
+ * address stream, after Mattson et al.: for a given block size and number
+ * of sets, each set keeps its blocks in an LRU stack, and a reference
+ * found at depth D (0 for the most recent block) hits in every cache of
+ * that geometry with more than D ways.  One stack per set thus gives the
+ * misses of all associativities up to the stack depth at once.
+ *
+ * Set-associative analysis (CheetahSA) keeps such stacks for every
+ * power-of-two number of sets and block size in a range, and counts
+ * misses for every power-of-two associativity up to the stack depth.
+ * Direct-mapped analysis (CheetahDM) does the same for one cache size
+ * over a range of block sizes.  Either can sample sets: with a sampling
+ * ratio of N, only every Nth set is simulated and miss ratios are those
+ * of the references to the simulated sets, for about 1/N of the work.
+ *
+ * Fully-associative analysis (CheetahFA) finds the stack distance of
+ * every reference over the whole cache: the number of distinct blocks
+ * referenced since the last reference to the same block, which misses
+ * in every cache of that many blocks or fewer.  Every block is stamped
+ * with the time of its last reference, and a Fenwick tree over the
+ * stamps counts the younger ones, so a reference costs O(log n) however
+ * deep it is.  When the stamps run out they are renumbered, and blocks
+ * deeper than the largest cache are dropped, since they would miss in
+ * all of them anyway.
+ */
+
+/* kinds of analysis */
+enum cheetah_kind {
+  CheetahSA,			/* set-associative, many set counts */
+  CheetahDM,			/* direct-mapped, many block sizes */
+  CheetahFA,			/* fully-associative, many sizes */
+  Cheetah_NUM
+};
+
+/* most cache sizes of a fully-associative analysis */
+#define CHEETAH_MAX_SIZES	256
+
+/* LRU stacks of all sets of one geometry (CheetahSA, CheetahDM) */
+struct cheetah_geom_t {
+  unsigned int log_sets;	/* log2 number of sets */
+  unsigned int log_bsize;	/* log2 block size, in bytes */
+  unsigned int depth;		/* stack depth, the largest associativity */
+  unsigned int nassoc;		/* associativities, 1, 2, 4, ..., DEPTH */
+  unsigned int sample_mask;	/* sets S with (S & SAMPLE_MASK) == 0 are
+				   simulated */
+  md_addr_t *stacks;		/* DEPTH block numbers plus one per set,
+				   most recent first, 0 for none */
+
+  /* stats */
+  counter_t refs;		/* references to simulated sets */
+  counter_t *misses;		/* misses per associativity */
+};
+
+/* fully-associative block, keyed by block number plus one */
+struct cheetah_blk_t {
+  md_addr_t key;		/* block number plus one, 0 for a free
+				   entry */
+  unsigned int stamp;		/* time of the last reference */
+};
+
+/* single-pass cache simulation */
+struct cheetah_t {
+  char *name;			/* stats name prefix */
+  enum cheetah_kind kind;	/* kind of analysis */
+
+  /* CheetahSA, CheetahDM */
+  unsigned int ngeoms;		/* number of geometries */
+  struct cheetah_geom_t *geoms;	/* geometries, by block size and then
+				   number of sets */
+
+  /* CheetahFA */
+  unsigned int log_bsize;	/* log2 block size, in bytes */
+  unsigned int nsizes;		/* number of cache sizes */
+  unsigned int *lines;		/* blocks per cache size, increasing */
+  unsigned int cap;		/* stamps issued between renumberings */
+  unsigned int now;		/* last stamp issued */
+  unsigned int live;		/* blocks with a stamp */
+  int *tree;			/* Fenwick tree over stamps 1..CAP, one
+				   count per live block */
+  unsigned int table_size;	/* block table entries, a power of two */
+  struct cheetah_blk_t *table;	/* live blocks, open-addressed */
+
+  /* stats (CheetahFA) */
+  counter_t refs;		/* references */
+  counter_t *fa_misses;		/* misses per cache size */
+};
+
+/* create a set-associative analysis of all caches with 2^MIN_LOG_SETS to
+   2^MAX_LOG_SETS sets of 2^MIN_LOG_BSIZE to 2^MAX_LOG_BSIZE byte blocks
+   and 1 to 2^MAX_LOG_ASSOC ways, simulating one set in 2^LOG_SAMPLE */
+struct cheetah_t *			/* cheetah instance */
+cheetah_create_sa(char *name,		/* stats name prefix */
+		  unsigned int min_log_sets,/* fewest sets, log2 */
+		  unsigned int max_log_sets,/* most sets, log2 */
+		  unsigned int min_log_bsize,/* smallest block, log2 */
+		  unsigned int max_log_bsize,/* largest block, log2 */
+		  unsigned int max_log_assoc,/* most ways, log2 */
+		  unsigned int log_sample);/* set sampling ratio, log2 */
+
+/* create a direct-mapped analysis of caches of 2^LOG_SIZE bytes with
+   2^MIN_LOG_BSIZE to 2^MAX_LOG_BSIZE byte blocks, simulating one set in
+   2^LOG_SAMPLE */
+struct cheetah_t *			/* cheetah instance */
+cheetah_create_dm(char *name,		/* stats name prefix */
+		  unsigned int log_size,/* cache size, log2 */
+		  unsigned int min_log_bsize,/* smallest block, log2 */
+		  unsigned int max_log_bsize,/* largest block, log2 */
+		  unsigned int log_sample);/* set sampling ratio, log2 */
+
+/* create a fully-associative analysis of caches of SIZE_INCR, 2 x
+   SIZE_INCR, ..., MAX_SIZE bytes with 2^LOG_BSIZE byte blocks */
+struct cheetah_t *			/* cheetah instance */
+cheetah_create_fa(char *name,		/* stats name prefix */
+		  unsigned int log_bsize,/* block size, log2 */
+		  unsigned int size_incr,/* cache size increment */
+		  unsigned int max_size);/* largest cache size */
+
+/* simulate a reference to ADDR in every cache of CH */
+void
+cheetah_access(struct cheetah_t *ch,	/* cheetah instance */
+	       md_addr_t addr);		/* address referenced */
+
+/* print the configuration of CH */
+void
+cheetah_config(struct cheetah_t *ch,	/* cheetah instance */
+	       FILE *stream);		/* output stream */
+
+/* register the stats of CH, the references and misses of every cache */
+void
+cheetah_reg_stats(struct cheetah_t *ch,	/* cheetah instance */
+		  struct stat_sdb_t *sdb);/* stats database */
+
+/* print the miss ratios of all caches of CH as tables */
+void
+cheetah_print(struct cheetah_t *ch,	/* cheetah instance */
+	      FILE *stream);		/* output stream */
+
+/* free CH */
+void
+cheetah_free(struct cheetah_t *ch);	/* cheetah instance */
+
+#endif /* CHEETAH_H */
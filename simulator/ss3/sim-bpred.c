@@ -51,7 +51,10 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
 #include <math.h>
+#include <pthread.h>
 
 #include "host.h"
 #include "misc.h"
@@ -59,11 +62,14 @@
 #include "regs.h"
 #include "memory.h"
 #include "loader.h"
+#include "symbol.h"
 #include "syscall.h"
 #include "dlite.h"
 #include "options.h"
 #include "stats.h"
 #include "bpred.h"
+#include "bptrace.h"
+#include "cbptrace.h"
 #include "sim.h"
 
 /*
@@ -100,13 +106,100 @@ static int comb_config[1] =
 /* return address stack (RAS) size */
 static int ras_size = 8;
 
+/* RAS overflow behavior {wrap|stop|repeat} */
+static char *ras_overflow_opt;
+
 /* BTB predictor config (<num_sets> <associativity>) */
 static int btb_nelt = 2;
 static int btb_config[2] =
   { /* nsets */512, /* assoc */4 };
 
-/* branch predictor */
-static struct bpred_t *pred;
+/* BTB partial tag width, 0 for full tags */
+static int btb_tag_bits = 0;
+
+/* ITTAGE indirect target predictor config (<num_tables> <table_size>
+   <min_hist> <max_hist> <tag_bits>), no tables for none */
+static int ittage_nelt = 5;
+static int ittage_config[5] =
+  { /* tables */0, /* table size */512, /* min hist */4, /* max hist */64,
+    /* tag bits */9 };
+
+/* statistical corrector config (<num_tables> <table_size> <min_hist>
+   <max_hist>), no tables for none */
+static int sc_nelt = 4;
+static int sc_config[4] =
+  { /* tables */0, /* table size */1024, /* min hist */4, /* max hist */32 };
+
+/* loop predictor entries, 0 for none */
+static int loop_entries = 0;
+
+/* predictor snapshot to start from, if any */
+static char *bpred_load_fname = NULL;
+
+/* predictor snapshot to save at the end of the run, if any */
+static char *bpred_save_fname = NULL;
+
+/* branches to print from the per-branch profiles, 0 for no profiles */
+static int bpred_prof_top = 0;
+
+/* perceptron predictor config (<table_size> <weight_bits> <hist_size>) */
+static int perceptron_nelt = 3;
+static int perceptron_config[3] =
+  { /* table size */128, /* weight bits */8, /* hist */27 };
+
+/* Alpha 21264 predictor config (<local_hist_size> <pred_table_size>
+   <hist_width> <choice_size>) */
+static int alpha21264_nelt = 4;
+static int alpha21264_config[4] =
+  { /* local hist */1024, /* pred tables */1024, /* hist */10,
+    /* choice */4096 };
+
+/* TAGE predictor config (<base_size> <num_tables> <table_size>
+   <min_hist> <max_hist> <tag_bits>) */
+static int tage_nelt = 6;
+static int tage_config[6] =
+  { /* base */4096, /* tables */7, /* table size */1024, /* min hist */5,
+    /* max hist */130, /* tag bits */9 };
+
+/* hashed perceptron config (<num_tables> <table_size> <weight_bits>
+   <hist_size>) */
+static int hperc_nelt = 4;
+static int hperc_config[4] =
+  { /* tables */8, /* table size */1024, /* weight bits */8,
+    /* hist */256 };
+
+/* predictor sweep, one predictor spec per entry */
+#define MAX_SWEEP_PREDS		64
+static int sweep_nelt = 0;
+static char *sweep_specs[MAX_SWEEP_PREDS];
+
+/* longest argument list of a predictor spec (comb, tage) */
+#define MAX_SPEC_ARGS		6
+
+/* branch predictors, all fed the same branch stream */
+static int npreds = 0;
+static struct bpred_t *preds[MAX_SWEEP_PREDS];
+
+/* per-predictor update records for the branch in flight */
+static struct bpred_update_t update_recs[MAX_SWEEP_PREDS];
+
+/* branch trace file to capture, NULL for none */
+static char *bptrace_fname = NULL;
+
+/* replay the branch trace named in place of the program */
+static int bptrace_replay = FALSE;
+
+/* the replayed trace is a CBP (BT9) trace */
+static int bptrace_cbp = FALSE;
+
+/* branch trace being captured or replayed */
+static struct bptrace_t *bptrace = NULL;
+
+/* CBP trace to replay, streamed by each replay worker on its own */
+static char *cbp_fname = NULL;
+
+/* replay worker threads, predictors are dealt out among them */
+static int replay_threads = 1;
 
 /* track number of insn and refs */
 static counter_t sim_num_refs = 0;
@@ -145,11 +238,29 @@ sim_reg_options(struct opt_odb_t *odb)
 	       &max_insts, /* default */0,
 	       /* print */TRUE, /* format */NULL);
 
+  opt_reg_note(odb,
+"  Predictor sweep runs several predictors side by side over a single\n"
+"  emulation pass; give `-bpred:sweep <spec>' once per predictor.  Each\n"
+"  spec is <type>[:<arg>,<arg>...],\n"
+"  where the arguments are those of the -bpred:<type> option (comb takes\n"
+"  <bimod_size>,<l1size>,<l2size>,<hist_size>,<xor>,<meta_table_size>) and\n"
+"  default to that option's value; the BTB and RAS options are shared.\n"
+"  Stats of each predictor are named after its spec, e.g., spec\n"
+"  `2lev:1,4096,12,1' reports as `bpred_2lev_1_4096_12_1.*'.\n"
+	       );
+
   opt_reg_string(odb, "-bpred",
-		 "branch predictor type {nottaken|taken|bimod|2lev|comb}",
+		 "branch predictor type "
+		 "{nottaken|taken|bimod|2lev|comb|perceptron|alpha21264|tage|hperc}",
                  &pred_type, /* default */"bimod",
                  /* print */TRUE, /* format */NULL);
 
+  opt_reg_string_list(odb, "-bpred:sweep",
+		      "predictor spec to sweep in the same pass, "
+		      "overrides -bpred (<type>[:<args>])",
+		      sweep_specs, MAX_SWEEP_PREDS, &sweep_nelt, NULL,
+		      /* print */TRUE, /* format */NULL, /* accrue */TRUE);
+
   opt_reg_int_list(odb, "-bpred:bimod",
 		   "bimodal predictor config (<table size>)",
 		   bimod_config, bimod_nelt, &bimod_nelt,
@@ -169,42 +280,178 @@ sim_reg_options(struct opt_odb_t *odb)
 		   /* default */comb_config,
 		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
 
+  opt_reg_int_list(odb, "-bpred:perceptron",
+		   "perceptron predictor config "
+		   "(<table_size> <weight_bits> <hist_size>)",
+		   perceptron_config, perceptron_nelt, &perceptron_nelt,
+		   /* default */perceptron_config,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
+  opt_reg_int_list(odb, "-bpred:alpha21264",
+		   "Alpha 21264 tournament predictor config "
+		   "(<local_hist_size> <pred_table_size> <hist_width> "
+		   "<choice_size>)",
+		   alpha21264_config, alpha21264_nelt, &alpha21264_nelt,
+		   /* default */alpha21264_config,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
+  opt_reg_int_list(odb, "-bpred:tage",
+		   "TAGE predictor config "
+		   "(<base_size> <num_tables> <table_size> <min_hist> "
+		   "<max_hist> <tag_bits>)",
+		   tage_config, tage_nelt, &tage_nelt,
+		   /* default */tage_config,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
+  opt_reg_int_list(odb, "-bpred:hperc",
+		   "hashed perceptron config "
+		   "(<num_tables> <table_size> <weight_bits> <hist_size>)",
+		   hperc_config, hperc_nelt, &hperc_nelt,
+		   /* default */hperc_config,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
   opt_reg_int(odb, "-bpred:ras",
               "return address stack size (0 for no return stack)",
               &ras_size, /* default */ras_size,
               /* print */TRUE, /* format */NULL);
 
+  opt_reg_string(odb, "-bpred:ras_overflow",
+		 "return address stack overflow behavior {wrap|stop|repeat}",
+		 &ras_overflow_opt, /* default */"wrap",
+		 /* print */TRUE, /* format */NULL);
+
   opt_reg_int_list(odb, "-bpred:btb",
 		   "BTB config (<num_sets> <associativity>)",
 		   btb_config, btb_nelt, &btb_nelt,
 		   /* default */btb_config,
 		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
+  opt_reg_int(odb, "-bpred:btb_tag",
+	      "BTB partial tag width, in bits (0 for full tags)",
+	      &btb_tag_bits, /* default */btb_tag_bits,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int_list(odb, "-bpred:ittage",
+		   "ITTAGE indirect target predictor config (<num_tables> "
+		   "<table_size> <min_hist> <max_hist> <tag_bits>), "
+		   "0 tables for none",
+		   ittage_config, ittage_nelt, &ittage_nelt,
+		   /* default */ittage_config,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
+  opt_reg_int_list(odb, "-bpred:sc",
+		   "statistical corrector config (<num_tables> <table_size> "
+		   "<min_hist> <max_hist>), 0 tables for none",
+		   sc_config, sc_nelt, &sc_nelt,
+		   /* default */sc_config,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
+  opt_reg_int(odb, "-bpred:loop",
+	      "loop predictor entries (0 for none)",
+	      &loop_entries, /* default */loop_entries,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_string(odb, "-bpred:load",
+		 "restore predictor state from this snapshot",
+		 &bpred_load_fname, /* default */NULL,
+		 /* print */TRUE, /* format */NULL);
+
+  opt_reg_string(odb, "-bpred:save",
+		 "save predictor state to this snapshot at the end of the run",
+		 &bpred_save_fname, /* default */NULL,
+		 /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-bpred:profile",
+	      "print the branches with the most mispredictions, this many "
+	      "(0 for none)",
+	      &bpred_prof_top, /* default */0,
+	      /* print */TRUE, /* format */NULL);
+
+  /* branch trace options */
+  opt_reg_note(odb,
+"  A branch trace (-bptrace) records every executed control instruction.\n"
+"  With -bptrace:replay, the program argument names such a trace instead,\n"
+"  and the predictors are driven from it without emulating the program;\n"
+"  memory reference counts are not part of the trace.  Replay of a sweep\n"
+"  can be spread over threads (-bptrace:threads), which all read the same\n"
+"  mapped trace, each driving its own share of the predictors.\n"
+"  Championship Branch Prediction (BT9) traces, raw or gzip'ed, can be\n"
+"  replayed with -bptrace:cbp; they are streamed rather than mapped, once\n"
+"  per thread.\n"
+	       );
+
+  opt_reg_string(odb, "-bptrace",
+		 "capture a branch trace of the program to this file",
+		 &bptrace_fname, /* default */NULL,
+		 /* print */TRUE, /* format */NULL);
+
+  opt_reg_flag(odb, "-bptrace:replay",
+	       "replay a branch trace given in place of the program",
+	       &bptrace_replay, /* default */FALSE,
+	       /* print */TRUE, /* format */NULL);
+
+  opt_reg_flag(odb, "-bptrace:cbp",
+	       "replayed trace is a CBP (BT9) trace, optionally gzip'ed",
+	       &bptrace_cbp, /* default */FALSE,
+	       /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-bptrace:threads",
+	      "worker threads for trace replay, each runs a share of "
+	      "the predictors",
+	      &replay_threads, /* default */replay_threads,
+	      /* print */TRUE, /* format */NULL);
 }
 
-/* check simulator-specific option values */
-void
-sim_check_options(struct opt_odb_t *odb, int argc, char **argv)
+/* fill CFG with the N-value config of a predictor, taken from the NARGS
+   spec arguments ARGS if given, else from the option list OPT of NOPT
+   values; returns FALSE if the config has the wrong number of values */
+static int
+pred_config(int *cfg, int n,		/* config to fill, and its size */
+	    int nargs, int *args,	/* spec arguments, if any */
+	    int nopt, int *opt)		/* option values */
 {
-  if (!mystricmp(pred_type, "taken"))
+  if (!nargs)
     {
-      /* static predictor, not taken */
-      pred = bpred_create(BPredTaken, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+      nargs = nopt;
+      args = opt;
     }
-  else if (!mystricmp(pred_type, "nottaken"))
+  if (nargs != n)
+    return FALSE;
+
+  memcpy(cfg, args, n * sizeof(int));
+  return TRUE;
+}
+
+/* create a predictor of type TYPE, configured by the NARGS values in ARGS,
+   or by the matching -bpred:<type> options if NARGS is zero */
+static struct bpred_t *
+pred_create(char *type,			/* predictor type */
+	    int nargs, int *args)	/* spec arguments, if any */
+{
+  int cfg[MAX_SPEC_ARGS];
+
+  if (!mystricmp(type, "taken"))
     {
       /* static predictor, taken */
-      pred = bpred_create(BPredNotTaken, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+      if (nargs)
+	fatal("predictor `taken' takes no config");
+      return bpred_create(BPredTaken, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
     }
-  else if (!mystricmp(pred_type, "bimod"))
+  else if (!mystricmp(type, "nottaken"))
     {
-      if (bimod_nelt != 1)
+      /* static predictor, not taken */
+      if (nargs)
+	fatal("predictor `nottaken' takes no config");
+      return bpred_create(BPredNotTaken, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    }
+  else if (!mystricmp(type, "bimod"))
+    {
+      if (!pred_config(cfg, 1, nargs, args, bimod_nelt, bimod_config))
 	fatal("bad bimod predictor config (<table_size>)");
-      if (btb_nelt != 2)
-	fatal("bad btb config (<num_sets> <associativity>)");
 
       /* bimodal predictor, bpred_create() checks BTB_SIZE */
-      pred = bpred_create(BPred2bit,
-			  /* bimod table size */bimod_config[0],
+      return bpred_create(BPred2bit,
+			  /* bimod table size */cfg[0],
 			  /* 2lev l1 size */0,
 			  /* 2lev l2 size */0,
 			  /* meta table size */0,
@@ -212,58 +459,294 @@ sim_check_options(struct opt_odb_t *odb, int argc, char **argv)
 			  /* history xor address */0,
 			  /* btb sets */btb_config[0],
 			  /* btb assoc */btb_config[1],
+			  /* btb tag bits */btb_tag_bits,
 			  /* ret-addr stack size */ras_size);
     }
-  else if (!mystricmp(pred_type, "2lev"))
+  else if (!mystricmp(type, "2lev"))
     {
       /* 2-level adaptive predictor, bpred_create() checks args */
-      if (twolev_nelt != 4)
+      if (!pred_config(cfg, 4, nargs, args, twolev_nelt, twolev_config))
 	fatal("bad 2-level pred config (<l1size> <l2size> <hist_size> <xor>)");
-      if (btb_nelt != 2)
-	fatal("bad btb config (<num_sets> <associativity>)");
 
-      pred = bpred_create(BPred2Level,
+      return bpred_create(BPred2Level,
 			  /* bimod table size */0,
-			  /* 2lev l1 size */twolev_config[0],
-			  /* 2lev l2 size */twolev_config[1],
+			  /* 2lev l1 size */cfg[0],
+			  /* 2lev l2 size */cfg[1],
 			  /* meta table size */0,
-			  /* history reg size */twolev_config[2],
-			  /* history xor address */twolev_config[3],
+			  /* history reg size */cfg[2],
+			  /* history xor address */cfg[3],
 			  /* btb sets */btb_config[0],
 			  /* btb assoc */btb_config[1],
+			  /* btb tag bits */btb_tag_bits,
 			  /* ret-addr stack size */ras_size);
     }
-  else if (!mystricmp(pred_type, "comb"))
+  else if (!mystricmp(type, "comb"))
     {
       /* combining predictor, bpred_create() checks args */
-      if (twolev_nelt != 4)
-	fatal("bad 2-level pred config (<l1size> <l2size> <hist_size> <xor>)");
-      if (bimod_nelt != 1)
-	fatal("bad bimod predictor config (<table_size>)");
-      if (comb_nelt != 1)
-	fatal("bad combining predictor config (<meta_table_size>)");
-      if (btb_nelt != 2)
-	fatal("bad btb config (<num_sets> <associativity>)");
-
-      pred = bpred_create(BPredComb,
-			  /* bimod table size */bimod_config[0],
-			  /* l1 size */twolev_config[0],
-			  /* l2 size */twolev_config[1],
-			  /* meta table size */comb_config[0],
-			  /* history reg size */twolev_config[2],
-			  /* history xor address */twolev_config[3],
+      if (nargs)
+	{
+	  if (nargs != 6)
+	    fatal("bad combining predictor spec (<bimod_size>,<l1size>,"
+		  "<l2size>,<hist_size>,<xor>,<meta_table_size>)");
+	  memcpy(cfg, args, 6 * sizeof(int));
+	}
+      else
+	{
+	  if (twolev_nelt != 4)
+	    fatal("bad 2-level pred config "
+		  "(<l1size> <l2size> <hist_size> <xor>)");
+	  if (bimod_nelt != 1)
+	    fatal("bad bimod predictor config (<table_size>)");
+	  if (comb_nelt != 1)
+	    fatal("bad combining predictor config (<meta_table_size>)");
+	  cfg[0] = bimod_config[0];
+	  memcpy(cfg + 1, twolev_config, 4 * sizeof(int));
+	  cfg[5] = comb_config[0];
+	}
+
+      return bpred_create(BPredComb,
+			  /* bimod table size */cfg[0],
+			  /* l1 size */cfg[1],
+			  /* l2 size */cfg[2],
+			  /* meta table size */cfg[5],
+			  /* history reg size */cfg[3],
+			  /* history xor address */cfg[4],
 			  /* btb sets */btb_config[0],
 			  /* btb assoc */btb_config[1],
+			  /* btb tag bits */btb_tag_bits,
+			  /* ret-addr stack size */ras_size);
+    }
+  else if (!mystricmp(type, "perceptron"))
+    {
+      /* perceptron predictor, bpred_create() checks args */
+      if (!pred_config(cfg, 3, nargs, args,
+		       perceptron_nelt, perceptron_config))
+	fatal("bad perceptron predictor config "
+	      "(<table_size> <weight_bits> <hist_size>)");
+
+      return bpred_create(BPredPerc,
+			  /* bimod table size */0,
+			  /* perceptrons */cfg[0],
+			  /* weight bits */cfg[1],
+			  /* meta table size */0,
+			  /* history reg size */cfg[2],
+			  /* history xor address */0,
+			  /* btb sets */btb_config[0],
+			  /* btb assoc */btb_config[1],
+			  /* btb tag bits */btb_tag_bits,
+			  /* ret-addr stack size */ras_size);
+    }
+  else if (!mystricmp(type, "alpha21264"))
+    {
+      /* Alpha 21264 tournament predictor */
+      if (!pred_config(cfg, 4, nargs, args,
+		       alpha21264_nelt, alpha21264_config))
+	fatal("bad Alpha 21264 config (<local_hist_size> <pred_table_size> "
+	      "<hist_width> <choice_size>)");
+
+      return bpred_create(BPredAlpha21264,
+			  /* bimod table size */0,
+			  /* l1 size (local hist) */cfg[0],
+			  /* l2 size (pred tables) */cfg[1],
+			  /* meta table (choice) */cfg[3],
+			  /* history width */cfg[2],
+			  /* xor flag (unused) */0,
+			  /* btb sets */btb_config[0],
+			  /* btb assoc */btb_config[1],
+			  /* btb tag bits */btb_tag_bits,
+			  /* ret-addr stack size */ras_size);
+    }
+  else if (!mystricmp(type, "tage"))
+    {
+      /* TAGE predictor, bpred_create() checks args */
+      if (!pred_config(cfg, 6, nargs, args, tage_nelt, tage_config))
+	fatal("bad TAGE predictor config (<base_size> <num_tables> "
+	      "<table_size> <min_hist> <max_hist> <tag_bits>)");
+
+      return bpred_create(BPredTage,
+			  /* base table size */cfg[0],
+			  /* tagged tables */cfg[1],
+			  /* tagged table size */cfg[2],
+			  /* shortest history */cfg[3],
+			  /* longest history */cfg[4],
+			  /* tag bits */cfg[5],
+			  /* btb sets */btb_config[0],
+			  /* btb assoc */btb_config[1],
+			  /* btb tag bits */btb_tag_bits,
+			  /* ret-addr stack size */ras_size);
+    }
+  else if (!mystricmp(type, "hperc"))
+    {
+      /* hashed perceptron, bpred_create() checks args */
+      if (!pred_config(cfg, 4, nargs, args, hperc_nelt, hperc_config))
+	fatal("bad hashed perceptron config (<num_tables> <table_size> "
+	      "<weight_bits> <hist_size>)");
+
+      return bpred_create(BPredHPerc,
+			  /* bimod table size */0,
+			  /* table size */cfg[1],
+			  /* weight bits */cfg[2],
+			  /* tables */cfg[0],
+			  /* history length */cfg[3],
+			  /* xor */0,
+			  /* btb sets */btb_config[0],
+			  /* btb assoc */btb_config[1],
+			  /* btb tag bits */btb_tag_bits,
 			  /* ret-addr stack size */ras_size);
     }
   else
-    fatal("cannot parse predictor type `%s'", pred_type);
+    fatal("cannot parse predictor type `%s'", type);
+
+  /* not reached */
+  return NULL;
+}
+
+/* create the predictor described by sweep spec SPEC, <type>[:<args>], and
+   name its stats after the spec */
+static struct bpred_t *
+pred_create_spec(char *spec)		/* predictor spec */
+{
+  char type[64], name[128], *p, *q;
+  int args[MAX_SPEC_ARGS], nargs = 0;
+  struct bpred_t *pred;
+
+  /* split off the predictor type */
+  for (p = spec, q = type; *p && *p != ':'; p++)
+    {
+      if (q == type + sizeof(type) - 1)
+	fatal("predictor spec `%s' is too long", spec);
+      *q++ = *p;
+    }
+  *q = '\0';
+
+  /* parse the comma-separated config values */
+  if (*p == ':')
+    {
+      do {
+	p++;
+	if (nargs == MAX_SPEC_ARGS)
+	  fatal("too many values in predictor spec `%s'", spec);
+	args[nargs++] = strtol(p, &q, 0);
+	if (q == p || (*q != ',' && *q != '\0'))
+	  fatal("cannot parse predictor spec `%s'", spec);
+	p = q;
+      } while (*p == ',');
+    }
+
+  pred = pred_create(type, nargs, args);
+
+  /* stat names must be valid expression identifiers */
+  if (strlen(spec) > sizeof(name) - sizeof("bpred_"))
+    fatal("predictor spec `%s' is too long", spec);
+  sprintf(name, "bpred_%s", spec);
+  for (p = name; *p; p++)
+    if (!isalnum((int)*p))
+      *p = '_';
+  pred->name = mystrdup(name);
+
+  return pred;
+}
+
+/* parse the RAS overflow behavior option */
+static enum bpred_ras_overflow
+ras_overflow_mode(char *opt)		/* option value */
+{
+  if (!mystricmp(opt, "wrap"))
+    return RASOverflowWrap;
+  else if (!mystricmp(opt, "stop"))
+    return RASOverflowStop;
+  else if (!mystricmp(opt, "repeat"))
+    return RASOverflowRepeat;
+
+  fatal("bad return address stack overflow behavior `%s', "
+	"use {wrap|stop|repeat}", opt);
+  return RASOverflowWrap;
+}
+
+/* check simulator-specific option values */
+void
+sim_check_options(struct opt_odb_t *odb, int argc, char **argv)
+{
+  int i, j;
+
+  if (btb_nelt != 2)
+    fatal("bad btb config (<num_sets> <associativity>)");
+  if (ittage_config[0] && ittage_nelt != 5)
+    fatal("bad ITTAGE config (<num_tables> <table_size> <min_hist> "
+	  "<max_hist> <tag_bits>)");
+  if (sc_config[0] && sc_nelt != 4)
+    fatal("bad statistical corrector config (<num_tables> <table_size> "
+	  "<min_hist> <max_hist>)");
+  if (loop_entries < 0)
+    fatal("loop predictor entries must be non-negative");
+
+  if (bptrace_replay && bptrace_fname)
+    fatal("cannot capture a branch trace while replaying one");
+  if (bptrace_cbp && !bptrace_replay)
+    fatal("-bptrace:cbp only applies to trace replay");
+  if (replay_threads < 1)
+    fatal("replay needs at least one thread");
+
+  if (!sweep_nelt)
+    {
+      /* a single predictor, selected by -bpred */
+      preds[npreds++] = pred_create(pred_type, 0, NULL);
+    }
+  else
+    {
+      for (i = 0; i < sweep_nelt; i++)
+	{
+	  preds[npreds++] = pred_create_spec(sweep_specs[i]);
+	  for (j = 0; j < i; j++)
+	    if (!strcmp(preds[j]->name, preds[i]->name))
+	      fatal("predictor spec `%s' appears twice in the sweep",
+		    sweep_specs[i]);
+	}
+    }
+
+  for (i = 0; i < npreds; i++)
+    bpred_retstack_mode(preds[i], 0, ras_overflow_mode(ras_overflow_opt));
+
+  /* back every stateful predictor with its own indirect target
+     predictor, statistical corrector and loop predictor */
+  for (i = 0; i < npreds; i++)
+    if (preds[i]->class != BPredTaken && preds[i]->class != BPredNotTaken)
+      bpred_components(preds[i],
+		       ittage_config[0]
+		       ? bpred_ittage_create(/* tables */ittage_config[0],
+					     /* table size */ittage_config[1],
+					     /* min hist */ittage_config[2],
+					     /* max hist */ittage_config[3],
+					     /* tag bits */ittage_config[4])
+		       : NULL,
+		       sc_config[0]
+		       ? bpred_sc_create(/* tables */sc_config[0],
+					 /* table size */sc_config[1],
+					 /* min hist */sc_config[2],
+					 /* max hist */sc_config[3])
+		       : NULL,
+		       loop_entries ? bpred_loop_create(loop_entries) : NULL);
+
+  /* a snapshot holds one predictor */
+  if ((bpred_load_fname || bpred_save_fname) && npreds != 1)
+    fatal("predictor snapshots (-bpred:load, -bpred:save) need a single "
+	  "predictor, not a sweep");
+  if (bpred_load_fname)
+    bpred_load(preds[0], bpred_load_fname);
+
+  if (bpred_prof_top < 0)
+    fatal("branch profile size must be non-negative");
+  if (bpred_prof_top)
+    for (i = 0; i < npreds; i++)
+      bpred_profile(preds[i]);
 }
 
 /* register simulator-specific statistics */
 void
 sim_reg_stats(struct stat_sdb_t *sdb)
 {
+  int i;
+
   stat_reg_counter(sdb, "sim_num_insn",
 		   "total number of instructions executed",
 		   &sim_num_insn, sim_num_insn, NULL);
@@ -285,8 +768,8 @@ sim_reg_stats(struct stat_sdb_t *sdb)
                    "sim_num_insn / sim_num_branches", /* format */NULL);
 
   /* register predictor stats */
-  if (pred)
-    bpred_reg_stats(pred, sdb);
+  for (i = 0; i < npreds; i++)
+    bpred_reg_stats(preds[i], sdb);
 }
 
 /* initialize the simulator */
@@ -323,6 +806,16 @@ sim_load_prog(char *fname,		/* program to load */
 	      int argc, char **argv,	/* program arguments */
 	      char **envp)		/* program environment */
 {
+  if (bptrace_replay)
+    {
+      /* no program to load, the trace stands in for it */
+      if (bptrace_cbp)
+	cbp_fname = fname;
+      else
+	bptrace = bptrace_open(fname);
+      return;
+    }
+
   /* load program text and data, set up environment, memory, and regs */
   ld_load_prog(fname, argc, argv, envp, &regs, mem, TRUE);
 
@@ -337,18 +830,51 @@ sim_aux_config(FILE *stream)		/* output stream */
   /* nothing currently */
 }
 
+/* function containing PC, for the branch profiles */
+static char *
+prof_sym(md_addr_t pc, int *offset)
+{
+  struct sym_sym_t *sym;
+  int index;
+
+  if (!(sym = sym_bind_addr(pc, &index, /* !exact */FALSE, sdb_text)))
+    return NULL;
+  *offset = (int)(pc - sym->addr);
+  return sym->name;
+}
+
 /* dump simulator-specific auxiliary simulator statistics */
 void
 sim_aux_stats(FILE *stream)		/* output stream */
 {
-  /* nada */
+  int i;
+
+  if (!bpred_prof_top)
+    return;
+
+  /* a replayed trace comes without its program, and its symbols */
+  if (!bptrace_replay)
+    sym_loadsyms(ld_prog_fname, /* !locals */FALSE);
+  for (i = 0; i < npreds; i++)
+    bpred_profile_print(preds[i], bpred_prof_top,
+			bptrace_replay ? NULL : prof_sym, stream);
 }
 
 /* un-initialize simulator-specific state */
 void
 sim_uninit(void)
 {
-  /* nada */
+  if (bpred_save_fname)
+    bpred_save(preds[0], bpred_save_fname);
+
+  if (bptrace)
+    {
+      if (bptrace_replay)
+	bptrace_free(bptrace);
+      else
+	bptrace_close(bptrace, sim_num_insn);
+      bptrace = NULL;
+    }
 }
 
 
@@ -436,6 +962,146 @@ sim_uninit(void)
 /* system call handler macro */
 #define SYSCALL(INST)	sys_syscall(&regs, mem_access, mem, INST, TRUE)
 
+/* run the branch at PC, with target TARGET and actual next PC NPC,
+   through predictors FIRST, FIRST+STEP, FIRST+2*STEP, ... */
+static void
+pred_branch(int first, int step,	/* predictors to run */
+	    md_addr_t pc,		/* branch address */
+	    md_addr_t target,		/* branch target if taken */
+	    md_addr_t npc,		/* resolved next PC */
+	    enum md_opcode op,		/* branch opcode */
+	    int is_call,		/* non-zero if branch is fn call */
+	    int is_return)		/* non-zero if branch is fn return */
+{
+  md_addr_t pred_PC;
+  int i, stack_idx;
+
+  for (i = first; i < npreds; i += step)
+    {
+      struct bpred_t *pred = preds[i];
+
+      /* get the next predicted fetch address */
+      pred_PC = bpred_lookup(pred,
+			     /* branch addr */pc,
+			     /* target */target,
+			     /* inst opcode */op,
+			     /* call? */is_call,
+			     /* return? */is_return,
+			     /* stash an update ptr */&update_recs[i],
+			     /* stash return stack ptr */&stack_idx);
+
+      /* valid address returned from branch predictor? */
+      if (!pred_PC)
+	{
+	  /* no predicted taken target, attempt not taken target */
+	  pred_PC = pc + sizeof(md_inst_t);
+	}
+
+      bpred_update(pred,
+		   /* branch addr */pc,
+		   /* resolved branch target */npc,
+		   /* taken? */npc != (pc + sizeof(md_inst_t)),
+		   /* pred taken? */pred_PC != (pc + sizeof(md_inst_t)),
+		   /* correct pred? */pred_PC == npc,
+		   /* opcode */op,
+		   /* predictor update pointer */&update_recs[i]);
+    }
+}
+
+/* trace replay worker, drives its share of the predictors over the whole
+   trace through a private cursor; predictors are never shared between
+   workers, so no locking is needed */
+struct replay_worker_t {
+  pthread_t thread;		/* worker thread */
+  int first, step;		/* predictors FIRST, FIRST+STEP, ... */
+  counter_t num_insn;		/* instructions replayed */
+  counter_t num_branches;	/* branches replayed */
+};
+
+static void *
+replay_worker(void *arg)
+{
+  struct replay_worker_t *w = arg;
+  struct bptrace_cursor_t cursor;
+  struct cbptrace_t *cbp = NULL;
+  struct bptrace_rec_t rec;
+  md_addr_t next_PC = 0;
+  counter_t ninsts;
+
+  w->num_insn = w->num_branches = 0;
+  if (cbp_fname)
+    cbp = cbptrace_open(cbp_fname);
+  else
+    {
+      bptrace_rewind(bptrace, &cursor);
+      next_PC = bptrace->hdr.start_pc;
+    }
+
+  while (cbp
+	 ? cbptrace_read(cbp, &rec, &ninsts)
+	 : bptrace_read(bptrace, &cursor, &rec))
+    {
+      /* instructions since the previous branch ran in sequence */
+      if (!cbp)
+	ninsts = (rec.pc - next_PC) / sizeof(md_inst_t) + 1;
+      w->num_insn += ninsts;
+      w->num_branches++;
+
+      next_PC = rec.taken ? rec.target : rec.pc + sizeof(md_inst_t);
+      pred_branch(w->first, w->step, rec.pc, rec.target, next_PC, rec.op,
+		  rec.is_call, rec.is_return);
+
+      /* finish early? */
+      if (max_insts && w->num_insn >= max_insts)
+	break;
+    }
+
+  if (cbp)
+    cbptrace_close(cbp);
+  else if (!max_insts || w->num_insn < max_insts)
+    {
+      /* include the instructions after the last branch */
+      w->num_insn = bptrace->hdr.ninsts;
+    }
+  return NULL;
+}
+
+/* drive the predictors from the branch trace being replayed */
+static void
+replay_main(void)
+{
+  struct replay_worker_t *workers;
+  int i, nworkers = MIN(replay_threads, npreds);
+
+  fprintf(stderr, "sim: ** replaying branch trace w/ predictors "
+	  "on %d thread(s) **\n", nworkers);
+
+  if (!(workers = calloc(nworkers, sizeof(struct replay_worker_t))))
+    fatal("out of virtual memory");
+  for (i = 0; i < nworkers; i++)
+    {
+      workers[i].first = i;
+      workers[i].step = nworkers;
+    }
+
+  if (nworkers == 1)
+    replay_worker(&workers[0]);
+  else
+    {
+      for (i = 0; i < nworkers; i++)
+	if (pthread_create(&workers[i].thread, NULL,
+			   replay_worker, &workers[i]) != 0)
+	  fatal("cannot start replay thread");
+      for (i = 0; i < nworkers; i++)
+	pthread_join(workers[i].thread, NULL);
+    }
+
+  /* every worker saw the same branch stream */
+  sim_num_insn = workers[0].num_insn;
+  sim_num_branches = workers[0].num_branches;
+  free(workers);
+}
+
 /* start simulation, program loaded, processor precise state initialized */
 void
 sim_main(void)
@@ -444,11 +1110,19 @@ sim_main(void)
   register md_addr_t addr, target_PC = 0;
   enum md_opcode op;
   register int is_write;
-  int stack_idx;
   enum md_fault_type fault;
 
+  if (bptrace_replay)
+    {
+      replay_main();
+      return;
+    }
+
   fprintf(stderr, "sim: ** starting functional simulation w/ predictors **\n");
 
+  if (bptrace_fname)
+    bptrace = bptrace_create(bptrace_fname, regs.regs_PC);
+
   /* set up initial default next PC */
   regs.regs_NPC = regs.regs_PC + sizeof(md_inst_t);
 
@@ -510,41 +1184,16 @@ sim_main(void)
 
       if (MD_OP_FLAGS(op) & F_CTRL)
 	{
-	  md_addr_t pred_PC;
-	  struct bpred_update_t update_rec;
-
 	  sim_num_branches++;
 
-	  if (pred)
-	    {
-	      /* get the next predicted fetch address */
-	      pred_PC = bpred_lookup(pred,
-				     /* branch addr */regs.regs_PC,
-				     /* target */target_PC,
-				     /* inst opcode */op,
-				     /* call? */MD_IS_CALL(op),
-				     /* return? */MD_IS_RETURN(op),
-				     /* stash an update ptr */&update_rec,
-				     /* stash return stack ptr */&stack_idx);
-
-	      /* valid address returned from branch predictor? */
-	      if (!pred_PC)
-		{
-		  /* no predicted taken target, attempt not taken target */
-		  pred_PC = regs.regs_PC + sizeof(md_inst_t);
-		}
-
-	      bpred_update(pred,
-			   /* branch addr */regs.regs_PC,
-			   /* resolved branch target */regs.regs_NPC,
-			   /* taken? */regs.regs_NPC != (regs.regs_PC +
-							 sizeof(md_inst_t)),
-			   /* pred taken? */pred_PC != (regs.regs_PC +
-							sizeof(md_inst_t)),
-			   /* correct pred? */pred_PC == regs.regs_NPC,
-			   /* opcode */op,
-			   /* predictor update pointer */&update_rec);
-	    }
+	  if (bptrace)
+	    bptrace_write(bptrace, regs.regs_PC, target_PC, op,
+			  /* taken? */regs.regs_NPC != (regs.regs_PC +
+						     sizeof(md_inst_t)),
+			  MD_IS_CALL(op), MD_IS_RETURN(op));
+
+	  pred_branch(0, 1, regs.regs_PC, target_PC, regs.regs_NPC, op,
+		      MD_IS_CALL(op), MD_IS_RETURN(op));
 	}
 
       /* check for DLite debugger entry condition */
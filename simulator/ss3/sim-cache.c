@@ -649,12 +649,12 @@ sim_uninit(void)
 /* precise architected memory state accessor macros */
 #define __READ_CACHE(addr, SRC_T)					\
   ((dtlb								\
-    ? cache_access(dtlb, Read, (addr), NULL,				\
-		   sizeof(SRC_T), 0, NULL, NULL)			\
+    ? cache_access_fast(dtlb, Read, (addr), NULL,			\
+			sizeof(SRC_T), 0, NULL, NULL)			\
     : 0),								\
    (cache_dl1								\
-    ? cache_access(cache_dl1, Read, (addr), NULL,			\
-		   sizeof(SRC_T), 0, NULL, NULL)			\
+    ? cache_access_fast(cache_dl1, Read, (addr), NULL,			\
+			sizeof(SRC_T), 0, NULL, NULL)			\
     : 0))
 
 #define READ_BYTE(SRC, FAULT)						\
@@ -674,12 +674,12 @@ sim_uninit(void)
 
 #define __WRITE_CACHE(addr, DST_T)					\
   ((dtlb								\
-    ? cache_access(dtlb, Write, (addr), NULL,				\
-		   sizeof(DST_T), 0, NULL, NULL)			\
+    ? cache_access_fast(dtlb, Write, (addr), NULL,			\
+			sizeof(DST_T), 0, NULL, NULL)			\
     : 0),								\
    (cache_dl1								\
-    ? cache_access(cache_dl1, Write, (addr), NULL,			\
-		   sizeof(DST_T), 0, NULL, NULL)			\
+    ? cache_access_fast(cache_dl1, Write, (addr), NULL,			\
+			sizeof(DST_T), 0, NULL, NULL)			\
     : 0))
 
 #define WRITE_BYTE(SRC, DST, FAULT)					\
@@ -752,11 +752,11 @@ sim_main(void)
 
       /* get the next instruction to execute */
       if (itlb)
-	cache_access(itlb, Read, IACOMPRESS(regs.regs_PC),
-		     NULL, ISCOMPRESS(sizeof(md_inst_t)), 0, NULL, NULL);
+	cache_access_fast(itlb, Read, IACOMPRESS(regs.regs_PC),
+			  NULL, ISCOMPRESS(sizeof(md_inst_t)), 0, NULL, NULL);
       if (cache_il1)
-	cache_access(cache_il1, Read, IACOMPRESS(regs.regs_PC),
-		     NULL, ISCOMPRESS(sizeof(md_inst_t)), 0, NULL, NULL);
+	cache_access_fast(cache_il1, Read, IACOMPRESS(regs.regs_PC),
+			  NULL, ISCOMPRESS(sizeof(md_inst_t)), 0, NULL, NULL);
       MD_FETCH_INST(inst, mem, regs.regs_PC);
 
       /* keep an instruction count */
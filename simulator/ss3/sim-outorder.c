@@ -62,8 +62,10 @@
 #include "memory.h"
 #include "cache.h"
 #include "loader.h"
+#include "symbol.h"
 #include "syscall.h"
 #include "bpred.h"
+#include "bptrace.h"
 #include "resource.h"
 #include "bitmap.h"
 #include "options.h"
@@ -97,6 +99,13 @@ static unsigned int max_insts;
 /* number of insts skipped before timing starts */
 static int fastfwd_count;
 
+/* branch trace of the fast-forwarded insts, NULL for none */
+static char *bptrace_fname = NULL;
+
+/* branch trace being captured, and the number of insts it covers */
+static struct bptrace_t *bptrace = NULL;
+static counter_t bptrace_ninsts = 0;
+
 /* pipeline trace range and output filename */
 static int ptrace_nelt = 0;
 static char *ptrace_opts[2];
@@ -143,11 +152,51 @@ static int perceptron_config[3] =
 /* return address stack (RAS) size */
 static int ras_size = 8;
 
+/* top RAS entries checkpointed per branch (0 to restore the TOS only) */
+static int ras_ckpt = 0;
+
+/* RAS overflow behavior {wrap|stop|repeat} */
+static char *ras_overflow_opt;
+
 /* BTB predictor config (<num_sets> <associativity>) */
 static int btb_nelt = 2;
 static int btb_config[2] =
   { /* nsets */512, /* assoc */4 };
 
+/* BTB partial tag width, 0 for full tags */
+static int btb_tag_bits = 0;
+
+/* ITTAGE indirect target predictor config (<num_tables> <table_size>
+   <min_hist> <max_hist> <tag_bits>), no tables for none */
+static int ittage_nelt = 5;
+static int ittage_config[5] =
+  { /* tables */0, /* table size */512, /* min hist */4, /* max hist */64,
+    /* tag bits */9 };
+
+/* statistical corrector config (<num_tables> <table_size> <min_hist>
+   <max_hist>), no tables for none */
+static int sc_nelt = 4;
+static int sc_config[4] =
+  { /* tables */0, /* table size */1024, /* min hist */4, /* max hist */32 };
+
+/* loop predictor entries, 0 for none */
+static int loop_entries = 0;
+
+/* predictor snapshot to restore before timing simulation, if any */
+static char *bpred_load_fname = NULL;
+
+/* predictor snapshot to save, if any */
+static char *bpred_save_fname = NULL;
+
+/* committed insts after which to save it, 0 for the end of the run */
+static unsigned int bpred_save_at = 0;
+
+/* predictor snapshot saved yet? */
+static int bpred_saved = FALSE;
+
+/* branches to print from the per-branch profile, 0 for no profile */
+static int bpred_prof_top = 0;
+
 /* instruction decode B/W (insts/cycle) */
 static int ruu_decode_width;
 
@@ -193,6 +242,26 @@ static char *cache_il2_opt;
 /* l2 instruction cache hit latency (in cycles) */
 static int cache_il2_lat;
 
+/* MSHRs of each cache (<entries> <targets>), no limit on misses if there
+   are no entries */
+static int cache_dl1_mshr_nelt = 2;
+static int cache_dl1_mshr[2] = { /* entries */0, /* targets */4 };
+static int cache_dl2_mshr_nelt = 2;
+static int cache_dl2_mshr[2] = { /* entries */0, /* targets */4 };
+static int cache_il1_mshr_nelt = 2;
+static int cache_il1_mshr[2] = { /* entries */0, /* targets */4 };
+static int cache_il2_mshr_nelt = 2;
+static int cache_il2_mshr[2] = { /* entries */0, /* targets */4 };
+
+/* hardware prefetcher of each cache, i.e., {<config>|none} */
+static char *cache_dl1_pf_opt;
+static char *cache_dl2_pf_opt;
+static char *cache_il1_pf_opt;
+static char *cache_il2_pf_opt;
+
+/* throttle prefetchers to their accuracy */
+static int cache_pf_throttle;
+
 /* flush caches on system calls */
 static int flush_on_syscalls;
 
@@ -414,6 +483,20 @@ static int alpha21264_nelt = 4;
 static int alpha21264_config[4] =
   { 1024, 1024, 10, 4096};
 
+/* TAGE predictor config (<base_size> <num_tables> <table_size>
+   <min_hist> <max_hist> <tag_bits>) */
+static int tage_nelt = 6;
+static int tage_config[6] =
+  { /* base */4096, /* tables */7, /* table size */1024, /* min hist */5,
+    /* max hist */130, /* tag bits */9 };
+
+/* hashed perceptron config (<num_tables> <table_size> <weight_bits>
+   <hist_size>) */
+static int hperc_nelt = 4;
+static int hperc_config[4] =
+  { /* tables */8, /* table size */1024, /* weight bits */8,
+    /* hist */256 };
+
 /* wedge all stat values into a counter_t */
 #define STATVAL(STAT)							\
   ((STAT)->sc == sc_int							\
@@ -454,7 +537,9 @@ dl1_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
 
   if (cache_dl2)
     {
-      /* access next level of data cache hierarchy */
+      /* access next level of data cache hierarchy, on behalf of the same
+	 instruction */
+      cache_dl2->pf_pc = cache_dl1->pf_pc;
       lat = cache_access(cache_dl2, cmd, baddr, NULL, bsize,
 			 /* now */now, /* pudata */NULL, /* repl addr */NULL);
       if (cmd == Read)
@@ -509,6 +594,7 @@ il1_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
 if (cache_il2)
     {
       /* access next level of inst cache hierarchy */
+      cache_il2->pf_pc = cache_il1->pf_pc;
       lat = cache_access(cache_il2, cmd, baddr, NULL, bsize,
 			 /* now */now, /* pudata */NULL, /* repl addr */NULL);
       if (cmd == Read)
@@ -609,6 +695,10 @@ sim_reg_options(struct opt_odb_t *odb)
   opt_reg_int(odb, "-fastfwd", "number of insts skipped before timing starts",
 	      &fastfwd_count, /* default */0,
 	      /* print */TRUE, /* format */NULL);
+  opt_reg_string(odb, "-bptrace",
+		 "capture a branch trace of the fast-forwarded insts to this file",
+		 &bptrace_fname, /* default */NULL,
+		 /* print */TRUE, /* format */NULL);
   opt_reg_string_list(odb, "-ptrace",
 	      "generate pipetrace, i.e., <fname|stdout|stderr> <range>",
 	      ptrace_opts, /* arr_sz */2, &ptrace_nelt, /* default */NULL,
@@ -669,7 +759,7 @@ sim_reg_options(struct opt_odb_t *odb)
 
 
   opt_reg_string(odb, "-bpred",
-               "branch predictor type {nottaken|taken|perfect|bimod|2lev|comb|alpha21264}",
+               "branch predictor type {nottaken|taken|perfect|bimod|2lev|comb|alpha21264|perceptron|tage|hperc}",
                &pred_type, /* default */"bimod",
                /* print */TRUE, /* format */NULL);
 
@@ -680,6 +770,20 @@ sim_reg_options(struct opt_odb_t *odb)
                  /* default */alpha21264_config,
                  /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
 
+  opt_reg_int_list(odb, "-bpred:tage",
+		   "TAGE predictor config (<base_size> <num_tables> "
+		   "<table_size> <min_hist> <max_hist> <tag_bits>)",
+		   tage_config, tage_nelt, &tage_nelt,
+		   /* default */tage_config,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
+  opt_reg_int_list(odb, "-bpred:hperc",
+		   "hashed perceptron config (<num_tables> <table_size> "
+		   "<weight_bits> <hist_size>)",
+		   hperc_config, hperc_nelt, &hperc_nelt,
+		   /* default */hperc_config,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
   opt_reg_int_list(odb, "-bpred:bimod",
 		   "bimodal predictor config (<table size>)",
 		   bimod_config, bimod_nelt, &bimod_nelt,
@@ -716,12 +820,71 @@ sim_reg_options(struct opt_odb_t *odb)
               &ras_size, /* default */ras_size,
               /* print */TRUE, /* format */NULL);
 
+  opt_reg_int(odb, "-bpred:ras_ckpt",
+	      "return address stack entries checkpointed per branch and "
+	      "restored on a misprediction (0 to restore the TOS only)",
+	      &ras_ckpt, /* default */ras_ckpt,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_string(odb, "-bpred:ras_overflow",
+		 "return address stack overflow behavior {wrap|stop|repeat}",
+		 &ras_overflow_opt, /* default */"wrap",
+		 /* print */TRUE, /* format */NULL);
+
   opt_reg_int_list(odb, "-bpred:btb",
 		   "BTB config (<num_sets> <associativity>)",
 		   btb_config, btb_nelt, &btb_nelt,
 		   /* default */btb_config,
 		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
 
+  opt_reg_int(odb, "-bpred:btb_tag",
+	      "BTB partial tag width, in bits (0 for full tags)",
+	      &btb_tag_bits, /* default */btb_tag_bits,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int_list(odb, "-bpred:ittage",
+		   "ITTAGE indirect target predictor config (<num_tables> "
+		   "<table_size> <min_hist> <max_hist> <tag_bits>), "
+		   "0 tables for none",
+		   ittage_config, ittage_nelt, &ittage_nelt,
+		   /* default */ittage_config,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
+  opt_reg_int_list(odb, "-bpred:sc",
+		   "statistical corrector config (<num_tables> <table_size> "
+		   "<min_hist> <max_hist>), 0 tables for none",
+		   sc_config, sc_nelt, &sc_nelt,
+		   /* default */sc_config,
+		   /* print */TRUE, /* format */NULL, /* !accrue */FALSE);
+
+  opt_reg_int(odb, "-bpred:loop",
+	      "loop predictor entries (0 for none)",
+	      &loop_entries, /* default */loop_entries,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_string(odb, "-bpred:load",
+		 "restore predictor state from this snapshot before timing "
+		 "simulation",
+		 &bpred_load_fname, /* default */NULL,
+		 /* print */TRUE, /* format */NULL);
+
+  opt_reg_string(odb, "-bpred:save",
+		 "save predictor state to this snapshot",
+		 &bpred_save_fname, /* default */NULL,
+		 /* print */TRUE, /* format */NULL);
+
+  opt_reg_uint(odb, "-bpred:save_at",
+	       "committed insts after which to save the predictor snapshot "
+	       "(0 for the end of the run)",
+	       &bpred_save_at, /* default */0,
+	       /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-bpred:profile",
+	      "print the branches with the most mispredictions, this many "
+	      "(0 for none)",
+	      &bpred_prof_top, /* default */0,
+	      /* print */TRUE, /* format */NULL);
+
   opt_reg_string(odb, "-bpred:spec_update",
 		 "speculative predictors update in {ID|WB} (default non-spec)",
 		 &bpred_spec_opt, /* default */NULL,
@@ -798,6 +961,33 @@ sim_reg_options(struct opt_odb_t *odb)
 	      &cache_dl1_lat, /* default */1,
 	      /* print */TRUE, /* format */NULL);
 
+  opt_reg_int_list(odb, "-cache:dl1mshr",
+		   "l1 data cache MSHRs (<entries> <targets>), 0 entries for no limit",
+		   cache_dl1_mshr, cache_dl1_mshr_nelt, &cache_dl1_mshr_nelt,
+		   cache_dl1_mshr, /* print */TRUE, /* format */NULL,
+		   /* !accrue */FALSE);
+
+  opt_reg_string(odb, "-cache:dl1pf",
+		 "l1 data cache prefetcher, i.e., {<config>|none}",
+		 &cache_dl1_pf_opt, "none",
+		 /* print */TRUE, NULL);
+
+  opt_reg_note(odb,
+"  The prefetcher config parameter <config> has the following format:\n"
+"\n"
+"    next:<degree>              - next-line, tagged\n"
+"    stride:<entries>:<degree>  - PC-indexed stride, reference prediction table\n"
+"    stream:<buffers>:<depth>   - sequential stream buffers\n"
+"\n"
+"    <degree> - blocks prefetched ahead of each miss or access\n"
+"    <entries> - entries in the reference prediction table, a power of two\n"
+"    <buffers> - number of stream buffers\n"
+"    <depth>  - blocks prefetched into each stream buffer\n"
+"\n"
+"    Examples:   -cache:dl1pf stride:256:4\n"
+"                -cache:dl2pf stream:8:4\n"
+	       );
+
   opt_reg_string(odb, "-cache:dl2",
 		 "l2 data cache config, i.e., {<config>|none}",
 		 &cache_dl2_opt, "ul2:1024:64:4:l",
@@ -808,6 +998,17 @@ sim_reg_options(struct opt_odb_t *odb)
 	      &cache_dl2_lat, /* default */6,
 	      /* print */TRUE, /* format */NULL);
 
+  opt_reg_int_list(odb, "-cache:dl2mshr",
+		   "l2 data cache MSHRs (<entries> <targets>), 0 entries for no limit",
+		   cache_dl2_mshr, cache_dl2_mshr_nelt, &cache_dl2_mshr_nelt,
+		   cache_dl2_mshr, /* print */TRUE, /* format */NULL,
+		   /* !accrue */FALSE);
+
+  opt_reg_string(odb, "-cache:dl2pf",
+		 "l2 data cache prefetcher, i.e., {<config>|none}",
+		 &cache_dl2_pf_opt, "none",
+		 /* print */TRUE, NULL);
+
   opt_reg_string(odb, "-cache:il1",
 		 "l1 inst cache config, i.e., {<config>|dl1|dl2|none}",
 		 &cache_il1_opt, "il1:512:32:1:l",
@@ -832,6 +1033,17 @@ sim_reg_options(struct opt_odb_t *odb)
 	      &cache_il1_lat, /* default */1,
 	      /* print */TRUE, /* format */NULL);
 
+  opt_reg_int_list(odb, "-cache:il1mshr",
+		   "l1 instruction cache MSHRs (<entries> <targets>), 0 entries for no limit",
+		   cache_il1_mshr, cache_il1_mshr_nelt, &cache_il1_mshr_nelt,
+		   cache_il1_mshr, /* print */TRUE, /* format */NULL,
+		   /* !accrue */FALSE);
+
+  opt_reg_string(odb, "-cache:il1pf",
+		 "l1 instruction cache prefetcher, i.e., {<config>|none}",
+		 &cache_il1_pf_opt, "none",
+		 /* print */TRUE, NULL);
+
   opt_reg_string(odb, "-cache:il2",
 		 "l2 instruction cache config, i.e., {<config>|dl2|none}",
 		 &cache_il2_opt, "dl2",
@@ -842,6 +1054,21 @@ sim_reg_options(struct opt_odb_t *odb)
 	      &cache_il2_lat, /* default */6,
 	      /* print */TRUE, /* format */NULL);
 
+  opt_reg_int_list(odb, "-cache:il2mshr",
+		   "l2 instruction cache MSHRs (<entries> <targets>), 0 entries for no limit",
+		   cache_il2_mshr, cache_il2_mshr_nelt, &cache_il2_mshr_nelt,
+		   cache_il2_mshr, /* print */TRUE, /* format */NULL,
+		   /* !accrue */FALSE);
+
+  opt_reg_string(odb, "-cache:il2pf",
+		 "l2 instruction cache prefetcher, i.e., {<config>|none}",
+		 &cache_il2_pf_opt, "none",
+		 /* print */TRUE, NULL);
+
+  opt_reg_flag(odb, "-cache:pfthrottle",
+	       "throttle cache prefetchers to their accuracy",
+	       &cache_pf_throttle, /* default */FALSE, /* print */TRUE, NULL);
+
   opt_reg_flag(odb, "-cache:flush", "flush caches on system calls",
 	       &flush_on_syscalls, /* default */FALSE, /* print */TRUE, NULL);
 
@@ -912,6 +1139,73 @@ sim_reg_options(struct opt_odb_t *odb)
 	       &bugcompat_mode, /* default */FALSE, /* print */TRUE, NULL);
 }
 
+/* parse the RAS overflow behavior option */
+static enum bpred_ras_overflow
+ras_overflow_mode(char *opt)		/* option value */
+{
+  if (!mystricmp(opt, "wrap"))
+    return RASOverflowWrap;
+  else if (!mystricmp(opt, "stop"))
+    return RASOverflowStop;
+  else if (!mystricmp(opt, "repeat"))
+    return RASOverflowRepeat;
+
+  fatal("bad return address stack overflow behavior `%s', "
+	"use {wrap|stop|repeat}", opt);
+  return RASOverflowWrap;
+}
+
+/* give cache CP the MSHRs of option NAME, MSHR[0] entries of MSHR[1]
+   targets each */
+static void
+cache_mshr_opt(struct cache_t *cp,	/* cache instance */
+	       char *name,		/* option name */
+	       int nelt,		/* option values given */
+	       int *mshr)		/* option values */
+{
+  if (nelt != 2)
+    fatal("bad %s MSHR config (<entries> <targets>)", name);
+  if (mshr[0] < 0 || mshr[1] < 1)
+    fatal("%s MSHRs must be non-negative, with at least one target", name);
+  cache_set_mshrs(cp, mshr[0], mshr[1]);
+}
+
+/* give cache CP the prefetcher of option NAME, i.e., OPT, INST is
+   non-zero for an instruction cache, whose accesses have no load or store
+   PC to stride-prefetch by */
+static void
+cache_pf_opt(struct cache_t *cp,	/* cache instance */
+	     char *name,		/* option name */
+	     char *opt,			/* option value */
+	     int inst)			/* instruction cache? */
+{
+  char type[128];
+  int n, nentries = 0, degree = 0;
+  enum cache_pf_class class;
+
+  if (!mystricmp(opt, "none"))
+    return;
+
+  n = sscanf(opt, "%127[^:]:%d:%d", type, &nentries, &degree);
+  if (n < 2)
+    fatal("bad %s prefetcher config `%s'", name, opt);
+  class = cache_str2pf(type);
+  if (class == PF_NextLine)
+    {
+      if (n != 2)
+	fatal("bad %s prefetcher config: next:<degree>", name);
+      degree = nentries;
+      nentries = 0;
+    }
+  else if (n != 3)
+    fatal("bad %s prefetcher config: %s:<entries>:<degree>", name, type);
+  if (class == PF_Stride && inst)
+    fatal("%s cannot be a stride prefetcher, fetches have no load/store PC",
+	  name);
+
+  cache_set_prefetcher(cp, class, nentries, degree, cache_pf_throttle);
+}
+
 /* check simulator-specific option values */
 void
 sim_check_options(struct opt_odb_t *odb,        /* options database */
@@ -923,6 +1217,9 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
   if (fastfwd_count < 0 || fastfwd_count >= 2147483647)
     fatal("bad fast forward count: %d", fastfwd_count);
 
+  if (bptrace_fname && fastfwd_count == 0)
+    fatal("branch trace capture (-bptrace) needs a fast forward count");
+
   if (ruu_ifq_size < 1 || (ruu_ifq_size & (ruu_ifq_size - 1)) != 0)
     fatal("inst fetch queue size must be positive > 0 and a power of two");
 
@@ -941,12 +1238,12 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
   else if (!mystricmp(pred_type, "taken"))
     {
       /* static predictor, not taken */
-      pred = bpred_create(BPredTaken, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+      pred = bpred_create(BPredTaken, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
     }
   else if (!mystricmp(pred_type, "nottaken"))
     {
       /* static predictor, taken */
-      pred = bpred_create(BPredNotTaken, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+      pred = bpred_create(BPredNotTaken, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
     }
   else if (!mystricmp(pred_type, "bimod"))
     {
@@ -966,6 +1263,7 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
 			  /* history xor address */0,
 			  /* btb sets */btb_config[0],
 			  /* btb assoc */btb_config[1],
+			  /* btb tag bits */btb_tag_bits,
 			  /* ret-addr stack size */ras_size);
     }
   else if (!mystricmp(pred_type, "2lev"))
@@ -985,6 +1283,7 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
 			  /* history xor address */twolev_config[3],
 			  /* btb sets */btb_config[0],
 			  /* btb assoc */btb_config[1],
+			  /* btb tag bits */btb_tag_bits,
 			  /* ret-addr stack size */ras_size);
     }
   else if (!mystricmp(pred_type, "comb"))
@@ -1008,6 +1307,7 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
 			  /* history xor address */twolev_config[3],
 			  /* btb sets */btb_config[0],
 			  /* btb assoc */btb_config[1],
+			  /* btb tag bits */btb_tag_bits,
 			  /* ret-addr stack size */ras_size);
     }
   else if (!mystricmp(pred_type, "alpha21264"))
@@ -1028,8 +1328,51 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
                         /* xor flag (unused) */0,
                         /* btb sets */btb_config[0],
                         /* btb assoc */btb_config[1],
+                        /* btb tag bits */btb_tag_bits,
                         /* ret-addr stack size */ras_size);
   }
+  else if (!mystricmp(pred_type, "tage"))
+    {
+      /* TAGE predictor, bpred_create() checks args */
+      if (tage_nelt != 6)
+	fatal("bad TAGE predictor config (<base_size> <num_tables> "
+	      "<table_size> <min_hist> <max_hist> <tag_bits>)");
+      if (btb_nelt != 2)
+	fatal("bad btb config (<num_sets> <associativity>)");
+
+      pred = bpred_create(BPredTage,
+			  /* base table size */tage_config[0],
+			  /* tagged tables */tage_config[1],
+			  /* tagged table size */tage_config[2],
+			  /* shortest history */tage_config[3],
+			  /* longest history */tage_config[4],
+			  /* tag bits */tage_config[5],
+			  /* btb sets */btb_config[0],
+			  /* btb assoc */btb_config[1],
+			  /* btb tag bits */btb_tag_bits,
+			  /* ret-addr stack size */ras_size);
+    }
+  else if (!mystricmp(pred_type, "hperc"))
+    {
+      /* hashed perceptron, bpred_create() checks args */
+      if (hperc_nelt != 4)
+	fatal("bad hashed perceptron config (<num_tables> <table_size> "
+	      "<weight_bits> <hist_size>)");
+      if (btb_nelt != 2)
+	fatal("bad btb config (<num_sets> <associativity>)");
+
+      pred = bpred_create(BPredHPerc,
+			  /* bimod table size */0,
+			  /* table size */hperc_config[1],
+			  /* weight bits */hperc_config[2],
+			  /* tables */hperc_config[0],
+			  /* history length */hperc_config[3],
+			  /* xor */0,
+			  /* btb sets */btb_config[0],
+			  /* btb assoc */btb_config[1],
+			  /* btb tag bits */btb_tag_bits,
+			  /* ret-addr stack size */ras_size);
+    }
     // -Project ///////////////////////////////////////////// Perceptron //////
 // This is similar to the BpredComb but with a perceptron predictor
   else if (!mystricmp(pred_type, "perceptron"))
@@ -1043,12 +1386,47 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
 			  0,                      /* history xor address */
 			  btb_config[0],          /* btb sets */
 			  btb_config[1],          /* btb assoc */
+			  btb_tag_bits,          /* btb tag bits */
 			  ras_size);              /* ret-addr stack size */
   }
 // -Project ///////////////////////////////////////////// Perceptron //////
   else
     fatal("cannot parse predictor type `%s'", pred_type);
 
+  if (ittage_config[0] && ittage_nelt != 5)
+    fatal("bad ITTAGE config (<num_tables> <table_size> <min_hist> "
+	  "<max_hist> <tag_bits>)");
+  if (sc_config[0] && sc_nelt != 4)
+    fatal("bad statistical corrector config (<num_tables> <table_size> "
+	  "<min_hist> <max_hist>)");
+  if (loop_entries < 0)
+    fatal("loop predictor entries must be non-negative");
+  if (pred && pred->class != BPredTaken && pred->class != BPredNotTaken)
+    bpred_components(pred,
+		     ittage_config[0]
+		     ? bpred_ittage_create(/* tables */ittage_config[0],
+					   /* table size */ittage_config[1],
+					   /* min hist */ittage_config[2],
+					   /* max hist */ittage_config[3],
+					   /* tag bits */ittage_config[4])
+		     : NULL,
+		     sc_config[0]
+		     ? bpred_sc_create(/* tables */sc_config[0],
+				       /* table size */sc_config[1],
+				       /* min hist */sc_config[2],
+				       /* max hist */sc_config[3])
+		     : NULL,
+		     loop_entries ? bpred_loop_create(loop_entries) : NULL);
+  if (pred)
+    bpred_retstack_mode(pred, ras_ckpt, ras_overflow_mode(ras_overflow_opt));
+  if ((bpred_load_fname || bpred_save_fname) && !pred)
+    fatal("predictor snapshots (-bpred:load, -bpred:save) need a "
+	  "non-perfect predictor");
+  if (bpred_prof_top < 0)
+    fatal("branch profile size must be non-negative");
+  if (bpred_prof_top && pred)
+    bpred_profile(pred);
+
   if (!bpred_spec_opt)
     bpred_spec_update = spec_CT;
   else if (!mystricmp(bpred_spec_opt, "ID"))
@@ -1091,6 +1469,10 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
       cache_dl1 = cache_create(name, nsets, bsize, /* balloc */FALSE,
 			       /* usize */0, assoc, cache_char2policy(c),
 			       dl1_access_fn, /* hit lat */cache_dl1_lat);
+      cache_mshr_opt(cache_dl1, "-cache:dl1mshr",
+		     cache_dl1_mshr_nelt, cache_dl1_mshr);
+      cache_pf_opt(cache_dl1, "-cache:dl1pf", cache_dl1_pf_opt,
+		   /* inst */FALSE);
 
       /* is the level 2 D-cache defined? */
       if (!mystricmp(cache_dl2_opt, "none"))
@@ -1104,6 +1486,10 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
 	  cache_dl2 = cache_create(name, nsets, bsize, /* balloc */FALSE,
 				   /* usize */0, assoc, cache_char2policy(c),
 				   dl2_access_fn, /* hit lat */cache_dl2_lat);
+	  cache_mshr_opt(cache_dl2, "-cache:dl2mshr",
+			 cache_dl2_mshr_nelt, cache_dl2_mshr);
+	  cache_pf_opt(cache_dl2, "-cache:dl2pf", cache_dl2_pf_opt,
+		       /* inst */FALSE);
 	}
     }
 
@@ -1147,6 +1533,10 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
       cache_il1 = cache_create(name, nsets, bsize, /* balloc */FALSE,
 			       /* usize */0, assoc, cache_char2policy(c),
 			       il1_access_fn, /* hit lat */cache_il1_lat);
+      cache_mshr_opt(cache_il1, "-cache:il1mshr",
+		     cache_il1_mshr_nelt, cache_il1_mshr);
+      cache_pf_opt(cache_il1, "-cache:il1pf", cache_il1_pf_opt,
+		   /* inst */TRUE);
 
       /* is the level 2 D-cache defined? */
       if (!mystricmp(cache_il2_opt, "none"))
@@ -1166,6 +1556,10 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
 	  cache_il2 = cache_create(name, nsets, bsize, /* balloc */FALSE,
 				   /* usize */0, assoc, cache_char2policy(c),
 				   il2_access_fn, /* hit lat */cache_il2_lat);
+	  cache_mshr_opt(cache_il2, "-cache:il2mshr",
+			 cache_il2_mshr_nelt, cache_il2_mshr);
+	  cache_pf_opt(cache_il2, "-cache:il2pf", cache_il2_pf_opt,
+		       /* inst */TRUE);
 	}
     }
 
@@ -1259,6 +1653,21 @@ sim_aux_config(FILE *stream)            /* output stream */
   /* nada */
 }
 
+/* register the average MSHR occupancy of cache CP, if it has MSHRs */
+static void
+mshr_reg_occupancy(struct cache_t *cp,	/* cache instance */
+		   struct stat_sdb_t *sdb)/* stats database */
+{
+  char buf[512], buf1[512];
+
+  if (!cp->mshr_nentries)
+    return;
+
+  sprintf(buf, "%s.mshr_occupancy", cp->name);
+  sprintf(buf1, "%s.mshr_busy_cycles / sim_cycle", cp->name);
+  stat_reg_formula(sdb, buf, "avg MSHR occupancy (MSHRs)", buf1, NULL);
+}
+
 /* register simulator-specific statistics */
 void
 sim_reg_stats(struct stat_sdb_t *sdb)   /* stats database */
@@ -1374,14 +1783,26 @@ sim_reg_stats(struct stat_sdb_t *sdb)   /* stats database */
   /* register cache stats */
   if (cache_il1
       && (cache_il1 != cache_dl1 && cache_il1 != cache_dl2))
-    cache_reg_stats(cache_il1, sdb);
+    {
+      cache_reg_stats(cache_il1, sdb);
+      mshr_reg_occupancy(cache_il1, sdb);
+    }
   if (cache_il2
       && (cache_il2 != cache_dl1 && cache_il2 != cache_dl2))
-    cache_reg_stats(cache_il2, sdb);
+    {
+      cache_reg_stats(cache_il2, sdb);
+      mshr_reg_occupancy(cache_il2, sdb);
+    }
   if (cache_dl1)
-    cache_reg_stats(cache_dl1, sdb);
+    {
+      cache_reg_stats(cache_dl1, sdb);
+      mshr_reg_occupancy(cache_dl1, sdb);
+    }
   if (cache_dl2)
-    cache_reg_stats(cache_dl2, sdb);
+    {
+      cache_reg_stats(cache_dl2, sdb);
+      mshr_reg_occupancy(cache_dl2, sdb);
+    }
   if (itlb)
     cache_reg_stats(itlb, sdb);
   if (dtlb)
@@ -1513,11 +1934,28 @@ sim_load_prog(char *fname,		/* program to load */
   dlite_init(simoo_reg_obj, simoo_mem_obj, simoo_mstate_obj);
 }
 
+/* function containing PC, for the branch profiles */
+static char *
+prof_sym(md_addr_t pc, int *offset)
+{
+  struct sym_sym_t *sym;
+  int index;
+
+  if (!(sym = sym_bind_addr(pc, &index, /* !exact */FALSE, sdb_text)))
+    return NULL;
+  *offset = (int)(pc - sym->addr);
+  return sym->name;
+}
+
 /* dump simulator-specific auxiliary simulator statistics */
 void
 sim_aux_stats(FILE *stream)             /* output stream */
 {
-  /* nada */
+  if (pred && bpred_prof_top)
+    {
+      sym_loadsyms(ld_prog_fname, /* !locals */FALSE);
+      bpred_profile_print(pred, bpred_prof_top, prof_sym, stream);
+    }
 }
 
 /* un-initialize the simulator */
@@ -1526,6 +1964,14 @@ sim_uninit(void)
 {
   if (ptrace_nelt > 0)
     ptrace_close();
+
+  /* the run ended before -bpred:save_at, or there was none */
+  if (bpred_save_fname && !bpred_saved)
+    bpred_save(pred, bpred_save_fname);
+
+  /* program exited while fast forwarding */
+  if (bptrace)
+    bptrace_close(bptrace, bptrace_ninsts);
 }
 
 
@@ -2242,6 +2688,12 @@ ruu_commit(void)
 	    {
 	      struct res_template *fu;
 
+	      /* a store that would miss with no D-cache MSHR free cannot
+		 commit, we'll try to commit it again next cycle */
+	      if (cache_dl1
+		  && !cache_mshr_free(cache_dl1, (LSQ[LSQ_head].addr&~3),
+				      sim_cycle))
+		break;
 
 	      /* stores must retire their store value to the cache at commit,
 		 try to get a store port (functional unit allocation) */
@@ -2259,9 +2711,10 @@ ruu_commit(void)
 		  if (cache_dl1)
 		    {
 		      /* commit store value to D-cache */
+		      cache_dl1->pf_pc = LSQ[LSQ_head].PC;
 		      lat =
-			cache_access(cache_dl1, Write, (LSQ[LSQ_head].addr&~3),
-				     NULL, 4, sim_cycle, NULL, NULL);
+			cache_access_fast(cache_dl1, Write, (LSQ[LSQ_head].addr&~3),
+					  NULL, 4, sim_cycle, NULL, NULL);
 		      if (lat > cache_dl1_lat)
 			events |= PEV_CACHEMISS;
 		    }
@@ -2271,8 +2724,8 @@ ruu_commit(void)
 		    {
 		      /* access the D-TLB */
 		      lat =
-			cache_access(dtlb, Read, (LSQ[LSQ_head].addr & ~3),
-				     NULL, 4, sim_cycle, NULL, NULL);
+			cache_access_fast(dtlb, Read, (LSQ[LSQ_head].addr & ~3),
+					  NULL, 4, sim_cycle, NULL, NULL);
 		      if (lat > 1)
 			events |= PEV_TLBMISS;
 		    }
@@ -2476,7 +2929,10 @@ ruu_writeback(void)
 	  /* recover processor state and reinit fetch to correct path */
 	  ruu_recover(rs - RUU);
 	  tracer_recover();
-	  bpred_recover(pred, rs->PC, rs->stack_recover_idx);
+	  bpred_recover(pred, rs->PC, rs->stack_recover_idx,
+			&rs->dir_update,
+			/* taken? */rs->next_PC != (rs->PC +
+						   sizeof(md_inst_t)));
 
 	  /* stall fetch until I-fetch and I-decode recover */
 	  ruu_fetch_issue_delay = ruu_branch_penalty;
@@ -2670,6 +3126,35 @@ lsq_refresh(void)
 }
 
 
+/* return non-zero if an earlier store in the LSQ forwards its value to
+   load RS */
+static int
+lsq_forward(struct RUU_station *rs)	/* load LSQ entry */
+{
+  int i = (rs - LSQ);
+
+  if (i == LSQ_head)
+    return FALSE;
+
+  for (;;)
+    {
+      /* go to next earlier LSQ entry */
+      i = (i + (LSQ_size-1)) % LSQ_size;
+
+      /* FIXME: not dealing with partials! */
+      if ((MD_OP_FLAGS(LSQ[i].op) & F_STORE)
+	  && (LSQ[i].addr == rs->addr))
+	{
+	  /* hit in the LSQ */
+	  return TRUE;
+	}
+
+      /* scan finished? */
+      if (i == LSQ_head)
+	return FALSE;
+    }
+}
+
 /*
  *  RUU_ISSUE() - issue instructions to functional units
  */
@@ -2684,7 +3169,7 @@ lsq_refresh(void)
 static void
 ruu_issue(void)
 {
-  int i, load_lat, tlb_lat, n_issued;
+  int load_lat, tlb_lat, n_issued;
   struct RS_link *node, *next_node;
   struct res_template *fu;
 
@@ -2741,6 +3226,16 @@ ruu_issue(void)
 	      /* one more inst issued */
 	      n_issued++;
 	    }
+	  else if (rs->in_LSQ
+		   && ((MD_OP_FLAGS(rs->op) & (F_MEM|F_LOAD)) == (F_MEM|F_LOAD))
+		   && cache_dl1 && MD_VALID_ADDR(rs->addr)
+		   && !lsq_forward(rs)
+		   && !cache_mshr_free(cache_dl1, (rs->addr & ~3), sim_cycle))
+	    {
+	      /* the load would miss with no D-cache MSHR free, put it back
+		 onto the ready list, we'll try to issue it again next cycle */
+	      readyq_enqueue(rs);
+	    }
 	  else
 	    {
 	      /* issue the instruction to a functional unit */
@@ -2768,29 +3263,7 @@ ruu_issue(void)
 			  /* for loads, determine cache access latency:
 			     first scan LSQ to see if a store forward is
 			     possible, if not, access the data cache */
-			  load_lat = 0;
-			  i = (rs - LSQ);
-			  if (i != LSQ_head)
-			    {
-			      for (;;)
-				{
-				  /* go to next earlier LSQ entry */
-				  i = (i + (LSQ_size-1)) % LSQ_size;
-
-				  /* FIXME: not dealing with partials! */
-				  if ((MD_OP_FLAGS(LSQ[i].op) & F_STORE)
-				      && (LSQ[i].addr == rs->addr))
-				    {
-				      /* hit in the LSQ */
-				      load_lat = 1;
-				      break;
-				    }
-
-				  /* scan finished? */
-				  if (i == LSQ_head)
-				    break;
-				}
-			    }
+			  load_lat = lsq_forward(rs) ? 1 : 0;
 
 			  /* was the value store forwared from the LSQ? */
 			  if (!load_lat)
@@ -2804,10 +3277,11 @@ ruu_issue(void)
 			      if (cache_dl1 && valid_addr)
 				{
 				  /* access the cache if non-faulting */
+				  cache_dl1->pf_pc = rs->PC;
 				  load_lat =
-				    cache_access(cache_dl1, Read,
-						 (rs->addr & ~3), NULL, 4,
-						 sim_cycle, NULL, NULL);
+				    cache_access_fast(cache_dl1, Read,
+						      (rs->addr & ~3), NULL, 4,
+						      sim_cycle, NULL, NULL);
 				  if (load_lat > cache_dl1_lat)
 				    events |= PEV_CACHEMISS;
 				}
@@ -2824,8 +3298,8 @@ ruu_issue(void)
 			      /* access the D-DLB, NOTE: this code will
 				 initiate speculative TLB misses */
 			      tlb_lat =
-				cache_access(dtlb, Read, (rs->addr & ~3),
-					     NULL, 4, sim_cycle, NULL, NULL);
+				cache_access_fast(dtlb, Read, (rs->addr & ~3),
+						  NULL, 4, sim_cycle, NULL, NULL);
 			      if (tlb_lat > 1)
 				events |= PEV_TLBMISS;
 
@@ -3965,6 +4439,16 @@ ruu_dispatch(void)
 	  if (!pred_perfect)
 	    ruu_fetch_issue_delay = ruu_branch_penalty;
 
+	  /* the squashed fetches went through the predictor too; roll its
+	     speculative state back to just after this branch (a call keeps
+	     its own ret-addr stack push) */
+	  if (pred && !pred_perfect)
+	    bpred_recover(pred, regs.regs_PC,
+			  MD_IS_CALL(op) && pred->retstack.size
+			  ? (stack_recover_idx + 1) % pred->retstack.size
+			  : stack_recover_idx,
+			  dir_update_ptr, br_taken);
+
 	  fetch_redirected = TRUE;
 	}
 
@@ -4296,6 +4780,12 @@ ruu_fetch(void)
 	  && fetch_regs_PC < (ld_text_base+ld_text_size)
 	  && !(fetch_regs_PC & (sizeof(md_inst_t)-1)))
 	{
+	  /* an I-cache miss with no MSHR free, fetch again next cycle */
+	  if (cache_il1
+	      && !cache_mshr_free(cache_il1, IACOMPRESS(fetch_regs_PC),
+				  sim_cycle))
+	    break;
+
 	  /* read instruction from memory */
 	  MD_FETCH_INST(inst, mem, fetch_regs_PC);
 
@@ -4303,11 +4793,13 @@ ruu_fetch(void)
 	  lat = cache_il1_lat;
 	  if (cache_il1)
 	    {
-	      /* access the I-cache */
+	      /* access the I-cache, fetches do not train the stride
+		 prefetcher of a unified cache (il1 may be dl1) */
+	      cache_il1->pf_pc = 0;
 	      lat =
-		cache_access(cache_il1, Read, IACOMPRESS(fetch_regs_PC),
-			     NULL, ISCOMPRESS(sizeof(md_inst_t)), sim_cycle,
-			     NULL, NULL);
+		cache_access_fast(cache_il1, Read, IACOMPRESS(fetch_regs_PC),
+				  NULL, ISCOMPRESS(sizeof(md_inst_t)), sim_cycle,
+				  NULL, NULL);
 	      if (lat > cache_il1_lat)
 		last_inst_missed = TRUE;
 	    }
@@ -4317,9 +4809,9 @@ ruu_fetch(void)
 	      /* access the I-TLB, NOTE: this code will initiate
 		 speculative TLB misses */
 	      tlb_lat =
-		cache_access(itlb, Read, IACOMPRESS(fetch_regs_PC),
-			     NULL, ISCOMPRESS(sizeof(md_inst_t)), sim_cycle,
-			     NULL, NULL);
+		cache_access_fast(itlb, Read, IACOMPRESS(fetch_regs_PC),
+				  NULL, ISCOMPRESS(sizeof(md_inst_t)), sim_cycle,
+				  NULL, NULL);
 	      if (tlb_lat > 1)
 		last_inst_tmissed = TRUE;
 
@@ -4532,6 +5024,9 @@ sim_main(void)
 
       fprintf(stderr, "sim: ** fast forwarding %d insts **\n", fastfwd_count);
 
+      if (bptrace_fname)
+	bptrace = bptrace_create(bptrace_fname, regs.regs_PC);
+
       for (icount=0; icount < fastfwd_count; icount++)
 	{
 	  /* maintain $r0 semantics */
@@ -4581,6 +5076,14 @@ sim_main(void)
 		is_write = TRUE;
 	    }
 
+	  /* record control instructions in the branch trace */
+	  bptrace_ninsts++;
+	  if (bptrace && (MD_OP_FLAGS(op) & F_CTRL))
+	    bptrace_write(bptrace, regs.regs_PC, target_PC, op,
+			  /* taken? */regs.regs_NPC != (regs.regs_PC +
+						     sizeof(md_inst_t)),
+			  MD_IS_CALL(op), MD_IS_RETURN(op));
+
 	  /* check for DLite debugger entry condition */
 	  if (dlite_check_break(regs.regs_NPC,
 				is_write ? ACCESS_WRITE : ACCESS_READ,
@@ -4591,8 +5094,18 @@ sim_main(void)
 	  regs.regs_PC = regs.regs_NPC;
 	  regs.regs_NPC += sizeof(md_inst_t);
 	}
+
+      if (bptrace)
+	{
+	  bptrace_close(bptrace, bptrace_ninsts);
+	  bptrace = NULL;
+	}
     }
 
+  /* warm the predictor from a snapshot */
+  if (bpred_load_fname)
+    bpred_load(pred, bpred_load_fname);
+
   fprintf(stderr, "sim: ** starting performance simulation **\n");
 
   /* set up timing simulation entry state */
@@ -4673,6 +5186,14 @@ sim_main(void)
       /* go to next cycle */
       sim_cycle++;
 
+      /* snapshot the warmed predictor */
+      if (bpred_save_fname && !bpred_saved && bpred_save_at
+	  && sim_num_insn >= bpred_save_at)
+	{
+	  bpred_save(pred, bpred_save_fname);
+	  bpred_saved = TRUE;
+	}
+
       /* finish early? */
       if (max_insts && sim_num_insn >= max_insts)
 	return;